@@ -80,17 +80,27 @@ ApIrqInterruptHandler (
   IN  EFI_SYSTEM_CONTEXT         SystemContext
   )
 {
-  EFI_STATUS  Status;
-  UINT64      Bitmap;
+  EFI_STATUS                   Status;
+  FFA_EX_NOTIFICATION_BITMAPS  Bitmaps;
 
   DEBUG ((DEBUG_INFO, "Received IRQ interrupt %d!\n", Source));
 
-  // Then register this test app to receive notifications from the Ffa test SP
-  Status = FfaNotificationGet (0, ARM_FFA_NOTIFICATION_FLAG_BITMAP_SP, &Bitmap);
+  // Retrieve every pending notification source with a single call
+  Status = FfaNotificationGetAll (
+             0,
+             ARM_FFA_NOTIFICATION_FLAG_BITMAP_SP | ARM_FFA_NOTIFICATION_FLAG_BITMAP_VM | ARM_FFA_NOTIFICATION_FLAG_BITMAP_HYP,
+             &Bitmaps
+             );
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "Unable to notification get with FF-A Ffa test SP (%r).\n", Status));
   } else {
-    DEBUG ((DEBUG_INFO, "Got notification from FF-A Ffa test SP with VM bitmap %x.\n", Bitmap));
+    DEBUG ((
+      DEBUG_INFO,
+      "Got notification with SP bitmap %lx, VM bitmap %lx, HYP bitmap %lx.\n",
+      Bitmaps.SpBitmap,
+      Bitmaps.VmBitmap,
+      Bitmaps.HypBitmap
+      ));
   }
 
   mIsInterruptFired = TRUE;
@@ -470,12 +480,11 @@ FfaMiscRegisterNotifications (
 {
   EFI_STATUS  Status = EFI_SUCCESS;
   UINTN       SriIndex;
-  UINTN       Dummy;
 
   DEBUG ((DEBUG_INFO, "%a: enter...\n", __func__));
 
   // Followed by querying which notification ID is supported by the Ffa test SP
-  Status = ArmFfaLibGetFeatures (ARM_FFA_FEATURE_ID_SCHEDULE_RECEIVER_INTERRUPT, 0, &SriIndex, &Dummy);
+  Status = FfaExGetFeatureProperty (ARM_FFA_FEATURE_ID_SCHEDULE_RECEIVER_INTERRUPT, &SriIndex);
   if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_ERROR, "Unable to query feature SRI number with FF-A Ffa test SP (%r).\n", Status));
     UT_ASSERT_NOT_EFI_ERROR (Status);
@@ -1246,8 +1255,6 @@ FfaMiscTestFfaNsResInfoGet (
   FFA_RESOURCE_INFO_DESC_HEADER  *ResourceDescHeader;
   FFA_ADDRESS_MAP_DESC           *AddressMapDescArray;
   UINT32                         Index;
-  UINTN                          Property1;
-  UINTN                          Property2;
 
   DEBUG ((DEBUG_INFO, "%a: enter...\n", __func__));
 
@@ -1255,9 +1262,8 @@ FfaMiscTestFfaNsResInfoGet (
   UT_ASSERT_NOT_NULL (FfaTestContext);
 
   // Check if FFA_NS_RES_INFO_GET is supported
-  Status = ArmFfaLibGetFeatures (ARM_FID_FFA_NS_RES_INFO_GET, 0, &Property1, &Property2);
-  if (EFI_ERROR (Status)) {
-    DEBUG ((DEBUG_INFO, "FFA_NS_RES_INFO_GET is UNSUPPORTED (%r).\n", Status));
+  if (!FfaExIsFeatureSupported (ARM_FID_FFA_NS_RES_INFO_GET)) {
+    DEBUG ((DEBUG_INFO, "FFA_NS_RES_INFO_GET is UNSUPPORTED.\n"));
     return UNIT_TEST_PASSED;
   }
 
@@ -0,0 +1,52 @@
+/** @file
+  Service GUIDs in the byte order FF-A carries them in.
+
+  FF-A carries a UUID as 16 bytes in RFC 4122 order, so the Data1, Data2 and
+  Data3 fields of an EFI_GUID are byte swapped on the wire. A GUID known at
+  build time can be declared in wire order with FFA_WIRE_GUID_INIT, and then
+  compared to the UUID of a message as two 64-bit words, with nothing to swap
+  or copy.
+
+  Copyright (c), Microsoft Corporation.
+
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+**/
+
+#ifndef FFA_WIRE_GUID_H_
+#define FFA_WIRE_GUID_H_
+
+///
+/// A GUID in FF-A wire byte order. Words[0] and Words[1] are the registers it
+/// is carried in, e.g. x2 and x3 of FFA_MSG_SEND_DIRECT_REQ2.
+///
+typedef union {
+  EFI_GUID    Guid;
+  UINT64      Words[2];
+} FFA_WIRE_GUID;
+
+#define FFA_WIRE_GUID_SWAP16(Value) \
+  ((UINT16)((((Value) & 0x00FFU) << 8) | (((Value) & 0xFF00U) >> 8)))
+
+#define FFA_WIRE_GUID_SWAP32(Value)                                     \
+  ((UINT32)((((Value) & 0x000000FFU) << 24) | (((Value) & 0x0000FF00U) << 8) | \
+            (((Value) & 0x00FF0000U) >> 8) | (((Value) & 0xFF000000U) >> 24)))
+
+#define FFA_WIRE_GUID_INIT_FIELDS(Data1, Data2, Data3, ...)  \
+  { { FFA_WIRE_GUID_SWAP32 (Data1), FFA_WIRE_GUID_SWAP16 (Data2), \
+      FFA_WIRE_GUID_SWAP16 (Data3), __VA_ARGS__ } }
+
+///
+/// Initializer of an FFA_WIRE_GUID, taking the fields of the GUID in the
+/// usual EFI_GUID order, e.g.
+///   FFA_WIRE_GUID_INIT (0x6d3b4d2a, 0x1f0e, 0x4a7c, { 0x9b, ... })
+///
+#define FFA_WIRE_GUID_INIT(...)  FFA_WIRE_GUID_INIT_FIELDS (__VA_ARGS__)
+
+///
+/// TRUE if two FFA_WIRE_GUIDs are equal.
+///
+#define FFA_WIRE_GUID_EQUAL(WireGuid1, WireGuid2)           \
+  (((WireGuid1)->Words[0] == (WireGuid2)->Words[0]) &&      \
+   ((WireGuid1)->Words[1] == (WireGuid2)->Words[1]))
+
+#endif /* FFA_WIRE_GUID_H_ */
@@ -9,8 +9,13 @@
 #ifndef NOTIFICATION_SERVICE_FFA_H_
 #define NOTIFICATION_SERVICE_FFA_H_
 
-#define NOTIFICATION_SERVICE_UUID \
-  { 0xe474d87e, 0x5731, 0x4044, { 0xa7, 0x27, 0xcb, 0x3e, 0x8c, 0xf3, 0xc8, 0xdf } }
+#include <Guid/FfaWireGuid.h>
+
+#define NOTIFICATION_SERVICE_UUID_FIELDS \
+  0xe474d87e, 0x5731, 0x4044, { 0xa7, 0x27, 0xcb, 0x3e, 0x8c, 0xf3, 0xc8, 0xdf }
+
+#define NOTIFICATION_SERVICE_UUID       { NOTIFICATION_SERVICE_UUID_FIELDS }
+#define NOTIFICATION_SERVICE_WIRE_UUID  FFA_WIRE_GUID_INIT (NOTIFICATION_SERVICE_UUID_FIELDS)
 
 #define NOTIFICATION_STATUS_SUCCESS            (0)
 #define NOTIFICATION_STATUS_NOT_SUPPORTED      (-1)
@@ -9,8 +9,13 @@
 #ifndef TEST_SERVICE_FFA_H_
 #define TEST_SERVICE_FFA_H_
 
-#define TEST_SERVICE_UUID \
-  { 0xe0fad9b3, 0x7f5c, 0x42c5, { 0xb2, 0xee, 0xb7, 0xa8, 0x23, 0x13, 0xcd, 0xb2 } }
+#include <Guid/FfaWireGuid.h>
+
+#define TEST_SERVICE_UUID_FIELDS \
+  0xe0fad9b3, 0x7f5c, 0x42c5, { 0xb2, 0xee, 0xb7, 0xa8, 0x23, 0x13, 0xcd, 0xb2 }
+
+#define TEST_SERVICE_UUID       { TEST_SERVICE_UUID_FIELDS }
+#define TEST_SERVICE_WIRE_UUID  FFA_WIRE_GUID_INIT (TEST_SERVICE_UUID_FIELDS)
 
 #define TEST_STATUS_SUCCESS            (0)
 #define TEST_STATUS_GENERIC_ERROR      (-1)
@@ -11,8 +11,17 @@
 #define FF_A_HELPER_LIB_H_
 
 #include <Base.h>
+#include <Guid/FfaWireGuid.h>
 
-#if PcdGetBool (PcdFfaLibConduitSmc) == 1
+//
+// The instances binding the conduit at build time say so with a define, for
+// the others PcdFfaLibConduitSmc decides.
+//
+#if defined (FFA_LIB_EX_CONDUIT_SMC)
+typedef ARM_SMC_ARGS ARM_SXC_ARGS;
+#elif defined (FFA_LIB_EX_CONDUIT_SVC)
+typedef ARM_SVC_ARGS ARM_SXC_ARGS;
+#elif PcdGetBool (PcdFfaLibConduitSmc) == 1
 typedef ARM_SMC_ARGS ARM_SXC_ARGS;
 #else
 typedef ARM_SVC_ARGS ARM_SXC_ARGS;
@@ -74,6 +83,45 @@ typedef struct {
   UINTN       Arg13;
 } DIRECT_MSG_ARGS_EX;
 
+///
+/// Number of payload registers of FFA_MSG_SEND_DIRECT_REQ2, x4-x17.
+///
+#define FFA_EX_DIRECT_MSG_PAYLOAD_COUNT  14
+
+/**
+ * @brief Direct message in register order
+ *
+ * Mirrors x0-x17 exactly, so that the library traps with the message in
+ * place: there is nothing to pack or unpack. Payload[N] is ArgN of a
+ * FFA_MSG_SEND_DIRECT_REQ2 or RESP2 in DIRECT_MSG_ARGS_EX. A v1 direct
+ * request is returned as received, with Arg0-Arg5 in x2-x7; use
+ * FfaExDirectMsgToArgs to read it.
+ */
+typedef struct {
+  /// Function ID, x0
+  UINTN            FunctionId;
+
+  /// Source endpoint ID [31:16] and destination endpoint ID [15:0], x1
+  UINTN            EndpointIds;
+
+  /// Service UUID in wire byte order, x2-x3
+  FFA_WIRE_GUID    ServiceGuid;
+
+  /// Implementation defined payload, x4-x17
+  UINTN            Payload[FFA_EX_DIRECT_MSG_PAYLOAD_COUNT];
+} FFA_EX_DIRECT_MSG;
+
+#define FFA_EX_DIRECT_MSG_ENDPOINT_IDS(SourceId, DestinationId) \
+  (((UINTN)(UINT16)(SourceId) << 16) | (UINT16)(DestinationId))
+
+#define FFA_EX_DIRECT_MSG_SOURCE_ID(Message)       ((UINT16)((Message)->EndpointIds >> 16))
+#define FFA_EX_DIRECT_MSG_DESTINATION_ID(Message)  ((UINT16)(Message)->EndpointIds)
+
+///
+/// ArgN of DIRECT_MSG_ARGS_EX, for a FFA_MSG_SEND_DIRECT_REQ2 or RESP2.
+///
+#define FFA_EX_DIRECT_MSG_ARG(Message, Index)  ((Message)->Payload[(Index)])
+
 #pragma pack(1)
 
 /**
@@ -98,6 +146,85 @@ typedef struct {
   UINT16    EndpointId;
   UINT8     Flags;
 } FFA_ADDRESS_MAP_DESC;
+
+/**
+ * Partition message header
+ * Precedes the payload of an indirect message (FFA_MSG_SEND2) in the TX
+ * buffer of the sender and the RX buffer of the receiver
+ */
+typedef struct {
+  UINT32      Flags;
+  UINT32      Reserved1;
+  UINT32      PayloadOffset;
+  UINT16      ReceiverId;
+  UINT16      SenderId;
+  UINT32      PayloadSize;
+  UINT32      Reserved2;
+  EFI_GUID    ServiceGuid;
+} FFA_EX_PARTITION_MSG_HEADER;
+
+/**
+ * Memory transaction descriptor
+ * Starts the descriptor of an FFA_MEM_SHARE, FFA_MEM_LEND or FFA_MEM_DONATE
+ * transaction, the endpoint memory access descriptors follow at
+ * MemAccessDescOffset
+ */
+typedef struct {
+  UINT16    SenderId;
+  UINT16    Attributes;
+  UINT32    Flags;
+  UINT64    Handle;
+  UINT64    Tag;
+  UINT32    MemAccessDescSize;
+  UINT32    MemAccessDescCount;
+  UINT32    MemAccessDescOffset;
+  UINT8     Reserved[12];
+} FFA_EX_MEM_TRANSACTION_DESC;
+
+/**
+ * Endpoint memory access descriptor
+ * Grants a receiver access to the memory region described by the composite
+ * memory region descriptor at CompositeOffset
+ */
+typedef struct {
+  UINT16    ReceiverId;
+  UINT8     Permissions;
+  UINT8     Flags;
+  UINT32    CompositeOffset;
+  UINT64    Reserved;
+} FFA_EX_MEM_ACCESS_DESC;
+
+/**
+ * Composite memory region descriptor
+ * Followed by AddressRangeCount constituent memory region descriptors
+ */
+typedef struct {
+  UINT32    TotalPageCount;
+  UINT32    AddressRangeCount;
+  UINT64    Reserved;
+} FFA_EX_MEM_COMPOSITE_DESC;
+
+/**
+ * Constituent memory region descriptor
+ * One physically contiguous range of 4K pages of a memory region
+ */
+typedef struct {
+  UINT64    Address;
+  UINT32    PageCount;
+  UINT32    Reserved;
+} FFA_EX_MEM_CONSTITUENT_DESC;
+
+/**
+ * Memory relinquish descriptor
+ * Passed to FFA_MEM_RELINQUISH in the TX buffer, here with the ID of a single
+ * relinquishing endpoint
+ */
+typedef struct {
+  UINT64    Handle;
+  UINT32    Flags;
+  UINT32    EndpointCount;
+  UINT16    EndpointId;
+} FFA_EX_MEM_RELINQUISH_DESC;
 #pragma pack()
 
 /**
@@ -121,13 +248,73 @@ FfaMessageWait (
   OUT DIRECT_MSG_ARGS_EX  *Message
   );
 
+/**
+ * @brief      Same as FfaMessageWait, but returns the service GUID of a
+ *             direct request as received, for routing with
+ *             FFA_WIRE_GUID_EQUAL.
+ * @note       The ServiceGuid field of Message is zeroed.
+ *
+ * @param[out] Message      The incoming message
+ * @param[out] ServiceGuid  The service GUID of the message in wire byte
+ *                          order, zero for other than FFA_MSG_SEND_DIRECT_REQ2
+ *
+ * @return     The FF-A error status code
+ */
+EFI_STATUS
+EFIAPI
+FfaExMessageWaitWire (
+  OUT DIRECT_MSG_ARGS_EX  *Message,
+  OUT FFA_WIRE_GUID       *ServiceGuid
+  );
+
+/**
+ * @brief      Same as FfaMessageWait, but decides what becomes of an RX
+ *             buffer still held since FfaIndirectMsgReceive.
+ * @note       From FF-A v1.1 on, the release is folded into FFA_MSG_WAIT,
+ *             saving the FFA_RX_RELEASE trap. Before v1.1 it is issued
+ *             separately. Keeping the RX buffer takes FF-A v1.2, a v1.1
+ *             SPMC releases it with any FFA_MSG_WAIT.
+ *
+ * @param[out] Message    The incoming message
+ * @param[in]  ReleaseRx  TRUE to release the RX buffer, FALSE to keep it
+ *                        across the wait
+ *
+ * @return     The FF-A error status code
+ */
+EFI_STATUS
+EFIAPI
+FfaExMessageWaitRx (
+  OUT DIRECT_MSG_ARGS_EX  *Message,
+  IN  BOOLEAN             ReleaseRx
+  );
+
+/**
+ * @brief      Hands the interrupts deferred while requests of the partition
+ *             were pending to SecurePartitionInterruptHandler, oldest first.
+ * @note       Only interrupts are deferred when PcdFfaLibExDeferInterrupts
+ *             is set. The deferred work also runs on its own the next time
+ *             the partition is idle: on an interrupt received after a direct
+ *             response or while waiting for a message, and before
+ *             FfaMessageWait blocks.
+ *
+ * @return     The number of interrupts handled
+ */
+UINTN
+EFIAPI
+FfaExRunDeferredWork (
+  VOID
+  );
+
 /** Messaging interfaces */
 
 /**
  * @brief      Sends a 32 bit partition message in parameter registers as a
  *             request and blocks until the response is available.
  * @note       The ffa_interrupt_handler function can be called during the
- *             execution of this function
+ *             execution of this function, unless PcdFfaLibExDeferInterrupts
+ *             is set, see FfaExRunDeferredWork. A callee that yields or is
+ *             preempted is resumed at once, see FfaExDirectReq2Start to do
+ *             other work meanwhile.
  *
  * @param[in]  source            Source endpoint ID
  * @param[in]  dest              Destination endpoint ID
@@ -144,6 +331,215 @@ FfaMessageSendDirectReq2 (
   IN OUT  DIRECT_MSG_ARGS_EX  *ImpDefArgs
   );
 
+#ifndef ARM_FID_FFA_YIELD
+#define ARM_FID_FFA_YIELD  0x8400006C
+#endif
+
+#ifndef ARM_FID_FFA_RUN
+#define ARM_FID_FFA_RUN  0x8400006D
+#endif
+
+///
+/// A direct request whose callee yielded or was preempted before responding.
+///
+typedef struct {
+  ///
+  /// Endpoint ID [31:16] and vCPU ID [15:0] of the callee, as FFA_RUN takes
+  /// them.
+  ///
+  UINT32     Target;
+  ///
+  /// Nanoseconds after which the callee asked to be resumed through
+  /// FFA_YIELD, 0 if it gave no hint or was preempted.
+  ///
+  UINT64     Timeout;
+  ///
+  /// TRUE until the callee responds.
+  ///
+  BOOLEAN    Pending;
+} FFA_EX_DIRECT_REQ;
+
+/**
+ * @brief      Sends a partition message in parameter registers as a request
+ *             without waiting out a callee that yields or is preempted.
+ * @note       When the callee yields with FFA_YIELD, or the request is
+ *             preempted by an interrupt the caller has to take, this returns
+ *             EFI_NOT_READY and Request tells whom to resume. The caller can
+ *             do other work and complete the request with
+ *             FfaExDirectReq2Resume. Interrupts of the partition itself are
+ *             handled as for FfaMessageSendDirectReq2.
+ *
+ * @param[in]     DestPartId   Destination endpoint ID
+ * @param[in]     ServiceGuid  Service UUID, NULL for none
+ * @param[in,out] ImpDefArgs   The message, the response when this returns
+ *                             EFI_SUCCESS
+ * @param[out]    Request      The state of the request
+ *
+ * @retval     EFI_SUCCESS    The response is in ImpDefArgs
+ * @retval     EFI_NOT_READY  The request is in progress
+ * @return     Others         The FF-A error status code
+ */
+EFI_STATUS
+EFIAPI
+FfaExDirectReq2Start (
+  IN      UINT16              DestPartId,
+  IN      EFI_GUID            *ServiceGuid OPTIONAL,
+  IN OUT  DIRECT_MSG_ARGS_EX  *ImpDefArgs,
+  OUT     FFA_EX_DIRECT_REQ   *Request
+  );
+
+/**
+ * @brief      Resumes the callee of an in progress direct request with
+ *             FFA_RUN.
+ * @note       If FFA_RUN itself fails, the request stays pending and can be
+ *             resumed again.
+ *
+ * @param[in,out] Request   The state of the request
+ * @param[out]    Response  The response, when this returns EFI_SUCCESS
+ *
+ * @retval     EFI_SUCCESS            The callee responded
+ * @retval     EFI_NOT_READY          The callee yielded or was preempted again
+ * @retval     EFI_INVALID_PARAMETER  The request is not pending
+ * @return     Others                 The FF-A error status code
+ */
+EFI_STATUS
+EFIAPI
+FfaExDirectReq2Resume (
+  IN OUT  FFA_EX_DIRECT_REQ   *Request,
+  OUT     DIRECT_MSG_ARGS_EX  *Response
+  );
+
+/**
+ * @brief      Same as FfaMessageSendDirectReq2, but takes the service GUID
+ *             in wire byte order, e.g. from FFA_WIRE_GUID_INIT, so that it
+ *             goes to the registers as is.
+ * @note       The ServiceGuid field of ImpDefArgs is not used, and zeroed
+ *             with the response.
+ *
+ * @param[in]     DestPartId   Destination endpoint ID
+ * @param[in]     ServiceGuid  Service UUID in wire byte order, NULL for none
+ * @param[in,out] ImpDefArgs   The message, the response on return
+ *
+ * @return     The FF-A error status code
+ */
+EFI_STATUS
+EFIAPI
+FfaExMessageSendDirectReq2Wire (
+  IN      UINT16               DestPartId,
+  IN      CONST FFA_WIRE_GUID  *ServiceGuid OPTIONAL,
+  IN OUT  DIRECT_MSG_ARGS_EX   *ImpDefArgs
+  );
+
+/**
+ * @brief      Converts a GUID to FF-A wire byte order, for GUIDs not known
+ *             at build time.
+ *
+ * @param[in]  Guid      The GUID
+ * @param[out] WireGuid  The GUID in wire byte order
+ */
+VOID
+EFIAPI
+FfaExGuidToWireGuid (
+  IN  CONST EFI_GUID  *Guid,
+  OUT FFA_WIRE_GUID   *WireGuid
+  );
+
+/**
+ * @brief      Converts a GUID in FF-A wire byte order back to an EFI_GUID.
+ *
+ * @param[in]  WireGuid  The GUID in wire byte order
+ * @param[out] Guid      The GUID
+ */
+VOID
+EFIAPI
+FfaExWireGuidToGuid (
+  IN  CONST FFA_WIRE_GUID  *WireGuid,
+  OUT EFI_GUID             *Guid
+  );
+
+/**
+ * Register order direct messaging interfaces
+ *
+ * @note Same as FfaMessageSendDirectReq2, FfaMessageSendDirectResp2 and
+ * FfaMessageWait, but the message is an FFA_EX_DIRECT_MSG that the call is
+ * issued on in place. Callee yields and preemptions are resumed at once, and
+ * interrupts are handled as for the DIRECT_MSG_ARGS_EX interfaces.
+ */
+
+/**
+ * @brief      Sends Message as a FFA_MSG_SEND_DIRECT_REQ2 and returns the
+ *             response in it.
+ *
+ * @param[in]     DestPartId   Destination endpoint ID
+ * @param[in]     ServiceGuid  Service UUID in wire byte order, NULL for none
+ * @param[in,out] Message      Payload of the request, the response on return
+ *
+ * @return     The FF-A error status code
+ */
+EFI_STATUS
+EFIAPI
+FfaExDirectMsgSendReq2 (
+  IN      UINT16               DestPartId,
+  IN      CONST FFA_WIRE_GUID  *ServiceGuid OPTIONAL,
+  IN OUT  FFA_EX_DIRECT_MSG    *Message
+  );
+
+/**
+ * @brief      Sends Message as a FFA_MSG_SEND_DIRECT_RESP2 and returns the
+ *             next message in it.
+ * @note       EndpointIds and Payload are sent as set by the caller, x2-x3
+ *             are cleared.
+ *
+ * @param[in,out] Message  The response, the next message on return
+ *
+ * @return     The FF-A error status code
+ */
+EFI_STATUS
+EFIAPI
+FfaExDirectMsgSendResp2 (
+  IN OUT  FFA_EX_DIRECT_MSG  *Message
+  );
+
+/**
+ * @brief      Waits for a message, see FfaMessageWait.
+ *
+ * @param[out] Message  The incoming message
+ *
+ * @return     The FF-A error status code
+ */
+EFI_STATUS
+EFIAPI
+FfaExDirectMsgWait (
+  OUT FFA_EX_DIRECT_MSG  *Message
+  );
+
+/**
+ * @brief      Converts a DIRECT_MSG_ARGS_EX to register order, for callers
+ *             moving over from the DIRECT_MSG_ARGS_EX interfaces.
+ *
+ * @param[in]  Args     The message
+ * @param[out] Message  The message in register order
+ */
+VOID
+EFIAPI
+FfaExDirectMsgFromArgs (
+  IN  CONST DIRECT_MSG_ARGS_EX  *Args,
+  OUT FFA_EX_DIRECT_MSG         *Message
+  );
+
+/**
+ * @brief      Converts a message in register order to a DIRECT_MSG_ARGS_EX.
+ *
+ * @param[in]  Message  The message in register order
+ * @param[out] Args     The message
+ */
+VOID
+EFIAPI
+FfaExDirectMsgToArgs (
+  IN  CONST FFA_EX_DIRECT_MSG  *Message,
+  OUT DIRECT_MSG_ARGS_EX       *Args
+  );
+
 /**
  * @brief      Sends a 32 bit partition message in parameter registers as a
  *             response and blocks until the response is available.
@@ -191,6 +587,97 @@ FfaMessageSendDirectResp2 (
   OUT DIRECT_MSG_ARGS_EX  *Response
   );
 
+/**
+ * Indirect messaging interfaces
+ *
+ * @note Payloads are written to and read from the RX/TX buffers mapped by
+ * ArmFfaLib, so a message costs a single trap with no intermediate copy. The
+ * TX buffer is not locked: a caller owns it from FfaIndirectMsgPrepare to
+ * FfaIndirectMsgSend.
+ */
+
+#ifndef ARM_FID_FFA_MSG_SEND2
+#define ARM_FID_FFA_MSG_SEND2  0x84000086
+#endif
+
+///
+/// FFA_MSG_SEND2 flag asking the SPMC not to raise the schedule receiver
+/// interrupt for this message.
+///
+#define FFA_EX_MSG_SEND2_FLAG_DELAY_SRI  BIT1
+
+/**
+ * @brief       Writes the partition message header of an indirect message
+ *              to the TX buffer and returns where its payload goes.
+ *
+ * @param ReceiverId      Partition ID of the receiver
+ * @param ServiceGuid     Optional, GUID of the service the message is for
+ * @param Payload         Start of the payload in the TX buffer
+ * @param MaxPayloadSize  Number of payload bytes that fit in the TX buffer
+ * @return                EFI_UNSUPPORTED if the SPMC has no FFA_MSG_SEND2,
+ *                        EFI_NOT_READY if no TX buffer is mapped
+ */
+EFI_STATUS
+EFIAPI
+FfaIndirectMsgPrepare (
+  IN  UINT16          ReceiverId,
+  IN  CONST EFI_GUID  *ServiceGuid OPTIONAL,
+  OUT VOID            **Payload,
+  OUT UINTN           *MaxPayloadSize
+  );
+
+/**
+ * @brief       Sends the indirect message prepared in the TX buffer with
+ *              FFA_MSG_SEND2.
+ *
+ * @param PayloadSize   Number of payload bytes written after
+ *                      FfaIndirectMsgPrepare
+ * @param Flags         0 or FFA_EX_MSG_SEND2_FLAG_DELAY_SRI
+ * @return              EFI_BAD_BUFFER_SIZE if PayloadSize does not fit,
+ *                      EFI_NOT_READY if the RX buffer of the receiver is
+ *                      still full with a previous message
+ */
+EFI_STATUS
+EFIAPI
+FfaIndirectMsgSend (
+  IN UINTN   PayloadSize,
+  IN UINT32  Flags
+  );
+
+/**
+ * @brief       Parses the indirect message in the RX buffer.
+ *
+ * The payload is returned in place and stays valid until
+ * FfaIndirectMsgRelease hands the RX buffer back to the SPMC.
+ *
+ * @param SenderId      Partition ID of the sender
+ * @param ServiceGuid   Optional, GUID of the service the message is for
+ * @param Payload       Start of the payload in the RX buffer
+ * @param PayloadSize   Size of the payload
+ * @return              EFI_NOT_READY if no RX buffer is mapped,
+ *                      EFI_PROTOCOL_ERROR if the header is malformed
+ */
+EFI_STATUS
+EFIAPI
+FfaIndirectMsgReceive (
+  OUT UINT16      *SenderId,
+  OUT EFI_GUID    *ServiceGuid OPTIONAL,
+  OUT CONST VOID  **Payload,
+  OUT UINTN       *PayloadSize
+  );
+
+/**
+ * @brief       Hands the RX buffer back to the SPMC with FFA_RX_RELEASE so
+ *              that the next message can be delivered.
+ * @note        A caller about to wait for a message can instead pass TRUE
+ *              to FfaExMessageWaitRx, which saves the trap.
+ */
+EFI_STATUS
+EFIAPI
+FfaIndirectMsgRelease (
+  VOID
+  );
+
 EFI_STATUS
 EFIAPI
 FfaNsResInfoGet (
@@ -216,6 +703,127 @@ FfaNotificationGet (
   IN UINT64  *NotificationBitmap
   );
 
+/**
+ * @brief Notification bitmaps returned by FfaNotificationGetAll
+ */
+typedef struct {
+  /// Notifications pending from secure partitions (x2-x3)
+  UINT64    SpBitmap;
+
+  /// Notifications pending from VMs (x4-x5)
+  UINT64    VmBitmap;
+
+  /// Framework notifications pending from the SPMC and hypervisor (x6-x7)
+  UINT64    HypBitmap;
+} FFA_EX_NOTIFICATION_BITMAPS;
+
+/**
+ * @brief       Retrieves and clears every requested notification bitmap with
+ *              a single FFA_NOTIFICATION_GET.
+ *
+ * @param VCpuId        vCPU to retrieve per-vCPU notifications for
+ * @param Flags         OR of ARM_FFA_NOTIFICATION_FLAG_BITMAP_SP, _VM and
+ *                      _HYP
+ * @param Bitmaps       The requested bitmaps, the others are zero
+ * @return              EFI_INVALID_PARAMETER if Flags requests no bitmap or
+ *                      has unknown bits set
+ */
+EFI_STATUS
+EFIAPI
+FfaNotificationGetAll (
+  IN  UINT16                       VCpuId,
+  IN  UINT64                       Flags,
+  OUT FFA_EX_NOTIFICATION_BITMAPS  *Bitmaps
+  );
+
+#ifndef ARM_FID_FFA_NOTIFICATION_INFO_GET_AARCH64
+#define ARM_FID_FFA_NOTIFICATION_INFO_GET_AARCH64  0xC4000083
+#endif
+
+///
+/// Maximum number of lists one FFA_NOTIFICATION_INFO_GET returns. Each list
+/// takes one ID for the partition and one per vCPU, out of 20 IDs.
+///
+#define FFA_EX_NOTIFICATION_INFO_MAX_LISTS  20
+
+///
+/// Maximum number of vCPU IDs in one list.
+///
+#define FFA_EX_NOTIFICATION_INFO_MAX_VCPUS  3
+
+/**
+ * @brief One list returned by FFA_NOTIFICATION_INFO_GET
+ */
+typedef struct {
+  /// Partition with pending notifications
+  UINT16    PartitionId;
+
+  /// Number of valid entries in VcpuIds. 0 means the pending notifications
+  /// are global, i.e. not bound to a vCPU.
+  UINT16    VcpuCount;
+
+  /// vCPUs with pending per-vCPU notifications
+  UINT16    VcpuIds[FFA_EX_NOTIFICATION_INFO_MAX_VCPUS];
+} FFA_EX_NOTIFICATION_INFO;
+
+/**
+ * @brief       Returns the partitions and vCPUs with pending notifications
+ *              that were not reported by a previous call.
+ *
+ * A partition may appear in several lists if more vCPUs have pending
+ * notifications than fit in one.
+ *
+ * @param Info          Buffer receiving the lists. Must hold
+ *                      FFA_EX_NOTIFICATION_INFO_MAX_LISTS entries, as the
+ *                      SPMC does not report the same lists twice.
+ * @param InfoCount     On input the capacity of Info, on output the number of
+ *                      lists returned, 0 if nothing is pending
+ * @param MorePending   TRUE if more lists are pending than one call returns
+ * @return              EFI_BUFFER_TOO_SMALL if Info is too small, without
+ *                      calling the SPMC
+ */
+EFI_STATUS
+EFIAPI
+FfaNotificationInfoGet (
+  OUT    FFA_EX_NOTIFICATION_INFO  *Info,
+  IN OUT UINTN                     *InfoCount,
+  OUT    BOOLEAN                   *MorePending
+  );
+
+/**
+ * @brief       Handler invoked by FfaNotificationInfoDrain for each list.
+ *
+ * @param Info          The partition and vCPUs with pending notifications
+ * @param Context       The context passed to FfaNotificationInfoDrain
+ */
+typedef
+VOID
+(EFIAPI *FFA_EX_NOTIFICATION_INFO_HANDLER)(
+  IN CONST FFA_EX_NOTIFICATION_INFO  *Info,
+  IN VOID                            *Context OPTIONAL
+  );
+
+/**
+ * @brief       Calls FFA_NOTIFICATION_INFO_GET until nothing more is
+ *              pending and dispatches every list returned.
+ *
+ * Meant for the receiver scheduler on SRI: only the partitions and vCPUs
+ * reported need to be woken up to retrieve their notifications.
+ *
+ * @param Handler       Invoked for every list
+ * @param Context       Passed to Handler
+ * @param ListCount     Optional, number of lists dispatched
+ * @return              EFI_TIMEOUT if the SPMC still reported more pending
+ *                      notifications after a bounded number of calls
+ */
+EFI_STATUS
+EFIAPI
+FfaNotificationInfoDrain (
+  IN  FFA_EX_NOTIFICATION_INFO_HANDLER  Handler,
+  IN  VOID                              *Context OPTIONAL,
+  OUT UINTN                             *ListCount OPTIONAL
+  );
+
 EFI_STATUS
 EFIAPI
 FfaPartitionInfoGetRegs (
@@ -226,6 +834,33 @@ FfaPartitionInfoGetRegs (
   OUT EFI_FFA_PART_INFO_DESC  *PartDesc OPTIONAL
   );
 
+/**
+ * @brief       Returns the descriptors of every partition that implements a
+ *              service, walking all FFA_PARTITION_INFO_GET_REGS windows.
+ *
+ * The tag returned by the first window is passed on every following one, and
+ * the whole walk is restarted if the SPMC reports that the set of partitions
+ * changed in between. The UUID of every descriptor is converted back from the
+ * FF-A byte order. The RX buffer is never used.
+ *
+ * @param ServiceGuid   GUID of the service, NULL for all partitions
+ * @param PartDescCount On input the capacity of PartDesc, on output the
+ *                      number of descriptors returned, or the number needed
+ *                      if EFI_BUFFER_TOO_SMALL is returned
+ * @param PartDesc      Buffer receiving the descriptors. May be NULL if
+ *                      *PartDescCount is 0, to query the count.
+ * @return              EFI_BUFFER_TOO_SMALL after a single trap if PartDesc
+ *                      cannot hold every descriptor, EFI_NOT_READY if the
+ *                      enumeration kept changing
+ */
+EFI_STATUS
+EFIAPI
+FfaPartitionInfoGetAllRegs (
+  IN     EFI_GUID                *ServiceGuid OPTIONAL,
+  IN OUT UINT32                  *PartDescCount,
+  OUT    EFI_FFA_PART_INFO_DESC  *PartDesc OPTIONAL
+  );
+
 EFI_STATUS
 EFIAPI
 FfaNotificationBitmapCreate (
@@ -441,6 +1076,10 @@ FfaMemReclaim (
  *              Moreover this interface is only available in the boot phase,
  *              i.e. before invoking FFA_MSG_WAIT interface.
  *
+ *              When PcdFfaLibExPermShadowEnable is set, the answer comes from
+ *              the permissions shadowed by earlier calls without trapping
+ *              whenever they cover base_address.
+ *
  * @param[in]   base_address    Base VA of a translation granule whose
  *                              permission attributes must be returned.
  * @param[out]  mem_perm        Permission attributes of the memory region
@@ -478,16 +1117,339 @@ FfaMemPermSet (
   );
 
 /**
- * @brief       Allow an entity to provide debug logging to the console. Uses
- *              32 bit registers to pass characters.
- *
- * @param message       Message characters
- * @param length        Message length, max FFA_CONSOLE_LOG_32_MAX_LENGTH
- * @return              The FF-A error status code
+ * @brief One range of a FfaMemPermSetBatch request
  */
-EFI_STATUS
-EFIAPI
-FfaConsoleLog32 (
+typedef struct {
+  /// Base VA of the range, page aligned
+  UINT64    BaseAddress;
+
+  /// Number of 4K pages in the range
+  UINT32    PageCount;
+
+  /// Permission attributes to set, as for FfaMemPermSet
+  UINT32    MemoryPerm;
+} FFA_EX_MEM_PERM_RANGE;
+
+/**
+ * @brief       Sets the memory attributes of several memory regions with as
+ *              few FFA_MEM_PERM_SET calls as possible.
+ *
+ *              The ranges are sorted by base address in place, and adjacent
+ *              ranges with the same attributes are set with a single call.
+ *              A range based above 4GB is set with the SMC64 variant. The
+ *              same restrictions as for FfaMemPermSet apply.
+ *
+ * @param[in, out] Ranges      The ranges, sorted by base address on return
+ * @param[in]      Count       Number of entries in Ranges
+ * @param[out]     CallsSaved  Optional, receives the number of calls saved
+ *                             over setting each range on its own
+ * @return         EFI_INVALID_PARAMETER, before any call is made, if a range
+ *                 is empty, not page aligned, has reserved attribute bits set
+ *                 or overlaps another one. Otherwise the FF-A error status
+ *                 code of the first call that failed, the ranges below it are
+ *                 already set.
+ */
+EFI_STATUS
+EFIAPI
+FfaMemPermSetBatch (
+  IN OUT FFA_EX_MEM_PERM_RANGE  *Ranges,
+  IN     UINTN                  Count,
+  OUT    UINTN                  *CallsSaved OPTIONAL
+  );
+
+/**
+ * @brief       Drops the shadowed permissions FfaMemPermGet answers from
+ *              when PcdFfaLibExPermShadowEnable is set.
+ *
+ *              Only needed if the permissions of the caller were changed
+ *              without FfaMemPermSet or FfaMemPermSetBatch, e.g. by the
+ *              entry point before the library was initialized.
+ */
+VOID
+EFIAPI
+FfaExInvalidatePermShadow (
+  VOID
+  );
+
+/**
+ * Memory transaction builder interfaces
+ *
+ * @note The descriptor is serialized straight into the TX buffer mapped by
+ * ArmFfaLib: receivers are written as they are added, constituents are only
+ * referenced and copied by FfaExMemTransactionSend, one fragment at a time.
+ * Whatever does not fit the first fragment is streamed with FFA_MEM_FRAG_TX,
+ * so a transaction costs one trap per TX buffer worth of descriptor and no
+ * allocation. The TX buffer is not locked: a caller owns it from
+ * FfaExMemTransactionInit to FfaExMemTransactionSend.
+ */
+
+#ifndef ARM_FID_FFA_MEM_FRAG_RX
+#define ARM_FID_FFA_MEM_FRAG_RX  0x8400007A
+#endif
+
+#ifndef ARM_FID_FFA_MEM_FRAG_TX
+#define ARM_FID_FFA_MEM_FRAG_TX  0x8400007B
+#endif
+
+///
+/// Memory region attributes: normal memory, write-back cacheable, inner
+/// shareable
+///
+#define FFA_EX_MEM_ATTR_NORMAL_WB_INNER_SHAREABLE  0x2F
+
+///
+/// Memory access permissions of an endpoint memory access descriptor: data
+/// access in bits[1:0], instruction access in bits[3:2]
+///
+#define FFA_EX_MEM_PERM_RO  0x1
+#define FFA_EX_MEM_PERM_RW  0x2
+#define FFA_EX_MEM_PERM_NX  0x4
+#define FFA_EX_MEM_PERM_X   0x8
+
+/**
+ * @brief Memory management ABI a transaction is sent with
+ */
+typedef enum {
+  FfaExMemTypeShare,
+  FfaExMemTypeLend,
+  FfaExMemTypeDonate
+} FFA_EX_MEM_TRANSACTION_TYPE;
+
+/**
+ * @brief State of a memory transaction being built, owned by the caller
+ */
+typedef struct {
+  /// TX buffer the descriptor is serialized into
+  UINT8                                *Buffer;
+
+  /// Size of the TX buffer
+  UINT32                               BufferSize;
+
+  /// Number of endpoint memory access descriptors written so far
+  UINT32                               ReceiverCount;
+
+  /// Scatter-gather list of the region, referenced until sent
+  CONST FFA_EX_MEM_CONSTITUENT_DESC    *Constituents;
+
+  /// Number of entries in Constituents
+  UINT32                               ConstituentCount;
+
+  /// Sum of the page counts of Constituents
+  UINT32                               PageCount;
+} FFA_EX_MEM_TRANSACTION;
+
+/**
+ * @brief       Starts building a memory transaction descriptor in the TX
+ *              buffer.
+ *
+ * @param Transaction   The transaction to initialize
+ * @param Attributes    Memory region attributes, e.g.
+ *                      FFA_EX_MEM_ATTR_NORMAL_WB_INNER_SHAREABLE
+ * @param Flags         Memory transaction flags
+ * @param Tag           Implementation defined value associated with the
+ *                      transaction
+ * @return              EFI_NOT_READY if no TX buffer is mapped
+ */
+EFI_STATUS
+EFIAPI
+FfaExMemTransactionInit (
+  OUT FFA_EX_MEM_TRANSACTION  *Transaction,
+  IN  UINT16                  Attributes,
+  IN  UINT32                  Flags,
+  IN  UINT64                  Tag
+  );
+
+/**
+ * @brief       Grants a receiver access to the memory region of the
+ *              transaction.
+ *
+ * @param Transaction   The transaction
+ * @param ReceiverId    Partition ID of the receiver
+ * @param Permissions   Memory access permissions, FFA_EX_MEM_PERM_*
+ * @param Flags         Endpoint memory access flags
+ * @return              EFI_OUT_OF_RESOURCES if the receivers would no longer
+ *                      fit the first fragment
+ */
+EFI_STATUS
+EFIAPI
+FfaExMemTransactionAddReceiver (
+  IN OUT FFA_EX_MEM_TRANSACTION  *Transaction,
+  IN     UINT16                  ReceiverId,
+  IN     UINT8                   Permissions,
+  IN     UINT8                   Flags
+  );
+
+/**
+ * @brief       Sets the scatter-gather list of the memory region. The list is
+ *              not copied, it must stay valid until FfaExMemTransactionSend
+ *              returns.
+ *
+ * @param Transaction       The transaction
+ * @param Constituents      The constituent memory region descriptors
+ * @param ConstituentCount  Number of entries in Constituents
+ * @return                  EFI_INVALID_PARAMETER if a constituent is empty or
+ *                          the region has more than MAX_UINT32 pages
+ */
+EFI_STATUS
+EFIAPI
+FfaExMemTransactionSetConstituents (
+  IN OUT FFA_EX_MEM_TRANSACTION             *Transaction,
+  IN     CONST FFA_EX_MEM_CONSTITUENT_DESC  *Constituents,
+  IN     UINT32                             ConstituentCount
+  );
+
+/**
+ * @brief       Sends a memory transaction, streaming the descriptor in as
+ *              many fragments as the TX buffer requires.
+ * @note        A transaction that fails after the SPMC took a fragment is
+ *              reclaimed, so the memory can be sent again.
+ *
+ * @param Transaction   The transaction, with at least one receiver and one
+ *                      constituent
+ * @param Type          Whether the memory is shared, lent or donated
+ * @param Handle        Globally unique handle of the memory region
+ * @return              EFI_BAD_BUFFER_SIZE if the descriptor exceeds 4GB,
+ *                      EFI_PROTOCOL_ERROR if the SPMC asks for a fragment out
+ *                      of order or answers unexpectedly, otherwise the FF-A
+ *                      error status code
+ */
+EFI_STATUS
+EFIAPI
+FfaExMemTransactionSend (
+  IN OUT FFA_EX_MEM_TRANSACTION       *Transaction,
+  IN     FFA_EX_MEM_TRANSACTION_TYPE  Type,
+  OUT    UINT64                       *Handle
+  );
+
+/**
+ * @brief       Receives the constituents of a retrieved memory region as the
+ *              fragments of the retrieve response arrive.
+ *
+ * @param Constituents      Constituents of the current fragment, in the RX
+ *                          buffer, valid only for the duration of the call
+ * @param ConstituentCount  Number of entries in Constituents
+ * @param Context           Context passed to FfaExMemRetrieve
+ * @return                  An error stops the retrieve and is returned by
+ *                          FfaExMemRetrieve
+ */
+typedef
+EFI_STATUS
+(EFIAPI *FFA_EX_MEM_CONSTITUENT_HANDLER)(
+  IN CONST FFA_EX_MEM_CONSTITUENT_DESC  *Constituents,
+  IN UINT32                             ConstituentCount,
+  IN VOID                               *Context
+  );
+
+/**
+ * @brief       Retrieves a memory region shared, lent or donated to the
+ *              caller, pulling the response with FFA_MEM_FRAG_RX one fragment
+ *              at a time.
+ *
+ * @note        The RX buffer is released before returning. An error means
+ *              the caller does not hold the region: if it occurs after the
+ *              SPMC accepted the retrieve request, the region is
+ *              relinquished before returning.
+ *
+ * @param Handle          Handle of the memory region
+ * @param SenderId        Partition ID of the owner of the memory region
+ * @param Permissions     Memory access permissions requested,
+ *                        FFA_EX_MEM_PERM_*
+ * @param Handler         Optional, called with the constituents of each
+ *                        fragment as it arrives
+ * @param Context         Optional, passed to Handler
+ * @param Descriptor      Optional, receives a contiguous copy of the whole
+ *                        retrieve response
+ * @param DescriptorSize  Required with Descriptor. On input the size of
+ *                        Descriptor, on output the size of the response
+ * @return                EFI_BUFFER_TOO_SMALL if the response does not fit
+ *                        Descriptor, DescriptorSize is the size needed,
+ *                        EFI_PROTOCOL_ERROR if the response is malformed,
+ *                        otherwise the FF-A error status code
+ */
+EFI_STATUS
+EFIAPI
+FfaExMemRetrieve (
+  IN     UINT64                          Handle,
+  IN     UINT16                          SenderId,
+  IN     UINT8                           Permissions,
+  IN     FFA_EX_MEM_CONSTITUENT_HANDLER  Handler OPTIONAL,
+  IN     VOID                            *Context OPTIONAL,
+  OUT    VOID                            *Descriptor OPTIONAL,
+  IN OUT UINT32                          *DescriptorSize OPTIONAL
+  );
+
+/**
+ * @brief       Shares one physically contiguous range of pages, read-write,
+ *              with a single receiver.
+ *
+ * @param ReceiverId    Partition ID of the receiver
+ * @param Base          Base address of the range
+ * @param PageCount     Number of 4K pages in the range
+ * @param Handle        Globally unique handle of the memory region
+ * @return              The status of FfaExMemTransactionSend
+ */
+EFI_STATUS
+EFIAPI
+FfaExMemShareSingle (
+  IN  UINT16  ReceiverId,
+  IN  VOID    *Base,
+  IN  UINTN   PageCount,
+  OUT UINT64  *Handle
+  );
+
+/**
+ * @brief       Retrieves, read-write, a memory region made of a single
+ *              physically contiguous range, such as one shared with
+ *              FfaExMemShareSingle.
+ *
+ * @param Handle        Handle of the memory region
+ * @param SenderId      Partition ID of the owner of the memory region
+ * @param Base          Base address of the range
+ * @param Size          Size in bytes of the range
+ * @return              EFI_UNSUPPORTED if the region has more than one range,
+ *                      it is relinquished,
+ *                      otherwise the status of FfaExMemRetrieve
+ */
+EFI_STATUS
+EFIAPI
+FfaExMemRetrieveSingle (
+  IN  UINT64  Handle,
+  IN  UINT16  SenderId,
+  OUT UINT64  *Base,
+  OUT UINT64  *Size
+  );
+
+/**
+ * @brief       Relinquishes a retrieved memory region, building the relinquish
+ *              descriptor for the caller in the TX buffer.
+ *
+ * @param Handle        Handle of the memory region
+ * @return              EFI_NOT_READY if no TX buffer is mapped,
+ *                      otherwise the FF-A error status code
+ */
+EFI_STATUS
+EFIAPI
+FfaExMemRelinquish (
+  IN UINT64  Handle
+  );
+
+///
+/// Maximum number of characters one FFA_CONSOLE_LOG call carries.
+///
+#define FFA_CONSOLE_LOG_32_MAX_LENGTH  24
+#define FFA_CONSOLE_LOG_64_MAX_LENGTH  128
+
+/**
+ * @brief       Allow an entity to provide debug logging to the console. Uses
+ *              32 bit registers to pass characters.
+ *
+ * @param message       Message characters
+ * @param length        Message length, max FFA_CONSOLE_LOG_32_MAX_LENGTH
+ * @return              The FF-A error status code
+ */
+EFI_STATUS
+EFIAPI
+FfaConsoleLog32 (
   CONST CHAR8  *Message,
   UINTN        Length
   );
@@ -507,4 +1469,446 @@ FfaConsoleLog64 (
   UINTN       Length
   );
 
+/**
+ * Capability discovery interfaces
+ *
+ * @note The library constructor negotiates the version and resolves the
+ * partition ID, and fails if it cannot. Each function and feature ID traps to
+ * FFA_FEATURES on its first query only.
+ */
+
+/**
+ * @brief       Checks whether the SPMC supports an FF-A function ID or an
+ *              FF-A feature ID.
+ *
+ * @param Id            FF-A function ID (e.g. ARM_FID_FFA_NS_RES_INFO_GET)
+ *                      or feature ID (e.g.
+ *                      ARM_FFA_FEATURE_ID_SCHEDULE_RECEIVER_INTERRUPT)
+ * @return              TRUE if supported, FALSE otherwise
+ */
+BOOLEAN
+EFIAPI
+FfaExIsFeatureSupported (
+  IN UINT32  Id
+  );
+
+/**
+ * @brief       Returns the property FFA_FEATURES reported for one of the
+ *              interrupt feature IDs (NPI, SRI or MEI), i.e. the interrupt ID.
+ *
+ * @param FeatureId     One of the ARM_FFA_FEATURE_ID_*_INTERRUPT IDs
+ * @param Property      The interrupt ID assigned to the feature
+ * @return              EFI_UNSUPPORTED if the SPMC does not support FeatureId
+ */
+EFI_STATUS
+EFIAPI
+FfaExGetFeatureProperty (
+  IN  UINT32  FeatureId,
+  OUT UINTN   *Property
+  );
+
+/**
+ * @brief       Returns the FF-A version negotiated with the SPMC.
+ *
+ * @param MajorVersion  Negotiated major version
+ * @param MinorVersion  Negotiated minor version
+ * @return              EFI_NOT_READY if the version could not be negotiated
+ */
+EFI_STATUS
+EFIAPI
+FfaExGetVersion (
+  OUT UINT16  *MajorVersion,
+  OUT UINT16  *MinorVersion
+  );
+
+/**
+ * @brief       Returns the FF-A partition ID of the caller.
+ *
+ * @param PartitionId   The partition ID
+ * @return              EFI_NOT_READY if the partition ID could not be resolved
+ */
+EFI_STATUS
+EFIAPI
+FfaExGetPartitionId (
+  OUT UINT16  *PartitionId
+  );
+
+/**
+ * @brief       Returns the index of the vCPU the caller is running on, for
+ *              callers that keep per-vCPU state.
+ *
+ * @return              The index the vCPU was bound with, 0 if it is not bound
+ */
+UINT16
+EFIAPI
+FfaExGetCurrentVcpuId (
+  VOID
+  );
+
+/**
+ * @brief       Binds the calling vCPU to a context of its own, so that
+ *              requests handled on several vCPUs at once do not share
+ *              writable library state. Each vCPU of an MP partition calls
+ *              this before it handles requests, the library then owns the
+ *              thread ID register (TPIDR_EL0).
+ *
+ * @param VcpuId        Index of the calling vCPU
+ * @return              EFI_INVALID_PARAMETER if VcpuId is beyond the contexts
+ *                      built into the library, EFI_ACCESS_DENIED if another
+ *                      vCPU is bound to, or binding, the same index
+ */
+EFI_STATUS
+EFIAPI
+FfaExBindCurrentVcpu (
+  IN UINT16  VcpuId
+  );
+
+/**
+ * @brief       Returns the index the calling vCPU was bound with. Unlike
+ *              FfaExGetCurrentVcpuId, tells a vCPU that was never bound
+ *              apart from the one bound with index 0.
+ *
+ * @param VcpuId        The index passed to FfaExBindCurrentVcpu
+ * @return              EFI_NOT_FOUND if the calling vCPU is not bound
+ */
+EFI_STATUS
+EFIAPI
+FfaExGetBoundVcpuId (
+  OUT UINT16  *VcpuId
+  );
+
+/**
+ * Service resolution interfaces
+ *
+ * @note Resolved services are cached, so FfaExResolveService is cheap enough
+ * to call before every request. The cache is never refreshed on its own;
+ * invalidate it when a partition is known to have come or gone, e.g. after a
+ * direct request to a cached partition ID fails with EFI_INVALID_PARAMETER.
+ */
+
+/**
+ * @brief Partition implementing a service
+ */
+typedef struct {
+  /// FF-A partition ID
+  UINT16    PartitionId;
+
+  /// Number of execution contexts, or proxy partition ID for a VM
+  UINT16    ExecContextCount;
+
+  /// Partition properties as reported by FFA_PARTITION_INFO_GET_REGS
+  UINT32    Properties;
+} FFA_EX_SERVICE_INFO;
+
+/**
+ * @brief       Resolves a service GUID to the partition implementing it.
+ *
+ * The first call for a service issues one FFA_PARTITION_INFO_GET_REGS and
+ * caches the answer, later calls only look it up. If several partitions
+ * implement the service, the first one reported by the SPMC is returned.
+ *
+ * @param ServiceGuid   GUID of the service
+ * @param Info          The partition implementing the service
+ * @return              EFI_NOT_FOUND if no partition implements the service
+ */
+EFI_STATUS
+EFIAPI
+FfaExResolveService (
+  IN  CONST EFI_GUID       *ServiceGuid,
+  OUT FFA_EX_SERVICE_INFO  *Info
+  );
+
+/**
+ * @brief       Drops cached service resolutions.
+ *
+ * @param ServiceGuid   GUID of the service to forget, NULL to forget all
+ */
+VOID
+EFIAPI
+FfaExInvalidateServiceCache (
+  IN CONST EFI_GUID  *ServiceGuid OPTIONAL
+  );
+
+/**
+ * @brief       Handler of the direct requests of one service, the prototype
+ *              of the service libraries' handlers (e.g. TpmServiceHandle).
+ *              FfaExBatchDispatch, FfaExTraceReplay and FfaRingTransportLib
+ *              all dispatch to handlers of this type.
+ */
+typedef
+VOID
+(*FFA_EX_SERVICE_HANDLER)(
+  DIRECT_MSG_ARGS_EX  *Request,
+  DIRECT_MSG_ARGS_EX  *Response
+  );
+
+/**
+ * Batched command interfaces
+ *
+ * @note A batch packs several small commands for the same service into the
+ * payload of one FFA_MSG_SEND_DIRECT_REQ2. Arg0 holds the batch header:
+ *   [63:48] FFA_EX_BATCH_SIGNATURE
+ *   [47:44] Flags, FFA_EX_BATCH_STOP_ON_ERROR
+ *   [43:40] Number of commands
+ *   [39:0]  Number of registers of command N in bits [4N+3:4N]
+ * and Arg1-Arg13 the registers of the commands, back to back. The service
+ * runs the commands in order and responds with the same header, holding the
+ * number of commands run, and the status of command N in Arg(N+1).
+ *
+ * A service opts in by handing batch requests to FfaExBatchDispatch before
+ * decoding its own opcodes. Each command is then passed to the service
+ * handler as a direct request of its own, so handlers need no change.
+ */
+
+#define FFA_EX_BATCH_SIGNATURE  0xBA7C
+
+/// Maximum number of commands in a batch
+#define FFA_EX_BATCH_MAX_COMMANDS  10
+
+/// Maximum number of registers of all the commands of a batch, Arg1-Arg13
+#define FFA_EX_BATCH_MAX_REGISTERS  13
+
+/// Stop at the first command that does not return the success status
+#define FFA_EX_BATCH_STOP_ON_ERROR  BIT0
+
+/**
+ * @brief How FfaExBatchDispatch runs the commands of a service
+ */
+typedef struct {
+  /// Handler of a single command
+  FFA_EX_SERVICE_HANDLER    Handler;
+
+  /// ArgN of the request the first register of a command is placed in
+  UINT8                     CommandBase;
+
+  /// ArgN of the response holding the status of a command
+  UINT8                     StatusIndex;
+
+  /// Status a command returns on success
+  UINTN                     SuccessStatus;
+} FFA_EX_BATCH_SERVICE;
+
+/**
+ * @brief       Starts a batch in the payload of a direct request.
+ *
+ * @param Request       The request, zeroed but for the batch header
+ * @param Flags         FFA_EX_BATCH_STOP_ON_ERROR or 0
+ */
+VOID
+EFIAPI
+FfaExBatchInit (
+  OUT DIRECT_MSG_ARGS_EX  *Request,
+  IN  UINT8               Flags
+  );
+
+/**
+ * @brief       Appends a command to a batch.
+ *
+ * @param Request         The batch
+ * @param Registers       Registers of the command, placed from
+ *                        FFA_EX_BATCH_SERVICE.CommandBase on by the service
+ * @param RegisterCount   Number of registers, at least 1
+ * @return                EFI_BUFFER_TOO_SMALL if the batch is full
+ */
+EFI_STATUS
+EFIAPI
+FfaExBatchAdd (
+  IN OUT DIRECT_MSG_ARGS_EX  *Request,
+  IN     CONST UINTN         *Registers,
+  IN     UINTN               RegisterCount
+  );
+
+/**
+ * @brief       Returns the status of a command of a batch from the response.
+ *
+ * @param Response      The response to the batch
+ * @param Index         Index of the command in the batch
+ * @param Status        Status returned by the command
+ * @return              EFI_UNSUPPORTED if Response is not a batch response,
+ *                      EFI_NOT_FOUND if the command was not run
+ */
+EFI_STATUS
+EFIAPI
+FfaExBatchGetStatus (
+  IN  CONST DIRECT_MSG_ARGS_EX  *Response,
+  IN  UINTN                     Index,
+  OUT UINTN                     *Status
+  );
+
+/**
+ * @brief       Tells whether a direct request carries a batch.
+ *
+ * @param Request       The request
+ * @return              TRUE if Arg0 holds a batch header
+ */
+BOOLEAN
+EFIAPI
+FfaExIsBatchRequest (
+  IN CONST DIRECT_MSG_ARGS_EX  *Request
+  );
+
+/**
+ * @brief       Runs the commands of a batch through a service handler and
+ *              packs their statuses into the response.
+ *
+ * @param Service       How to run the commands
+ * @param Request       The batch
+ * @param Response      The response to the batch
+ * @return              EFI_INVALID_PARAMETER if the batch is malformed or
+ *                      nests a batch, no command is run then
+ */
+EFI_STATUS
+EFIAPI
+FfaExBatchDispatch (
+  IN  CONST FFA_EX_BATCH_SERVICE  *Service,
+  IN  CONST DIRECT_MSG_ARGS_EX    *Request,
+  OUT DIRECT_MSG_ARGS_EX          *Response
+  );
+
+/**
+ * Call statistics interfaces
+ *
+ * @note Only available when the library is built with
+ * FFA_LIB_EX_INSTRUMENTATION defined, otherwise EFI_UNSUPPORTED is returned.
+ */
+
+#define FFA_EX_LATENCY_BUCKETS  32
+
+/**
+ * @brief Call statistics of one FF-A function ID
+ */
+typedef struct {
+  /// Number of times the function ID was issued
+  UINT64    CallCount;
+
+  /// Number of calls that returned FFA_ERROR
+  UINT64    ErrorCount;
+
+  /// Number of calls that were preempted and returned FFA_INTERRUPT
+  UINT64    InterruptCount;
+
+  /// Trap latency in performance counter ticks. Bucket 0 counts calls that
+  /// took 0 ticks, bucket N counts calls that took [2^(N-1), 2^N) ticks and
+  /// the last bucket also counts everything longer.
+  UINT32    LatencyHistogram[FFA_EX_LATENCY_BUCKETS];
+} FFA_EX_CALL_STATS;
+
+/**
+ * @brief       Returns the call statistics collected for an FF-A function ID.
+ *
+ * @param FunctionId    FF-A function ID, e.g. ARM_FID_FFA_MSG_SEND_DIRECT_REQ2
+ * @param Stats         Copy of the statistics
+ * @return              EFI_UNSUPPORTED if instrumentation is compiled out
+ */
+EFI_STATUS
+EFIAPI
+FfaExGetCallStats (
+  IN  UINT32             FunctionId,
+  OUT FFA_EX_CALL_STATS  *Stats
+  );
+
+/**
+ * @brief       Clears the call statistics of every FF-A function ID.
+ *
+ * @return              EFI_UNSUPPORTED if instrumentation is compiled out
+ */
+EFI_STATUS
+EFIAPI
+FfaExResetCallStats (
+  VOID
+  );
+
+/**
+ * Call trace interfaces
+ *
+ * @note The trace ring is only available when the library is built with
+ * FFA_LIB_EX_TRACE defined, otherwise EFI_UNSUPPORTED is returned. The replay
+ * interface is always available so that captured traces can be replayed by a
+ * different build than the one that recorded them.
+ */
+
+/**
+ * @brief One traced FF-A call
+ */
+typedef struct {
+  /// Position of the record in the capture, starting at 1
+  UINT32          Sequence;
+
+  /// vCPU the call was issued on
+  UINT16          VcpuId;
+
+  UINT16          Reserved;
+
+  /// Performance counter value when the call returned
+  UINT64          Timestamp;
+
+  /// Registers the call was issued with, zero past x7 for ABIs taking
+  /// x0-x7 only
+  ARM_SXC_ARGS    Request;
+
+  /// Registers returned by the SPMC, zero past x7 for ABIs returning x0-x7
+  /// only
+  ARM_SXC_ARGS    Response;
+} FFA_EX_TRACE_RECORD;
+
+/**
+ * @brief Maps a service GUID to the handler replaying its requests
+ */
+typedef struct {
+  EFI_GUID                  ServiceGuid;
+  FFA_EX_SERVICE_HANDLER    Handler;
+} FFA_EX_TRACE_SERVICE;
+
+/**
+ * @brief       Copies the most recent trace records, oldest first.
+ *
+ * @param Records       Buffer receiving the records
+ * @param RecordCount   On input the capacity of Records, on output the
+ *                      number of records copied
+ * @return              EFI_UNSUPPORTED if tracing is compiled out
+ */
+EFI_STATUS
+EFIAPI
+FfaExTraceDump (
+  OUT    FFA_EX_TRACE_RECORD  *Records,
+  IN OUT UINTN                *RecordCount
+  );
+
+/**
+ * @brief       Discards every record in the trace ring.
+ *
+ * @return              EFI_UNSUPPORTED if tracing is compiled out
+ */
+EFI_STATUS
+EFIAPI
+FfaExTraceReset (
+  VOID
+  );
+
+/**
+ * @brief       Feeds the direct requests found in a captured trace back
+ *              through the service handlers.
+ *
+ * Every record whose response carries a direct request (i.e. a request the
+ * partition received from FFA_MSG_WAIT or from a direct response) is unpacked
+ * and dispatched to the handler registered for its service GUID. Requests for
+ * unknown services are skipped.
+ *
+ * @param Records         Captured records, oldest first
+ * @param RecordCount     Number of records
+ * @param Services        Service GUID to handler table
+ * @param ServiceCount    Number of entries in Services
+ * @param DispatchedCount Optional, number of requests dispatched
+ * @return                EFI_INVALID_PARAMETER on NULL tables
+ */
+EFI_STATUS
+EFIAPI
+FfaExTraceReplay (
+  IN  CONST FFA_EX_TRACE_RECORD   *Records,
+  IN  UINTN                       RecordCount,
+  IN  CONST FFA_EX_TRACE_SERVICE  *Services,
+  IN  UINTN                       ServiceCount,
+  OUT UINTN                       *DispatchedCount OPTIONAL
+  );
+
 #endif /* FF_A_HELPER_LIB_H_ */
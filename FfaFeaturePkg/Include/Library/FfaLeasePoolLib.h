@@ -0,0 +1,186 @@
+/** @file
+  Shared memory lease pool over FF-A.
+
+  Sharing a buffer for every bulk transfer costs a share, a retrieve, a
+  relinquish and a reclaim, each a trap and a stage-2 update in the SPMC. A
+  lease pool instead keeps a few long lived regions shared with one receiver
+  and leases fixed size buffers out of them. Only growing the pool and
+  reclaiming idle regions trap, acquiring and releasing a lease does not.
+
+  On the receiver side, FfaLeaseMap retrieves a region the first time one of
+  its leases is seen and resolves every later lease to an address without a
+  trap.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef FFA_LEASE_POOL_LIB_H_
+#define FFA_LEASE_POOL_LIB_H_
+
+#include <Base.h>
+
+///
+/// Maximum number of regions a pool can grow to.
+///
+#define FFA_LEASE_POOL_MAX_REGIONS  16
+
+///
+/// Maximum number of regions a receiver keeps retrieved at once.
+///
+#define FFA_LEASE_MAP_MAX_REGIONS  16
+
+///
+/// A buffer leased out of a pool, as passed from sender to receiver.
+///
+typedef struct {
+  UINT64    Handle;   // Handle of the memory region holding the buffer
+  UINT32    Offset;   // Byte offset of the buffer in the region
+  UINT32    Size;     // Size of the buffer in bytes
+} FFA_LEASE;
+
+typedef struct _FFA_LEASE_POOL FFA_LEASE_POOL;
+
+/**
+  Creates a lease pool for buffers shared with one receiver.
+
+  No memory is shared until the first lease is acquired.
+
+  @param  ReceiverId        Partition ID of the receiver.
+  @param  BufferSize        Size of each leased buffer in bytes.
+  @param  BuffersPerRegion  Number of buffers each shared region holds.
+  @param  MaxRegions        Number of regions the pool may grow to, at most
+                            FFA_LEASE_POOL_MAX_REGIONS.
+  @param  Pool              Receives the pool.
+
+  @retval EFI_SUCCESS            The pool was created.
+  @retval EFI_INVALID_PARAMETER  A parameter is zero or out of range.
+  @retval EFI_OUT_OF_RESOURCES   The pool could not be allocated.
+**/
+EFI_STATUS
+EFIAPI
+FfaLeasePoolCreate (
+  IN  UINT16          ReceiverId,
+  IN  UINT32          BufferSize,
+  IN  UINT32          BuffersPerRegion,
+  IN  UINT32          MaxRegions,
+  OUT FFA_LEASE_POOL  **Pool
+  );
+
+/**
+  Leases a buffer out of a pool.
+
+  A free buffer of an already shared region is preferred. A new region is
+  only allocated and shared when every buffer is leased.
+
+  @param  Pool    The pool.
+  @param  Buffer  Receives the address of the buffer.
+  @param  Lease   Receives the lease to pass to the receiver.
+
+  @retval EFI_SUCCESS           The buffer was leased.
+  @retval EFI_OUT_OF_RESOURCES  Every buffer is leased and the pool cannot
+                                grow.
+  @retval Others                Sharing a new region failed.
+**/
+EFI_STATUS
+EFIAPI
+FfaLeasePoolAcquire (
+  IN  FFA_LEASE_POOL  *Pool,
+  OUT VOID            **Buffer,
+  OUT FFA_LEASE       *Lease
+  );
+
+/**
+  Returns a leased buffer to its pool. The region stays shared.
+
+  @param  Pool   The pool.
+  @param  Lease  The lease returned by FfaLeasePoolAcquire.
+
+  @retval EFI_SUCCESS            The buffer was returned.
+  @retval EFI_INVALID_PARAMETER  Lease is not a lease of Pool, or was already
+                                 returned.
+**/
+EFI_STATUS
+EFIAPI
+FfaLeasePoolRelease (
+  IN FFA_LEASE_POOL   *Pool,
+  IN CONST FFA_LEASE  *Lease
+  );
+
+/**
+  Reclaims and frees the regions of a pool that have no buffer leased, to
+  relieve memory pressure.
+
+  A region the receiver has not relinquished yet cannot be reclaimed and
+  stays in the pool.
+
+  @param  Pool  The pool.
+
+  @retval The number of regions reclaimed.
+**/
+UINTN
+EFIAPI
+FfaLeasePoolTrim (
+  IN FFA_LEASE_POOL  *Pool
+  );
+
+/**
+  Reclaims every region of a pool and frees it.
+
+  @param  Pool  The pool.
+
+  @retval EFI_SUCCESS        The pool was freed.
+  @retval EFI_ACCESS_DENIED  A buffer is still leased or a region could not be
+                             reclaimed, the pool is left in place.
+**/
+EFI_STATUS
+EFIAPI
+FfaLeasePoolDestroy (
+  IN FFA_LEASE_POOL  *Pool
+  );
+
+/**
+  Resolves a lease received from a sender to an address.
+
+  The region holding the buffer is retrieved the first time one of its leases
+  is mapped and stays retrieved until FfaLeaseUnmap.
+
+  @param  SenderId  Partition ID of the sender.
+  @param  Lease     The lease.
+  @param  Buffer    Receives the address of the buffer.
+
+  @retval EFI_SUCCESS            The lease was mapped.
+  @retval EFI_INVALID_PARAMETER  The lease is outside its region.
+  @retval EFI_UNSUPPORTED        The region is not physically contiguous.
+  @retval EFI_OUT_OF_RESOURCES   FFA_LEASE_MAP_MAX_REGIONS regions are already
+                                 retrieved.
+  @retval Others                 Retrieving the region failed.
+**/
+EFI_STATUS
+EFIAPI
+FfaLeaseMap (
+  IN  UINT16           SenderId,
+  IN  CONST FFA_LEASE  *Lease,
+  OUT VOID             **Buffer
+  );
+
+/**
+  Relinquishes a region retrieved by FfaLeaseMap, so that its sender can
+  reclaim it.
+
+  @param  SenderId  Partition ID of the sender.
+  @param  Handle    Handle of the region.
+
+  @retval EFI_SUCCESS    The region was relinquished.
+  @retval EFI_NOT_FOUND  The region is not mapped.
+  @retval Others         FFA_MEM_RELINQUISH failed.
+**/
+EFI_STATUS
+EFIAPI
+FfaLeaseUnmap (
+  IN UINT16  SenderId,
+  IN UINT64  Handle
+  );
+
+#endif // FFA_LEASE_POOL_LIB_H_
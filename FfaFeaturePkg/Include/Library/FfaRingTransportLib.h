@@ -0,0 +1,255 @@
+/** @file
+  Shared memory ring transport over FF-A.
+
+  A direct request costs a world switch per request, which caps the rate at
+  which a client can feed a service. A ring transport instead shares one
+  region between a client and a server partition, holding a request ring
+  written by the client and a completion ring written by the server, each
+  with a single producer and a single consumer. A notification doorbell is
+  only rung when a ring goes from empty to non-empty, so a busy server drains
+  many requests per wakeup and a busy client submits without trapping.
+
+  Requests are dispatched to the same service handlers as direct requests,
+  e.g. TestServiceHandle, so services need no change to be reachable through
+  a ring.
+
+  The client creates the transport and passes the handle of the region to
+  the server by whatever means it likes, typically a direct request; the
+  server then attaches to it. A client never has more requests in flight
+  than the ring holds entries, so the server always finds room for a
+  completion.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef FFA_RING_TRANSPORT_LIB_H_
+#define FFA_RING_TRANSPORT_LIB_H_
+
+#include <Base.h>
+#include <Library/ArmFfaLibEx.h>
+
+#define FFA_RING_SIGNATURE  SIGNATURE_32 ('F', 'R', 'N', 'G')
+
+///
+/// Maximum number of entries of each ring.
+///
+#define FFA_RING_MAX_ENTRIES  1024
+
+///
+/// Doorbell value of a ring whose consumer polls instead.
+///
+#define FFA_RING_NO_DOORBELL  MAX_UINT32
+
+///
+/// Status of a completion.
+///
+#define FFA_RING_STATUS_SUCCESS     0   // The service handler ran
+#define FFA_RING_STATUS_NO_SERVICE  1   // No handler for the service GUID
+
+///
+/// Indices of one ring, on cache lines of their own so that the producer
+/// and the consumer never write the same line.
+///
+typedef struct {
+  volatile UINT32    Producer;
+  UINT8              Reserved1[60];
+  volatile UINT32    Consumer;
+  UINT8              Reserved2[60];
+} FFA_RING_INDICES;
+
+///
+/// Start of the shared region. The request entries follow, then the
+/// completion entries. Indices run freely and wrap modulo 2^32.
+///
+typedef struct {
+  UINT32              Signature;
+  UINT32              EntryCount;           // Entries of each ring, a power of two
+  UINT32              RequestDoorbell;      // Notification ID rung by the client
+  UINT32              CompletionDoorbell;   // Notification ID rung by the server
+  UINT8               Reserved[48];
+  FFA_RING_INDICES    Requests;
+  FFA_RING_INDICES    Completions;
+} FFA_RING_HEADER;
+
+///
+/// A request or a completion.
+///
+typedef struct {
+  UINT64      Cookie;       // Chosen by the client, returned with the completion
+  UINT32      Status;       // FFA_RING_STATUS_*, completions only
+  UINT32      Reserved;
+  EFI_GUID    ServiceGuid;
+  UINT64      Args[FFA_EX_DIRECT_MSG_PAYLOAD_COUNT];   // Arg0-Arg13 of the request or response
+} FFA_RING_ENTRY;
+
+///
+/// Maps a service GUID to the handler of its requests.
+///
+typedef struct {
+  EFI_GUID                  ServiceGuid;
+  FFA_EX_SERVICE_HANDLER    Handler;
+} FFA_RING_SERVICE;
+
+typedef struct _FFA_RING_TRANSPORT FFA_RING_TRANSPORT;
+
+/**
+  Creates a transport and shares its region with the server.
+
+  @param  ServerId            Partition ID of the server.
+  @param  EntryCount          Number of entries of each ring, a power of two
+                              up to FFA_RING_MAX_ENTRIES.
+  @param  RequestDoorbell     Notification ID rung toward the server, below 64.
+  @param  CompletionDoorbell  Notification ID rung toward the client, below
+                              64, or FFA_RING_NO_DOORBELL if the client polls.
+  @param  Transport           Receives the transport.
+  @param  Handle              Receives the handle of the region, to pass to
+                              the server.
+
+  @retval EFI_SUCCESS            The transport was created.
+  @retval EFI_INVALID_PARAMETER  A parameter is out of range.
+  @retval EFI_OUT_OF_RESOURCES   The region could not be allocated.
+  @retval Others                 Sharing the region or binding the doorbell
+                                 failed.
+**/
+EFI_STATUS
+EFIAPI
+FfaRingTransportCreate (
+  IN  UINT16              ServerId,
+  IN  UINT32              EntryCount,
+  IN  UINT32              RequestDoorbell,
+  IN  UINT32              CompletionDoorbell,
+  OUT FFA_RING_TRANSPORT  **Transport,
+  OUT UINT64              *Handle
+  );
+
+/**
+  Reclaims the region of a transport and frees it.
+
+  @param  Transport  The transport, created by FfaRingTransportCreate.
+
+  @retval EFI_SUCCESS            The transport was freed.
+  @retval EFI_INVALID_PARAMETER  Transport is NULL or was not created.
+  @retval EFI_ACCESS_DENIED      The server has not detached yet, the
+                                 transport is left in place.
+**/
+EFI_STATUS
+EFIAPI
+FfaRingTransportDestroy (
+  IN FFA_RING_TRANSPORT  *Transport
+  );
+
+/**
+  Queues requests, ringing the doorbell if the server may be idle.
+
+  @param  Transport  The transport.
+  @param  Requests   The requests. Status is ignored.
+  @param  Count      Number of requests.
+  @param  Submitted  Receives the number of requests queued, fewer than
+                     Count if the ring is full.
+
+  @retval EFI_SUCCESS            At least one request was queued, or Count is
+                                 zero.
+  @retval EFI_NOT_READY          The ring is full, reap completions first.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL.
+  @retval Others                 The requests were queued but the doorbell
+                                 could not be rung.
+**/
+EFI_STATUS
+EFIAPI
+FfaRingTransportSubmit (
+  IN  FFA_RING_TRANSPORT    *Transport,
+  IN  CONST FFA_RING_ENTRY  *Requests,
+  IN  UINTN                 Count,
+  OUT UINTN                 *Submitted
+  );
+
+/**
+  Takes completions out of the completion ring, oldest first.
+
+  The completion doorbell is only rung again once the ring was seen empty,
+  so a caller that filled Completions must call again before waiting.
+
+  @param  Transport    The transport.
+  @param  Completions  Receives the completions.
+  @param  Count        On input the capacity of Completions, on output the
+                       number of completions taken.
+
+  @retval EFI_SUCCESS            The completions were taken, possibly none.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL.
+  @retval EFI_PROTOCOL_ERROR     The server corrupted the completion ring.
+**/
+EFI_STATUS
+EFIAPI
+FfaRingTransportReap (
+  IN     FFA_RING_TRANSPORT  *Transport,
+  OUT    FFA_RING_ENTRY      *Completions,
+  IN OUT UINTN               *Count
+  );
+
+/**
+  Retrieves the region of a transport created by a client and binds the
+  request doorbell.
+
+  @param  ClientId   Partition ID of the client.
+  @param  Handle     Handle of the region.
+  @param  Transport  Receives the transport.
+
+  @retval EFI_SUCCESS           The transport is ready to serve.
+  @retval EFI_UNSUPPORTED       The region does not hold a ring transport.
+  @retval EFI_OUT_OF_RESOURCES  The transport could not be allocated.
+  @retval Others                Retrieving the region or binding the doorbell
+                                failed.
+**/
+EFI_STATUS
+EFIAPI
+FfaRingTransportAttach (
+  IN  UINT16              ClientId,
+  IN  UINT64              Handle,
+  OUT FFA_RING_TRANSPORT  **Transport
+  );
+
+/**
+  Unbinds the request doorbell, relinquishes the region of a transport and
+  frees it.
+
+  @param  Transport  The transport, attached by FfaRingTransportAttach.
+
+  @retval EFI_SUCCESS            The transport was freed.
+  @retval EFI_INVALID_PARAMETER  Transport is NULL or was not attached.
+  @retval Others                 Relinquishing the region failed, the
+                                 transport is left in place.
+**/
+EFI_STATUS
+EFIAPI
+FfaRingTransportDetach (
+  IN FFA_RING_TRANSPORT  *Transport
+  );
+
+/**
+  Runs every queued request through the handler of its service and posts
+  the completions, ringing the doorbell if the client may be idle.
+
+  Meant to be called when the request doorbell rings, it returns once the
+  request ring is seen empty.
+
+  @param  Transport     The transport.
+  @param  Services      Service GUID to handler table.
+  @param  ServiceCount  Number of entries in Services.
+  @param  Served        Optional, receives the number of requests served.
+
+  @retval EFI_SUCCESS            The request ring is empty.
+  @retval EFI_INVALID_PARAMETER  A parameter is NULL.
+  @retval EFI_PROTOCOL_ERROR     The client corrupted a ring, serving stops.
+**/
+EFI_STATUS
+EFIAPI
+FfaRingTransportServe (
+  IN  FFA_RING_TRANSPORT      *Transport,
+  IN  CONST FFA_RING_SERVICE  *Services,
+  IN  UINTN                   ServiceCount,
+  OUT UINTN                   *Served OPTIONAL
+  );
+
+#endif /* FFA_RING_TRANSPORT_LIB_H_ */
@@ -13,6 +13,14 @@
 #include <IndustryStandard/ArmFfaPartInfo.h>
 #include <Library/ArmSvcLib.h>
 #include <Library/ArmFfaLibEx.h>
+#include <Guid/FfaWireGuid.h>
+
+//
+// gTpm2ServiceFfaGuid, 17b862a4-1806-4faf-86b3-089a58353861, in FF-A wire
+// byte order.
+//
+#define TPM2_SERVICE_FFA_WIRE_UUID \
+  FFA_WIRE_GUID_INIT (0x17b862a4, 0x1806, 0x4faf, { 0x86, 0xb3, 0x08, 0x9a, 0x58, 0x35, 0x38, 0x61 })
 
 /**
   Initializes the TPM service
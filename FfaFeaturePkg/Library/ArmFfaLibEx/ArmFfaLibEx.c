@@ -17,9 +17,83 @@
 #include <Library/ArmFfaLibEx.h>
 #include <Library/PlatformFfaInterruptLib.h>
 
-#define INVALID_SOURCE_ID  0xFFFF
-
-STATIC UINT16  mPartitionId = INVALID_SOURCE_ID;
+#include "ArmFfaLibExInternal.h"
+
+//
+// ArmFfaLibExSvc.inf and ArmFfaLibExSmc.inf bind the conduit at build time.
+// ArmFfaLibEx.inf defines neither and picks it from PcdFfaLibConduitSmc.
+//
+#if defined (FFA_LIB_EX_CONDUIT_SVC) && defined (FFA_LIB_EX_CONDUIT_SMC)
+  #error "FFA_LIB_EX_CONDUIT_SVC and FFA_LIB_EX_CONDUIT_SMC are mutually exclusive"
+#endif
+
+//
+// Number of payload registers of the v1 direct message ABIs, x2-x7.
+//
+#define FFA_DIRECT_MSG_V1_PAYLOAD_COUNT  6
+
+//
+// FFA_MSG_WAIT hands the RX buffer back to the SPMC from FF-A v1.1 on. From
+// v1.2 on, bit[0] of w2 asks the SPMC to leave it with the caller instead.
+//
+#define FFA_MSG_WAIT_FLAG_RETAIN_RX  BIT0
+
+//
+// First constituent and number of constituents of a region retrieved by
+// FfaExMemRetrieveSingle.
+//
+typedef struct {
+  FFA_EX_MEM_CONSTITUENT_DESC    First;
+  UINT32                         Count;
+} FFA_MEM_RETRIEVE_SINGLE_CONTEXT;
+
+//
+// FfaExDirectMsgToArgs clears the payload a v1 message does not use as one
+// block, and FFA_EX_DIRECT_MSG is trapped on in place, so both have to match
+// the register layout.
+//
+STATIC_ASSERT (
+  OFFSET_OF (DIRECT_MSG_ARGS_EX, Arg13) - OFFSET_OF (DIRECT_MSG_ARGS_EX, Arg0) ==
+  (FFA_EX_DIRECT_MSG_PAYLOAD_COUNT - 1) * sizeof (UINTN),
+  "DIRECT_MSG_ARGS_EX payload is not contiguous"
+  );
+STATIC_ASSERT (
+  OFFSET_OF (FFA_EX_DIRECT_MSG, Payload) == OFFSET_OF (ARM_SXC_ARGS, Arg4),
+  "FFA_EX_DIRECT_MSG does not mirror x0-x17"
+  );
+STATIC_ASSERT (
+  sizeof (FFA_EX_DIRECT_MSG) == sizeof (ARM_SXC_ARGS),
+  "FFA_EX_DIRECT_MSG does not mirror x0-x17"
+  );
+
+//
+// Capabilities of the SPMC. The version is negotiated by
+// ArmFfaLibExConstructor, each function and feature ID is asked of
+// FFA_FEATURES the first time it is queried and the answer kept, so that only
+// the IDs a partition actually queries cost a trap.
+//
+#define FFA_ID_UNKNOWN      0
+#define FFA_ID_SUPPORTED    1
+#define FFA_ID_UNSUPPORTED  2
+
+STATIC UINT16          mFfaMajorVersion;
+STATIC UINT16          mFfaMinorVersion;
+STATIC volatile UINT8  mFfaFidState[FFA_FID_INDEX_COUNT];
+STATIC volatile UINT8  mFfaFeatureIdState[FFA_FEATURE_ID_MAX + 1];
+STATIC UINTN           mFfaFeatureIdProperty[FFA_FEATURE_ID_MAX + 1];
+
+//
+// Set while the caller holds the RX buffer, from FfaIndirectMsgReceive until
+// it is released, so that a wait can release it on the way. The RX buffer
+// belongs to the partition, not to a vCPU.
+//
+STATIC BOOLEAN  mFfaRxHeld;
+
+//
+// Partition ID of the caller, resolved once by ArmFfaLibExConstructor. It
+// belongs to the partition, not to a vCPU.
+//
+STATIC UINT16  mFfaPartitionId = INVALID_SOURCE_ID;
 
 /**
   This function is used to prepare a GUID for FF-A.
@@ -54,39 +128,185 @@ FfaPrepareGuid (
   Data16[1] = SwapBytes16 (Data16[1]);
 }
 
+VOID
+EFIAPI
+FfaExGuidToWireGuid (
+  IN  CONST EFI_GUID  *Guid,
+  OUT FFA_WIRE_GUID   *WireGuid
+  )
+{
+  WireGuid->Words[0] = SwapBytes32 (Guid->Data1) |
+                       LShiftU64 (SwapBytes16 (Guid->Data2), 32) |
+                       LShiftU64 (SwapBytes16 (Guid->Data3), 48);
+  WireGuid->Words[1] = ReadUnaligned64 ((CONST UINT64 *)Guid->Data4);
+}
+
+VOID
+EFIAPI
+FfaExWireGuidToGuid (
+  IN  CONST FFA_WIRE_GUID  *WireGuid,
+  OUT EFI_GUID             *Guid
+  )
+{
+  Guid->Data1 = SwapBytes32 ((UINT32)WireGuid->Words[0]);
+  Guid->Data2 = SwapBytes16 ((UINT16)RShiftU64 (WireGuid->Words[0], 32));
+  Guid->Data3 = SwapBytes16 ((UINT16)RShiftU64 (WireGuid->Words[0], 48));
+  WriteUnaligned64 ((UINT64 *)Guid->Data4, WireGuid->Words[1]);
+}
+
+/**
+  Issues an FF-A call in place, marshalling x0-x17 in both directions.
+
+  @param  Args  Parameter registers on input, result registers on output.
+
+**/
 STATIC
 VOID
 ArmCallSxc (
-  ARM_SXC_ARGS  *Request,
-  ARM_SXC_ARGS  *Response
+  IN OUT ARM_SXC_ARGS  *Args
   )
 {
-  ARM_SXC_ARGS  LocalParams;
+  FFA_TRACE_BEGIN (Args, FFA_X17_REGISTER_COUNT);
+  FFA_STATS_BEGIN (Args);
+
+ #if defined (FFA_LIB_EX_CONDUIT_SMC)
+  FfaSmcCallX17 (Args);
+ #elif defined (FFA_LIB_EX_CONDUIT_SVC)
+  FfaSvcCallX17 (Args);
+ #else
+  if (PcdGetBool (PcdFfaLibConduitSmc) == 1) {
+    FfaSmcCallX17 (Args);
+  } else {
+    FfaSvcCallX17 (Args);
+  }
+ #endif
 
-  CopyMem (&LocalParams, Request, sizeof (ARM_SXC_ARGS));
+  FFA_STATS_END (Args);
+  FFA_TRACE_END (Args, FFA_X17_REGISTER_COUNT);
+}
 
-  /*
-   * The ArmCallSxc function is a wrapper around the ffa_params structure
-   * which checks the current execution level and calls the appropriate
-   * conduit.
-   */
+/**
+  Issues an FF-A call in place for an ABI that takes its parameters in x0-x7
+  but may return a message in x0-x17.
+
+  @param  Args  Parameter registers on input, result registers on output.
+
+**/
+STATIC
+VOID
+ArmCallSxcX7X17 (
+  IN OUT ARM_SXC_ARGS  *Args
+  )
+{
+  FFA_TRACE_BEGIN (Args, FFA_X7_REGISTER_COUNT);
+  FFA_STATS_BEGIN (Args);
+
+ #if defined (FFA_LIB_EX_CONDUIT_SMC)
+  FfaSmcCallX7X17 (Args);
+ #elif defined (FFA_LIB_EX_CONDUIT_SVC)
+  FfaSvcCallX7X17 (Args);
+ #else
+  if (PcdGetBool (PcdFfaLibConduitSmc) == 1) {
+    FfaSmcCallX7X17 (Args);
+  } else {
+    FfaSvcCallX7X17 (Args);
+  }
+ #endif
+
+  FFA_STATS_END (Args);
+  FFA_TRACE_END (Args, FFA_X17_REGISTER_COUNT);
+}
+
+/**
+  Issues an FF-A call in place for an ABI that only uses x0-x7 in both
+  directions. Arg8-Arg17 of Args are neither read nor written.
+
+  @param  Args  Parameter registers on input, result registers on output.
+
+**/
+STATIC
+VOID
+ArmCallSxcX7 (
+  IN OUT ARM_SXC_ARGS  *Args
+  )
+{
+  FFA_TRACE_BEGIN (Args, FFA_X7_REGISTER_COUNT);
+  FFA_STATS_BEGIN (Args);
+
+ #if defined (FFA_LIB_EX_CONDUIT_SMC)
+  FfaSmcCallX7 (Args);
+ #elif defined (FFA_LIB_EX_CONDUIT_SVC)
+  FfaSvcCallX7 (Args);
+ #else
   if (PcdGetBool (PcdFfaLibConduitSmc) == 1) {
-    ArmCallSmc ((ARM_SMC_ARGS *)&LocalParams);
+    FfaSmcCallX7 (Args);
   } else {
-    ArmCallSvc ((ARM_SVC_ARGS *)&LocalParams);
+    FfaSvcCallX7 (Args);
   }
+ #endif
+
+  FFA_STATS_END (Args);
+  FFA_TRACE_END (Args, FFA_X7_REGISTER_COUNT);
+}
+
+/**
+  Sets the function ID and clears x1-x7 of an argument block.
+
+  Only the registers consumed by the X7 call variants are initialized, callers
+  then fill in the parameters the ABI actually takes.
+
+  @param  Args        The argument block to initialize.
+  @param  FunctionId  The FF-A function ID to place in x0.
+
+**/
+STATIC
+VOID
+FfaInitArgs (
+  OUT ARM_SXC_ARGS  *Args,
+  IN  UINTN         FunctionId
+  )
+{
+  Args->Arg0 = FunctionId;
+  Args->Arg1 = 0;
+  Args->Arg2 = 0;
+  Args->Arg3 = 0;
+  Args->Arg4 = 0;
+  Args->Arg5 = 0;
+  Args->Arg6 = 0;
+  Args->Arg7 = 0;
+}
+
+/**
+  Tells whether a function ID is one of the v2 direct message ABIs, which
+  carry a service GUID and fourteen payload registers.
 
-  CopyMem (Response, &LocalParams, sizeof (ARM_SXC_ARGS));
+  @param  FunctionId  The FF-A function ID.
+
+  @retval TRUE   FFA_MSG_SEND_DIRECT_REQ2 or FFA_MSG_SEND_DIRECT_RESP2.
+  @retval FALSE  Any other function ID.
+**/
+STATIC
+BOOLEAN
+FfaIsDirectMessageV2 (
+  IN UINTN  FunctionId
+  )
+{
+  return (FunctionId == ARM_FID_FFA_MSG_SEND_DIRECT_REQ2) ||
+         (FunctionId == ARM_FID_FFA_MSG_SEND_DIRECT_RESP2);
 }
 
 /*
  * Unpacks the content of the ffa instruction Response into an ffa_direct_msg structure.
+ *
+ * If WireGuid is not NULL, it receives the service GUID as carried in x2-x3
+ * and the ServiceGuid of Message is zeroed rather than converted.
  */
 STATIC
 VOID
-FfaUnpackDirectMessage (
-  ARM_SXC_ARGS        *Response,
-  DIRECT_MSG_ARGS_EX  *Message
+FfaUnpackDirectMessageEx (
+  IN CONST ARM_SXC_ARGS   *Response,
+  OUT DIRECT_MSG_ARGS_EX  *Message,
+  OUT FFA_WIRE_GUID       *WireGuid OPTIONAL
   )
 {
   Message->FunctionId    = Response->Arg0;
@@ -102,9 +322,18 @@ FfaUnpackDirectMessage (
     Message->Arg3 = Response->Arg5;
     Message->Arg4 = Response->Arg6;
     Message->Arg5 = Response->Arg7;
+    if (WireGuid != NULL) {
+      ZeroMem (WireGuid, sizeof (*WireGuid));
+    }
   } else {
-    CopyMem (&Message->ServiceGuid, &Response->Arg2, sizeof (EFI_GUID));
-    FfaPrepareGuid (&Message->ServiceGuid);
+    if (WireGuid != NULL) {
+      WireGuid->Words[0] = Response->Arg2;
+      WireGuid->Words[1] = Response->Arg3;
+      ZeroMem (&Message->ServiceGuid, sizeof (EFI_GUID));
+    } else {
+      FfaExWireGuidToGuid ((CONST FFA_WIRE_GUID *)&Response->Arg2, &Message->ServiceGuid);
+    }
+
     Message->Arg0  = Response->Arg4;
     Message->Arg1  = Response->Arg5;
     Message->Arg2  = Response->Arg6;
@@ -122,18 +351,32 @@ FfaUnpackDirectMessage (
   }
 }
 
+/*
+ * Unpacks the content of the ffa instruction Response into an ffa_direct_msg structure.
+ */
+VOID
+FfaUnpackDirectMessage (
+  IN CONST ARM_SXC_ARGS   *Response,
+  OUT DIRECT_MSG_ARGS_EX  *Message
+  )
+{
+  FfaUnpackDirectMessageEx (Response, Message, NULL);
+}
+
 /*
  * Packs the content of the ffa_direct_msg into a Request message.
+ *
+ * Only x0-x7 are written for the v1 direct message ABIs, which must then be
+ * issued with one of the X7 call variants. If WireGuid is not NULL, it is
+ * used as is instead of converting the ServiceGuid of Message.
  */
-STATIC
 VOID
 FfaPackDirectMessage (
-  OUT ARM_SXC_ARGS       *Request,
-  IN DIRECT_MSG_ARGS_EX  *Message
+  OUT ARM_SXC_ARGS             *Request,
+  IN CONST DIRECT_MSG_ARGS_EX  *Message,
+  IN CONST FFA_WIRE_GUID       *WireGuid OPTIONAL
   )
 {
-  EFI_GUID  ServiceGuid;
-
   Request->Arg0 = Message->FunctionId;
 
   /* NOTE: There is a DIRECT_RESP define in ffa_api_defines.h, this may need to be updated
@@ -152,9 +395,13 @@ FfaPackDirectMessage (
     Request->Arg6 = Message->Arg4;
     Request->Arg7 = Message->Arg5;
   } else {
-    CopyMem (&ServiceGuid, &Message->ServiceGuid, sizeof (EFI_GUID));
-    FfaPrepareGuid (&ServiceGuid);
-    CopyMem (&Request->Arg2, &ServiceGuid, sizeof (EFI_GUID));
+    if (WireGuid != NULL) {
+      Request->Arg2 = WireGuid->Words[0];
+      Request->Arg3 = WireGuid->Words[1];
+    } else {
+      FfaExGuidToWireGuid (&Message->ServiceGuid, (FFA_WIRE_GUID *)&Request->Arg2);
+    }
+
     Request->Arg4  = Message->Arg0;
     Request->Arg5  = Message->Arg1;
     Request->Arg6  = Message->Arg2;
@@ -172,136 +419,265 @@ FfaPackDirectMessage (
   }
 }
 
-/*
- * The end of the interrupt handler is indicated by an FFA_MSG_WAIT call.
- */
+/**
+  Checks whether the negotiated FF-A version is at least Major.Minor.
+
+  @param  Major  The major version.
+  @param  Minor  The minor version.
+
+  @retval TRUE   The negotiated version is Major.Minor or later.
+  @retval FALSE  It is older, or no version was negotiated.
+**/
+STATIC
+BOOLEAN
+FfaVersionAtLeast (
+  IN UINT16  Major,
+  IN UINT16  Minor
+  )
+{
+  return (mFfaMajorVersion > Major) ||
+         ((mFfaMajorVersion == Major) && (mFfaMinorVersion >= Minor));
+}
+
+/**
+  Initializes the registers of an FFA_MSG_WAIT and accounts for the RX buffer
+  it releases.
+
+  @param  Args      Receives the registers.
+  @param  RetainRx  TRUE to keep a held RX buffer across the wait. Only
+                    honored from FF-A v1.2 on, older SPMCs release it anyway
+                    from v1.1 on.
+
+**/
 STATIC
 VOID
-FfaReturnFromInterrupt (
-  ARM_SXC_ARGS  *Result
+FfaInitWaitArgs (
+  OUT ARM_SXC_ARGS  *Args,
+  IN  BOOLEAN       RetainRx
   )
 {
-  ARM_SXC_ARGS  Request = { 0 };
+  FfaInitArgs (Args, ARM_FID_FFA_WAIT);
+  if (!mFfaRxHeld) {
+    return;
+  }
 
-  Request.Arg0 = ARM_FID_FFA_WAIT;
-  ArmCallSxc (&Request, Result);
+  if (RetainRx && FfaVersionAtLeast (1, 2)) {
+    Args->Arg2 = FFA_MSG_WAIT_FLAG_RETAIN_RX;
+  } else if (FfaVersionAtLeast (1, 1)) {
+    mFfaRxHeld = FALSE;
+  }
 }
 
-EFI_STATUS
-EFIAPI
-FfaMessageWait (
-  OUT DIRECT_MSG_ARGS_EX  *Message
+/*
+ * The end of the interrupt handler is indicated by an FFA_MSG_WAIT call. It
+ * must not take the RX buffer away from the code the interrupt preempted.
+ */
+STATIC
+VOID
+FfaReturnFromInterrupt (
+  IN OUT ARM_SXC_ARGS  *Args
   )
 {
-  ARM_SXC_ARGS  Request = { 0 };
-  ARM_SXC_ARGS  Result  = { 0 };
+  FfaInitWaitArgs (Args, TRUE);
+  ArmCallSxcX7X17 (Args);
+}
+
+/**
+  Handles the FFA_INTERRUPTs that preempt a call, until the call completes.
 
-  Request.Arg0 = ARM_FID_FFA_WAIT;
+  Unless PcdFfaLibExDeferInterrupts is set, each interrupt is handled on the
+  spot. Otherwise, an interrupt received while a request of the partition is
+  pending is only queued, and one received while the partition is idle first
+  runs the work queued so far. Once an idling call completes, the work queued
+  so far is run too, so a response does not leave it behind until the next
+  wait.
 
-  ArmCallSxc (&Request, &Result);
+  @param  Args  Registers returned by the call on input, registers it
+                completed with on output.
+  @param  Idle  TRUE if the call was FFA_MSG_WAIT or a direct response, i.e.
+                no request of the partition is pending.
 
-  while (Result.Arg0 == ARM_FID_FFA_INTERRUPT) {
-    SecurePartitionInterruptHandler ((UINT32)Result.Arg2);
-    FfaReturnFromInterrupt (&Result);
+**/
+STATIC
+VOID
+FfaHandleInterrupts (
+  IN OUT ARM_SXC_ARGS  *Args,
+  IN     BOOLEAN       Idle
+  )
+{
+  UINT32  InterruptId;
+
+  //
+  // An FFA_INTERRUPT naming an endpoint in w1 is not for this partition: it
+  // reports that the callee of a direct request was preempted.
+  //
+  while ((Args->Arg0 == ARM_FID_FFA_INTERRUPT) && ((UINT32)Args->Arg1 == 0)) {
+    InterruptId = (UINT32)Args->Arg2;
+    if (!FeaturePcdGet (PcdFfaLibExDeferInterrupts)) {
+      SecurePartitionInterruptHandler (InterruptId);
+    } else if (Idle) {
+      FfaExRunDeferredWork ();
+      SecurePartitionInterruptHandler (InterruptId);
+    } else if (!FfaDeferredWorkQueue (InterruptId)) {
+      //
+      // Better late than lost: with the queue full, handle it now, after the
+      // older interrupts so they still run in the order they arrived.
+      //
+      FfaExRunDeferredWork ();
+      SecurePartitionInterruptHandler (InterruptId);
+    }
+
+    FfaReturnFromInterrupt (Args);
   }
 
-  if (Result.Arg0 == ARM_FID_FFA_ERROR) {
-    return FfaStatusToEfiStatus (Result.Arg2);
-  } else if ((Result.Arg0 == ARM_FID_FFA_MSG_SEND_DIRECT_REQ_AARCH32) ||
-             (Result.Arg0 == ARM_FID_FFA_MSG_SEND_DIRECT_REQ_AARCH64) ||
-             (Result.Arg0 == ARM_FID_FFA_MSG_SEND_DIRECT_REQ2))
-  {
-    FfaUnpackDirectMessage (&Result, Message);
-  } else {
-    ASSERT (Result.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
-    *Message = (DIRECT_MSG_ARGS_EX) {
-      .FunctionId = Result.Arg0
-    };
+  if (FeaturePcdGet (PcdFfaLibExDeferInterrupts) && Idle) {
+    FfaExRunDeferredWork ();
   }
+}
 
-  return EFI_SUCCESS;
+/**
+  Resumes the callee of a direct request that yielded or was preempted.
+
+  @param  Args    Receives the registers FFA_RUN completed with.
+  @param  Target  Endpoint ID and vCPU ID of the callee.
+
+**/
+STATIC
+VOID
+FfaDirectReq2Run (
+  OUT ARM_SXC_ARGS  *Args,
+  IN  UINT32        Target
+  )
+{
+  FfaInitArgs (Args, ARM_FID_FFA_RUN);
+  Args->Arg1 = Target;
+  ArmCallSxcX7X17 (Args);
 }
 
+/**
+  Completes a direct request from the registers it, or the FFA_RUN resuming
+  its callee, returned with.
+
+  Interrupts of the partition are handled as they arrive. When the callee
+  yields or is preempted, it is resumed at once if Request is NULL, and the
+  request is left in progress otherwise.
+
+  @param  Args      Registers returned by the call. Hold the response on
+                    return if Response is NULL.
+  @param  Response  Optional, receives the response.
+  @param  WireGuid  Optional, receives the service GUID of the response as
+                    received instead of Response.
+  @param  Request   Optional, the state of the request, updated when it is
+                    left in progress or completes.
+
+  @retval EFI_SUCCESS    The callee responded.
+  @retval EFI_NOT_READY  The callee yielded or was preempted, see Request.
+  @retval Others         The call failed.
+**/
+STATIC
 EFI_STATUS
-EFIAPI
-FfaMessageSendDirectReq2 (
-  IN      UINT16              DestPartId,
-  IN      EFI_GUID            *ServiceGuid OPTIONAL,
-  IN OUT  DIRECT_MSG_ARGS_EX  *ImpDefArgs
+FfaDirectReq2Complete (
+  IN OUT ARM_SXC_ARGS        *Args,
+  OUT    DIRECT_MSG_ARGS_EX  *Response OPTIONAL,
+  OUT    FFA_WIRE_GUID       *WireGuid OPTIONAL,
+  IN OUT FFA_EX_DIRECT_REQ   *Request OPTIONAL
   )
 {
-  ARM_SXC_ARGS  InputArgs = { 0 };
-  ARM_SXC_ARGS  Result    = { 0 };
-
-  if (mPartitionId == INVALID_SOURCE_ID) {
-    ArmFfaLibPartitionIdGet (&mPartitionId);
-  }
+  for ( ; ;) {
+    FfaHandleInterrupts (Args, FALSE);
+    if ((Args->Arg0 != ARM_FID_FFA_YIELD) && (Args->Arg0 != ARM_FID_FFA_INTERRUPT)) {
+      break;
+    }
 
-  ImpDefArgs->FunctionId    = ARM_FID_FFA_MSG_SEND_DIRECT_REQ2;
-  ImpDefArgs->SourceId      = mPartitionId;
-  ImpDefArgs->DestinationId = DestPartId;
-  if (ServiceGuid != NULL) {
-    CopyMem (&(ImpDefArgs->ServiceGuid), ServiceGuid, sizeof (EFI_GUID));
-  } else {
-    ZeroMem (&(ImpDefArgs->ServiceGuid), sizeof (EFI_GUID));
-  }
+    if (Request != NULL) {
+      Request->Target  = (UINT32)Args->Arg1;
+      Request->Timeout = 0;
+      if (Args->Arg0 == ARM_FID_FFA_YIELD) {
+        Request->Timeout = LShiftU64 ((UINT32)Args->Arg3, 32) | (UINT32)Args->Arg2;
+      }
 
-  FfaPackDirectMessage (&InputArgs, ImpDefArgs);
+      Request->Pending = TRUE;
+      return EFI_NOT_READY;
+    }
 
-  ArmCallSxc (&InputArgs, &Result);
+    FfaDirectReq2Run (Args, (UINT32)Args->Arg1);
+  }
 
-  while (Result.Arg0 == ARM_FID_FFA_INTERRUPT) {
-    SecurePartitionInterruptHandler ((UINT32)Result.Arg2);
-    FfaReturnFromInterrupt (&Result);
+  if (Args->Arg0 == ARM_FID_FFA_ERROR) {
+    return FfaStatusToEfiStatus (Args->Arg2);
   }
 
-  if (Result.Arg0 == ARM_FID_FFA_ERROR) {
-    return FfaStatusToEfiStatus (Result.Arg2);
-  } else if (Result.Arg0 == ARM_FID_FFA_MSG_SEND_DIRECT_RESP2) {
-    FfaUnpackDirectMessage (&Result, ImpDefArgs);
+  ASSERT (
+    (Args->Arg0 == ARM_FID_FFA_MSG_SEND_DIRECT_RESP2) ||
+    (Args->Arg0 == ARM_FID_FFA_SUCCESS_AARCH32)
+    );
+  if (Response == NULL) {
+    // The response stays in Args
+  } else if (Args->Arg0 == ARM_FID_FFA_MSG_SEND_DIRECT_RESP2) {
+    FfaUnpackDirectMessageEx (Args, Response, WireGuid);
   } else {
-    ASSERT (Result.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
-    *ImpDefArgs = (DIRECT_MSG_ARGS_EX) {
-      .FunctionId = Result.Arg0
+    *Response = (DIRECT_MSG_ARGS_EX) {
+      .FunctionId = Args->Arg0
     };
   }
 
+  if (Request != NULL) {
+    Request->Pending = FALSE;
+  }
+
   return EFI_SUCCESS;
 }
 
+/**
+  Waits for a message, see FfaMessageWait.
+
+  @param  Message   Receives the message.
+  @param  WireGuid  Optional, receives the service GUID of the message as
+                    received instead of Message.
+  @param  RetainRx  TRUE to keep a held RX buffer across the wait, see
+                    FfaInitWaitArgs.
+
+  @retval EFI_SUCCESS  A message was received.
+  @retval Others       FFA_MSG_WAIT failed.
+**/
 STATIC
 EFI_STATUS
-FfaMessageSendDirectResp (
-  IN UINT32               FunctionId,
-  IN DIRECT_MSG_ARGS_EX   *Request,
-  OUT DIRECT_MSG_ARGS_EX  *Response
+FfaMessageWaitEx (
+  OUT DIRECT_MSG_ARGS_EX  *Message,
+  OUT FFA_WIRE_GUID       *WireGuid OPTIONAL,
+  IN  BOOLEAN             RetainRx
   )
 {
-  ARM_SXC_ARGS  InputArgs = { 0 };
-  ARM_SXC_ARGS  Result    = { 0 };
+  ARM_SXC_ARGS  Args;
 
-  Request->FunctionId = FunctionId;
-  FfaPackDirectMessage (&InputArgs, Request);
+  if (FeaturePcdGet (PcdFfaLibExDeferInterrupts)) {
+    //
+    // About to go idle, catch up with the interrupts deferred meanwhile.
+    //
+    FfaExRunDeferredWork ();
+  }
 
-  ArmCallSxc (&InputArgs, &Result);
+  FfaInitWaitArgs (&Args, RetainRx);
 
-  while (Result.Arg0 == ARM_FID_FFA_INTERRUPT) {
-    SecurePartitionInterruptHandler ((UINT32)Result.Arg2);
-    FfaReturnFromInterrupt (&Result);
-  }
+  ArmCallSxcX7X17 (&Args);
+
+  FfaHandleInterrupts (&Args, TRUE);
 
-  if (Result.Arg0 == ARM_FID_FFA_ERROR) {
-    return FfaStatusToEfiStatus (Result.Arg2);
-  } else if ((Result.Arg0 == ARM_FID_FFA_MSG_SEND_DIRECT_REQ_AARCH32) ||
-             (Result.Arg0 == ARM_FID_FFA_MSG_SEND_DIRECT_REQ_AARCH64) ||
-             (Result.Arg0 == ARM_FID_FFA_MSG_SEND_DIRECT_REQ2))
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    return FfaStatusToEfiStatus (Args.Arg2);
+  } else if ((Args.Arg0 == ARM_FID_FFA_MSG_SEND_DIRECT_REQ_AARCH32) ||
+             (Args.Arg0 == ARM_FID_FFA_MSG_SEND_DIRECT_REQ_AARCH64) ||
+             (Args.Arg0 == ARM_FID_FFA_MSG_SEND_DIRECT_REQ2))
   {
-    FfaUnpackDirectMessage (&Result, Response);
+    FfaUnpackDirectMessageEx (&Args, Message, WireGuid);
   } else {
-    ASSERT (Result.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
-    *Response = (DIRECT_MSG_ARGS_EX) {
-      .FunctionId = Result.Arg0
+    ASSERT (Args.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
+    *Message = (DIRECT_MSG_ARGS_EX) {
+      .FunctionId = Args.Arg0
     };
+    if (WireGuid != NULL) {
+      ZeroMem (WireGuid, sizeof (*WireGuid));
+    }
   }
 
   return EFI_SUCCESS;
@@ -309,695 +685,2473 @@ FfaMessageSendDirectResp (
 
 EFI_STATUS
 EFIAPI
-FfaMessageSendDirectResp32 (
-  IN DIRECT_MSG_ARGS_EX   *Request,
-  OUT DIRECT_MSG_ARGS_EX  *Response
+FfaMessageWait (
+  OUT DIRECT_MSG_ARGS_EX  *Message
   )
 {
-  return FfaMessageSendDirectResp (
-           ARM_FID_FFA_MSG_SEND_DIRECT_RESP_AARCH32,
-           Request,
-           Response
-           );
+  return FfaMessageWaitEx (Message, NULL, FALSE);
 }
 
 EFI_STATUS
 EFIAPI
-FfaMessageSendDirectResp64 (
-  IN DIRECT_MSG_ARGS_EX   *Request,
-  OUT DIRECT_MSG_ARGS_EX  *Response
+FfaExMessageWaitWire (
+  OUT DIRECT_MSG_ARGS_EX  *Message,
+  OUT FFA_WIRE_GUID       *ServiceGuid
   )
 {
-  return FfaMessageSendDirectResp (
-           ARM_FID_FFA_MSG_SEND_DIRECT_RESP_AARCH64,
-           Request,
-           Response
-           );
+  if (ServiceGuid == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  return FfaMessageWaitEx (Message, ServiceGuid, FALSE);
 }
 
 EFI_STATUS
 EFIAPI
-FfaMessageSendDirectResp2 (
-  IN DIRECT_MSG_ARGS_EX   *Request,
-  OUT DIRECT_MSG_ARGS_EX  *Response
+FfaExMessageWaitRx (
+  OUT DIRECT_MSG_ARGS_EX  *Message,
+  IN  BOOLEAN             ReleaseRx
   )
 {
-  return FfaMessageSendDirectResp (
-           ARM_FID_FFA_MSG_SEND_DIRECT_RESP2,
-           Request,
-           Response
-           );
+  EFI_STATUS  Status;
+
+  //
+  // Before v1.1, FFA_MSG_WAIT leaves the RX buffer alone and it takes an
+  // FFA_RX_RELEASE of its own.
+  //
+  if (ReleaseRx && mFfaRxHeld && !FfaVersionAtLeast (1, 1)) {
+    Status = FfaIndirectMsgRelease ();
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  return FfaMessageWaitEx (Message, NULL, !ReleaseRx);
 }
 
 EFI_STATUS
 EFIAPI
-FfaNsResInfoGet (
-  IN UINT16   TargetId,
-  IN UINT64   Flags,
-  OUT UINT32  *WrittenSize,
-  OUT UINT32  *RemainingSize
+FfaExDirectMsgSendReq2 (
+  IN      UINT16               DestPartId,
+  IN      CONST FFA_WIRE_GUID  *ServiceGuid OPTIONAL,
+  IN OUT  FFA_EX_DIRECT_MSG    *Message
   )
 {
-  ARM_SXC_ARGS  Request = { 0 };
-  ARM_SXC_ARGS  Result  = { 0 };
-
-  if ((WrittenSize == NULL) || (RemainingSize == NULL)) {
-    return EFI_INVALID_PARAMETER;
-  }
-
-  Request.Arg0 = ARM_FID_FFA_NS_RES_INFO_GET;
-  Request.Arg1 = TargetId;
-  Request.Arg2 = Flags;
-
-  ArmCallSxc (&Request, &Result);
+  ARM_SXC_ARGS  *Args;
 
-  if (Result.Arg0 == ARM_FID_FFA_ERROR) {
-    return FfaStatusToEfiStatus (Result.Arg2);
+  Message->FunctionId  = ARM_FID_FFA_MSG_SEND_DIRECT_REQ2;
+  Message->EndpointIds = FFA_EX_DIRECT_MSG_ENDPOINT_IDS (mFfaPartitionId, DestPartId);
+  if (ServiceGuid != NULL) {
+    Message->ServiceGuid = *ServiceGuid;
+  } else {
+    ZeroMem (&Message->ServiceGuid, sizeof (Message->ServiceGuid));
   }
 
-  *WrittenSize   = Result.Arg2 >> 32;
-  *RemainingSize = Result.Arg2;
+  Args = (ARM_SXC_ARGS *)Message;
+  ArmCallSxc (Args);
 
-  return EFI_SUCCESS;
+  return FfaDirectReq2Complete (Args, NULL, NULL, NULL);
 }
 
 EFI_STATUS
 EFIAPI
-FfaMemDonate (
-  UINT32  TotalLength,
-  UINT32  FragmentLength,
-  VOID    *BufferAddr,
-  UINT32  PageCount,
-  UINT64  *Handle
+FfaExDirectMsgSendResp2 (
+  IN OUT  FFA_EX_DIRECT_MSG  *Message
   )
 {
-  ARM_SXC_ARGS  Request = { 0 };
-  ARM_SXC_ARGS  Result  = { 0 };
+  ARM_SXC_ARGS  *Args;
 
-  Request.Arg0 = (BufferAddr) ? ARM_FID_FFA_MEM_DONATE_AARCH64 : ARM_FID_FFA_MEM_DONATE_AARCH32;
-  Request.Arg1 = TotalLength;
-  Request.Arg2 = FragmentLength;
-  Request.Arg3 = (UINTN)BufferAddr;
-  Request.Arg4 = PageCount;
+  Message->FunctionId = ARM_FID_FFA_MSG_SEND_DIRECT_RESP2;
+  ZeroMem (&Message->ServiceGuid, sizeof (Message->ServiceGuid));
 
-  ArmCallSxc (&Request, &Result);
+  Args = (ARM_SXC_ARGS *)Message;
+  ArmCallSxc (Args);
 
-  if (Result.Arg0 == ARM_FID_FFA_ERROR) {
-    *Handle = 0U;
-    return FfaStatusToEfiStatus (Result.Arg2);
+  FfaHandleInterrupts (Args, TRUE);
+
+  if (Args->Arg0 == ARM_FID_FFA_ERROR) {
+    return FfaStatusToEfiStatus (Args->Arg2);
   }
 
-  /*
-   * There are no 64-bit parameters returned with FFA_SUCCESS, the SPMC
-   * will use the default 32-bit version.
-   */
-  ASSERT (Result.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
-  *Handle = ((UINT64)Result.Arg3 << 32) | Result.Arg2;
   return EFI_SUCCESS;
 }
 
 EFI_STATUS
 EFIAPI
-FfaNotificationSet (
-  IN UINT16  DestinationId,
-  IN UINT64  Flags,
-  IN UINT64  NotificationBitmap
+FfaExDirectMsgWait (
+  OUT FFA_EX_DIRECT_MSG  *Message
   )
 {
-  ARM_SXC_ARGS  Request = { 0 };
-  ARM_SXC_ARGS  Result  = { 0 };
+  ARM_SXC_ARGS  *Args;
 
-  if (mPartitionId == INVALID_SOURCE_ID) {
-    ArmFfaLibPartitionIdGet (&mPartitionId);
+  if (FeaturePcdGet (PcdFfaLibExDeferInterrupts)) {
+    //
+    // About to go idle, catch up with the interrupts deferred meanwhile.
+    //
+    FfaExRunDeferredWork ();
   }
 
-  Request.Arg0 = ARM_FID_FFA_NOTIFICATION_SET;
-  Request.Arg1 = ((UINT32)mPartitionId << 16) | DestinationId;
-  Request.Arg2 = Flags;
-  Request.Arg3 = (UINT32)NotificationBitmap;
-  Request.Arg4 = (UINT32)(NotificationBitmap >> 32);
+  Args = (ARM_SXC_ARGS *)Message;
+  FfaInitWaitArgs (Args, FALSE);
+  ArmCallSxcX7X17 (Args);
 
-  ArmCallSxc (&Request, &Result);
+  FfaHandleInterrupts (Args, TRUE);
 
-  if (Result.Arg0 == ARM_FID_FFA_ERROR) {
-    return FfaStatusToEfiStatus (Result.Arg2);
+  if (Args->Arg0 == ARM_FID_FFA_ERROR) {
+    return FfaStatusToEfiStatus (Args->Arg2);
   }
 
   return EFI_SUCCESS;
 }
 
-EFI_STATUS
+VOID
 EFIAPI
-FfaNotificationGet (
-  IN UINT16  VCpuId,
-  IN UINT64  Flags,
-  IN UINT64  *NotificationBitmap
+FfaExDirectMsgFromArgs (
+  IN  CONST DIRECT_MSG_ARGS_EX  *Args,
+  OUT FFA_EX_DIRECT_MSG         *Message
   )
 {
-  ARM_SXC_ARGS  Request = { 0 };
-  ARM_SXC_ARGS  Result  = { 0 };
-
-  if (mPartitionId == INVALID_SOURCE_ID) {
-    ArmFfaLibPartitionIdGet (&mPartitionId);
-  }
-
-  Request.Arg0 = ARM_FID_FFA_NOTIFICATION_GET;
-  Request.Arg1 = ((UINT32)VCpuId << 16) | mPartitionId;
-  Request.Arg2 = Flags;
-
-  ArmCallSxc (&Request, &Result);
-
-  if (Result.Arg0 == ARM_FID_FFA_ERROR) {
-    return FfaStatusToEfiStatus (Result.Arg2);
-  }
-
-  switch (Flags) {
-    case ARM_FFA_NOTIFICATION_FLAG_BITMAP_SP:
-      *NotificationBitmap = ((UINT64)Result.Arg3 << 32) | Result.Arg2;
-      break;
-    case ARM_FFA_NOTIFICATION_FLAG_BITMAP_VM:
-      *NotificationBitmap = ((UINT64)Result.Arg5 << 32) | Result.Arg4;
-      break;
-    case ARM_FFA_NOTIFICATION_FLAG_BITMAP_HYP:
-      *NotificationBitmap = ((UINT64)Result.Arg7 << 32) | Result.Arg6;
-      break;
-    default:
-      return EFI_UNSUPPORTED;
+  FfaPackDirectMessage ((ARM_SXC_ARGS *)Message, Args, NULL);
+  if (!FfaIsDirectMessageV2 (Args->FunctionId)) {
+    ZeroMem (
+      &Message->Payload[FFA_DIRECT_MSG_V1_PAYLOAD_COUNT - 2],
+      (FFA_EX_DIRECT_MSG_PAYLOAD_COUNT - FFA_DIRECT_MSG_V1_PAYLOAD_COUNT + 2) * sizeof (UINTN)
+      );
   }
-
-  return EFI_SUCCESS;
 }
 
-EFI_STATUS
+VOID
 EFIAPI
-FfaPartitionInfoGetRegs (
-  IN EFI_GUID                 *ServiceGuid,
-  IN UINT16                   StartIndex,
-  IN OUT UINT16               *Tag OPTIONAL,
-  IN OUT UINT32               *PartDescCount,
-  OUT EFI_FFA_PART_INFO_DESC  *PartDesc OPTIONAL
+FfaExDirectMsgToArgs (
+  IN  CONST FFA_EX_DIRECT_MSG  *Message,
+  OUT DIRECT_MSG_ARGS_EX       *Args
   )
 {
-  EFI_GUID  ServiceGuidMangled;
-  UINT64    Metadata     = 0;
-  UINT16    TagValue     = 0;
-  UINT16    CurrentIndex = 0;
-  UINT32    Count        = 0;
+  FfaUnpackDirectMessage ((CONST ARM_SXC_ARGS *)Message, Args);
+  if (!FfaIsDirectMessageV2 (Message->FunctionId)) {
+    ZeroMem (&Args->ServiceGuid, sizeof (Args->ServiceGuid));
+    ZeroMem (
+      &Args->Arg0 + FFA_DIRECT_MSG_V1_PAYLOAD_COUNT,
+      (FFA_EX_DIRECT_MSG_PAYLOAD_COUNT - FFA_DIRECT_MSG_V1_PAYLOAD_COUNT) * sizeof (UINTN)
+      );
+  }
+}
 
-  ARM_SXC_ARGS  Request = { 0 };
-  ARM_SXC_ARGS  Result  = { 0 };
+EFI_STATUS
+EFIAPI
+FfaMessageSendDirectReq2 (
+  IN      UINT16              DestPartId,
+  IN      EFI_GUID            *ServiceGuid OPTIONAL,
+  IN OUT  DIRECT_MSG_ARGS_EX  *ImpDefArgs
+  )
+{
+  ARM_SXC_ARGS  Args;
+
+  ImpDefArgs->FunctionId    = ARM_FID_FFA_MSG_SEND_DIRECT_REQ2;
+  ImpDefArgs->SourceId      = mFfaPartitionId;
+  ImpDefArgs->DestinationId = DestPartId;
+  if (ServiceGuid != NULL) {
+    CopyMem (&(ImpDefArgs->ServiceGuid), ServiceGuid, sizeof (EFI_GUID));
+  } else {
+    ZeroMem (&(ImpDefArgs->ServiceGuid), sizeof (EFI_GUID));
+  }
+
+  FfaPackDirectMessage (&Args, ImpDefArgs, NULL);
+
+  ArmCallSxc (&Args);
+
+  return FfaDirectReq2Complete (&Args, ImpDefArgs, NULL, NULL);
+}
+
+EFI_STATUS
+EFIAPI
+FfaExMessageSendDirectReq2Wire (
+  IN      UINT16               DestPartId,
+  IN      CONST FFA_WIRE_GUID  *ServiceGuid OPTIONAL,
+  IN OUT  DIRECT_MSG_ARGS_EX   *ImpDefArgs
+  )
+{
+  STATIC CONST FFA_WIRE_GUID  NullGuid;
+  FFA_WIRE_GUID               ResponseGuid;
+  ARM_SXC_ARGS                Args;
+
+  ImpDefArgs->FunctionId    = ARM_FID_FFA_MSG_SEND_DIRECT_REQ2;
+  ImpDefArgs->SourceId      = mFfaPartitionId;
+  ImpDefArgs->DestinationId = DestPartId;
+
+  FfaPackDirectMessage (&Args, ImpDefArgs, (ServiceGuid != NULL) ? ServiceGuid : &NullGuid);
+
+  ArmCallSxc (&Args);
+
+  return FfaDirectReq2Complete (&Args, ImpDefArgs, &ResponseGuid, NULL);
+}
+
+EFI_STATUS
+EFIAPI
+FfaExDirectReq2Start (
+  IN      UINT16              DestPartId,
+  IN      EFI_GUID            *ServiceGuid OPTIONAL,
+  IN OUT  DIRECT_MSG_ARGS_EX  *ImpDefArgs,
+  OUT     FFA_EX_DIRECT_REQ   *Request
+  )
+{
+  ARM_SXC_ARGS  Args;
+
+  if ((ImpDefArgs == NULL) || (Request == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  ZeroMem (Request, sizeof (*Request));
+
+  ImpDefArgs->FunctionId    = ARM_FID_FFA_MSG_SEND_DIRECT_REQ2;
+  ImpDefArgs->SourceId      = mFfaPartitionId;
+  ImpDefArgs->DestinationId = DestPartId;
+  if (ServiceGuid != NULL) {
+    CopyMem (&(ImpDefArgs->ServiceGuid), ServiceGuid, sizeof (EFI_GUID));
+  } else {
+    ZeroMem (&(ImpDefArgs->ServiceGuid), sizeof (EFI_GUID));
+  }
+
+  FfaPackDirectMessage (&Args, ImpDefArgs, NULL);
+
+  ArmCallSxc (&Args);
+
+  return FfaDirectReq2Complete (&Args, ImpDefArgs, NULL, Request);
+}
+
+EFI_STATUS
+EFIAPI
+FfaExDirectReq2Resume (
+  IN OUT  FFA_EX_DIRECT_REQ   *Request,
+  OUT     DIRECT_MSG_ARGS_EX  *Response
+  )
+{
+  ARM_SXC_ARGS  Args;
+
+  if ((Request == NULL) || (Response == NULL) || !Request->Pending) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  FfaDirectReq2Run (&Args, Request->Target);
+
+  return FfaDirectReq2Complete (&Args, Response, NULL, Request);
+}
+
+STATIC
+EFI_STATUS
+FfaMessageSendDirectResp (
+  IN UINT32               FunctionId,
+  IN DIRECT_MSG_ARGS_EX   *Request,
+  OUT DIRECT_MSG_ARGS_EX  *Response
+  )
+{
+  ARM_SXC_ARGS  Args;
+
+  Request->FunctionId = FunctionId;
+  FfaPackDirectMessage (&Args, Request, NULL);
+
+  if (FunctionId == ARM_FID_FFA_MSG_SEND_DIRECT_RESP2) {
+    ArmCallSxc (&Args);
+  } else {
+    ArmCallSxcX7X17 (&Args);
+  }
+
+  FfaHandleInterrupts (&Args, TRUE);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    return FfaStatusToEfiStatus (Args.Arg2);
+  } else if ((Args.Arg0 == ARM_FID_FFA_MSG_SEND_DIRECT_REQ_AARCH32) ||
+             (Args.Arg0 == ARM_FID_FFA_MSG_SEND_DIRECT_REQ_AARCH64) ||
+             (Args.Arg0 == ARM_FID_FFA_MSG_SEND_DIRECT_REQ2))
+  {
+    FfaUnpackDirectMessage (&Args, Response);
+  } else {
+    ASSERT (Args.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
+    *Response = (DIRECT_MSG_ARGS_EX) {
+      .FunctionId = Args.Arg0
+    };
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaMessageSendDirectResp32 (
+  IN DIRECT_MSG_ARGS_EX   *Request,
+  OUT DIRECT_MSG_ARGS_EX  *Response
+  )
+{
+  return FfaMessageSendDirectResp (
+           ARM_FID_FFA_MSG_SEND_DIRECT_RESP_AARCH32,
+           Request,
+           Response
+           );
+}
+
+EFI_STATUS
+EFIAPI
+FfaMessageSendDirectResp64 (
+  IN DIRECT_MSG_ARGS_EX   *Request,
+  OUT DIRECT_MSG_ARGS_EX  *Response
+  )
+{
+  return FfaMessageSendDirectResp (
+           ARM_FID_FFA_MSG_SEND_DIRECT_RESP_AARCH64,
+           Request,
+           Response
+           );
+}
+
+EFI_STATUS
+EFIAPI
+FfaMessageSendDirectResp2 (
+  IN DIRECT_MSG_ARGS_EX   *Request,
+  OUT DIRECT_MSG_ARGS_EX  *Response
+  )
+{
+  return FfaMessageSendDirectResp (
+           ARM_FID_FFA_MSG_SEND_DIRECT_RESP2,
+           Request,
+           Response
+           );
+}
+
+EFI_STATUS
+EFIAPI
+FfaIndirectMsgPrepare (
+  IN  UINT16          ReceiverId,
+  IN  CONST EFI_GUID  *ServiceGuid OPTIONAL,
+  OUT VOID            **Payload,
+  OUT UINTN           *MaxPayloadSize
+  )
+{
+  EFI_STATUS                   Status;
+  FFA_EX_PARTITION_MSG_HEADER  *Header;
+  VOID                         *TxBuffer;
+  UINT64                       TxBufferSize;
+
+  if ((Payload == NULL) || (MaxPayloadSize == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (!FfaExIsFeatureSupported (ARM_FID_FFA_MSG_SEND2)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Status = ArmFfaLibGetRxTxBuffers (&TxBuffer, &TxBufferSize, NULL, NULL);
+  if (EFI_ERROR (Status) || (TxBuffer == NULL) || (TxBufferSize <= sizeof (*Header))) {
+    return EFI_NOT_READY;
+  }
+
+  Header = (FFA_EX_PARTITION_MSG_HEADER *)TxBuffer;
+  ZeroMem (Header, sizeof (*Header));
+  Header->PayloadOffset = sizeof (*Header);
+  Header->ReceiverId    = ReceiverId;
+  Header->SenderId      = mFfaPartitionId;
+  if (ServiceGuid != NULL) {
+    FfaExGuidToWireGuid (ServiceGuid, (FFA_WIRE_GUID *)&Header->ServiceGuid);
+  }
+
+  *Payload        = (UINT8 *)TxBuffer + sizeof (*Header);
+  *MaxPayloadSize = (UINTN)TxBufferSize - sizeof (*Header);
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaIndirectMsgSend (
+  IN UINTN   PayloadSize,
+  IN UINT32  Flags
+  )
+{
+  EFI_STATUS                   Status;
+  FFA_EX_PARTITION_MSG_HEADER  *Header;
+  ARM_SXC_ARGS                 Args;
+  VOID                         *TxBuffer;
+  UINT64                       TxBufferSize;
+
+  if ((Flags & ~FFA_EX_MSG_SEND2_FLAG_DELAY_SRI) != 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = ArmFfaLibGetRxTxBuffers (&TxBuffer, &TxBufferSize, NULL, NULL);
+  if (EFI_ERROR (Status) || (TxBuffer == NULL)) {
+    return EFI_NOT_READY;
+  }
+
+  Header = (FFA_EX_PARTITION_MSG_HEADER *)TxBuffer;
+  if ((Header->PayloadOffset != sizeof (*Header)) ||
+      (PayloadSize > TxBufferSize - sizeof (*Header)))
+  {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  Header->PayloadSize = (UINT32)PayloadSize;
+
+  FfaInitArgs (&Args, ARM_FID_FFA_MSG_SEND2);
+  Args.Arg2 = Flags;
+
+  ArmCallSxcX7 (&Args);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    if ((INT32)Args.Arg2 == ARM_FFA_RET_BUSY) {
+      return EFI_NOT_READY;
+    }
+
+    return FfaStatusToEfiStatus (Args.Arg2);
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaIndirectMsgReceive (
+  OUT UINT16      *SenderId,
+  OUT EFI_GUID    *ServiceGuid OPTIONAL,
+  OUT CONST VOID  **Payload,
+  OUT UINTN       *PayloadSize
+  )
+{
+  EFI_STATUS                         Status;
+  CONST FFA_EX_PARTITION_MSG_HEADER  *Header;
+  VOID                               *RxBuffer;
+  UINT64                             RxBufferSize;
+
+  if ((SenderId == NULL) || (Payload == NULL) || (PayloadSize == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = ArmFfaLibGetRxTxBuffers (NULL, NULL, &RxBuffer, &RxBufferSize);
+  if (EFI_ERROR (Status) || (RxBuffer == NULL) || (RxBufferSize < sizeof (*Header))) {
+    return EFI_NOT_READY;
+  }
+
+  //
+  // The header is written by the SPMC, but check it anyway so that a corrupt
+  // one cannot point the caller outside of the RX buffer.
+  //
+  Header = (CONST FFA_EX_PARTITION_MSG_HEADER *)RxBuffer;
+  if ((Header->PayloadOffset < sizeof (*Header)) ||
+      (Header->PayloadOffset > RxBufferSize) ||
+      (Header->PayloadSize > RxBufferSize - Header->PayloadOffset))
+  {
+    return EFI_PROTOCOL_ERROR;
+  }
+
+  *SenderId    = Header->SenderId;
+  *Payload     = (CONST UINT8 *)RxBuffer + Header->PayloadOffset;
+  *PayloadSize = Header->PayloadSize;
+  mFfaRxHeld   = TRUE;
+  if (ServiceGuid != NULL) {
+    FfaExWireGuidToGuid ((CONST FFA_WIRE_GUID *)&Header->ServiceGuid, ServiceGuid);
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaIndirectMsgRelease (
+  VOID
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = ArmFfaLibRxRelease (0);
+  if (!EFI_ERROR (Status)) {
+    mFfaRxHeld = FALSE;
+  }
+
+  return Status;
+}
+
+EFI_STATUS
+EFIAPI
+FfaNsResInfoGet (
+  IN UINT16   TargetId,
+  IN UINT64   Flags,
+  OUT UINT32  *WrittenSize,
+  OUT UINT32  *RemainingSize
+  )
+{
+  ARM_SXC_ARGS  Args;
+
+  if ((WrittenSize == NULL) || (RemainingSize == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  FfaInitArgs (&Args, ARM_FID_FFA_NS_RES_INFO_GET);
+  Args.Arg1 = TargetId;
+  Args.Arg2 = Flags;
+
+  ArmCallSxcX7 (&Args);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    return FfaStatusToEfiStatus (Args.Arg2);
+  }
+
+  *WrittenSize   = Args.Arg2 >> 32;
+  *RemainingSize = Args.Arg2;
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaMemDonate (
+  UINT32  TotalLength,
+  UINT32  FragmentLength,
+  VOID    *BufferAddr,
+  UINT32  PageCount,
+  UINT64  *Handle
+  )
+{
+  ARM_SXC_ARGS  Args;
+
+  FfaInitArgs (&Args, (BufferAddr) ? ARM_FID_FFA_MEM_DONATE_AARCH64 : ARM_FID_FFA_MEM_DONATE_AARCH32);
+  Args.Arg1 = TotalLength;
+  Args.Arg2 = FragmentLength;
+  Args.Arg3 = (UINTN)BufferAddr;
+  Args.Arg4 = PageCount;
+
+  ArmCallSxcX7 (&Args);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    *Handle = 0U;
+    return FfaStatusToEfiStatus (Args.Arg2);
+  }
+
+  /*
+   * There are no 64-bit parameters returned with FFA_SUCCESS, the SPMC
+   * will use the default 32-bit version.
+   */
+  ASSERT (Args.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
+  *Handle = ((UINT64)Args.Arg3 << 32) | Args.Arg2;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaNotificationSet (
+  IN UINT16  DestinationId,
+  IN UINT64  Flags,
+  IN UINT64  NotificationBitmap
+  )
+{
+  ARM_SXC_ARGS  Args;
+
+  FfaInitArgs (&Args, ARM_FID_FFA_NOTIFICATION_SET);
+  Args.Arg1 = ((UINT32)mFfaPartitionId << 16) | DestinationId;
+  Args.Arg2 = Flags;
+  Args.Arg3 = (UINT32)NotificationBitmap;
+  Args.Arg4 = (UINT32)(NotificationBitmap >> 32);
+
+  ArmCallSxcX7 (&Args);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    return FfaStatusToEfiStatus (Args.Arg2);
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaNotificationGetAll (
+  IN  UINT16                       VCpuId,
+  IN  UINT64                       Flags,
+  OUT FFA_EX_NOTIFICATION_BITMAPS  *Bitmaps
+  )
+{
+  ARM_SXC_ARGS  Args;
+
+  if ((Bitmaps == NULL) || (Flags == 0) || ((Flags & ~FFA_NOTIFICATION_FLAG_BITMAP_ALL) != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  FfaInitArgs (&Args, ARM_FID_FFA_NOTIFICATION_GET);
+  Args.Arg1 = ((UINT32)VCpuId << 16) | mFfaPartitionId;
+  Args.Arg2 = Flags;
+
+  ArmCallSxcX7 (&Args);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    return FfaStatusToEfiStatus (Args.Arg2);
+  }
+
+  //
+  // The SPMC leaves the registers of bitmaps that were not requested zero,
+  // mask them anyway so that callers can rely on it.
+  //
+  ZeroMem (Bitmaps, sizeof (*Bitmaps));
+  if ((Flags & ARM_FFA_NOTIFICATION_FLAG_BITMAP_SP) != 0) {
+    Bitmaps->SpBitmap = ((UINT64)(UINT32)Args.Arg3 << 32) | (UINT32)Args.Arg2;
+  }
+
+  if ((Flags & ARM_FFA_NOTIFICATION_FLAG_BITMAP_VM) != 0) {
+    Bitmaps->VmBitmap = ((UINT64)(UINT32)Args.Arg5 << 32) | (UINT32)Args.Arg4;
+  }
+
+  if ((Flags & ARM_FFA_NOTIFICATION_FLAG_BITMAP_HYP) != 0) {
+    Bitmaps->HypBitmap = ((UINT64)(UINT32)Args.Arg7 << 32) | (UINT32)Args.Arg6;
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaNotificationGet (
+  IN UINT16  VCpuId,
+  IN UINT64  Flags,
+  IN UINT64  *NotificationBitmap
+  )
+{
+  EFI_STATUS                   Status;
+  FFA_EX_NOTIFICATION_BITMAPS  Bitmaps;
+
+  if ((Flags != ARM_FFA_NOTIFICATION_FLAG_BITMAP_SP) &&
+      (Flags != ARM_FFA_NOTIFICATION_FLAG_BITMAP_VM) &&
+      (Flags != ARM_FFA_NOTIFICATION_FLAG_BITMAP_HYP))
+  {
+    return EFI_UNSUPPORTED;
+  }
+
+  Status = FfaNotificationGetAll (VCpuId, Flags, &Bitmaps);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *NotificationBitmap = Bitmaps.SpBitmap | Bitmaps.VmBitmap | Bitmaps.HypBitmap;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaNotificationInfoGet (
+  OUT    FFA_EX_NOTIFICATION_INFO  *Info,
+  IN OUT UINTN                     *InfoCount,
+  OUT    BOOLEAN                   *MorePending
+  )
+{
+  ARM_SXC_ARGS  Args;
+  UINT64        *IdRegisters;
+  UINTN         ListCount;
+  UINTN         ListSize;
+  UINTN         IdIndex;
+  UINTN         List;
+  UINTN         Vcpu;
+
+  if ((Info == NULL) || (InfoCount == NULL) || (MorePending == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Reported lists are not reported again, so the whole answer must fit.
+  //
+  if (*InfoCount < FFA_EX_NOTIFICATION_INFO_MAX_LISTS) {
+    *InfoCount = FFA_EX_NOTIFICATION_INFO_MAX_LISTS;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  FfaInitArgs (&Args, ARM_FID_FFA_NOTIFICATION_INFO_GET_AARCH64);
+
+  ArmCallSxcX7 (&Args);
+
+  *InfoCount   = 0;
+  *MorePending = FALSE;
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    if ((INT32)Args.Arg2 == ARM_FFA_RET_NODATA) {
+      return EFI_SUCCESS;
+    }
+
+    return FfaStatusToEfiStatus (Args.Arg2);
+  }
+
+  IdRegisters = (UINT64 *)&Args.Arg3;
+  ListCount   = (Args.Arg2 >> FFA_NOTIFICATION_INFO_LIST_COUNT_SHIFT) & FFA_NOTIFICATION_INFO_LIST_COUNT_MASK;
+  IdIndex     = 0;
+
+  for (List = 0; List < ListCount; List++) {
+    ListSize = (Args.Arg2 >> (FFA_NOTIFICATION_INFO_LIST_SIZE_SHIFT + 2 * List)) &
+               FFA_NOTIFICATION_INFO_LIST_SIZE_MASK;
+    if ((List >= FFA_EX_NOTIFICATION_INFO_MAX_LISTS) ||
+        (IdIndex + 1 + ListSize > FFA_NOTIFICATION_INFO_MAX_IDS))
+    {
+      return EFI_DEVICE_ERROR;
+    }
+
+    Info[List].PartitionId = (UINT16)RShiftU64 (
+                                       IdRegisters[IdIndex / FFA_NOTIFICATION_INFO_IDS_PER_REGISTER],
+                                       (IdIndex % FFA_NOTIFICATION_INFO_IDS_PER_REGISTER) * 16
+                                       );
+    Info[List].VcpuCount = (UINT16)ListSize;
+    IdIndex++;
+
+    for (Vcpu = 0; Vcpu < ListSize; Vcpu++, IdIndex++) {
+      Info[List].VcpuIds[Vcpu] = (UINT16)RShiftU64 (
+                                           IdRegisters[IdIndex / FFA_NOTIFICATION_INFO_IDS_PER_REGISTER],
+                                           (IdIndex % FFA_NOTIFICATION_INFO_IDS_PER_REGISTER) * 16
+                                           );
+    }
+  }
+
+  *InfoCount   = ListCount;
+  *MorePending = (Args.Arg2 & FFA_NOTIFICATION_INFO_MORE_PENDING) != 0;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaNotificationInfoDrain (
+  IN  FFA_EX_NOTIFICATION_INFO_HANDLER  Handler,
+  IN  VOID                              *Context OPTIONAL,
+  OUT UINTN                             *ListCount OPTIONAL
+  )
+{
+  EFI_STATUS                Status;
+  FFA_EX_NOTIFICATION_INFO  Info[FFA_EX_NOTIFICATION_INFO_MAX_LISTS];
+  UINTN                     InfoCount;
+  BOOLEAN                   MorePending;
+  UINTN                     Dispatched;
+  UINTN                     Call;
+  UINTN                     Index;
+
+  if (Handler == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Dispatched  = 0;
+  MorePending = TRUE;
+  Status      = EFI_SUCCESS;
+
+  for (Call = 0; MorePending && (Call < FFA_NOTIFICATION_INFO_MAX_DRAIN); Call++) {
+    InfoCount = ARRAY_SIZE (Info);
+    Status    = FfaNotificationInfoGet (Info, &InfoCount, &MorePending);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+
+    for (Index = 0; Index < InfoCount; Index++) {
+      Handler (&Info[Index], Context);
+    }
+
+    Dispatched += InfoCount;
+  }
+
+  if (ListCount != NULL) {
+    *ListCount = Dispatched;
+  }
+
+  if (!EFI_ERROR (Status) && MorePending) {
+    Status = EFI_TIMEOUT;
+  }
+
+  return Status;
+}
+
+/**
+  Issues one FFA_PARTITION_INFO_GET_REGS call and copies the descriptors of
+  the returned window, with their UUIDs fixed up.
+
+  @param  ServiceGuid    GUID of the partitions to return, or the NULL GUID
+                         for all partitions, already prepared for FF-A.
+  @param  StartIndex     Index of the first descriptor to return.
+  @param  Tag            Tag returned by the previous window, 0 for the first.
+  @param  Metadata       Receives the metadata register of the response.
+  @param  PartDesc       Receives the descriptors of the window.
+  @param  MaxCount       Capacity of PartDesc.
+  @param  Count          Receives the number of descriptors in the window.
+
+  @retval EFI_SUCCESS           The window was copied.
+  @retval EFI_BUFFER_TOO_SMALL  The window holds more than MaxCount
+                                descriptors, Count has the window size.
+  @retval EFI_NOT_READY         The SPMC asked for a retry because the set of
+                                partitions changed since the first window.
+  @retval EFI_DEVICE_ERROR      The SPMC returned malformed metadata.
+  @retval Others                The SPMC returned an error.
+**/
+STATIC
+EFI_STATUS
+FfaPartitionInfoGetRegsWindow (
+  IN  CONST FFA_WIRE_GUID     *ServiceGuid,
+  IN  UINT16                  StartIndex,
+  IN  UINT16                  Tag,
+  OUT UINT64                  *Metadata,
+  OUT EFI_FFA_PART_INFO_DESC  *PartDesc,
+  IN  UINT32                  MaxCount,
+  OUT UINT32                  *Count
+  )
+{
+  ARM_SXC_ARGS  Args;
+  UINT16        CurrentIndex;
+  UINT16        LastIndex;
+  UINTN         Index;
+
+  FfaInitArgs (&Args, ARM_FID_FFA_PARTITION_INFO_GET_REGS);
+  Args.Arg1 = ServiceGuid->Words[0];
+  Args.Arg2 = ServiceGuid->Words[1];
+  Args.Arg3 = ((UINT32)Tag << 16) | StartIndex;
+
+  ArmCallSxcX7X17 (&Args);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    if ((INT32)Args.Arg2 == ARM_FFA_RET_RETRY) {
+      return EFI_NOT_READY;
+    }
+
+    return FfaStatusToEfiStatus (Args.Arg2);
+  }
+
+  *Metadata    = Args.Arg2;
+  LastIndex    = (UINT16)(*Metadata & FFA_PART_INFO_REGS_INDEX_MASK);
+  CurrentIndex = (UINT16)((*Metadata >> FFA_PART_INFO_REGS_CURRENT_SHIFT) & FFA_PART_INFO_REGS_INDEX_MASK);
+  if ((CurrentIndex < StartIndex) ||
+      (CurrentIndex > LastIndex) ||
+      (CurrentIndex - StartIndex >= FFA_PART_INFO_REGS_MAX_DESCS))
+  {
+    return EFI_DEVICE_ERROR;
+  }
+
+  *Count = CurrentIndex - StartIndex + 1;
+  if (*Count > MaxCount) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  CopyMem (PartDesc, &Args.Arg3, *Count * sizeof (EFI_FFA_PART_INFO_DESC));
+  for (Index = 0; Index < *Count; Index++) {
+    FfaPrepareGuid ((EFI_GUID *)PartDesc[Index].PartitionUuid);
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaPartitionInfoGetRegs (
+  IN EFI_GUID                 *ServiceGuid,
+  IN UINT16                   StartIndex,
+  IN OUT UINT16               *Tag OPTIONAL,
+  IN OUT UINT32               *PartDescCount,
+  OUT EFI_FFA_PART_INFO_DESC  *PartDesc OPTIONAL
+  )
+{
+  EFI_STATUS     Status;
+  FFA_WIRE_GUID  ServiceGuidMangled;
+  UINT64         Metadata = 0;
+  UINT16         TagValue = 0;
+
+  if ((PartDesc == NULL) || (PartDescCount == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (Tag != NULL) {
+    TagValue = *Tag;
+  }
+
+  if (ServiceGuid != NULL) {
+    FfaExGuidToWireGuid (ServiceGuid, &ServiceGuidMangled);
+  } else {
+    ZeroMem (&ServiceGuidMangled, sizeof (ServiceGuidMangled));
+  }
+
+  Status = FfaPartitionInfoGetRegsWindow (
+             &ServiceGuidMangled,
+             StartIndex,
+             TagValue,
+             &Metadata,
+             PartDesc,
+             *PartDescCount,
+             PartDescCount
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (Tag != NULL) {
+    *Tag = (UINT16)((Metadata >> FFA_PART_INFO_REGS_TAG_SHIFT) & FFA_PART_INFO_REGS_INDEX_MASK);
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaPartitionInfoGetAllRegs (
+  IN     EFI_GUID                *ServiceGuid OPTIONAL,
+  IN OUT UINT32                  *PartDescCount,
+  OUT    EFI_FFA_PART_INFO_DESC  *PartDesc OPTIONAL
+  )
+{
+  EFI_STATUS     Status;
+  FFA_WIRE_GUID  ServiceGuidMangled;
+  UINT64         Metadata;
+  UINT32         Total;
+  UINT32         Filled;
+  UINT32         Count;
+  UINT16         Tag;
+  UINTN          Attempt;
+
+  if (PartDescCount == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if ((PartDesc == NULL) && (*PartDescCount != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (ServiceGuid != NULL) {
+    FfaExGuidToWireGuid (ServiceGuid, &ServiceGuidMangled);
+  } else {
+    ZeroMem (&ServiceGuidMangled, sizeof (ServiceGuidMangled));
+  }
+
+  for (Attempt = 0; Attempt < FFA_PART_INFO_REGS_MAX_RETRIES; Attempt++) {
+    Filled = 0;
+    Tag    = 0;
+    Total  = 0;
+
+    //
+    // Walk the windows. The tag returned by the first window pins the
+    // enumeration; if the set of partitions changes before the last window
+    // the SPMC answers RETRY and the walk restarts from index 0.
+    //
+    do {
+      Status = FfaPartitionInfoGetRegsWindow (
+                 &ServiceGuidMangled,
+                 (UINT16)Filled,
+                 Tag,
+                 &Metadata,
+                 PartDesc + Filled,
+                 *PartDescCount - Filled,
+                 &Count
+                 );
+      if ((Status == EFI_BUFFER_TOO_SMALL) && (Filled == 0)) {
+        //
+        // The total is known after the first window, no need to walk the
+        // rest to report it.
+        //
+        *PartDescCount = (UINT32)(Metadata & FFA_PART_INFO_REGS_INDEX_MASK) + 1;
+        return EFI_BUFFER_TOO_SMALL;
+      }
+
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+
+      if (Filled == 0) {
+        Total = (UINT32)(Metadata & FFA_PART_INFO_REGS_INDEX_MASK) + 1;
+        Tag   = (UINT16)((Metadata >> FFA_PART_INFO_REGS_TAG_SHIFT) & FFA_PART_INFO_REGS_INDEX_MASK);
+        if (Total > *PartDescCount) {
+          *PartDescCount = Total;
+          return EFI_BUFFER_TOO_SMALL;
+        }
+      } else if ((UINT32)(Metadata & FFA_PART_INFO_REGS_INDEX_MASK) + 1 != Total) {
+        //
+        // The SPMC does not use tags and the set of partitions changed.
+        //
+        Status = EFI_NOT_READY;
+        break;
+      }
+
+      Filled += Count;
+    } while (Filled < Total);
+
+    if (!EFI_ERROR (Status)) {
+      *PartDescCount = Filled;
+      return EFI_SUCCESS;
+    }
+
+    if (Status != EFI_NOT_READY) {
+      return Status;
+    }
+  }
+
+  return EFI_NOT_READY;
+}
+
+EFI_STATUS
+EFIAPI
+FfaNotificationBitmapCreate (
+  IN UINT16  VCpuCount
+  )
+{
+  ARM_SXC_ARGS  Args;
+
+  FfaInitArgs (&Args, ARM_FID_FFA_NOTIFICATION_BITMAP_CREATE);
+  Args.Arg1 = mFfaPartitionId;
+  Args.Arg2 = VCpuCount;
+
+  ArmCallSxcX7 (&Args);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    return FfaStatusToEfiStatus (Args.Arg2);
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaNotificationBitmapDestroy (
+  VOID
+  )
+{
+  ARM_SXC_ARGS  Args;
+
+  FfaInitArgs (&Args, ARM_FID_FFA_NOTIFICATION_BITMAP_DESTROY);
+  Args.Arg1 = mFfaPartitionId;
+
+  ArmCallSxcX7 (&Args);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    return FfaStatusToEfiStatus (Args.Arg2);
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaNotificationBind (
+  IN UINT16  DestinationId,
+  IN UINT32  Flags,
+  IN UINT64  NotificationBitmap
+  )
+{
+  ARM_SXC_ARGS  Args;
+
+  FfaInitArgs (&Args, ARM_FID_FFA_NOTIFICATION_BIND);
+  Args.Arg1 = ((UINT32)DestinationId << 16) | mFfaPartitionId;
+  Args.Arg2 = Flags;
+  Args.Arg3 = (UINT32)NotificationBitmap;
+  Args.Arg4 = (UINT32)(NotificationBitmap >> 32);
+
+  ArmCallSxcX7 (&Args);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    return FfaStatusToEfiStatus (Args.Arg2);
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaNotificationUnbind (
+  IN UINT16  DestinationId,
+  IN UINT64  NotificationBitmap
+  )
+{
+  ARM_SXC_ARGS  Args;
+
+  FfaInitArgs (&Args, ARM_FID_FFA_NOTIFICATION_UNBIND);
+  Args.Arg1 = ((UINT32)DestinationId << 16) | mFfaPartitionId;
+  Args.Arg2 = 0;
+  Args.Arg3 = (UINT32)NotificationBitmap;
+  Args.Arg4 = (UINT32)(NotificationBitmap >> 32);
+
+  ArmCallSxcX7 (&Args);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    return FfaStatusToEfiStatus (Args.Arg2);
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaMemDonateRxTx (
+  UINT32  TotalLength,
+  UINT32  FragmentLength,
+  UINT64  *Handle
+  )
+{
+  return FfaMemDonate (TotalLength, FragmentLength, NULL, 0, Handle);
+}
+
+EFI_STATUS
+EFIAPI
+FfaMemLend (
+  UINT32  TotalLength,
+  UINT32  FragmentLength,
+  VOID    *BufferAddr,
+  UINT32  PageCount,
+  UINT64  *Handle
+  )
+{
+  ARM_SXC_ARGS  Args;
+
+  FfaInitArgs (&Args, (BufferAddr) ? ARM_FID_FFA_MEM_LEND_AARCH64 : ARM_FID_FFA_MEM_LEND_AARCH32);
+  Args.Arg1 = TotalLength;
+  Args.Arg2 = FragmentLength;
+  Args.Arg3 = (UINTN)BufferAddr;
+  Args.Arg4 = PageCount;
+
+  ArmCallSxcX7 (&Args);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    *Handle = 0U;
+    return FfaStatusToEfiStatus (Args.Arg2);
+  }
+
+  /*
+   * There are no 64-bit parameters returned with FFA_SUCCESS, the SPMC
+   * will use the default 32-bit version.
+   */
+  ASSERT (Args.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
+  *Handle = ((UINT64)Args.Arg3 << 32) | Args.Arg2;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaMemLendRxTx (
+  UINT32  TotalLength,
+  UINT32  FragmentLength,
+  UINT64  *Handle
+  )
+{
+  return FfaMemLend (TotalLength, FragmentLength, NULL, 0, Handle);
+}
+
+EFI_STATUS
+EFIAPI
+FfaMemShare (
+  UINT32  TotalLength,
+  UINT32  FragmentLength,
+  VOID    *BufferAddr,
+  UINT32  PageCount,
+  UINT64  *Handle
+  )
+{
+  ARM_SXC_ARGS  Args;
+
+  FfaInitArgs (&Args, (BufferAddr) ? ARM_FID_FFA_MEM_SHARE_AARCH64 : ARM_FID_FFA_MEM_SHARE_AARCH32);
+  Args.Arg1 = TotalLength;
+  Args.Arg2 = FragmentLength;
+  Args.Arg3 = (UINTN)BufferAddr;
+  Args.Arg4 = PageCount;
+
+  ArmCallSxcX7 (&Args);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    *Handle = 0U;
+    return FfaStatusToEfiStatus (Args.Arg2);
+  }
+
+  /*
+   * There are no 64-bit parameters returned with FFA_SUCCESS, the SPMC
+   * will use the default 32-bit version.
+   */
+  ASSERT (Args.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
+  *Handle = ((UINT64)Args.Arg3 << 32) | Args.Arg2;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaMemShareRxTx (
+  UINT32  TotalLength,
+  UINT32  FragmentLength,
+  UINT64  *Handle
+  )
+{
+  return FfaMemShare (TotalLength, FragmentLength, NULL, 0, Handle);
+}
+
+EFI_STATUS
+EFIAPI
+FfaMemRetrieveReq (
+  UINT32  TotalLength,
+  UINT32  FragmentLength,
+  VOID    *BufferAddr,
+  UINT32  PageCount,
+  UINT32  *RespTotalLength,
+  UINT32  *RespFragmentLength
+  )
+{
+  ARM_SXC_ARGS  Args;
+
+  FfaInitArgs (&Args, (BufferAddr) ? ARM_FID_FFA_MEM_RETRIEVE_REQ_AARCH64 : ARM_FID_FFA_MEM_RETRIEVE_REQ_AARCH32);
+  Args.Arg1 = TotalLength;
+  Args.Arg2 = FragmentLength;
+  Args.Arg3 = (UINTN)BufferAddr;
+  Args.Arg4 = PageCount;
+
+  ArmCallSxcX7 (&Args);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    *RespTotalLength    = 0U;
+    *RespFragmentLength = 0U;
+    return FfaStatusToEfiStatus (Args.Arg2);
+  }
+
+  ASSERT (Args.Arg0 == ARM_FID_FFA_MEM_RETRIEVE_RESP);
+  *RespTotalLength    = Args.Arg1;
+  *RespFragmentLength = Args.Arg2;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaMemRetrieveReqRxTx (
+  UINT32  TotalLength,
+  UINT32  FragmentLength,
+  UINT32  *RespTotalLength,
+  UINT32  *RespFragmentLength
+  )
+{
+  return FfaMemRetrieveReq (
+           TotalLength,
+           FragmentLength,
+           NULL,
+           0,
+           RespTotalLength,
+           RespFragmentLength
+           );
+}
+
+EFI_STATUS
+EFIAPI
+FfaMemRelinquish (
+  VOID
+  )
+{
+  ARM_SXC_ARGS  Args;
+
+  FfaInitArgs (&Args, ARM_FID_FFA_MEM_RETRIEVE_RELINQUISH);
+
+  ArmCallSxcX7 (&Args);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    return FfaStatusToEfiStatus (Args.Arg2);
+  }
+
+  ASSERT (Args.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaMemReclaim (
+  UINT64  Handle,
+  UINT32  Flags
+  )
+{
+  ARM_SXC_ARGS  Args;
+  UINT32        HandleHi = 0;
+  UINT32        HandleLo = 0;
+
+  HandleHi = (Handle >> 32) & MAX_UINT32;
+  HandleLo = Handle & MAX_UINT32;
+
+  FfaInitArgs (&Args, ARM_FID_FFA_MEM_RETRIEVE_RECLAIM);
+  Args.Arg1 = HandleLo;
+  Args.Arg2 = HandleHi;
+  Args.Arg3 = Flags;
+
+  ArmCallSxcX7 (&Args);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    return FfaStatusToEfiStatus (Args.Arg2);
+  }
+
+  ASSERT (Args.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
+  return EFI_SUCCESS;
+}
+
+/**
+  Sets the memory attributes of one run of pages, with the SMC64 variant of
+  FFA_MEM_PERM_SET if its base does not fit 32 bits, and keeps the permission
+  shadow in sync.
+
+  @param  BaseAddress  Base VA of the run.
+  @param  PageCount    Number of 4K pages in the run.
+  @param  MemoryPerm   Permission attributes to set.
+
+  @retval EFI_SUCCESS  The attributes were set.
+  @retval Others       The FF-A error status code.
+**/
+STATIC
+EFI_STATUS
+FfaMemPermSetRun (
+  IN UINT64  BaseAddress,
+  IN UINT32  PageCount,
+  IN UINT32  MemoryPerm
+  )
+{
+  ARM_SXC_ARGS  Args;
+
+  if (BaseAddress > MAX_UINT32) {
+    FfaInitArgs (&Args, ARM_FID_FFA_MEM_PERM_SET_AARCH64);
+  } else {
+    FfaInitArgs (&Args, ARM_FID_FFA_MEM_PERM_SET_AARCH32);
+  }
+
+  Args.Arg1 = (UINTN)BaseAddress;
+  Args.Arg2 = PageCount;
+  Args.Arg3 = MemoryPerm;
+
+  ArmCallSxcX7 (&Args);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    //
+    // The SPMC may have changed part of the run before it failed.
+    //
+    if (FeaturePcdGet (PcdFfaLibExPermShadowEnable)) {
+      FfaPermShadowInvalidate (BaseAddress & ~(UINT64)EFI_PAGE_MASK, PageCount);
+    }
+
+    return FfaStatusToEfiStatus (Args.Arg2);
+  }
+
+  ASSERT (Args.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
+  if (FeaturePcdGet (PcdFfaLibExPermShadowEnable)) {
+    FfaPermShadowUpdate (BaseAddress, PageCount, MemoryPerm);
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaMemPermGet (
+  CONST VOID  *BaseAddr,
+  UINT32      *MemoryPerm
+  )
+{
+  ARM_SXC_ARGS  Args;
+
+  if (FeaturePcdGet (PcdFfaLibExPermShadowEnable) && FfaPermShadowLookup ((UINTN)BaseAddr, MemoryPerm)) {
+    return EFI_SUCCESS;
+  }
+
+  FfaInitArgs (&Args, ARM_FID_FFA_MEM_PERM_GET_AARCH32);
+  Args.Arg1 = (UINTN)BaseAddr;
+
+  ArmCallSxcX7 (&Args);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    return FfaStatusToEfiStatus (Args.Arg2);
+  }
+
+  ASSERT (Args.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
+  *MemoryPerm = Args.Arg2;
+
+  //
+  // The answer covers the translation granule holding BaseAddr.
+  //
+  if (FeaturePcdGet (PcdFfaLibExPermShadowEnable)) {
+    FfaPermShadowUpdate ((UINTN)BaseAddr & ~(UINT64)EFI_PAGE_MASK, 1, *MemoryPerm);
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaMemPermSet (
+  CONST VOID  *BaseAddr,
+  UINT32      PageCount,
+  UINT32      MemoryPerm
+  )
+{
+  ASSERT ((MemoryPerm & ARM_FFA_MEM_PERM_RESERVED_MASK) == 0);
+
+  return FfaMemPermSetRun ((UINTN)BaseAddr, PageCount, MemoryPerm);
+}
+
+/**
+  Orders permission ranges by base address.
+
+  @param  Buffer1  The first FFA_EX_MEM_PERM_RANGE.
+  @param  Buffer2  The second FFA_EX_MEM_PERM_RANGE.
+
+  @retval <0  Buffer1 is based below Buffer2.
+  @retval 0   Both have the same base.
+  @retval >0  Buffer1 is based above Buffer2.
+**/
+STATIC
+INTN
+EFIAPI
+FfaMemPermRangeCompare (
+  IN CONST VOID  *Buffer1,
+  IN CONST VOID  *Buffer2
+  )
+{
+  CONST FFA_EX_MEM_PERM_RANGE  *Range1;
+  CONST FFA_EX_MEM_PERM_RANGE  *Range2;
+
+  Range1 = Buffer1;
+  Range2 = Buffer2;
+  if (Range1->BaseAddress == Range2->BaseAddress) {
+    return 0;
+  }
+
+  return (Range1->BaseAddress < Range2->BaseAddress) ? -1 : 1;
+}
+
+EFI_STATUS
+EFIAPI
+FfaMemPermSetBatch (
+  IN OUT FFA_EX_MEM_PERM_RANGE  *Ranges,
+  IN     UINTN                  Count,
+  OUT    UINTN                  *CallsSaved OPTIONAL
+  )
+{
+  EFI_STATUS             Status;
+  FFA_EX_MEM_PERM_RANGE  Scratch;
+  UINT64                 RunBase;
+  UINT64                 RunPages;
+  UINT32                 RunPerm;
+  UINT32                 Pages;
+  UINTN                  Index;
+  UINTN                  Calls;
+
+  if ((Ranges == NULL) && (Count != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  for (Index = 0; Index < Count; Index++) {
+    if ((Ranges[Index].PageCount == 0) ||
+        ((Ranges[Index].BaseAddress & EFI_PAGE_MASK) != 0) ||
+        ((Ranges[Index].MemoryPerm & ARM_FFA_MEM_PERM_RESERVED_MASK) != 0) ||
+        (Ranges[Index].BaseAddress > MAX_UINT64 - EFI_PAGES_TO_SIZE ((UINTN)Ranges[Index].PageCount)))
+    {
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+
+  QuickSort (Ranges, Count, sizeof (*Ranges), FfaMemPermRangeCompare, &Scratch);
+
+  //
+  // Overlapping ranges leave the outcome up to the order of the calls,
+  // reject them before anything is changed.
+  //
+  for (Index = 1; Index < Count; Index++) {
+    if (Ranges[Index].BaseAddress < Ranges[Index - 1].BaseAddress + EFI_PAGES_TO_SIZE ((UINTN)Ranges[Index - 1].PageCount)) {
+      return EFI_INVALID_PARAMETER;
+    }
+  }
+
+  Calls = 0;
+  Index = 0;
+  while (Index < Count) {
+    RunBase  = Ranges[Index].BaseAddress;
+    RunPages = Ranges[Index].PageCount;
+    RunPerm  = Ranges[Index].MemoryPerm;
+    for (Index++; Index < Count; Index++) {
+      if ((Ranges[Index].MemoryPerm != RunPerm) ||
+          (Ranges[Index].BaseAddress != RunBase + EFI_PAGES_TO_SIZE ((UINTN)RunPages)))
+      {
+        break;
+      }
+
+      RunPages += Ranges[Index].PageCount;
+    }
+
+    //
+    // The page count is 32-bit in both variants, split a merged run that
+    // outgrew it. This never takes more calls than the ranges it merged.
+    //
+    while (RunPages != 0) {
+      Pages  = (UINT32)MIN (RunPages, MAX_UINT32);
+      Status = FfaMemPermSetRun (RunBase, Pages, RunPerm);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+
+      Calls++;
+      RunBase  += EFI_PAGES_TO_SIZE ((UINTN)Pages);
+      RunPages -= Pages;
+    }
+  }
+
+  if (CallsSaved != NULL) {
+    *CallsSaved = Count - Calls;
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaExMemTransactionInit (
+  OUT FFA_EX_MEM_TRANSACTION  *Transaction,
+  IN  UINT16                  Attributes,
+  IN  UINT32                  Flags,
+  IN  UINT64                  Tag
+  )
+{
+  EFI_STATUS                   Status;
+  FFA_EX_MEM_TRANSACTION_DESC  *Desc;
+  VOID                         *TxBuffer;
+  UINT64                       TxBufferSize;
+
+  if (Transaction == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // The first fragment must at least hold the header, one receiver, the
+  // composite descriptor and one constituent.
+  //
+  Status = ArmFfaLibGetRxTxBuffers (&TxBuffer, &TxBufferSize, NULL, NULL);
+  if (EFI_ERROR (Status) || (TxBuffer == NULL) ||
+      (TxBufferSize < sizeof (FFA_EX_MEM_TRANSACTION_DESC) + sizeof (FFA_EX_MEM_ACCESS_DESC) +
+       sizeof (FFA_EX_MEM_COMPOSITE_DESC) + sizeof (FFA_EX_MEM_CONSTITUENT_DESC)))
+  {
+    return EFI_NOT_READY;
+  }
+
+  ZeroMem (Transaction, sizeof (*Transaction));
+  Transaction->Buffer     = TxBuffer;
+  Transaction->BufferSize = (UINT32)MIN (TxBufferSize, MAX_UINT32);
+
+  Desc = (FFA_EX_MEM_TRANSACTION_DESC *)TxBuffer;
+  ZeroMem (Desc, sizeof (*Desc));
+  Desc->SenderId            = mFfaPartitionId;
+  Desc->Attributes          = Attributes;
+  Desc->Flags               = Flags;
+  Desc->Tag                 = Tag;
+  Desc->MemAccessDescSize   = sizeof (FFA_EX_MEM_ACCESS_DESC);
+  Desc->MemAccessDescOffset = sizeof (FFA_EX_MEM_TRANSACTION_DESC);
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaExMemTransactionAddReceiver (
+  IN OUT FFA_EX_MEM_TRANSACTION  *Transaction,
+  IN     UINT16                  ReceiverId,
+  IN     UINT8                   Permissions,
+  IN     UINT8                   Flags
+  )
+{
+  FFA_EX_MEM_ACCESS_DESC  *Access;
+  UINTN                   Length;
+
+  if ((Transaction == NULL) || (Transaction->Buffer == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Length = sizeof (FFA_EX_MEM_TRANSACTION_DESC) +
+           (Transaction->ReceiverCount + 1) * sizeof (FFA_EX_MEM_ACCESS_DESC) +
+           sizeof (FFA_EX_MEM_COMPOSITE_DESC) + sizeof (FFA_EX_MEM_CONSTITUENT_DESC);
+  if (Length > Transaction->BufferSize) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // The composite descriptor offset depends on the final receiver count, it
+  // is filled in by FfaExMemTransactionSend.
+  //
+  Access = (FFA_EX_MEM_ACCESS_DESC *)(Transaction->Buffer + sizeof (FFA_EX_MEM_TRANSACTION_DESC)) +
+           Transaction->ReceiverCount;
+  ZeroMem (Access, sizeof (*Access));
+  Access->ReceiverId  = ReceiverId;
+  Access->Permissions = Permissions;
+  Access->Flags       = Flags;
+
+  Transaction->ReceiverCount++;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaExMemTransactionSetConstituents (
+  IN OUT FFA_EX_MEM_TRANSACTION             *Transaction,
+  IN     CONST FFA_EX_MEM_CONSTITUENT_DESC  *Constituents,
+  IN     UINT32                             ConstituentCount
+  )
+{
+  UINT64  PageCount;
+  UINT32  Index;
+
+  if ((Transaction == NULL) || (Constituents == NULL) || (ConstituentCount == 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  PageCount = 0;
+  for (Index = 0; Index < ConstituentCount; Index++) {
+    if (Constituents[Index].PageCount == 0) {
+      return EFI_INVALID_PARAMETER;
+    }
+
+    PageCount += Constituents[Index].PageCount;
+  }
+
+  if (PageCount > MAX_UINT32) {
+    return EFI_INVALID_PARAMETER;
+  }
 
-  if (PartDesc == NULL) {
+  Transaction->Constituents     = Constituents;
+  Transaction->ConstituentCount = ConstituentCount;
+  Transaction->PageCount        = (UINT32)PageCount;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaExMemTransactionSend (
+  IN OUT FFA_EX_MEM_TRANSACTION       *Transaction,
+  IN     FFA_EX_MEM_TRANSACTION_TYPE  Type,
+  OUT    UINT64                       *Handle
+  )
+{
+  FFA_EX_MEM_TRANSACTION_DESC  *Desc;
+  FFA_EX_MEM_ACCESS_DESC       *Access;
+  FFA_EX_MEM_COMPOSITE_DESC    *Composite;
+  ARM_SXC_ARGS                 Args;
+  EFI_STATUS                   Status;
+  UINT64                       TotalLength;
+  UINT32                       CompositeOffset;
+  UINT32                       FragmentLength;
+  UINT32                       SentLength;
+  UINT32                       Sent;
+  UINT32                       Count;
+  UINT32                       Index;
+  UINT64                       FragHandle;
+  BOOLEAN                      Fragmented;
+
+  if ((Transaction == NULL) || (Handle == NULL) || (Transaction->Buffer == NULL) ||
+      (Transaction->ReceiverCount == 0) || (Transaction->ConstituentCount == 0))
+  {
     return EFI_INVALID_PARAMETER;
   }
 
-  if (Tag != NULL) {
-    TagValue = *Tag;
-  }
+  *Handle = 0U;
 
-  if (ServiceGuid != NULL) {
-    CopyMem (&ServiceGuidMangled, ServiceGuid, sizeof (EFI_GUID));
-  } else {
-    ZeroMem (&ServiceGuidMangled, sizeof (EFI_GUID));
+  switch (Type) {
+    case FfaExMemTypeShare:
+      FfaInitArgs (&Args, ARM_FID_FFA_MEM_SHARE_AARCH32);
+      break;
+    case FfaExMemTypeLend:
+      FfaInitArgs (&Args, ARM_FID_FFA_MEM_LEND_AARCH32);
+      break;
+    case FfaExMemTypeDonate:
+      FfaInitArgs (&Args, ARM_FID_FFA_MEM_DONATE_AARCH32);
+      break;
+    default:
+      return EFI_INVALID_PARAMETER;
   }
 
-  FfaPrepareGuid (&ServiceGuidMangled);
-  Request.Arg0 = ARM_FID_FFA_PARTITION_INFO_GET_REGS;
-  CopyMem (&Request.Arg1, &ServiceGuidMangled, sizeof (EFI_GUID));
-  Request.Arg3 = ((UINT32)TagValue << 16) | StartIndex;
+  CompositeOffset = sizeof (FFA_EX_MEM_TRANSACTION_DESC) +
+                    Transaction->ReceiverCount * sizeof (FFA_EX_MEM_ACCESS_DESC);
+  TotalLength = (UINT64)CompositeOffset + sizeof (FFA_EX_MEM_COMPOSITE_DESC) +
+                (UINT64)Transaction->ConstituentCount * sizeof (FFA_EX_MEM_CONSTITUENT_DESC);
+  if (TotalLength > MAX_UINT32) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
 
-  ArmCallSxc (&Request, &Result);
+  //
+  // Finish the first fragment: the receivers are already in place, all of
+  // them point at the single composite descriptor.
+  //
+  Desc                     = (FFA_EX_MEM_TRANSACTION_DESC *)Transaction->Buffer;
+  Desc->MemAccessDescCount = Transaction->ReceiverCount;
+  Access                   = (FFA_EX_MEM_ACCESS_DESC *)(Desc + 1);
+  for (Index = 0; Index < Transaction->ReceiverCount; Index++) {
+    Access[Index].CompositeOffset = CompositeOffset;
+  }
 
-  if (Result.Arg0 == ARM_FID_FFA_ERROR) {
-    return FfaStatusToEfiStatus (Result.Arg2);
+  Composite = (FFA_EX_MEM_COMPOSITE_DESC *)(Transaction->Buffer + CompositeOffset);
+  ZeroMem (Composite, sizeof (*Composite));
+  Composite->TotalPageCount    = Transaction->PageCount;
+  Composite->AddressRangeCount = Transaction->ConstituentCount;
+
+  Count = MIN (
+            Transaction->ConstituentCount,
+            (Transaction->BufferSize - CompositeOffset - sizeof (*Composite)) / sizeof (FFA_EX_MEM_CONSTITUENT_DESC)
+            );
+  CopyMem (Composite + 1, Transaction->Constituents, Count * sizeof (FFA_EX_MEM_CONSTITUENT_DESC));
+  FragmentLength = CompositeOffset + sizeof (*Composite) + Count * sizeof (FFA_EX_MEM_CONSTITUENT_DESC);
+
+  Args.Arg1 = (UINT32)TotalLength;
+  Args.Arg2 = FragmentLength;
+
+  ArmCallSxcX7 (&Args);
+
+  SentLength = FragmentLength;
+  Sent       = Count;
+  FragHandle = 0;
+  Fragmented = FALSE;
+
+  //
+  // Each further fragment is a whole number of constituents, copied from the
+  // caller's list into the TX buffer the SPMC just consumed.
+  //
+  while (Args.Arg0 == ARM_FID_FFA_MEM_FRAG_RX) {
+    FragHandle = ((UINT64)(UINT32)Args.Arg2 << 32) | (UINT32)Args.Arg1;
+    Fragmented = TRUE;
+    if (((UINT32)Args.Arg3 != SentLength) || (Sent == Transaction->ConstituentCount)) {
+      DEBUG ((DEBUG_ERROR, "%a: SPMC asked for offset 0x%x, 0x%x bytes sent\n", __func__, (UINT32)Args.Arg3, SentLength));
+      Status = EFI_PROTOCOL_ERROR;
+      goto Abort;
+    }
+
+    Count = MIN (
+              Transaction->ConstituentCount - Sent,
+              Transaction->BufferSize / sizeof (FFA_EX_MEM_CONSTITUENT_DESC)
+              );
+    CopyMem (Transaction->Buffer, &Transaction->Constituents[Sent], Count * sizeof (FFA_EX_MEM_CONSTITUENT_DESC));
+    FragmentLength = Count * sizeof (FFA_EX_MEM_CONSTITUENT_DESC);
+
+    FfaInitArgs (&Args, ARM_FID_FFA_MEM_FRAG_TX);
+    Args.Arg1 = (UINT32)FragHandle;
+    Args.Arg2 = (UINT32)RShiftU64 (FragHandle, 32);
+    Args.Arg3 = FragmentLength;
+
+    ArmCallSxcX7 (&Args);
+
+    SentLength += FragmentLength;
+    Sent       += Count;
   }
 
-  Metadata     = Result.Arg2;
-  CurrentIndex = (UINT16)((Metadata >> 16) & 0xFFFF);
-  Count        = CurrentIndex - StartIndex + 1;
-  if ((PartDesc == NULL) ||
-      (*PartDescCount < Count))
-  {
-    *PartDescCount = Count;
-    return EFI_BUFFER_TOO_SMALL;
+  if (Args.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32) {
+    *Handle = ((UINT64)(UINT32)Args.Arg3 << 32) | (UINT32)Args.Arg2;
+    return EFI_SUCCESS;
   }
 
-  *PartDescCount = Count;
-  for (UINTN Index = 0; Index < Count; Index++) {
-    CopyMem (PartDesc + Index, (VOID *)((UINTN)(&Result.Arg3) + Index * sizeof (EFI_FFA_PART_INFO_DESC)), sizeof (EFI_FFA_PART_INFO_DESC));
-    FfaPrepareGuid ((EFI_GUID *)PartDesc->PartitionUuid);
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    Status = FfaStatusToEfiStatus (Args.Arg2);
+  } else {
+    DEBUG ((DEBUG_ERROR, "%a: unexpected response 0x%x\n", __func__, (UINT32)Args.Arg0));
+    Status = EFI_PROTOCOL_ERROR;
   }
 
-  if (Tag != NULL) {
-    *Tag = (UINT16)((Metadata >> 32) & 0xFFFF);
+Abort:
+  //
+  // Once the SPMC took a fragment, the transaction stays open under
+  // FragHandle until reclaimed, and the memory cannot be shared again.
+  //
+  if (Fragmented) {
+    FfaMemReclaim (FragHandle, 0);
   }
 
-  return EFI_SUCCESS;
+  return Status;
 }
 
+/**
+  Hands the constituents of one fragment of a retrieve response to the
+  caller.
+
+  @param  Constituents  The constituents, in the RX buffer.
+  @param  Length        The length in bytes of the constituents.
+  @param  RangeCount    The number of constituents of the whole region.
+  @param  Handler       Optional, the caller's constituent handler.
+  @param  Context       Context passed to Handler.
+  @param  Delivered     On input the number of constituents delivered so far,
+                        on output updated with this fragment.
+
+  @retval EFI_SUCCESS         The constituents were delivered.
+  @retval EFI_PROTOCOL_ERROR  The fragment does not hold whole constituents,
+                              or more than the region has.
+  @retval Others              The status returned by Handler.
+**/
+STATIC
 EFI_STATUS
-EFIAPI
-FfaNotificationBitmapCreate (
-  IN UINT16  VCpuCount
+FfaMemRetrieveDeliver (
+  IN     CONST FFA_EX_MEM_CONSTITUENT_DESC  *Constituents,
+  IN     UINT32                             Length,
+  IN     UINT32                             RangeCount,
+  IN     FFA_EX_MEM_CONSTITUENT_HANDLER     Handler OPTIONAL,
+  IN     VOID                               *Context,
+  IN OUT UINT32                             *Delivered
   )
 {
-  ARM_SXC_ARGS  Request = { 0 };
-  ARM_SXC_ARGS  Result  = { 0 };
+  EFI_STATUS  Status;
+  UINT32      Count;
 
-  if (mPartitionId == INVALID_SOURCE_ID) {
-    ArmFfaLibPartitionIdGet (&mPartitionId);
+  if ((Length % sizeof (FFA_EX_MEM_CONSTITUENT_DESC)) != 0) {
+    return EFI_PROTOCOL_ERROR;
   }
 
-  Request.Arg0 = ARM_FID_FFA_NOTIFICATION_BITMAP_CREATE;
-  Request.Arg1 = mPartitionId;
-  Request.Arg2 = VCpuCount;
-
-  ArmCallSxc (&Request, &Result);
+  Count = Length / sizeof (FFA_EX_MEM_CONSTITUENT_DESC);
+  if (Count > RangeCount - *Delivered) {
+    return EFI_PROTOCOL_ERROR;
+  }
 
-  if (Result.Arg0 == ARM_FID_FFA_ERROR) {
-    return FfaStatusToEfiStatus (Result.Arg2);
+  if ((Handler != NULL) && (Count != 0)) {
+    Status = Handler (Constituents, Count, Context);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
   }
 
+  *Delivered += Count;
   return EFI_SUCCESS;
 }
 
+/**
+  Retrieves a memory region, see FfaExMemRetrieve.
+
+  @param  Handle          Handle of the memory region.
+  @param  SenderId        Partition ID of the owner of the memory region.
+  @param  Permissions     Memory access permissions requested.
+  @param  Handler         Optional, called with the constituents of each
+                          fragment.
+  @param  Context         Optional, passed to Handler.
+  @param  Descriptor      Optional, receives a copy of the retrieve response.
+  @param  DescriptorSize  Required with Descriptor, its size on input, the
+                          size of the response on output.
+  @param  Retrieved       Set to TRUE once the SPMC accepted the retrieve
+                          request, i.e. the region is held even if an error
+                          is returned.
+
+  @retval EFI_SUCCESS  The region was retrieved.
+  @retval Others       See FfaExMemRetrieve.
+**/
+STATIC
 EFI_STATUS
-EFIAPI
-FfaNotificationBitmapDestroy (
-  VOID
+FfaMemRetrieve (
+  IN     UINT64                          Handle,
+  IN     UINT16                          SenderId,
+  IN     UINT8                           Permissions,
+  IN     FFA_EX_MEM_CONSTITUENT_HANDLER  Handler OPTIONAL,
+  IN     VOID                            *Context OPTIONAL,
+  OUT    VOID                            *Descriptor OPTIONAL,
+  IN OUT UINT32                          *DescriptorSize OPTIONAL,
+  OUT    BOOLEAN                         *Retrieved
   )
 {
-  ARM_SXC_ARGS  Request = { 0 };
-  ARM_SXC_ARGS  Result  = { 0 };
+  EFI_STATUS                         Status;
+  EFI_STATUS                         ReleaseStatus;
+  FFA_EX_MEM_TRANSACTION_DESC        *Request;
+  FFA_EX_MEM_ACCESS_DESC             *RequestAccess;
+  CONST FFA_EX_MEM_TRANSACTION_DESC  *Response;
+  CONST FFA_EX_MEM_ACCESS_DESC       *Access;
+  CONST FFA_EX_MEM_COMPOSITE_DESC    *Composite;
+  ARM_SXC_ARGS                       Args;
+  VOID                               *TxBuffer;
+  VOID                               *RxBuffer;
+  UINT64                             TxBufferSize;
+  UINT64                             RxBufferSize;
+  UINT32                             TotalLength;
+  UINT32                             FragmentLength;
+  UINT32                             Received;
+  UINT32                             Start;
+  UINT32                             RangeCount;
+  UINT32                             Delivered;
+  BOOLEAN                            Copy;
+
+  *Retrieved = FALSE;
+  if ((Descriptor != NULL) && (DescriptorSize == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
 
-  if (mPartitionId == INVALID_SOURCE_ID) {
-    ArmFfaLibPartitionIdGet (&mPartitionId);
+  Status = ArmFfaLibGetRxTxBuffers (&TxBuffer, &TxBufferSize, &RxBuffer, &RxBufferSize);
+  if (EFI_ERROR (Status) || (TxBuffer == NULL) || (RxBuffer == NULL) ||
+      (TxBufferSize < sizeof (*Request) + sizeof (*RequestAccess)))
+  {
+    return EFI_NOT_READY;
   }
 
-  Request.Arg0 = ARM_FID_FFA_NOTIFICATION_BITMAP_DESTROY;
-  Request.Arg1 = mPartitionId;
+  //
+  // The retrieve request is a transaction descriptor with a single endpoint
+  // memory access descriptor for the caller and no composite descriptor.
+  //
+  Request = (FFA_EX_MEM_TRANSACTION_DESC *)TxBuffer;
+  ZeroMem (Request, sizeof (*Request) + sizeof (*RequestAccess));
+  Request->SenderId            = SenderId;
+  Request->Handle              = Handle;
+  Request->MemAccessDescSize   = sizeof (*RequestAccess);
+  Request->MemAccessDescCount  = 1;
+  Request->MemAccessDescOffset = sizeof (*Request);
+
+  RequestAccess              = (FFA_EX_MEM_ACCESS_DESC *)(Request + 1);
+  RequestAccess->ReceiverId  = mFfaPartitionId;
+  RequestAccess->Permissions = Permissions;
+
+  Status = FfaMemRetrieveReqRxTx (
+             sizeof (*Request) + sizeof (*RequestAccess),
+             sizeof (*Request) + sizeof (*RequestAccess),
+             &TotalLength,
+             &FragmentLength
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
 
-  ArmCallSxc (&Request, &Result);
+  *Retrieved = TRUE;
+
+  //
+  // From here on the RX buffer holds the response and must be released on
+  // every path. The constituents of the first fragment start right after the
+  // composite descriptor the caller's access descriptor points at.
+  //
+  Response = (CONST FFA_EX_MEM_TRANSACTION_DESC *)RxBuffer;
+  if ((FragmentLength > TotalLength) || (FragmentLength > RxBufferSize) ||
+      (FragmentLength < sizeof (*Response) + sizeof (*Access)) ||
+      (Response->MemAccessDescCount == 0) ||
+      (Response->MemAccessDescOffset > FragmentLength - sizeof (*Access)))
+  {
+    Status = EFI_PROTOCOL_ERROR;
+    goto Release;
+  }
 
-  if (Result.Arg0 == ARM_FID_FFA_ERROR) {
-    return FfaStatusToEfiStatus (Result.Arg2);
+  Access = (CONST FFA_EX_MEM_ACCESS_DESC *)((CONST UINT8 *)RxBuffer + Response->MemAccessDescOffset);
+  if (Access->CompositeOffset > FragmentLength - sizeof (*Composite)) {
+    Status = EFI_PROTOCOL_ERROR;
+    goto Release;
   }
 
-  return EFI_SUCCESS;
-}
+  Composite  = (CONST FFA_EX_MEM_COMPOSITE_DESC *)((CONST UINT8 *)RxBuffer + Access->CompositeOffset);
+  RangeCount = Composite->AddressRangeCount;
+  Start      = Access->CompositeOffset + sizeof (*Composite);
 
-EFI_STATUS
-EFIAPI
-FfaNotificationBind (
-  IN UINT16  DestinationId,
-  IN UINT32  Flags,
-  IN UINT64  NotificationBitmap
-  )
-{
-  ARM_SXC_ARGS  Request = { 0 };
-  ARM_SXC_ARGS  Result  = { 0 };
+  Copy = (Descriptor != NULL) && (TotalLength <= *DescriptorSize);
+  if (DescriptorSize != NULL) {
+    *DescriptorSize = TotalLength;
+  }
+
+  Received  = 0;
+  Delivered = 0;
+  while (TRUE) {
+    if (Copy) {
+      CopyMem ((UINT8 *)Descriptor + Received, RxBuffer, FragmentLength);
+    }
+
+    Status = FfaMemRetrieveDeliver (
+               (CONST FFA_EX_MEM_CONSTITUENT_DESC *)((CONST UINT8 *)RxBuffer + Start),
+               FragmentLength - Start,
+               RangeCount,
+               Handler,
+               Context,
+               &Delivered
+               );
+    if (EFI_ERROR (Status)) {
+      goto Release;
+    }
+
+    Received += FragmentLength;
+    if (Received == TotalLength) {
+      break;
+    }
+
+    //
+    // Hand the RX buffer back and ask for the fragment at Received, it comes
+    // back in FFA_MEM_FRAG_TX with its length in w3.
+    //
+    FfaInitArgs (&Args, ARM_FID_FFA_MEM_FRAG_RX);
+    Args.Arg1 = (UINT32)Handle;
+    Args.Arg2 = (UINT32)RShiftU64 (Handle, 32);
+    Args.Arg3 = Received;
+
+    ArmCallSxcX7 (&Args);
+
+    if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+      Status = FfaStatusToEfiStatus (Args.Arg2);
+      goto Release;
+    }
+
+    FragmentLength = (UINT32)Args.Arg3;
+    if ((Args.Arg0 != ARM_FID_FFA_MEM_FRAG_TX) || (FragmentLength == 0) ||
+        (FragmentLength > TotalLength - Received) || (FragmentLength > RxBufferSize))
+    {
+      Status = EFI_PROTOCOL_ERROR;
+      goto Release;
+    }
+
+    Start = 0;
+  }
 
-  if (mPartitionId == INVALID_SOURCE_ID) {
-    ArmFfaLibPartitionIdGet (&mPartitionId);
+  if (Delivered != RangeCount) {
+    Status = EFI_PROTOCOL_ERROR;
+  } else if ((Descriptor != NULL) && !Copy) {
+    Status = EFI_BUFFER_TOO_SMALL;
   }
 
-  Request.Arg0 = ARM_FID_FFA_NOTIFICATION_BIND;
-  Request.Arg1 = ((UINT32)DestinationId << 16) | mPartitionId;
-  Request.Arg2 = Flags;
-  Request.Arg3 = (UINT32)NotificationBitmap;
-  Request.Arg4 = (UINT32)(NotificationBitmap >> 32);
+Release:
+  ReleaseStatus = ArmFfaLibRxRelease (0);
+  if (!EFI_ERROR (Status)) {
+    Status = ReleaseStatus;
+  }
 
-  ArmCallSxc (&Request, &Result);
+  return Status;
+}
 
-  if (Result.Arg0 == ARM_FID_FFA_ERROR) {
-    return FfaStatusToEfiStatus (Result.Arg2);
+EFI_STATUS
+EFIAPI
+FfaExMemRetrieve (
+  IN     UINT64                          Handle,
+  IN     UINT16                          SenderId,
+  IN     UINT8                           Permissions,
+  IN     FFA_EX_MEM_CONSTITUENT_HANDLER  Handler OPTIONAL,
+  IN     VOID                            *Context OPTIONAL,
+  OUT    VOID                            *Descriptor OPTIONAL,
+  IN OUT UINT32                          *DescriptorSize OPTIONAL
+  )
+{
+  EFI_STATUS  Status;
+  BOOLEAN     Retrieved;
+
+  //
+  // An error always means the caller holds nothing, whatever stage failed.
+  //
+  Status = FfaMemRetrieve (Handle, SenderId, Permissions, Handler, Context, Descriptor, DescriptorSize, &Retrieved);
+  if (EFI_ERROR (Status) && Retrieved) {
+    FfaExMemRelinquish (Handle);
   }
 
-  return EFI_SUCCESS;
+  return Status;
 }
 
 EFI_STATUS
 EFIAPI
-FfaNotificationUnbind (
-  IN UINT16  DestinationId,
-  IN UINT64  NotificationBitmap
+FfaExMemShareSingle (
+  IN  UINT16  ReceiverId,
+  IN  VOID    *Base,
+  IN  UINTN   PageCount,
+  OUT UINT64  *Handle
   )
 {
-  ARM_SXC_ARGS  Request = { 0 };
-  ARM_SXC_ARGS  Result  = { 0 };
+  EFI_STATUS                   Status;
+  FFA_EX_MEM_TRANSACTION       Transaction;
+  FFA_EX_MEM_CONSTITUENT_DESC  Constituent;
 
-  if (mPartitionId == INVALID_SOURCE_ID) {
-    ArmFfaLibPartitionIdGet (&mPartitionId);
+  if ((Base == NULL) || (PageCount == 0) || (PageCount > MAX_UINT32) || (Handle == NULL)) {
+    return EFI_INVALID_PARAMETER;
   }
 
-  Request.Arg0 = ARM_FID_FFA_NOTIFICATION_UNBIND;
-  Request.Arg1 = ((UINT32)DestinationId << 16) | mPartitionId;
-  Request.Arg2 = 0;
-  Request.Arg3 = (UINT32)NotificationBitmap;
-  Request.Arg4 = (UINT32)(NotificationBitmap >> 32);
+  ZeroMem (&Constituent, sizeof (Constituent));
+  Constituent.Address   = (UINTN)Base;
+  Constituent.PageCount = (UINT32)PageCount;
 
-  ArmCallSxc (&Request, &Result);
+  Status = FfaExMemTransactionInit (&Transaction, FFA_EX_MEM_ATTR_NORMAL_WB_INNER_SHAREABLE, 0, 0);
+  if (!EFI_ERROR (Status)) {
+    Status = FfaExMemTransactionAddReceiver (&Transaction, ReceiverId, FFA_EX_MEM_PERM_RW, 0);
+  }
 
-  if (Result.Arg0 == ARM_FID_FFA_ERROR) {
-    return FfaStatusToEfiStatus (Result.Arg2);
+  if (!EFI_ERROR (Status)) {
+    Status = FfaExMemTransactionSetConstituents (&Transaction, &Constituent, 1);
   }
 
-  return EFI_SUCCESS;
+  if (!EFI_ERROR (Status)) {
+    Status = FfaExMemTransactionSend (&Transaction, FfaExMemTypeShare, Handle);
+  }
+
+  return Status;
 }
 
+/**
+  Records the first constituent of a region retrieved by
+  FfaExMemRetrieveSingle and counts the others.
+
+  @param  Constituents      Constituents of the current fragment.
+  @param  ConstituentCount  Number of entries in Constituents.
+  @param  Context           A FFA_MEM_RETRIEVE_SINGLE_CONTEXT.
+
+  @retval EFI_SUCCESS  Always.
+**/
+STATIC
 EFI_STATUS
 EFIAPI
-FfaMemDonateRxTx (
-  UINT32  TotalLength,
-  UINT32  FragmentLength,
-  UINT64  *Handle
+FfaMemRetrieveSingleHandler (
+  IN CONST FFA_EX_MEM_CONSTITUENT_DESC  *Constituents,
+  IN UINT32                             ConstituentCount,
+  IN VOID                               *Context
   )
 {
-  return FfaMemDonate (TotalLength, FragmentLength, NULL, 0, Handle);
+  FFA_MEM_RETRIEVE_SINGLE_CONTEXT  *Retrieve;
+
+  Retrieve = Context;
+  if (Retrieve->Count == 0) {
+    Retrieve->First = Constituents[0];
+  }
+
+  Retrieve->Count += ConstituentCount;
+  return EFI_SUCCESS;
 }
 
 EFI_STATUS
 EFIAPI
-FfaMemLend (
-  UINT32  TotalLength,
-  UINT32  FragmentLength,
-  VOID    *BufferAddr,
-  UINT32  PageCount,
-  UINT64  *Handle
+FfaExMemRetrieveSingle (
+  IN  UINT64  Handle,
+  IN  UINT16  SenderId,
+  OUT UINT64  *Base,
+  OUT UINT64  *Size
   )
 {
-  ARM_SXC_ARGS  Request = { 0 };
-  ARM_SXC_ARGS  Result  = { 0 };
+  EFI_STATUS                       Status;
+  FFA_MEM_RETRIEVE_SINGLE_CONTEXT  Retrieve;
 
-  Request.Arg0 = (BufferAddr) ? ARM_FID_FFA_MEM_LEND_AARCH64 : ARM_FID_FFA_MEM_LEND_AARCH32;
-  Request.Arg1 = TotalLength;
-  Request.Arg2 = FragmentLength;
-  Request.Arg3 = (UINTN)BufferAddr;
-  Request.Arg4 = PageCount;
+  if ((Base == NULL) || (Size == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
 
-  ArmCallSxc (&Request, &Result);
+  ZeroMem (&Retrieve, sizeof (Retrieve));
+  Status = FfaExMemRetrieve (Handle, SenderId, FFA_EX_MEM_PERM_RW, FfaMemRetrieveSingleHandler, &Retrieve, NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
 
-  if (Result.Arg0 == ARM_FID_FFA_ERROR) {
-    *Handle = 0U;
-    return FfaStatusToEfiStatus (Result.Arg2);
+  if (Retrieve.Count != 1) {
+    FfaExMemRelinquish (Handle);
+    return EFI_UNSUPPORTED;
   }
 
-  /*
-   * There are no 64-bit parameters returned with FFA_SUCCESS, the SPMC
-   * will use the default 32-bit version.
-   */
-  ASSERT (Result.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
-  *Handle = ((UINT64)Result.Arg3 << 32) | Result.Arg2;
+  *Base = Retrieve.First.Address;
+  *Size = EFI_PAGES_TO_SIZE ((UINTN)Retrieve.First.PageCount);
   return EFI_SUCCESS;
 }
 
 EFI_STATUS
 EFIAPI
-FfaMemLendRxTx (
-  UINT32  TotalLength,
-  UINT32  FragmentLength,
-  UINT64  *Handle
+FfaExMemRelinquish (
+  IN UINT64  Handle
   )
 {
-  return FfaMemLend (TotalLength, FragmentLength, NULL, 0, Handle);
+  EFI_STATUS                  Status;
+  FFA_EX_MEM_RELINQUISH_DESC  *Desc;
+  VOID                        *TxBuffer;
+  UINT64                      TxBufferSize;
+
+  Status = ArmFfaLibGetRxTxBuffers (&TxBuffer, &TxBufferSize, NULL, NULL);
+  if (EFI_ERROR (Status) || (TxBuffer == NULL) || (TxBufferSize < sizeof (*Desc))) {
+    return EFI_NOT_READY;
+  }
+
+  Desc                = TxBuffer;
+  Desc->Handle        = Handle;
+  Desc->Flags         = 0;
+  Desc->EndpointCount = 1;
+  Desc->EndpointId    = mFfaPartitionId;
+
+  return FfaMemRelinquish ();
 }
 
 EFI_STATUS
 EFIAPI
-FfaMemShare (
-  UINT32  TotalLength,
-  UINT32  FragmentLength,
-  VOID    *BufferAddr,
-  UINT32  PageCount,
-  UINT64  *Handle
+FfaConsoleLog32 (
+  CONST CHAR8  *Message,
+  UINTN        Length
   )
 {
-  ARM_SXC_ARGS  Request = { 0 };
-  ARM_SXC_ARGS  Result  = { 0 };
+  ARM_SXC_ARGS  Args;
+  UINT32        CharLists[6] = { 0 };
+
+  ASSERT (Length > 0 && Length <= sizeof (CharLists));
+
+  CopyMem (CharLists, Message, MIN (Length, sizeof (CharLists)));
 
-  Request.Arg0 = (BufferAddr) ? ARM_FID_FFA_MEM_SHARE_AARCH64 : ARM_FID_FFA_MEM_SHARE_AARCH32;
-  Request.Arg1 = TotalLength;
-  Request.Arg2 = FragmentLength;
-  Request.Arg3 = (UINTN)BufferAddr;
-  Request.Arg4 = PageCount;
+  FfaInitArgs (&Args, ARM_FID_FFA_CONSOLE_LOG_AARCH32);
+  Args.Arg1 = Length;
+  Args.Arg2 = CharLists[0];
+  Args.Arg3 = CharLists[1];
+  Args.Arg4 = CharLists[2];
+  Args.Arg5 = CharLists[3];
+  Args.Arg6 = CharLists[4];
+  Args.Arg7 = CharLists[5];
 
-  ArmCallSxc (&Request, &Result);
+  ArmCallSxcX7 (&Args);
 
-  if (Result.Arg0 == ARM_FID_FFA_ERROR) {
-    *Handle = 0U;
-    return FfaStatusToEfiStatus (Result.Arg2);
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    return FfaStatusToEfiStatus (Args.Arg2);
   }
 
-  /*
-   * There are no 64-bit parameters returned with FFA_SUCCESS, the SPMC
-   * will use the default 32-bit version.
-   */
-  ASSERT (Result.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
-  *Handle = ((UINT64)Result.Arg3 << 32) | Result.Arg2;
+  ASSERT (Args.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
   return EFI_SUCCESS;
 }
 
 EFI_STATUS
 EFIAPI
-FfaMemShareRxTx (
-  UINT32  TotalLength,
-  UINT32  FragmentLength,
-  UINT64  *Handle
-  )
-{
-  return FfaMemShare (TotalLength, FragmentLength, NULL, 0, Handle);
-}
-
-EFI_STATUS
-EFIAPI
-FfaMemRetrieveReq (
-  UINT32  TotalLength,
-  UINT32  FragmentLength,
-  VOID    *BufferAddr,
-  UINT32  PageCount,
-  UINT32  *RespTotalLength,
-  UINT32  *RespFragmentLength
+FfaConsoleLog64 (
+  CONST char  *Message,
+  UINTN       Length
   )
 {
-  ARM_SXC_ARGS  Request = { 0 };
-  ARM_SXC_ARGS  Result  = { 0 };
+  ARM_SXC_ARGS  Args;
+  UINT64        CharLists[16] = { 0 };
 
-  Request.Arg0 = (BufferAddr) ? ARM_FID_FFA_MEM_RETRIEVE_REQ_AARCH64 : ARM_FID_FFA_MEM_RETRIEVE_REQ_AARCH32;
-  Request.Arg1 = TotalLength;
-  Request.Arg2 = FragmentLength;
-  Request.Arg3 = (UINTN)BufferAddr;
-  Request.Arg4 = PageCount;
+  ASSERT (Length > 0 && Length <= sizeof (CharLists));
 
-  ArmCallSxc (&Request, &Result);
+  CopyMem (CharLists, Message, MIN (Length, sizeof (CharLists)));
 
-  if (Result.Arg0 == ARM_FID_FFA_ERROR) {
-    *RespTotalLength    = 0U;
-    *RespFragmentLength = 0U;
-    return FfaStatusToEfiStatus (Result.Arg2);
+  Args.Arg0  = ARM_FID_FFA_CONSOLE_LOG_AARCH64;
+  Args.Arg1  = Length;
+  Args.Arg2  = CharLists[0];
+  Args.Arg3  = CharLists[1];
+  Args.Arg4  = CharLists[2];
+  Args.Arg5  = CharLists[3];
+  Args.Arg6  = CharLists[4];
+  Args.Arg7  = CharLists[5];
+  Args.Arg8  = CharLists[6];
+  Args.Arg9  = CharLists[7];
+  Args.Arg10 = CharLists[8];
+  Args.Arg11 = CharLists[9];
+  Args.Arg12 = CharLists[10];
+  Args.Arg13 = CharLists[11];
+  Args.Arg14 = CharLists[12];
+  Args.Arg15 = CharLists[13];
+  Args.Arg16 = CharLists[14];
+  Args.Arg17 = CharLists[15];
+
+  ArmCallSxc (&Args);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    return FfaStatusToEfiStatus (Args.Arg2);
   }
 
-  ASSERT (Result.Arg0 == ARM_FID_FFA_MEM_RETRIEVE_RESP);
-  *RespTotalLength    = Result.Arg1;
-  *RespFragmentLength = Result.Arg2;
+  ASSERT (Args.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
   return EFI_SUCCESS;
 }
 
-EFI_STATUS
-EFIAPI
-FfaMemRetrieveReqRxTx (
-  UINT32  TotalLength,
-  UINT32  FragmentLength,
-  UINT32  *RespTotalLength,
-  UINT32  *RespFragmentLength
+/**
+  Maps an FF-A function ID to a dense index.
+
+  SMC32 function IDs map to [0, FFA_FID_COUNT) and SMC64 function IDs map to
+  [FFA_FID_COUNT, FFA_FID_INDEX_COUNT).
+
+  @param  FunctionId  The FF-A function ID.
+
+  @retval The index of FunctionId, or FFA_FID_INDEX_COUNT if FunctionId is not
+          an FF-A function ID.
+**/
+UINTN
+FfaFidToIndex (
+  IN UINT32  FunctionId
   )
 {
-  return FfaMemRetrieveReq (
-           TotalLength,
-           FragmentLength,
-           NULL,
-           0,
-           RespTotalLength,
-           RespFragmentLength
-           );
+  UINT32  Index;
+
+  Index = (FunctionId & 0xFF) - FFA_FID_BASE;
+  if (Index >= FFA_FID_COUNT) {
+    return FFA_FID_INDEX_COUNT;
+  }
+
+  switch (FunctionId & FFA_FID_PREFIX_MASK) {
+    case FFA_FID_SMC32_PREFIX:
+      return Index;
+    case FFA_FID_SMC64_PREFIX:
+      return FFA_FID_COUNT + Index;
+    default:
+      return FFA_FID_INDEX_COUNT;
+  }
 }
 
-EFI_STATUS
-EFIAPI
-FfaMemRelinquish (
-  VOID
-  )
-{
-  ARM_SXC_ARGS  Request = { 0 };
-  ARM_SXC_ARGS  Result  = { 0 };
+/**
+  Checks whether the SPMC supports an FF-A function or feature ID, asking
+  FFA_FEATURES the first time the ID is checked.
 
-  Request.Arg0 = ARM_FID_FFA_MEM_RETRIEVE_RELINQUISH;
+  Two vCPUs checking the same ID for the first time may both trap, they store
+  the same answer.
 
-  ArmCallSxc (&Request, &Result);
+  @param  Id        The function or feature ID.
+  @param  State     The answer kept for Id.
+  @param  Property  Optional, receives property 1 of the answer before State
+                    is published.
 
-  if (Result.Arg0 == ARM_FID_FFA_ERROR) {
-    return FfaStatusToEfiStatus (Result.Arg2);
+  @retval TRUE   The ID is supported.
+  @retval FALSE  The ID is not supported, or no version was negotiated.
+**/
+STATIC
+BOOLEAN
+FfaProbeId (
+  IN     UINT32          Id,
+  IN OUT volatile UINT8  *State,
+  OUT    UINTN           *Property OPTIONAL
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Property1;
+  UINTN       Property2;
+
+  if (*State == FFA_ID_UNKNOWN) {
+    if ((mFfaMajorVersion == 0) && (mFfaMinorVersion == 0)) {
+      return FALSE;
+    }
+
+    Status = ArmFfaLibGetFeatures (Id, 0, &Property1, &Property2);
+    if (!EFI_ERROR (Status) && (Property != NULL)) {
+      *Property = Property1;
+    }
+
+    MemoryFence ();
+    *State = EFI_ERROR (Status) ? FFA_ID_UNSUPPORTED : FFA_ID_SUPPORTED;
   }
 
-  ASSERT (Result.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
-  return EFI_SUCCESS;
+  return *State == FFA_ID_SUPPORTED;
 }
 
-EFI_STATUS
+/**
+  Library constructor.
+
+  Negotiates the FF-A version and resolves the partition ID, so that the rest
+  of the library and its callers never need to rediscover them. Function and
+  feature IDs are only probed when first queried.
+
+  Without a version every feature query reports "unsupported". A partition
+  that has a version but cannot get its ID fails here, the calls carrying it
+  never ask again.
+
+  @retval RETURN_SUCCESS  The library is initialized.
+  @retval Others          FFA_ID_GET failed.
+**/
+RETURN_STATUS
 EFIAPI
-FfaMemReclaim (
-  UINT64  Handle,
-  UINT32  Flags
+ArmFfaLibExConstructor (
+  VOID
   )
 {
-  ARM_SXC_ARGS  Request  = { 0 };
-  ARM_SXC_ARGS  Result   = { 0 };
-  UINT32        HandleHi = 0;
-  UINT32        HandleLo = 0;
+  EFI_STATUS  Status;
+  UINT16      PartitionId;
+
+  FfaVcpuInit ();
+  FfaDeferredWorkInit ();
+  FfaPermShadowInit ();
+  mFfaRxHeld      = FALSE;
+  mFfaPartitionId = INVALID_SOURCE_ID;
+  ZeroMem ((VOID *)mFfaFidState, sizeof (mFfaFidState));
+  ZeroMem ((VOID *)mFfaFeatureIdState, sizeof (mFfaFeatureIdState));
+
+  Status = ArmFfaLibGetVersion (
+             ARM_FFA_MAJOR_VERSION,
+             ARM_FFA_MINOR_VERSION,
+             &mFfaMajorVersion,
+             &mFfaMinorVersion
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a Failed to get FF-A version - %r\n", __func__, Status));
+    return RETURN_SUCCESS;
+  }
 
-  HandleHi = (Handle >> 32) & MAX_UINT32;
-  HandleLo = Handle & MAX_UINT32;
+  Status = ArmFfaLibPartitionIdGet (&PartitionId);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a Failed to get partition ID - %r\n", __func__, Status));
+    return Status;
+  }
 
-  Request.Arg0 = ARM_FID_FFA_MEM_RETRIEVE_RECLAIM;
-  Request.Arg1 = HandleLo;
-  Request.Arg2 = HandleHi;
-  Request.Arg3 = Flags;
+  mFfaPartitionId = PartitionId;
 
-  ArmCallSxc (&Request, &Result);
+  return RETURN_SUCCESS;
+}
 
-  if (Result.Arg0 == ARM_FID_FFA_ERROR) {
-    return FfaStatusToEfiStatus (Result.Arg2);
-  }
+/**
+  Checks whether the SPMC supports an FF-A function ID or feature ID.
 
-  ASSERT (Result.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
-  return EFI_SUCCESS;
-}
+  @param  Id  An FF-A function ID, or an FF-A feature ID such as
+              ARM_FFA_FEATURE_ID_SCHEDULE_RECEIVER_INTERRUPT.
 
-EFI_STATUS
+  @retval TRUE   The ID is supported.
+  @retval FALSE  The ID is not supported or is not an FF-A ID.
+**/
+BOOLEAN
 EFIAPI
-FfaMemPermGet (
-  CONST VOID  *BaseAddr,
-  UINT32      *MemoryPerm
+FfaExIsFeatureSupported (
+  IN UINT32  Id
   )
 {
-  ARM_SXC_ARGS  Request = { 0 };
-  ARM_SXC_ARGS  Result  = { 0 };
+  UINTN  Index;
 
-  Request.Arg0 = ARM_FID_FFA_MEM_PERM_GET_AARCH32;
-  Request.Arg1 = (UINTN)BaseAddr;
+  if (Id == 0) {
+    return FALSE;
+  }
 
-  ArmCallSxc (&Request, &Result);
+  if (Id <= FFA_FEATURE_ID_MAX) {
+    return FfaProbeId (Id, &mFfaFeatureIdState[Id], &mFfaFeatureIdProperty[Id]);
+  }
 
-  if (Result.Arg0 == ARM_FID_FFA_ERROR) {
-    return FfaStatusToEfiStatus (Result.Arg2);
+  Index = FfaFidToIndex (Id);
+  if (Index < FFA_FID_INDEX_COUNT) {
+    return FfaProbeId (Id, &mFfaFidState[Index], NULL);
   }
 
-  ASSERT (Result.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
-  *MemoryPerm = Result.Arg2;
-  return EFI_SUCCESS;
+  return FALSE;
 }
 
+/**
+  Returns the property reported by FFA_FEATURES for an interrupt feature ID.
+
+  @param  FeatureId  ARM_FFA_FEATURE_ID_NOTIFICATION_PENDING_INTERRUPT,
+                     ARM_FFA_FEATURE_ID_SCHEDULE_RECEIVER_INTERRUPT or
+                     ARM_FFA_FEATURE_ID_MANAGED_EXIT_INTERRUPT.
+  @param  Property   Receives the interrupt ID assigned to the feature.
+
+  @retval EFI_SUCCESS            The property was returned.
+  @retval EFI_INVALID_PARAMETER  Property is NULL or FeatureId is not one of
+                                 the feature IDs above.
+  @retval EFI_UNSUPPORTED        The SPMC does not support FeatureId.
+**/
 EFI_STATUS
 EFIAPI
-FfaMemPermSet (
-  CONST VOID  *BaseAddr,
-  UINT32      PageCount,
-  UINT32      MemoryPerm
+FfaExGetFeatureProperty (
+  IN  UINT32  FeatureId,
+  OUT UINTN   *Property
   )
 {
-  ARM_SXC_ARGS  Request = { 0 };
-  ARM_SXC_ARGS  Result  = { 0 };
-
-  ASSERT ((MemoryPerm & ARM_FFA_MEM_PERM_RESERVED_MASK) == 0);
-
-  Request.Arg0 = ARM_FID_FFA_MEM_PERM_SET_AARCH32;
-  Request.Arg1 = (UINTN)BaseAddr;
-  Request.Arg2 = PageCount;
-  Request.Arg3 = MemoryPerm;
-
-  ArmCallSxc (&Request, &Result);
+  if ((Property == NULL) || (FeatureId == 0) || (FeatureId > FFA_FEATURE_ID_MAX)) {
+    return EFI_INVALID_PARAMETER;
+  }
 
-  if (Result.Arg0 == ARM_FID_FFA_ERROR) {
-    return FfaStatusToEfiStatus (Result.Arg2);
+  if (!FfaExIsFeatureSupported (FeatureId)) {
+    return EFI_UNSUPPORTED;
   }
 
-  ASSERT (Result.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
+  *Property = mFfaFeatureIdProperty[FeatureId];
   return EFI_SUCCESS;
 }
 
+/**
+  Returns the FF-A version negotiated by the library constructor.
+
+  @param  MajorVersion  Receives the major version.
+  @param  MinorVersion  Receives the minor version.
+
+  @retval EFI_SUCCESS            The version was returned.
+  @retval EFI_INVALID_PARAMETER  MajorVersion or MinorVersion is NULL.
+  @retval EFI_NOT_READY          The version could not be negotiated.
+**/
 EFI_STATUS
 EFIAPI
-FfaConsoleLog32 (
-  CONST CHAR8  *Message,
-  UINTN        Length
+FfaExGetVersion (
+  OUT UINT16  *MajorVersion,
+  OUT UINT16  *MinorVersion
   )
 {
-  ARM_SXC_ARGS  Request      = { 0 };
-  ARM_SXC_ARGS  Result       = { 0 };
-  UINT32        CharLists[6] = { 0 };
-
-  ASSERT (Length > 0 && Length <= sizeof (CharLists));
-
-  CopyMem (CharLists, Message, MIN (Length, sizeof (CharLists)));
-
-  Request.Arg0 = ARM_FID_FFA_CONSOLE_LOG_AARCH32;
-  Request.Arg1 = Length;
-  Request.Arg2 = CharLists[0];
-  Request.Arg3 = CharLists[1];
-  Request.Arg4 = CharLists[2];
-  Request.Arg5 = CharLists[3];
-  Request.Arg6 = CharLists[4];
-  Request.Arg7 = CharLists[5];
-
-  ArmCallSxc (&Request, &Result);
+  if ((MajorVersion == NULL) || (MinorVersion == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
 
-  if (Result.Arg0 == ARM_FID_FFA_ERROR) {
-    return FfaStatusToEfiStatus (Result.Arg2);
+  if ((mFfaMajorVersion == 0) && (mFfaMinorVersion == 0)) {
+    return EFI_NOT_READY;
   }
 
-  ASSERT (Result.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
+  *MajorVersion = mFfaMajorVersion;
+  *MinorVersion = mFfaMinorVersion;
   return EFI_SUCCESS;
 }
 
+/**
+  Returns the FF-A partition ID of the caller, as resolved by the library
+  constructor.
+
+  @param  PartitionId  Receives the partition ID.
+
+  @retval EFI_SUCCESS            The partition ID was returned.
+  @retval EFI_INVALID_PARAMETER  PartitionId is NULL.
+  @retval EFI_NOT_READY          The constructor could not resolve the
+                                 partition ID.
+**/
 EFI_STATUS
 EFIAPI
-FfaConsoleLog64 (
-  CONST char  *Message,
-  UINTN       Length
+FfaExGetPartitionId (
+  OUT UINT16  *PartitionId
   )
 {
-  ARM_SXC_ARGS  Request       = { 0 };
-  ARM_SXC_ARGS  Result        = { 0 };
-  UINT64        CharLists[16] = { 0 };
-
-  ASSERT (Length > 0 && Length <= sizeof (CharLists));
+  if (PartitionId == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
 
-  CopyMem (CharLists, Message, MIN (Length, sizeof (CharLists)));
+  if (mFfaPartitionId == INVALID_SOURCE_ID) {
+    return EFI_NOT_READY;
+  }
 
-  Request.Arg0  = ARM_FID_FFA_CONSOLE_LOG_AARCH64;
-  Request.Arg1  = Length;
-  Request.Arg2  = CharLists[0];
-  Request.Arg3  = CharLists[1];
-  Request.Arg4  = CharLists[2];
-  Request.Arg5  = CharLists[3];
-  Request.Arg6  = CharLists[4];
-  Request.Arg7  = CharLists[5];
-  Request.Arg8  = CharLists[6];
-  Request.Arg9  = CharLists[7];
-  Request.Arg10 = CharLists[8];
-  Request.Arg11 = CharLists[9];
-  Request.Arg12 = CharLists[10];
-  Request.Arg13 = CharLists[11];
-  Request.Arg14 = CharLists[12];
-  Request.Arg15 = CharLists[13];
-  Request.Arg16 = CharLists[14];
-  Request.Arg17 = CharLists[15];
-
-  ArmCallSxc (&Request, &Result);
-
-  if (Result.Arg0 == ARM_FID_FFA_ERROR) {
-    return FfaStatusToEfiStatus (Result.Arg2);
-  }
-
-  ASSERT (Result.Arg0 == ARM_FID_FFA_SUCCESS_AARCH32);
+  *PartitionId = mFfaPartitionId;
   return EFI_SUCCESS;
 }
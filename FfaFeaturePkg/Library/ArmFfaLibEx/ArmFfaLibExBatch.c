@@ -0,0 +1,293 @@
+/** @file
+  Batched commands for ArmFfaLibEx.
+
+  Clients often send bursts of commands that only take a register or two,
+  e.g. opening and closing a TPM locality, each costing a world switch. A
+  batch packs up to FFA_EX_BATCH_MAX_COMMANDS of them into the payload of a
+  single FFA_MSG_SEND_DIRECT_REQ2, see ArmFfaLibEx.h for the layout.
+
+  On the partition side, FfaExBatchDispatch unpacks each command into a
+  direct request of its own, placed where the service expects its opcode, and
+  runs it through the unchanged service handler. The status each command
+  leaves in the response is collected into the batch response.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/ArmFfaSvc.h>
+#include <IndustryStandard/ArmFfaPartInfo.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+#include "ArmFfaLibExInternal.h"
+
+#define FFA_BATCH_SIGNATURE_SHIFT  48
+#define FFA_BATCH_FLAGS_SHIFT      44
+#define FFA_BATCH_COUNT_SHIFT      40
+#define FFA_BATCH_FIELD_BITS       4
+#define FFA_BATCH_FIELD_MASK       0xF
+
+#define FFA_BATCH_PAYLOAD_COUNT  (FFA_EX_BATCH_MAX_REGISTERS + 1)
+
+STATIC_ASSERT (
+  FFA_EX_BATCH_MAX_COMMANDS * FFA_BATCH_FIELD_BITS <= FFA_BATCH_COUNT_SHIFT,
+  "Batch command lengths overlap the command count"
+  );
+
+/**
+  Tells whether a register holds a batch header.
+
+  @param  Header  The register.
+
+  @retval TRUE   The register holds a batch header.
+  @retval FALSE  It does not.
+**/
+STATIC
+BOOLEAN
+FfaBatchIsHeader (
+  IN UINT64  Header
+  )
+{
+  return (UINT16)(Header >> FFA_BATCH_SIGNATURE_SHIFT) == FFA_EX_BATCH_SIGNATURE;
+}
+
+/**
+  Returns the number of commands in a batch header.
+
+  @param  Header  The batch header.
+
+  @retval The number of commands.
+**/
+STATIC
+UINTN
+FfaBatchGetCount (
+  IN UINT64  Header
+  )
+{
+  return (UINTN)(Header >> FFA_BATCH_COUNT_SHIFT) & FFA_BATCH_FIELD_MASK;
+}
+
+/**
+  Returns the number of registers of a command in a batch header.
+
+  @param  Header  The batch header.
+  @param  Index   Index of the command.
+
+  @retval The number of registers.
+**/
+STATIC
+UINTN
+FfaBatchGetLength (
+  IN UINT64  Header,
+  IN UINTN   Index
+  )
+{
+  return (UINTN)(Header >> (Index * FFA_BATCH_FIELD_BITS)) & FFA_BATCH_FIELD_MASK;
+}
+
+/**
+  Returns a batch header holding a different number of commands.
+
+  @param  Header  The batch header.
+  @param  Count   The number of commands.
+
+  @retval The new header.
+**/
+STATIC
+UINT64
+FfaBatchSetCount (
+  IN UINT64  Header,
+  IN UINTN   Count
+  )
+{
+  Header &= ~((UINT64)FFA_BATCH_FIELD_MASK << FFA_BATCH_COUNT_SHIFT);
+  return Header | ((UINT64)Count << FFA_BATCH_COUNT_SHIFT);
+}
+
+/**
+  Returns the number of registers used by the commands of a batch, or
+  MAX_UINTN if a command has none.
+
+  @param  Header  The batch header.
+
+  @retval The number of registers.
+**/
+STATIC
+UINTN
+FfaBatchGetUsed (
+  IN UINT64  Header
+  )
+{
+  UINTN  Count;
+  UINTN  Index;
+  UINTN  Length;
+  UINTN  Used;
+
+  Count = FfaBatchGetCount (Header);
+  Used  = 0;
+  for (Index = 0; Index < Count; Index++) {
+    Length = FfaBatchGetLength (Header, Index);
+    if (Length == 0) {
+      return MAX_UINTN;
+    }
+
+    Used += Length;
+  }
+
+  return Used;
+}
+
+VOID
+EFIAPI
+FfaExBatchInit (
+  OUT DIRECT_MSG_ARGS_EX  *Request,
+  IN  UINT8               Flags
+  )
+{
+  ZeroMem (Request, sizeof (*Request));
+  Request->Arg0 = ((UINT64)FFA_EX_BATCH_SIGNATURE << FFA_BATCH_SIGNATURE_SHIFT) |
+                  ((UINT64)(Flags & FFA_BATCH_FIELD_MASK) << FFA_BATCH_FLAGS_SHIFT);
+}
+
+EFI_STATUS
+EFIAPI
+FfaExBatchAdd (
+  IN OUT DIRECT_MSG_ARGS_EX  *Request,
+  IN     CONST UINTN         *Registers,
+  IN     UINTN               RegisterCount
+  )
+{
+  UINTN  Count;
+  UINTN  Used;
+
+  if ((Request == NULL) || (Registers == NULL) || (RegisterCount == 0) ||
+      (RegisterCount > FFA_EX_BATCH_MAX_REGISTERS) || !FfaExIsBatchRequest (Request))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Count = FfaBatchGetCount (Request->Arg0);
+  Used  = FfaBatchGetUsed (Request->Arg0);
+  if ((Count == FFA_EX_BATCH_MAX_COMMANDS) || (Used + RegisterCount > FFA_EX_BATCH_MAX_REGISTERS)) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  CopyMem (&Request->Arg1 + Used, Registers, RegisterCount * sizeof (UINTN));
+  Request->Arg0  = FfaBatchSetCount (Request->Arg0, Count + 1);
+  Request->Arg0 |= (UINT64)RegisterCount << (Count * FFA_BATCH_FIELD_BITS);
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaExBatchGetStatus (
+  IN  CONST DIRECT_MSG_ARGS_EX  *Response,
+  IN  UINTN                     Index,
+  OUT UINTN                     *Status
+  )
+{
+  if ((Response == NULL) || (Status == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (!FfaExIsBatchRequest (Response)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (Index >= FfaBatchGetCount (Response->Arg0)) {
+    return EFI_NOT_FOUND;
+  }
+
+  *Status = (&Response->Arg1)[Index];
+  return EFI_SUCCESS;
+}
+
+BOOLEAN
+EFIAPI
+FfaExIsBatchRequest (
+  IN CONST DIRECT_MSG_ARGS_EX  *Request
+  )
+{
+  return FfaBatchIsHeader (Request->Arg0);
+}
+
+EFI_STATUS
+EFIAPI
+FfaExBatchDispatch (
+  IN  CONST FFA_EX_BATCH_SERVICE  *Service,
+  IN  CONST DIRECT_MSG_ARGS_EX    *Request,
+  OUT DIRECT_MSG_ARGS_EX          *Response
+  )
+{
+  DIRECT_MSG_ARGS_EX  Command;
+  DIRECT_MSG_ARGS_EX  CommandResponse;
+  CONST UINTN         *Registers;
+  UINT64              Header;
+  UINTN               Count;
+  UINTN               Index;
+  UINTN               Length;
+  UINTN               Status;
+
+  if ((Service == NULL) || (Service->Handler == NULL) || (Request == NULL) || (Response == NULL) ||
+      (Service->CommandBase >= FFA_BATCH_PAYLOAD_COUNT) || (Service->StatusIndex >= FFA_BATCH_PAYLOAD_COUNT))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Header = Request->Arg0;
+  Count  = FfaBatchGetCount (Header);
+  ZeroMem (&Response->Arg0, FFA_BATCH_PAYLOAD_COUNT * sizeof (UINTN));
+  Response->Arg0 = FfaBatchSetCount (Header, 0);
+
+  //
+  // Check the whole batch before running any of it, so that a malformed one
+  // has no side effect. A command that would be seen as a batch itself is
+  // refused rather than recursed into.
+  //
+  if (!FfaExIsBatchRequest (Request) || (Count > FFA_EX_BATCH_MAX_COMMANDS) ||
+      (FfaBatchGetUsed (Header) > FFA_EX_BATCH_MAX_REGISTERS))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Registers = &Request->Arg1;
+  for (Index = 0; Index < Count; Index++) {
+    Length = FfaBatchGetLength (Header, Index);
+    if ((Service->CommandBase + Length > FFA_BATCH_PAYLOAD_COUNT) ||
+        ((Service->CommandBase == 0) && FfaBatchIsHeader (Registers[0])))
+    {
+      return EFI_INVALID_PARAMETER;
+    }
+
+    Registers += Length;
+  }
+
+  Registers = &Request->Arg1;
+  for (Index = 0; Index < Count; Index++) {
+    Length = FfaBatchGetLength (Header, Index);
+
+    CopyMem (&Command, Request, sizeof (Command));
+    ZeroMem (&Command.Arg0, FFA_BATCH_PAYLOAD_COUNT * sizeof (UINTN));
+    CopyMem (&Command.Arg0 + Service->CommandBase, Registers, Length * sizeof (UINTN));
+    Registers += Length;
+
+    CopyMem (&CommandResponse, Response, sizeof (CommandResponse));
+    ZeroMem (&CommandResponse.Arg0, FFA_BATCH_PAYLOAD_COUNT * sizeof (UINTN));
+    Service->Handler (&Command, &CommandResponse);
+
+    Status                   = (&CommandResponse.Arg0)[Service->StatusIndex];
+    (&Response->Arg1)[Index] = Status;
+    Response->Arg0           = FfaBatchSetCount (Header, Index + 1);
+
+    if (((Header >> FFA_BATCH_FLAGS_SHIFT) & FFA_EX_BATCH_STOP_ON_ERROR) &&
+        (Status != Service->SuccessStatus))
+    {
+      break;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
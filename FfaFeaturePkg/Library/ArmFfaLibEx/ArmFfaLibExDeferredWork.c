@@ -0,0 +1,181 @@
+/** @file
+  Deferred interrupt work queue for ArmFfaLibEx.
+
+  When PcdFfaLibExDeferInterrupts is set, an FFA_INTERRUPT that preempts a
+  direct request the partition sent is only acknowledged on the spot: its ID
+  is queued and FFA_MSG_WAIT hands the vCPU back at once, so the response is
+  not held up by interrupt processing. The queued IDs are handed to
+  SecurePartitionInterruptHandler the next time the partition is idle, i.e.
+  once a direct response it sent completes, when an FFA_INTERRUPT arrives
+  while waiting for a message, right before FfaMessageWait blocks, or when
+  the caller runs FfaExRunDeferredWork. If the queue is full, it is drained
+  before the new interrupt is handled, so interrupts still run in order.
+
+  The queue is a bounded ring of cells, each carrying a sequence count that
+  tells producers and consumers whether the cell is free or full for their
+  lap of the ring. Both claim a position with a compare exchange and never
+  block, so an interrupt can be queued from any vCPU, even while another one
+  drains the queue.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/ArmFfaSvc.h>
+#include <IndustryStandard/ArmFfaPartInfo.h>
+#include <Library/BaseLib.h>
+#include <Library/PlatformFfaInterruptLib.h>
+#include <Library/SynchronizationLib.h>
+
+#include "ArmFfaLibExInternal.h"
+
+//
+// Number of interrupts the queue holds. Can be overridden from the build
+// options, must be a power of two.
+//
+#ifndef FFA_LIB_EX_DEFERRED_WORK_SIZE
+  #define FFA_LIB_EX_DEFERRED_WORK_SIZE  32
+#endif
+
+STATIC_ASSERT (
+  (FFA_LIB_EX_DEFERRED_WORK_SIZE & (FFA_LIB_EX_DEFERRED_WORK_SIZE - 1)) == 0,
+  "FFA_LIB_EX_DEFERRED_WORK_SIZE must be a power of two"
+  );
+
+typedef struct {
+  //
+  // Equal to the position of the cell while it is free for the producer at
+  // that position, and to the position plus one once it holds an interrupt.
+  //
+  volatile UINT32    Sequence;
+  UINT32             InterruptId;
+} FFA_DEFERRED_WORK_CELL;
+
+typedef struct {
+  FFA_DEFERRED_WORK_CELL    Cells[FFA_LIB_EX_DEFERRED_WORK_SIZE];
+  volatile UINT32           Head;   // Next position to queue to
+  volatile UINT32           Tail;   // Next position to run
+} FFA_DEFERRED_WORK_QUEUE;
+
+STATIC FFA_DEFERRED_WORK_QUEUE  mFfaDeferredWork;
+
+/**
+  Takes the oldest interrupt out of the queue.
+
+  @param  InterruptId  Receives the interrupt ID.
+
+  @retval TRUE   An interrupt was taken.
+  @retval FALSE  The queue is empty.
+**/
+STATIC
+BOOLEAN
+FfaDeferredWorkDequeue (
+  OUT UINT32  *InterruptId
+  )
+{
+  FFA_DEFERRED_WORK_CELL  *Cell;
+  UINT32                  Position;
+  INT32                   Lag;
+
+  Position = mFfaDeferredWork.Tail;
+  for ( ; ;) {
+    Cell = &mFfaDeferredWork.Cells[Position & (FFA_LIB_EX_DEFERRED_WORK_SIZE - 1)];
+    Lag  = (INT32)(Cell->Sequence - (Position + 1));
+    if (Lag < 0) {
+      return FALSE;
+    }
+
+    if ((Lag == 0) &&
+        (InterlockedCompareExchange32 (&mFfaDeferredWork.Tail, Position, Position + 1) == Position))
+    {
+      break;
+    }
+
+    Position = mFfaDeferredWork.Tail;
+  }
+
+  MemoryFence ();
+  *InterruptId = Cell->InterruptId;
+  MemoryFence ();
+  Cell->Sequence = Position + FFA_LIB_EX_DEFERRED_WORK_SIZE;
+  return TRUE;
+}
+
+/**
+  Empties the deferred work queue.
+
+**/
+VOID
+FfaDeferredWorkInit (
+  VOID
+  )
+{
+  UINT32  Index;
+
+  for (Index = 0; Index < FFA_LIB_EX_DEFERRED_WORK_SIZE; Index++) {
+    mFfaDeferredWork.Cells[Index].Sequence = Index;
+  }
+
+  mFfaDeferredWork.Head = 0;
+  mFfaDeferredWork.Tail = 0;
+}
+
+/**
+  Queues an interrupt for SecurePartitionInterruptHandler.
+
+  @param  InterruptId  The interrupt ID.
+
+  @retval TRUE   The interrupt was queued.
+  @retval FALSE  The queue is full.
+**/
+BOOLEAN
+FfaDeferredWorkQueue (
+  IN UINT32  InterruptId
+  )
+{
+  FFA_DEFERRED_WORK_CELL  *Cell;
+  UINT32                  Position;
+  INT32                   Lag;
+
+  Position = mFfaDeferredWork.Head;
+  for ( ; ;) {
+    Cell = &mFfaDeferredWork.Cells[Position & (FFA_LIB_EX_DEFERRED_WORK_SIZE - 1)];
+    Lag  = (INT32)(Cell->Sequence - Position);
+    if (Lag < 0) {
+      return FALSE;
+    }
+
+    if ((Lag == 0) &&
+        (InterlockedCompareExchange32 (&mFfaDeferredWork.Head, Position, Position + 1) == Position))
+    {
+      break;
+    }
+
+    Position = mFfaDeferredWork.Head;
+  }
+
+  Cell->InterruptId = InterruptId;
+  MemoryFence ();
+  Cell->Sequence = Position + 1;
+  return TRUE;
+}
+
+UINTN
+EFIAPI
+FfaExRunDeferredWork (
+  VOID
+  )
+{
+  UINT32  InterruptId;
+  UINTN   Count;
+
+  Count = 0;
+  while (FfaDeferredWorkDequeue (&InterruptId)) {
+    SecurePartitionInterruptHandler (InterruptId);
+    Count++;
+  }
+
+  return Count;
+}
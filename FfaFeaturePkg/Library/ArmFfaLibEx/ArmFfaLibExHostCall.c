@@ -0,0 +1,166 @@
+/** @file
+  Portable C versions of the register-subset trampolines in
+  AArch64/ArmFfaLibExCall.S and of the thread ID register accessors in
+  AArch64/ArmFfaLibExVcpu.S, for host based unit tests. Calls are forwarded
+  to ArmCallSvc/ArmCallSmc, which the host test platform maps to the SPMC
+  model.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/ArmFfaSvc.h>
+#include <IndustryStandard/ArmFfaPartInfo.h>
+#include <Library/BaseMemoryLib.h>
+
+#include "ArmFfaLibExInternal.h"
+
+//
+// Number of registers above x7, i.e. x8-x17.
+//
+#define FFA_HIGH_REGISTER_COUNT  10
+
+//
+// Host tests run on a single thread, which stands for whichever vCPU was
+// bound last.
+//
+STATIC UINTN  mFfaHostVcpuRegister;
+
+/**
+  Issues an FF-A call through the SVC conduit, in place.
+
+  x0-x17 are loaded from Args and all of x0-x17 are stored back into Args.
+
+  @param  Args  Parameter registers on input, result registers on output.
+
+**/
+VOID
+FfaSvcCallX17 (
+  IN OUT ARM_SXC_ARGS  *Args
+  )
+{
+  ArmCallSvc ((ARM_SVC_ARGS *)Args);
+}
+
+/**
+  Issues an FF-A call through the SVC conduit, in place.
+
+  x0-x7 are loaded from Args, x8-x17 are passed as zero and all of x0-x17 are
+  stored back into Args.
+
+  @param  Args  Parameter registers on input, result registers on output.
+
+**/
+VOID
+FfaSvcCallX7X17 (
+  IN OUT ARM_SXC_ARGS  *Args
+  )
+{
+  ZeroMem (&Args->Arg8, FFA_HIGH_REGISTER_COUNT * sizeof (UINTN));
+  ArmCallSvc ((ARM_SVC_ARGS *)Args);
+}
+
+/**
+  Issues an FF-A call through the SVC conduit, in place.
+
+  x0-x7 are loaded from Args, x8-x17 are passed as zero and only x0-x7 are
+  stored back into Args.
+
+  @param  Args  Parameter registers on input, result registers on output.
+
+**/
+VOID
+FfaSvcCallX7 (
+  IN OUT ARM_SXC_ARGS  *Args
+  )
+{
+  UINTN  High[FFA_HIGH_REGISTER_COUNT];
+
+  CopyMem (High, &Args->Arg8, sizeof (High));
+  FfaSvcCallX7X17 (Args);
+  CopyMem (&Args->Arg8, High, sizeof (High));
+}
+
+/**
+  Issues an FF-A call through the SMC conduit, in place.
+
+  x0-x17 are loaded from Args and all of x0-x17 are stored back into Args.
+
+  @param  Args  Parameter registers on input, result registers on output.
+
+**/
+VOID
+FfaSmcCallX17 (
+  IN OUT ARM_SXC_ARGS  *Args
+  )
+{
+  ArmCallSmc ((ARM_SMC_ARGS *)Args);
+}
+
+/**
+  Issues an FF-A call through the SMC conduit, in place.
+
+  x0-x7 are loaded from Args, x8-x17 are passed as zero and all of x0-x17 are
+  stored back into Args.
+
+  @param  Args  Parameter registers on input, result registers on output.
+
+**/
+VOID
+FfaSmcCallX7X17 (
+  IN OUT ARM_SXC_ARGS  *Args
+  )
+{
+  ZeroMem (&Args->Arg8, FFA_HIGH_REGISTER_COUNT * sizeof (UINTN));
+  ArmCallSmc ((ARM_SMC_ARGS *)Args);
+}
+
+/**
+  Issues an FF-A call through the SMC conduit, in place.
+
+  x0-x7 are loaded from Args, x8-x17 are passed as zero and only x0-x7 are
+  stored back into Args.
+
+  @param  Args  Parameter registers on input, result registers on output.
+
+**/
+VOID
+FfaSmcCallX7 (
+  IN OUT ARM_SXC_ARGS  *Args
+  )
+{
+  UINTN  High[FFA_HIGH_REGISTER_COUNT];
+
+  CopyMem (High, &Args->Arg8, sizeof (High));
+  FfaSmcCallX7X17 (Args);
+  CopyMem (&Args->Arg8, High, sizeof (High));
+}
+
+/**
+  Reads the thread ID register, which holds the context of the current vCPU.
+
+  @retval The register value.
+**/
+UINTN
+FfaReadVcpuRegister (
+  VOID
+  )
+{
+  return mFfaHostVcpuRegister;
+}
+
+/**
+  Writes the thread ID register, which holds the context of the current vCPU.
+
+  @param  Value  The new register value.
+
+**/
+VOID
+FfaWriteVcpuRegister (
+  IN UINTN  Value
+  )
+{
+  mFfaHostVcpuRegister = Value;
+}
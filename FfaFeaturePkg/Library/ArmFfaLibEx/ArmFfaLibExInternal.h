@@ -0,0 +1,505 @@
+/** @file
+  Internal definitions shared by the ArmFfaLibEx library sources.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef ARM_FFA_LIB_EX_INTERNAL_H_
+#define ARM_FFA_LIB_EX_INTERNAL_H_
+
+#include <Library/ArmSvcLib.h>
+#include <Library/ArmSmcLib.h>
+#include <Library/ArmFfaLibEx.h>
+#include <Library/TimerLib.h>
+
+#define INVALID_SOURCE_ID  0xFFFF
+
+//
+// FF-A function IDs occupy 0x60-0x9F in the low byte, both for the SMC32
+// (0x84xxxxxx) and SMC64 (0xC4xxxxxx) calling conventions. FfaFidToIndex
+// packs both conventions into one dense index, by offset from FFA_FID_BASE.
+//
+#define FFA_FID_BASE          0x60
+#define FFA_FID_COUNT         64
+#define FFA_FID_INDEX_COUNT   (2 * FFA_FID_COUNT)
+#define FFA_FID_SMC32_PREFIX  0x84000000
+#define FFA_FID_SMC64_PREFIX  0xC4000000
+#define FFA_FID_PREFIX_MASK   0xFFFFFF00
+
+//
+// Feature IDs that FFA_FEATURES answers with an interrupt ID in w2.
+//
+#define FFA_FEATURE_ID_MAX  ARM_FFA_FEATURE_ID_MANAGED_EXIT_INTERRUPT
+
+//
+// Notification bitmaps FfaNotificationGetAll can request in one call.
+//
+#define FFA_NOTIFICATION_FLAG_BITMAP_ALL  (ARM_FFA_NOTIFICATION_FLAG_BITMAP_SP |  \
+                                           ARM_FFA_NOTIFICATION_FLAG_BITMAP_VM |  \
+                                           ARM_FFA_NOTIFICATION_FLAG_BITMAP_HYP)
+
+//
+// FFA_NOTIFICATION_INFO_GET packs up to 20 16-bit IDs in x3-x7. x2 carries
+// the more pending flag in bit[0], the number of lists in bits[11:7] and, from
+// bit[12] on, the number of vCPU IDs of each list in 2 bits.
+//
+#define FFA_NOTIFICATION_INFO_MORE_PENDING       BIT0
+#define FFA_NOTIFICATION_INFO_LIST_COUNT_SHIFT   7
+#define FFA_NOTIFICATION_INFO_LIST_COUNT_MASK    0x1F
+#define FFA_NOTIFICATION_INFO_LIST_SIZE_SHIFT    12
+#define FFA_NOTIFICATION_INFO_LIST_SIZE_MASK     0x3
+#define FFA_NOTIFICATION_INFO_MAX_IDS            20
+#define FFA_NOTIFICATION_INFO_IDS_PER_REGISTER   4
+
+//
+// Upper bound on the FFA_NOTIFICATION_INFO_GET calls of one drain, so that
+// notifications set faster than they are drained cannot livelock the caller.
+//
+#define FFA_NOTIFICATION_INFO_MAX_DRAIN  8
+
+//
+// FFA_PARTITION_INFO_GET_REGS returns up to five 24-byte descriptors in
+// x3-x17. x2 carries the last index in bits[15:0], the index of the last
+// descriptor of this window in bits[31:16] and the tag in bits[47:32].
+//
+#define FFA_PART_INFO_REGS_MAX_DESCS      5
+#define FFA_PART_INFO_REGS_INDEX_MASK     0xFFFF
+#define FFA_PART_INFO_REGS_CURRENT_SHIFT  16
+#define FFA_PART_INFO_REGS_TAG_SHIFT      32
+
+//
+// Number of times FfaPartitionInfoGetAllRegs restarts an enumeration that
+// the SPMC invalidated before giving up.
+//
+#define FFA_PART_INFO_REGS_MAX_RETRIES  8
+
+//
+// State the library reads or updates on every call, one per bound vCPU. Only
+// the vCPU a context belongs to writes it once bound.
+//
+typedef struct {
+  volatile UINT32      State;
+  UINT16               VcpuId;
+ #ifdef FFA_LIB_EX_INSTRUMENTATION
+  FFA_EX_CALL_STATS    CallStats[FFA_FID_INDEX_COUNT];
+ #endif
+} FFA_VCPU_CONTEXT;
+
+/**
+  Issues an FF-A call through the SVC conduit, in place.
+
+  x0-x17 are loaded from Args and all of x0-x17 are stored back into Args.
+
+  @param  Args  Parameter registers on input, result registers on output.
+
+**/
+VOID
+FfaSvcCallX17 (
+  IN OUT ARM_SXC_ARGS  *Args
+  );
+
+/**
+  Issues an FF-A call through the SVC conduit, in place.
+
+  x0-x7 are loaded from Args, x8-x17 are passed as zero and all of x0-x17 are
+  stored back into Args.
+
+  @param  Args  Parameter registers on input, result registers on output.
+
+**/
+VOID
+FfaSvcCallX7X17 (
+  IN OUT ARM_SXC_ARGS  *Args
+  );
+
+/**
+  Issues an FF-A call through the SVC conduit, in place.
+
+  x0-x7 are loaded from Args, x8-x17 are passed as zero and only x0-x7 are
+  stored back into Args.
+
+  @param  Args  Parameter registers on input, result registers on output.
+
+**/
+VOID
+FfaSvcCallX7 (
+  IN OUT ARM_SXC_ARGS  *Args
+  );
+
+/**
+  Issues an FF-A call through the SMC conduit, in place.
+
+  x0-x17 are loaded from Args and all of x0-x17 are stored back into Args.
+
+  @param  Args  Parameter registers on input, result registers on output.
+
+**/
+VOID
+FfaSmcCallX17 (
+  IN OUT ARM_SXC_ARGS  *Args
+  );
+
+/**
+  Issues an FF-A call through the SMC conduit, in place.
+
+  x0-x7 are loaded from Args, x8-x17 are passed as zero and all of x0-x17 are
+  stored back into Args.
+
+  @param  Args  Parameter registers on input, result registers on output.
+
+**/
+VOID
+FfaSmcCallX7X17 (
+  IN OUT ARM_SXC_ARGS  *Args
+  );
+
+/**
+  Issues an FF-A call through the SMC conduit, in place.
+
+  x0-x7 are loaded from Args, x8-x17 are passed as zero and only x0-x7 are
+  stored back into Args.
+
+  @param  Args  Parameter registers on input, result registers on output.
+
+**/
+VOID
+FfaSmcCallX7 (
+  IN OUT ARM_SXC_ARGS  *Args
+  );
+
+/**
+  Reads the thread ID register, which holds the context of the current vCPU.
+
+  @retval The register value.
+**/
+UINTN
+FfaReadVcpuRegister (
+  VOID
+  );
+
+/**
+  Writes the thread ID register, which holds the context of the current vCPU.
+
+  @param  Value  The new register value.
+
+**/
+VOID
+FfaWriteVcpuRegister (
+  IN UINTN  Value
+  );
+
+/**
+  Maps an FF-A function ID to a dense index.
+
+  SMC32 function IDs map to [0, FFA_FID_COUNT) and SMC64 function IDs map to
+  [FFA_FID_COUNT, FFA_FID_INDEX_COUNT).
+
+  @param  FunctionId  The FF-A function ID.
+
+  @retval The index of FunctionId, or FFA_FID_INDEX_COUNT if FunctionId is not
+          an FF-A function ID.
+**/
+UINTN
+FfaFidToIndex (
+  IN UINT32  FunctionId
+  );
+
+/**
+  Unpacks the registers of a direct message ABI into a DIRECT_MSG_ARGS_EX.
+
+  @param  Response  The registers as exchanged with the SPMC.
+  @param  Message   Receives the unpacked message.
+
+**/
+VOID
+FfaUnpackDirectMessage (
+  IN CONST ARM_SXC_ARGS   *Response,
+  OUT DIRECT_MSG_ARGS_EX  *Message
+  );
+
+/**
+  Packs a DIRECT_MSG_ARGS_EX into the registers of its direct message ABI.
+
+  @param  Request   Receives the registers.
+  @param  Message   The message.
+  @param  WireGuid  Optional, the service GUID in wire order, used instead of
+                    the ServiceGuid of Message.
+
+**/
+VOID
+FfaPackDirectMessage (
+  OUT ARM_SXC_ARGS             *Request,
+  IN CONST DIRECT_MSG_ARGS_EX  *Message,
+  IN CONST FFA_WIRE_GUID       *WireGuid OPTIONAL
+  );
+
+/**
+  Releases every vCPU context and resets the boot context.
+
+  Runs from the constructor, before any other vCPU enters the library.
+
+**/
+VOID
+FfaVcpuInit (
+  VOID
+  );
+
+/**
+  Returns the context of the calling vCPU.
+
+  @retval The context of the vCPU, or the boot context if it is not bound.
+**/
+FFA_VCPU_CONTEXT *
+FfaGetVcpuContext (
+  VOID
+  );
+
+/**
+  Returns a context by position, for code that aggregates over all of them.
+
+  @param  Index  0 for the boot context, N for the context of vCPU N - 1.
+
+  @retval The context, or NULL past the last one.
+**/
+FFA_VCPU_CONTEXT *
+FfaGetVcpuContextAt (
+  IN UINTN  Index
+  );
+
+/**
+  Empties the deferred work queue.
+
+**/
+VOID
+FfaDeferredWorkInit (
+  VOID
+  );
+
+/**
+  Queues an interrupt for SecurePartitionInterruptHandler.
+
+  @param  InterruptId  The interrupt ID.
+
+  @retval TRUE   The interrupt was queued.
+  @retval FALSE  The queue is full.
+**/
+BOOLEAN
+FfaDeferredWorkQueue (
+  IN UINT32  InterruptId
+  );
+
+//
+// Sequence counts let readers of state shared by all vCPUs, such as the
+// service cache and the permission shadow, copy it without taking a lock.
+// A writer makes the count odd while it updates the state and even again
+// when done, so every update moves it on by two. A reader snapshots the
+// count with FfaSeqReadBegin, copies what it needs, and keeps the copy only
+// if FfaSeqReadValidate finds the count even and unchanged. Otherwise the
+// copy may be torn and the reader falls back to the slow path, so reads
+// never block. Writers claim the count with FfaSeqWriteBegin, which fails
+// instead of waiting when another writer holds it.
+//
+
+/**
+  Claims a sequence count for writing.
+
+  @param  Sequence  The sequence count guarding the state.
+
+  @retval TRUE   The count is odd and the caller may update the state.
+  @retval FALSE  Another writer holds the count, nothing was done.
+**/
+BOOLEAN
+FfaSeqWriteBegin (
+  IN OUT volatile UINT32  *Sequence
+  );
+
+/**
+  Publishes an update and releases a sequence count claimed by
+  FfaSeqWriteBegin.
+
+  @param  Sequence  The sequence count guarding the state.
+
+**/
+VOID
+FfaSeqWriteEnd (
+  IN OUT volatile UINT32  *Sequence
+  );
+
+/**
+  Snapshots a sequence count before reading the state it guards.
+
+  @param  Sequence  The sequence count guarding the state.
+
+  @retval The snapshot, odd if a writer is updating the state.
+**/
+UINT32
+FfaSeqReadBegin (
+  IN volatile UINT32  *Sequence
+  );
+
+/**
+  Checks that the state read since FfaSeqReadBegin was not torn.
+
+  @param  Sequence  The sequence count guarding the state.
+  @param  Snapshot  The value FfaSeqReadBegin returned.
+
+  @retval TRUE   No writer touched the state, the copy can be used.
+  @retval FALSE  The copy may be torn and must be discarded.
+**/
+BOOLEAN
+FfaSeqReadValidate (
+  IN volatile UINT32  *Sequence,
+  IN UINT32           Snapshot
+  );
+
+/**
+  Empties the permission shadow.
+
+**/
+VOID
+FfaPermShadowInit (
+  VOID
+  );
+
+/**
+  Looks up the permissions of a page in the shadow.
+
+  @param  Address     An address in the page.
+  @param  MemoryPerm  Receives the permissions.
+
+  @retval TRUE   The permissions were found.
+  @retval FALSE  The page is not shadowed, or the map is being updated.
+**/
+BOOLEAN
+FfaPermShadowLookup (
+  IN  UINT64  Address,
+  OUT UINT32  *MemoryPerm
+  );
+
+/**
+  Records the permissions of a range of pages in the shadow.
+
+  @param  BaseAddress  Base of the range.
+  @param  PageCount    Number of 4K pages in the range.
+  @param  MemoryPerm   The permissions.
+
+**/
+VOID
+FfaPermShadowUpdate (
+  IN UINT64  BaseAddress,
+  IN UINT64  PageCount,
+  IN UINT32  MemoryPerm
+  );
+
+/**
+  Forgets the permissions of a range of pages, or of every page.
+
+  @param  BaseAddress  Base of the range.
+  @param  PageCount    Number of 4K pages in the range, 0 for every page.
+
+**/
+VOID
+FfaPermShadowInvalidate (
+  IN UINT64  BaseAddress,
+  IN UINT64  PageCount
+  );
+
+#ifdef FFA_LIB_EX_INSTRUMENTATION
+
+/**
+  Records one completed FF-A call in the per function ID statistics.
+
+  @param  FunctionId  The function ID the call was issued with.
+  @param  StartTicks  Performance counter value sampled before the trap.
+  @param  Result      The registers returned by the SPMC.
+
+**/
+VOID
+FfaStatsRecordCall (
+  IN UINT32              FunctionId,
+  IN UINT64              StartTicks,
+  IN CONST ARM_SXC_ARGS  *Result
+  );
+
+//
+// Bracket a trap with FFA_STATS_BEGIN/FFA_STATS_END to account for it. Both
+// expand to nothing unless FFA_LIB_EX_INSTRUMENTATION is defined.
+//
+  #define FFA_STATS_BEGIN(Args)                      \
+  UINT32  StatsFunctionId = (UINT32)(Args)->Arg0;  \
+  UINT64  StatsStartTicks = GetPerformanceCounter ()
+
+  #define FFA_STATS_END(Args) \
+  FfaStatsRecordCall (StatsFunctionId, StatsStartTicks, (Args))
+
+#else
+
+  #define FFA_STATS_BEGIN(Args)
+  #define FFA_STATS_END(Args)
+
+#endif
+
+#ifdef FFA_LIB_EX_TRACE
+
+//
+// Number of registers, from x0, the call variants read or write. Registers
+// past the count are not initialized in the argument block.
+//
+  #define FFA_X7_REGISTER_COUNT   8
+  #define FFA_X17_REGISTER_COUNT  18
+
+/**
+  Saves the registers an FF-A call is about to be issued with.
+
+  @param  Request  Receives the registers.
+  @param  Args     The argument block of the call.
+  @param  Count    Number of registers, from x0, the call reads.
+
+  @retval Count.
+**/
+UINTN
+FfaTraceCaptureRequest (
+  OUT ARM_SXC_ARGS        *Request,
+  IN  CONST ARM_SXC_ARGS  *Args,
+  IN  UINTN               Count
+  );
+
+/**
+  Appends one completed FF-A call to the trace ring.
+
+  @param  Request        The registers the call was issued with.
+  @param  RequestCount   Number of registers, from x0, the call read.
+  @param  Response       The registers returned by the SPMC.
+  @param  ResponseCount  Number of registers, from x0, the call wrote.
+
+**/
+VOID
+FfaTraceRecordCall (
+  IN CONST ARM_SXC_ARGS  *Request,
+  IN UINTN               RequestCount,
+  IN CONST ARM_SXC_ARGS  *Response,
+  IN UINTN               ResponseCount
+  );
+
+//
+// Bracket a trap with FFA_TRACE_BEGIN/FFA_TRACE_END to capture it, passing
+// the number of registers the call reads and writes. Both expand to nothing
+// unless FFA_LIB_EX_TRACE is defined.
+//
+  #define FFA_TRACE_BEGIN(Args, RequestCount) \
+  ARM_SXC_ARGS  TraceRequest;                 \
+  UINTN         TraceRequestCount = FfaTraceCaptureRequest (&TraceRequest, (Args), (RequestCount))
+
+  #define FFA_TRACE_END(Args, ResponseCount) \
+  FfaTraceRecordCall (&TraceRequest, TraceRequestCount, (Args), (ResponseCount))
+
+#else
+
+  #define FFA_TRACE_BEGIN(Args, RequestCount)
+  #define FFA_TRACE_END(Args, ResponseCount)
+
+#endif
+
+#endif /* ARM_FFA_LIB_EX_INTERNAL_H_ */
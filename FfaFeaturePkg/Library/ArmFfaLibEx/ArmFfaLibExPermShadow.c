@@ -0,0 +1,287 @@
+/** @file
+  Shadow of the stage-1 permissions of the calling partition for ArmFfaLibEx.
+
+  FFA_MEM_PERM_GET costs a trap, yet the permissions of a partition's own
+  regions only change through its own FFA_MEM_PERM_SET calls. When
+  PcdFfaLibExPermShadowEnable is set, the permissions are kept in an interval
+  map: every successful FFA_MEM_PERM_SET is recorded, every FFA_MEM_PERM_GET
+  that had to trap seeds the page it asked for, and FfaMemPermGet answers from
+  the map whenever it can.
+
+  The map is a sorted array of disjoint intervals. Adjacent intervals with the
+  same permissions are merged, so that a handful of entries describe an image.
+  Writers serialize on a spin lock, since an update must not be lost, and
+  the array is guarded by a sequence count, so a lookup that races with an
+  update misses and traps rather than blocks or returns a stale answer.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/ArmFfaSvc.h>
+#include <IndustryStandard/ArmFfaPartInfo.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/SynchronizationLib.h>
+
+#include "ArmFfaLibExInternal.h"
+
+//
+// Number of intervals in the map. Can be overridden from the build options.
+//
+#ifndef FFA_LIB_EX_PERM_SHADOW_SIZE
+  #define FFA_LIB_EX_PERM_SHADOW_SIZE  64
+#endif
+
+typedef struct {
+  UINT64    Base;
+  UINT64    End;          // Exclusive
+  UINT32    MemoryPerm;
+} FFA_PERM_SHADOW_ENTRY;
+
+typedef struct {
+  volatile UINT32          Sequence;
+  SPIN_LOCK                Lock;
+  UINTN                    Count;
+  FFA_PERM_SHADOW_ENTRY    Entries[FFA_LIB_EX_PERM_SHADOW_SIZE];
+} FFA_PERM_SHADOW;
+
+STATIC FFA_PERM_SHADOW  mFfaPermShadow;
+
+/**
+  Returns the first interval of the map that ends above an address.
+
+  @param  Address  The address.
+  @param  Count    Number of intervals in the map.
+
+  @retval The index of the interval, or Count if there is none.
+**/
+STATIC
+UINTN
+FfaPermShadowFind (
+  IN UINT64  Address,
+  IN UINTN   Count
+  )
+{
+  UINTN  Low;
+  UINTN  High;
+  UINTN  Middle;
+
+  Low  = 0;
+  High = Count;
+  while (Low < High) {
+    Middle = Low + (High - Low) / 2;
+    if (mFfaPermShadow.Entries[Middle].End <= Address) {
+      Low = Middle + 1;
+    } else {
+      High = Middle;
+    }
+  }
+
+  return Low;
+}
+
+/**
+  Replaces whatever the map holds for a range of addresses.
+
+  @param  Base        Base of the range.
+  @param  End         End of the range, exclusive.
+  @param  MemoryPerm  Permissions of the range, ignored if Insert is FALSE.
+  @param  Insert      TRUE to record the range, FALSE to forget it.
+
+**/
+STATIC
+VOID
+FfaPermShadowReplace (
+  IN UINT64   Base,
+  IN UINT64   End,
+  IN UINT32   MemoryPerm,
+  IN BOOLEAN  Insert
+  )
+{
+  FFA_PERM_SHADOW_ENTRY  *Entries;
+  FFA_PERM_SHADOW_ENTRY  Pieces[3];
+  FFA_PERM_SHADOW_ENTRY  Left;
+  FFA_PERM_SHADOW_ENTRY  Right;
+  UINTN                  PieceCount;
+  UINTN                  Count;
+  UINTN                  First;
+  UINTN                  Last;
+
+  //
+  // Holding the lock, no other writer can have claimed the count.
+  //
+  AcquireSpinLock (&mFfaPermShadow.Lock);
+  FfaSeqWriteBegin (&mFfaPermShadow.Sequence);
+
+  Entries = mFfaPermShadow.Entries;
+  Count   = mFfaPermShadow.Count;
+
+  //
+  // Entries[First, Last) overlap the range. A new range also takes in the
+  // neighbours it touches, so that they can be merged with it.
+  //
+  First = FfaPermShadowFind (Base, Count);
+  for (Last = First; (Last < Count) && (Entries[Last].Base < End); Last++) {
+  }
+
+  if (Insert) {
+    if ((First > 0) && (Entries[First - 1].End == Base) && (Entries[First - 1].MemoryPerm == MemoryPerm)) {
+      First--;
+    }
+
+    if ((Last < Count) && (Entries[Last].Base == End) && (Entries[Last].MemoryPerm == MemoryPerm)) {
+      Last++;
+    }
+  }
+
+  //
+  // Whatever part of those intervals lies outside the range is kept, merged
+  // into the range if it has the same permissions.
+  //
+  PieceCount = 0;
+  if ((First < Last) && (Entries[First].Base < Base)) {
+    Left = Entries[First];
+    if (Insert && (Left.MemoryPerm == MemoryPerm)) {
+      Base = Left.Base;
+    } else {
+      Left.End             = Base;
+      Pieces[PieceCount++] = Left;
+    }
+  }
+
+  ZeroMem (&Right, sizeof (Right));
+  if ((First < Last) && (Entries[Last - 1].End > End)) {
+    Right = Entries[Last - 1];
+    if (Insert && (Right.MemoryPerm == MemoryPerm)) {
+      End = Right.End;
+      ZeroMem (&Right, sizeof (Right));
+    } else {
+      Right.Base = End;
+    }
+  }
+
+  if (Insert) {
+    Pieces[PieceCount].Base       = Base;
+    Pieces[PieceCount].End        = End;
+    Pieces[PieceCount].MemoryPerm = MemoryPerm;
+    PieceCount++;
+  }
+
+  if (Right.End != 0) {
+    Pieces[PieceCount++] = Right;
+  }
+
+  //
+  // Without room for the pieces, only forget the overlapped intervals. The
+  // range then misses and traps again.
+  //
+  if (Count - (Last - First) + PieceCount > FFA_LIB_EX_PERM_SHADOW_SIZE) {
+    PieceCount = 0;
+  }
+
+  CopyMem (&Entries[First + PieceCount], &Entries[Last], (Count - Last) * sizeof (*Entries));
+  CopyMem (&Entries[First], Pieces, PieceCount * sizeof (*Entries));
+  mFfaPermShadow.Count = Count - (Last - First) + PieceCount;
+
+  FfaSeqWriteEnd (&mFfaPermShadow.Sequence);
+  ReleaseSpinLock (&mFfaPermShadow.Lock);
+}
+
+/**
+  Empties the permission shadow.
+
+**/
+VOID
+FfaPermShadowInit (
+  VOID
+  )
+{
+  ZeroMem (&mFfaPermShadow, sizeof (mFfaPermShadow));
+  InitializeSpinLock (&mFfaPermShadow.Lock);
+}
+
+/**
+  Looks up the permissions of a page in the shadow.
+
+  @param  Address     An address in the page.
+  @param  MemoryPerm  Receives the permissions.
+
+  @retval TRUE   The permissions were found.
+  @retval FALSE  The page is not shadowed, or the map is being updated.
+**/
+BOOLEAN
+FfaPermShadowLookup (
+  IN  UINT64  Address,
+  OUT UINT32  *MemoryPerm
+  )
+{
+  UINT32   Sequence;
+  UINTN    Count;
+  UINTN    Index;
+  BOOLEAN  Hit;
+
+  Sequence = FfaSeqReadBegin (&mFfaPermShadow.Sequence);
+  Count    = MIN (mFfaPermShadow.Count, FFA_LIB_EX_PERM_SHADOW_SIZE);
+  Index    = FfaPermShadowFind (Address, Count);
+  Hit      = (Index < Count) && (mFfaPermShadow.Entries[Index].Base <= Address);
+  if (Hit) {
+    *MemoryPerm = mFfaPermShadow.Entries[Index].MemoryPerm;
+  }
+
+  return FfaSeqReadValidate (&mFfaPermShadow.Sequence, Sequence) && Hit;
+}
+
+/**
+  Records the permissions of a range of pages in the shadow.
+
+  @param  BaseAddress  Base of the range.
+  @param  PageCount    Number of 4K pages in the range.
+  @param  MemoryPerm   The permissions.
+
+**/
+VOID
+FfaPermShadowUpdate (
+  IN UINT64  BaseAddress,
+  IN UINT64  PageCount,
+  IN UINT32  MemoryPerm
+  )
+{
+  if (PageCount == 0) {
+    return;
+  }
+
+  FfaPermShadowReplace (BaseAddress, BaseAddress + EFI_PAGES_TO_SIZE ((UINTN)PageCount), MemoryPerm, TRUE);
+}
+
+/**
+  Forgets the permissions of a range of pages, or of every page.
+
+  @param  BaseAddress  Base of the range.
+  @param  PageCount    Number of 4K pages in the range, 0 for every page.
+
+**/
+VOID
+FfaPermShadowInvalidate (
+  IN UINT64  BaseAddress,
+  IN UINT64  PageCount
+  )
+{
+  if (PageCount == 0) {
+    FfaPermShadowReplace (0, MAX_UINT64, 0, FALSE);
+    return;
+  }
+
+  FfaPermShadowReplace (BaseAddress, BaseAddress + EFI_PAGES_TO_SIZE ((UINTN)PageCount), 0, FALSE);
+}
+
+VOID
+EFIAPI
+FfaExInvalidatePermShadow (
+  VOID
+  )
+{
+  FfaPermShadowInvalidate (0, 0);
+}
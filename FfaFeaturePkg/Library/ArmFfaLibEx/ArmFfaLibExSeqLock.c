@@ -0,0 +1,97 @@
+/** @file
+  Sequence count helpers for ArmFfaLibEx.
+
+  See ArmFfaLibExInternal.h for the protocol.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/ArmFfaSvc.h>
+#include <IndustryStandard/ArmFfaPartInfo.h>
+#include <Library/BaseLib.h>
+#include <Library/SynchronizationLib.h>
+
+#include "ArmFfaLibExInternal.h"
+
+/**
+  Claims a sequence count for writing.
+
+  @param  Sequence  The sequence count guarding the state.
+
+  @retval TRUE   The count is odd and the caller may update the state.
+  @retval FALSE  Another writer holds the count, nothing was done.
+**/
+BOOLEAN
+FfaSeqWriteBegin (
+  IN OUT volatile UINT32  *Sequence
+  )
+{
+  UINT32  Snapshot;
+
+  Snapshot = *Sequence;
+  if (((Snapshot & BIT0) != 0) ||
+      (InterlockedCompareExchange32 (Sequence, Snapshot, Snapshot + 1) != Snapshot))
+  {
+    return FALSE;
+  }
+
+  MemoryFence ();
+  return TRUE;
+}
+
+/**
+  Publishes an update and releases a sequence count claimed by
+  FfaSeqWriteBegin.
+
+  @param  Sequence  The sequence count guarding the state.
+
+**/
+VOID
+FfaSeqWriteEnd (
+  IN OUT volatile UINT32  *Sequence
+  )
+{
+  MemoryFence ();
+  *Sequence = *Sequence + 1;
+}
+
+/**
+  Snapshots a sequence count before reading the state it guards.
+
+  @param  Sequence  The sequence count guarding the state.
+
+  @retval The snapshot, odd if a writer is updating the state.
+**/
+UINT32
+FfaSeqReadBegin (
+  IN volatile UINT32  *Sequence
+  )
+{
+  UINT32  Snapshot;
+
+  Snapshot = *Sequence;
+  MemoryFence ();
+  return Snapshot;
+}
+
+/**
+  Checks that the state read since FfaSeqReadBegin was not torn.
+
+  @param  Sequence  The sequence count guarding the state.
+  @param  Snapshot  The value FfaSeqReadBegin returned.
+
+  @retval TRUE   No writer touched the state, the copy can be used.
+  @retval FALSE  The copy may be torn and must be discarded.
+**/
+BOOLEAN
+FfaSeqReadValidate (
+  IN volatile UINT32  *Sequence,
+  IN UINT32           Snapshot
+  )
+{
+  MemoryFence ();
+  return ((Snapshot & BIT0) == 0) && (*Sequence == Snapshot);
+}
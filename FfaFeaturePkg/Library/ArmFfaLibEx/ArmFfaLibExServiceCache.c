@@ -0,0 +1,213 @@
+/** @file
+  Service GUID to partition ID cache for ArmFfaLibEx.
+
+  Resolving a service through FFA_PARTITION_INFO_GET_REGS costs a trap, and
+  through FFA_PARTITION_INFO_GET an RX buffer round trip on top. The set of
+  partitions rarely changes after boot, so the result is kept in a small
+  direct mapped table indexed by a hash of the GUID and the send path only
+  pays a lookup.
+
+  Each slot is guarded by a sequence count, so a lookup that races with a
+  fill on another vCPU misses rather than blocks or returns a torn entry.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/ArmFfaSvc.h>
+#include <IndustryStandard/ArmFfaPartInfo.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+#include "ArmFfaLibExInternal.h"
+
+//
+// Number of slots in the cache. Can be overridden from the build options,
+// must be a power of two.
+//
+#ifndef FFA_LIB_EX_SERVICE_CACHE_SIZE
+  #define FFA_LIB_EX_SERVICE_CACHE_SIZE  16
+#endif
+
+STATIC_ASSERT (
+  (FFA_LIB_EX_SERVICE_CACHE_SIZE & (FFA_LIB_EX_SERVICE_CACHE_SIZE - 1)) == 0,
+  "FFA_LIB_EX_SERVICE_CACHE_SIZE must be a power of two"
+  );
+
+typedef struct {
+  volatile UINT32        Sequence;
+  BOOLEAN                Valid;
+  EFI_GUID               ServiceGuid;
+  FFA_EX_SERVICE_INFO    Info;
+} FFA_SERVICE_CACHE_ENTRY;
+
+STATIC FFA_SERVICE_CACHE_ENTRY  mFfaServiceCache[FFA_LIB_EX_SERVICE_CACHE_SIZE];
+
+/**
+  Returns the cache slot a service GUID maps to.
+
+  @param  ServiceGuid  The service GUID.
+
+  @retval The slot.
+**/
+STATIC
+FFA_SERVICE_CACHE_ENTRY *
+FfaServiceCacheSlot (
+  IN CONST EFI_GUID  *ServiceGuid
+  )
+{
+  CONST UINT32  *Words;
+  UINT32        Hash;
+
+  //
+  // Service GUIDs are random, folding the four words is enough to spread
+  // them over the slots.
+  //
+  Words = (CONST UINT32 *)ServiceGuid;
+  Hash  = Words[0] ^ Words[1] ^ Words[2] ^ Words[3];
+  Hash ^= Hash >> 16;
+  Hash ^= Hash >> 8;
+
+  return &mFfaServiceCache[Hash & (FFA_LIB_EX_SERVICE_CACHE_SIZE - 1)];
+}
+
+/**
+  Looks up a service in the cache.
+
+  @param  ServiceGuid  The service GUID.
+  @param  Info         Receives the cached partition information.
+
+  @retval TRUE   The service was found.
+  @retval FALSE  The service is not cached, or its slot is being updated.
+**/
+STATIC
+BOOLEAN
+FfaServiceCacheLookup (
+  IN  CONST EFI_GUID       *ServiceGuid,
+  OUT FFA_EX_SERVICE_INFO  *Info
+  )
+{
+  FFA_SERVICE_CACHE_ENTRY  *Entry;
+  UINT32                   Sequence;
+  BOOLEAN                  Hit;
+
+  Entry    = FfaServiceCacheSlot (ServiceGuid);
+  Sequence = FfaSeqReadBegin (&Entry->Sequence);
+  Hit      = Entry->Valid && CompareGuid (&Entry->ServiceGuid, ServiceGuid);
+  if (Hit) {
+    CopyMem (Info, &Entry->Info, sizeof (*Info));
+  }
+
+  return FfaSeqReadValidate (&Entry->Sequence, Sequence) && Hit;
+}
+
+/**
+  Stores a service in the cache, evicting whatever shared its slot.
+
+  @param  ServiceGuid  The service GUID, or NULL to clear the slot only.
+  @param  Entry        The slot.
+  @param  Info         The partition information, ignored if ServiceGuid is
+                       NULL.
+
+  @retval TRUE   The slot was updated.
+  @retval FALSE  Another vCPU is writing the slot, nothing was done.
+**/
+STATIC
+BOOLEAN
+FfaServiceCacheStore (
+  IN CONST EFI_GUID             *ServiceGuid OPTIONAL,
+  IN FFA_SERVICE_CACHE_ENTRY    *Entry,
+  IN CONST FFA_EX_SERVICE_INFO  *Info OPTIONAL
+  )
+{
+  if (!FfaSeqWriteBegin (&Entry->Sequence)) {
+    return FALSE;
+  }
+
+  Entry->Valid = (ServiceGuid != NULL);
+  if (ServiceGuid != NULL) {
+    CopyGuid (&Entry->ServiceGuid, ServiceGuid);
+    CopyMem (&Entry->Info, Info, sizeof (*Info));
+  }
+
+  FfaSeqWriteEnd (&Entry->Sequence);
+  return TRUE;
+}
+
+EFI_STATUS
+EFIAPI
+FfaExResolveService (
+  IN  CONST EFI_GUID       *ServiceGuid,
+  OUT FFA_EX_SERVICE_INFO  *Info
+  )
+{
+  EFI_STATUS              Status;
+  EFI_FFA_PART_INFO_DESC  PartDesc[FFA_PART_INFO_REGS_MAX_DESCS];
+  UINT32                  Count;
+
+  if ((ServiceGuid == NULL) || (Info == NULL) || IsZeroGuid (ServiceGuid)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (FfaServiceCacheLookup (ServiceGuid, Info)) {
+    return EFI_SUCCESS;
+  }
+
+  //
+  // A single window always fits a full FFA_PARTITION_INFO_GET_REGS response.
+  // If several partitions implement the service the first one is cached.
+  //
+  Count  = ARRAY_SIZE (PartDesc);
+  Status = FfaPartitionInfoGetRegs ((EFI_GUID *)ServiceGuid, 0, NULL, &Count, PartDesc);
+  if (Status == EFI_INVALID_PARAMETER) {
+    //
+    // The SPMC rejects a UUID no partition implements.
+    //
+    return EFI_NOT_FOUND;
+  }
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Info->PartitionId      = PartDesc[0].PartitionId;
+  Info->ExecContextCount = PartDesc[0].ExecContextCountOrProxyPartitionId;
+  Info->Properties       = PartDesc[0].PartitionProps;
+
+  //
+  // Losing the race for the slot only costs another trap on the next call.
+  //
+  FfaServiceCacheStore (ServiceGuid, FfaServiceCacheSlot (ServiceGuid), Info);
+  return EFI_SUCCESS;
+}
+
+VOID
+EFIAPI
+FfaExInvalidateServiceCache (
+  IN CONST EFI_GUID  *ServiceGuid OPTIONAL
+  )
+{
+  FFA_SERVICE_CACHE_ENTRY  *Entry;
+  UINTN                    Index;
+
+  //
+  // Unlike a fill, an invalidation must not be lost, so wait for a writer
+  // to finish with the slot.
+  //
+  if (ServiceGuid != NULL) {
+    Entry = FfaServiceCacheSlot (ServiceGuid);
+    while (!FfaServiceCacheStore (NULL, Entry, NULL)) {
+      CpuPause ();
+    }
+
+    return;
+  }
+
+  for (Index = 0; Index < ARRAY_SIZE (mFfaServiceCache); Index++) {
+    while (!FfaServiceCacheStore (NULL, &mFfaServiceCache[Index], NULL)) {
+      CpuPause ();
+    }
+  }
+}
@@ -0,0 +1,152 @@
+/** @file
+  Per function ID call statistics for ArmFfaLibEx.
+
+  Only built into the library when FFA_LIB_EX_INSTRUMENTATION is defined, e.g.
+  through the module scoped <BuildOptions> of the ArmFfaLibEx instance in the
+  platform DSC. Otherwise the query functions report EFI_UNSUPPORTED and the
+  call path carries no accounting code at all.
+
+  Each bound vCPU counts in its own context and the query functions add the
+  contexts up, so vCPUs never write the same counters. vCPUs that were not
+  bound share the boot context, and their totals are approximate.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/ArmFfaSvc.h>
+#include <IndustryStandard/ArmFfaPartInfo.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/TimerLib.h>
+
+#include "ArmFfaLibExInternal.h"
+
+#ifdef FFA_LIB_EX_INSTRUMENTATION
+
+/**
+  Records one completed FF-A call in the per function ID statistics.
+
+  @param  FunctionId  The function ID the call was issued with.
+  @param  StartTicks  Performance counter value sampled before the trap.
+  @param  Result      The registers returned by the SPMC.
+
+**/
+VOID
+FfaStatsRecordCall (
+  IN UINT32              FunctionId,
+  IN UINT64              StartTicks,
+  IN CONST ARM_SXC_ARGS  *Result
+  )
+{
+  FFA_EX_CALL_STATS  *Stats;
+  UINT64             Ticks;
+  UINTN              Index;
+  UINTN              Bucket;
+
+  Ticks = GetPerformanceCounter () - StartTicks;
+
+  Index = FfaFidToIndex (FunctionId);
+  if (Index >= FFA_FID_INDEX_COUNT) {
+    return;
+  }
+
+  Stats = &FfaGetVcpuContext ()->CallStats[Index];
+  Stats->CallCount++;
+  if (Result->Arg0 == ARM_FID_FFA_ERROR) {
+    Stats->ErrorCount++;
+  } else if (Result->Arg0 == ARM_FID_FFA_INTERRUPT) {
+    Stats->InterruptCount++;
+  }
+
+  //
+  // Bucket 0 holds calls that took no measurable time, bucket N holds calls
+  // that took [2^(N-1), 2^N) ticks and the last bucket collects everything
+  // longer.
+  //
+  Bucket = (Ticks == 0) ? 0 : (UINTN)HighBitSet64 (Ticks) + 1;
+  if (Bucket >= FFA_EX_LATENCY_BUCKETS) {
+    Bucket = FFA_EX_LATENCY_BUCKETS - 1;
+  }
+
+  Stats->LatencyHistogram[Bucket]++;
+}
+
+#endif
+
+/**
+  Returns the call statistics collected for an FF-A function ID.
+
+  @param  FunctionId  The FF-A function ID to query.
+  @param  Stats       Receives a copy of the statistics.
+
+  @retval EFI_SUCCESS            The statistics were returned.
+  @retval EFI_INVALID_PARAMETER  Stats is NULL or FunctionId is not an FF-A
+                                 function ID.
+  @retval EFI_UNSUPPORTED        The library was built without
+                                 FFA_LIB_EX_INSTRUMENTATION.
+**/
+EFI_STATUS
+EFIAPI
+FfaExGetCallStats (
+  IN  UINT32             FunctionId,
+  OUT FFA_EX_CALL_STATS  *Stats
+  )
+{
+ #ifdef FFA_LIB_EX_INSTRUMENTATION
+  CONST FFA_EX_CALL_STATS  *VcpuStats;
+  FFA_VCPU_CONTEXT         *Context;
+  UINTN                    Index;
+  UINTN                    ContextIndex;
+  UINTN                    Bucket;
+
+  Index = FfaFidToIndex (FunctionId);
+  if ((Stats == NULL) || (Index >= FFA_FID_INDEX_COUNT)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  ZeroMem (Stats, sizeof (*Stats));
+  for (ContextIndex = 0; (Context = FfaGetVcpuContextAt (ContextIndex)) != NULL; ContextIndex++) {
+    VcpuStats             = &Context->CallStats[Index];
+    Stats->CallCount      += VcpuStats->CallCount;
+    Stats->ErrorCount     += VcpuStats->ErrorCount;
+    Stats->InterruptCount += VcpuStats->InterruptCount;
+    for (Bucket = 0; Bucket < FFA_EX_LATENCY_BUCKETS; Bucket++) {
+      Stats->LatencyHistogram[Bucket] += VcpuStats->LatencyHistogram[Bucket];
+    }
+  }
+
+  return EFI_SUCCESS;
+ #else
+  return EFI_UNSUPPORTED;
+ #endif
+}
+
+/**
+  Clears the call statistics of every FF-A function ID.
+
+  @retval EFI_SUCCESS      The statistics were cleared.
+  @retval EFI_UNSUPPORTED  The library was built without
+                           FFA_LIB_EX_INSTRUMENTATION.
+**/
+EFI_STATUS
+EFIAPI
+FfaExResetCallStats (
+  VOID
+  )
+{
+ #ifdef FFA_LIB_EX_INSTRUMENTATION
+  FFA_VCPU_CONTEXT  *Context;
+  UINTN             ContextIndex;
+
+  for (ContextIndex = 0; (Context = FfaGetVcpuContextAt (ContextIndex)) != NULL; ContextIndex++) {
+    ZeroMem (Context->CallStats, sizeof (Context->CallStats));
+  }
+
+  return EFI_SUCCESS;
+ #else
+  return EFI_UNSUPPORTED;
+ #endif
+}
@@ -0,0 +1,277 @@
+/** @file
+  FF-A call trace ring and offline replay for ArmFfaLibEx.
+
+  When FFA_LIB_EX_TRACE is defined, every FF-A call issued by the library is
+  appended to a fixed size ring of FFA_EX_TRACE_RECORD. Writers claim a slot
+  with a single atomic increment and never block, so the ring can be fed from
+  any vCPU and from interrupt context. The oldest records are overwritten once
+  the ring is full.
+
+  The replay half only depends on the record format and is always built, so a
+  trace dumped from a production partition can be fed through the service
+  handlers by any other build, including a host one.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/ArmFfaSvc.h>
+#include <IndustryStandard/ArmFfaPartInfo.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/SynchronizationLib.h>
+#include <Library/TimerLib.h>
+
+#include "ArmFfaLibExInternal.h"
+
+#ifdef FFA_LIB_EX_TRACE
+
+//
+// Number of records kept in the ring. Can be overridden from the build
+// options, must be a power of two.
+//
+  #ifndef FFA_LIB_EX_TRACE_RECORDS
+    #define FFA_LIB_EX_TRACE_RECORDS  256
+  #endif
+
+STATIC_ASSERT (
+  (FFA_LIB_EX_TRACE_RECORDS & (FFA_LIB_EX_TRACE_RECORDS - 1)) == 0,
+  "FFA_LIB_EX_TRACE_RECORDS must be a power of two"
+  );
+
+  #define FFA_TRACE_SLOT(Sequence)  (((Sequence) - 1) & (FFA_LIB_EX_TRACE_RECORDS - 1))
+
+STATIC FFA_EX_TRACE_RECORD  mFfaTraceRing[FFA_LIB_EX_TRACE_RECORDS];
+
+//
+// Sequence number of the last claimed record. Record N lives in slot
+// FFA_TRACE_SLOT (N) and carries Sequence == N once it is fully written.
+//
+STATIC volatile UINT32  mFfaTraceHead;
+
+/**
+  Saves the registers an FF-A call is about to be issued with.
+
+  @param  Request  Receives the registers.
+  @param  Args     The argument block of the call.
+  @param  Count    Number of registers, from x0, the call reads.
+
+  @retval Count.
+**/
+UINTN
+FfaTraceCaptureRequest (
+  OUT ARM_SXC_ARGS        *Request,
+  IN  CONST ARM_SXC_ARGS  *Args,
+  IN  UINTN               Count
+  )
+{
+  CopyMem (Request, Args, Count * sizeof (UINTN));
+  return Count;
+}
+
+/**
+  Appends one completed FF-A call to the trace ring.
+
+  Only the registers the call used are copied, the others are recorded as
+  zero rather than as whatever the argument block held.
+
+  @param  Request        The registers the call was issued with.
+  @param  RequestCount   Number of registers, from x0, the call read.
+  @param  Response       The registers returned by the SPMC.
+  @param  ResponseCount  Number of registers, from x0, the call wrote.
+
+**/
+VOID
+FfaTraceRecordCall (
+  IN CONST ARM_SXC_ARGS  *Request,
+  IN UINTN               RequestCount,
+  IN CONST ARM_SXC_ARGS  *Response,
+  IN UINTN               ResponseCount
+  )
+{
+  FFA_EX_TRACE_RECORD  *Record;
+  UINT32               Sequence;
+
+  Sequence = InterlockedIncrement (&mFfaTraceHead);
+  Record   = &mFfaTraceRing[FFA_TRACE_SLOT (Sequence)];
+
+  //
+  // Invalidate the slot first so that a concurrent dump never mistakes a half
+  // written record for a complete one.
+  //
+  Record->Sequence = 0;
+  MemoryFence ();
+
+  Record->VcpuId    = FfaExGetCurrentVcpuId ();
+  Record->Reserved  = 0;
+  Record->Timestamp = GetPerformanceCounter ();
+  ZeroMem (&Record->Request, sizeof (ARM_SXC_ARGS));
+  ZeroMem (&Record->Response, sizeof (ARM_SXC_ARGS));
+  CopyMem (&Record->Request, Request, RequestCount * sizeof (UINTN));
+  CopyMem (&Record->Response, Response, ResponseCount * sizeof (UINTN));
+
+  MemoryFence ();
+  Record->Sequence = Sequence;
+}
+
+#endif
+
+/**
+  Copies the most recent trace records, oldest first.
+
+  Records that are being written while the ring is dumped are skipped: the
+  sequence of a slot is read before and after its copy, and the copy is only
+  kept if neither read saw a writer in the slot.
+
+  @param  Records      Buffer receiving the records.
+  @param  RecordCount  On input, the capacity of Records in records. On output,
+                       the number of records copied.
+
+  @retval EFI_SUCCESS            The records were copied.
+  @retval EFI_INVALID_PARAMETER  Records or RecordCount is NULL.
+  @retval EFI_UNSUPPORTED        The library was built without
+                                 FFA_LIB_EX_TRACE.
+**/
+EFI_STATUS
+EFIAPI
+FfaExTraceDump (
+  OUT    FFA_EX_TRACE_RECORD  *Records,
+  IN OUT UINTN                *RecordCount
+  )
+{
+ #ifdef FFA_LIB_EX_TRACE
+  FFA_EX_TRACE_RECORD  *Slot;
+  UINT32               Head;
+  UINT32               Sequence;
+  UINTN                Count;
+  UINTN                Copied;
+
+  if ((Records == NULL) || (RecordCount == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Head  = mFfaTraceHead;
+  Count = MIN (MIN (*RecordCount, (UINTN)Head), (UINTN)FFA_LIB_EX_TRACE_RECORDS);
+
+  Copied = 0;
+  for (Sequence = Head - (UINT32)Count + 1; Sequence <= Head; Sequence++) {
+    Slot = &mFfaTraceRing[FFA_TRACE_SLOT (Sequence)];
+    if (*(volatile UINT32 *)&Slot->Sequence != Sequence) {
+      continue;
+    }
+
+    MemoryFence ();
+    CopyMem (&Records[Copied], Slot, sizeof (FFA_EX_TRACE_RECORD));
+    MemoryFence ();
+    if (*(volatile UINT32 *)&Slot->Sequence == Sequence) {
+      Copied++;
+    }
+  }
+
+  *RecordCount = Copied;
+  return EFI_SUCCESS;
+ #else
+  return EFI_UNSUPPORTED;
+ #endif
+}
+
+/**
+  Discards every record in the trace ring.
+
+  Must not race with FF-A calls on other vCPUs.
+
+  @retval EFI_SUCCESS      The ring was cleared.
+  @retval EFI_UNSUPPORTED  The library was built without FFA_LIB_EX_TRACE.
+**/
+EFI_STATUS
+EFIAPI
+FfaExTraceReset (
+  VOID
+  )
+{
+ #ifdef FFA_LIB_EX_TRACE
+  mFfaTraceHead = 0;
+  ZeroMem (mFfaTraceRing, sizeof (mFfaTraceRing));
+  return EFI_SUCCESS;
+ #else
+  return EFI_UNSUPPORTED;
+ #endif
+}
+
+/**
+  Feeds the direct requests found in a captured trace back through the service
+  handlers.
+
+  A partition receives its requests as the result of FFA_MSG_WAIT or of a
+  direct response, so every record whose response registers hold a direct
+  request is unpacked with FfaUnpackDirectMessage and dispatched to the handler
+  registered for its service GUID. FF-A v1 direct requests carry no GUID and
+  are dispatched to the entry with a zero GUID, if any.
+
+  @param  Records          Captured records, oldest first.
+  @param  RecordCount      Number of records.
+  @param  Services         Service GUID to handler table.
+  @param  ServiceCount     Number of entries in Services.
+  @param  DispatchedCount  Optional, receives the number of requests that
+                           were dispatched.
+
+  @retval EFI_SUCCESS            The trace was replayed.
+  @retval EFI_INVALID_PARAMETER  Records or Services is NULL.
+**/
+EFI_STATUS
+EFIAPI
+FfaExTraceReplay (
+  IN  CONST FFA_EX_TRACE_RECORD   *Records,
+  IN  UINTN                       RecordCount,
+  IN  CONST FFA_EX_TRACE_SERVICE  *Services,
+  IN  UINTN                       ServiceCount,
+  OUT UINTN                       *DispatchedCount OPTIONAL
+  )
+{
+  DIRECT_MSG_ARGS_EX  Request;
+  DIRECT_MSG_ARGS_EX  Response;
+  UINTN               Dispatched;
+  UINTN               Index;
+  UINTN               ServiceIndex;
+  UINTN               Function;
+
+  if ((Records == NULL) || (Services == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Dispatched = 0;
+  for (Index = 0; Index < RecordCount; Index++) {
+    Function = Records[Index].Response.Arg0;
+    if ((Function != ARM_FID_FFA_MSG_SEND_DIRECT_REQ_AARCH32) &&
+        (Function != ARM_FID_FFA_MSG_SEND_DIRECT_REQ_AARCH64) &&
+        (Function != ARM_FID_FFA_MSG_SEND_DIRECT_REQ2))
+    {
+      continue;
+    }
+
+    ZeroMem (&Request, sizeof (Request));
+    FfaUnpackDirectMessage (&Records[Index].Response, &Request);
+
+    for (ServiceIndex = 0; ServiceIndex < ServiceCount; ServiceIndex++) {
+      if (CompareGuid (&Services[ServiceIndex].ServiceGuid, &Request.ServiceGuid)) {
+        break;
+      }
+    }
+
+    if ((ServiceIndex == ServiceCount) || (Services[ServiceIndex].Handler == NULL)) {
+      continue;
+    }
+
+    ZeroMem (&Response, sizeof (Response));
+    Services[ServiceIndex].Handler (&Request, &Response);
+    Dispatched++;
+  }
+
+  if (DispatchedCount != NULL) {
+    *DispatchedCount = Dispatched;
+  }
+
+  return EFI_SUCCESS;
+}
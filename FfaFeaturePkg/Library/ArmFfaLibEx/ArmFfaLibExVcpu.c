@@ -0,0 +1,210 @@
+/** @file
+  Per-vCPU contexts for ArmFfaLibEx.
+
+  An MP partition serves requests on several vCPUs at once. Each vCPU that
+  calls FfaExBindCurrentVcpu gets a context of its own, holding the state the
+  library reads or updates on every call, so that vCPUs never write a shared
+  line on the call path. The context is found again through the thread ID
+  register (TPIDR_EL0), which the library reserves for this purpose.
+
+  A context is claimed with a compare exchange and only written by the vCPU
+  it belongs to afterwards, so binding takes no lock. Callers on a vCPU that
+  was never bound share the boot context set up by the constructor.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/ArmFfaSvc.h>
+#include <IndustryStandard/ArmFfaPartInfo.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/SynchronizationLib.h>
+
+#include "ArmFfaLibExInternal.h"
+
+//
+// Number of vCPUs with a context of their own. Can be overridden from the
+// build options.
+//
+#ifndef FFA_LIB_EX_MAX_VCPUS
+  #define FFA_LIB_EX_MAX_VCPUS  8
+#endif
+
+STATIC_ASSERT (
+  (FFA_LIB_EX_MAX_VCPUS > 0) && (FFA_LIB_EX_MAX_VCPUS <= MAX_UINT16),
+  "FFA_LIB_EX_MAX_VCPUS is out of range"
+  );
+
+//
+// Context states.
+//
+#define FFA_VCPU_FREE     0
+#define FFA_VCPU_BINDING  1
+#define FFA_VCPU_BOUND    2
+
+STATIC FFA_VCPU_CONTEXT  mFfaBootContext;
+STATIC FFA_VCPU_CONTEXT  mFfaVcpuContexts[FFA_LIB_EX_MAX_VCPUS];
+
+/**
+  Releases every vCPU context and resets the boot context.
+
+  Runs from the constructor, before any other vCPU enters the library.
+
+**/
+VOID
+FfaVcpuInit (
+  VOID
+  )
+{
+  ZeroMem (&mFfaBootContext, sizeof (mFfaBootContext));
+  ZeroMem (mFfaVcpuContexts, sizeof (mFfaVcpuContexts));
+  mFfaBootContext.State = FFA_VCPU_BOUND;
+  FfaWriteVcpuRegister (0);
+}
+
+/**
+  Returns the context of the calling vCPU.
+
+  The thread ID register is only trusted if it points at a bound context: its
+  reset value is UNKNOWN on a vCPU that never called FfaExBindCurrentVcpu.
+
+  @retval The context of the vCPU, or the boot context if it is not bound.
+**/
+FFA_VCPU_CONTEXT *
+FfaGetVcpuContext (
+  VOID
+  )
+{
+  UINTN             Value;
+  UINTN             Offset;
+  FFA_VCPU_CONTEXT  *Context;
+
+  Value  = FfaReadVcpuRegister ();
+  Offset = Value - (UINTN)mFfaVcpuContexts;
+  if ((Value < (UINTN)mFfaVcpuContexts) || (Offset >= sizeof (mFfaVcpuContexts)) ||
+      ((Offset % sizeof (FFA_VCPU_CONTEXT)) != 0))
+  {
+    return &mFfaBootContext;
+  }
+
+  Context = (FFA_VCPU_CONTEXT *)Value;
+  if (Context->State != FFA_VCPU_BOUND) {
+    return &mFfaBootContext;
+  }
+
+  return Context;
+}
+
+/**
+  Returns a context by position, for code that aggregates over all of them.
+
+  @param  Index  0 for the boot context, N for the context of vCPU N - 1.
+
+  @retval The context, or NULL past the last one.
+**/
+FFA_VCPU_CONTEXT *
+FfaGetVcpuContextAt (
+  IN UINTN  Index
+  )
+{
+  if (Index == 0) {
+    return &mFfaBootContext;
+  }
+
+  if (Index > FFA_LIB_EX_MAX_VCPUS) {
+    return NULL;
+  }
+
+  return &mFfaVcpuContexts[Index - 1];
+}
+
+/**
+  Binds the calling vCPU to its context.
+
+  Each vCPU of an MP partition calls this once, before it handles requests,
+  typically from its entry point. Binding again from the same vCPU keeps the
+  context, an index already bound to another vCPU is refused so that two
+  vCPUs never share a context.
+
+  @param  VcpuId  Index of the calling vCPU.
+
+  @retval EFI_SUCCESS            The vCPU is bound.
+  @retval EFI_INVALID_PARAMETER  VcpuId is not below FFA_LIB_EX_MAX_VCPUS.
+  @retval EFI_ACCESS_DENIED      Another vCPU is bound to, or binding, the
+                                 same context.
+**/
+EFI_STATUS
+EFIAPI
+FfaExBindCurrentVcpu (
+  IN UINT16  VcpuId
+  )
+{
+  FFA_VCPU_CONTEXT  *Context;
+  UINT32            State;
+
+  if (VcpuId >= FFA_LIB_EX_MAX_VCPUS) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Context = &mFfaVcpuContexts[VcpuId];
+  State   = InterlockedCompareExchange32 (&Context->State, FFA_VCPU_FREE, FFA_VCPU_BINDING);
+  if (State == FFA_VCPU_FREE) {
+    Context->VcpuId = VcpuId;
+    MemoryFence ();
+    Context->State = FFA_VCPU_BOUND;
+  } else if ((State != FFA_VCPU_BOUND) || (FfaReadVcpuRegister () != (UINTN)Context)) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  FfaWriteVcpuRegister ((UINTN)Context);
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns the index the calling vCPU was bound with.
+
+  @param  VcpuId  Receives the index passed to FfaExBindCurrentVcpu.
+
+  @retval EFI_SUCCESS            The vCPU is bound.
+  @retval EFI_INVALID_PARAMETER  VcpuId is NULL.
+  @retval EFI_NOT_FOUND          The vCPU is not bound, it shares the boot
+                                 context.
+**/
+EFI_STATUS
+EFIAPI
+FfaExGetBoundVcpuId (
+  OUT UINT16  *VcpuId
+  )
+{
+  FFA_VCPU_CONTEXT  *Context;
+
+  if (VcpuId == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Context = FfaGetVcpuContext ();
+  if (Context == &mFfaBootContext) {
+    return EFI_NOT_FOUND;
+  }
+
+  *VcpuId = Context->VcpuId;
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns the index of the vCPU the caller is running on.
+
+  @retval The index passed to FfaExBindCurrentVcpu, or 0 if the vCPU is not
+          bound.
+**/
+UINT16
+EFIAPI
+FfaExGetCurrentVcpuId (
+  VOID
+  )
+{
+  return FfaGetVcpuContext ()->VcpuId;
+}
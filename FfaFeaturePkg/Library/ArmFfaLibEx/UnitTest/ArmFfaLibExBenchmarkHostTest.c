@@ -0,0 +1,629 @@
+/** @file
+  Host based micro benchmarks for ArmFfaLibEx.
+
+  Each case times a hot path against the SPMC model in MockSpmcLib and logs
+  the average cost per operation. The bare ArmCallSvc case is the cost of the
+  model itself, so the difference to the other cases is the library overhead
+  (register packing, statistics and trace). The call path cases time the
+  copy-in/copy-out ArmCallSvc wrapper ArmFfaLibEx used to trap through
+  against the in-place trampolines; on the host the trampolines are their
+  portable C stand-ins, so only the saved copies show. The marshalling cases
+  time the packing and unpacking of a direct request alone, by the library's
+  own FfaPackDirectMessage/FfaUnpackDirectMessage and through the register
+  order shim; FFA_EX_DIRECT_MSG callers marshal nothing, their end to end
+  cost is the FfaExDirectMsgSendReq2 case.
+
+  The numbers are informative only; a case fails only if a call fails.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/ArmFfaSvc.h>
+#include <IndustryStandard/ArmFfaPartInfo.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/ArmSvcLib.h>
+#include <Library/ArmSmcLib.h>
+#include <Library/ArmFfaLibEx.h>
+#include <Library/MockSpmcLib.h>
+#include <Library/NotificationServiceLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UnitTestLib.h>
+#include <Guid/NotificationServiceFfa.h>
+
+#define UNIT_TEST_APP_NAME     "ArmFfaLibEx Host Benchmarks"
+#define UNIT_TEST_APP_VERSION  "1.0"
+
+#define BENCHMARK_ITERATIONS  100000
+
+#define BENCHMARK_VM_ID  0x0001
+#define BENCHMARK_SP_ID  0x8002
+
+#define BENCHMARK_TRACE_RECORDS  4
+
+//
+// In-place trampolines of ArmFfaLibEx, see ArmFfaLibExInternal.h.
+//
+VOID
+FfaSvcCallX7 (
+  IN OUT ARM_SXC_ARGS  *Args
+  );
+
+VOID
+FfaSvcCallX17 (
+  IN OUT ARM_SXC_ARGS  *Args
+  );
+
+//
+// Direct message marshalling of ArmFfaLibEx, see ArmFfaLibExInternal.h.
+//
+VOID
+FfaUnpackDirectMessage (
+  IN CONST ARM_SXC_ARGS   *Response,
+  OUT DIRECT_MSG_ARGS_EX  *Message
+  );
+
+VOID
+FfaPackDirectMessage (
+  OUT ARM_SXC_ARGS             *Request,
+  IN CONST DIRECT_MSG_ARGS_EX  *Message,
+  IN CONST FFA_WIRE_GUID       *WireGuid OPTIONAL
+  );
+
+STATIC EFI_GUID  mBenchmarkGuid = {
+  0x6d3b4d2a, 0x1f0e, 0x4a7c, { 0x9b, 0x5e, 0x21, 0x84, 0xc3, 0x6f, 0x70, 0x19 }
+};
+
+STATIC CONST FFA_EX_TRACE_SERVICE  mReplayServices[] = {
+  { NOTIFICATION_SERVICE_UUID, NotificationServiceHandle },
+};
+
+/**
+  Logs the average cost of one operation.
+
+  @param  Name        Name of the operation.
+  @param  StartTicks  Performance counter value before the first operation.
+  @param  EndTicks    Performance counter value after the last operation.
+
+**/
+STATIC
+VOID
+LogResult (
+  IN CONST CHAR8  *Name,
+  IN UINT64       StartTicks,
+  IN UINT64       EndTicks
+  )
+{
+  UINT64  Nanoseconds;
+
+  Nanoseconds = GetTimeInNanoSecond (EndTicks - StartTicks);
+  UT_LOG_INFO (
+    "%a: %ld ns/op over %d iterations\n",
+    Name,
+    DivU64x32 (Nanoseconds, BENCHMARK_ITERATIONS),
+    BENCHMARK_ITERATIONS
+    );
+}
+
+/**
+  Resets the SPMC model and the library state before each benchmark.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED  Always.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+ResetSpmc (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  MockSpmcResetAndInit ();
+  MockSpmcAddPartition (BENCHMARK_VM_ID, NULL);
+  MockSpmcAddPartition (BENCHMARK_SP_ID, NULL);
+  FfaExInvalidateServiceCache (NULL);
+  FfaExTraceReset ();
+  NotificationServiceInit ();
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Baseline: a bare ArmCallSvc answered by the model.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The benchmark ran.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  A call failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+BareCallBenchmark (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  ARM_SVC_ARGS  Args;
+  UINT64        Start;
+  UINTN         Index;
+
+  Start = GetPerformanceCounter ();
+  for (Index = 0; Index < BENCHMARK_ITERATIONS; Index++) {
+    ZeroMem (&Args, sizeof (Args));
+    Args.Arg0 = ARM_FID_FFA_NOTIFICATION_SET;
+    Args.Arg1 = ((UINT32)MOCK_SPMC_CALLER_ID << 16) | BENCHMARK_VM_ID;
+    Args.Arg3 = BIT0;
+    ArmCallSvc (&Args);
+    UT_ASSERT_EQUAL (Args.Arg0, ARM_FID_FFA_SUCCESS_AARCH32);
+  }
+
+  LogResult ("ArmCallSvc", Start, GetPerformanceCounter ());
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Traps the way ArmFfaLibEx did before the in-place trampolines: the request
+  is copied into a local block, and the whole block is copied out to a
+  separate response after the call.
+
+  @param  Request   The parameter registers.
+  @param  Response  Receives the result registers.
+
+**/
+STATIC
+VOID
+CopyInOutCall (
+  IN  ARM_SXC_ARGS  *Request,
+  OUT ARM_SXC_ARGS  *Response
+  )
+{
+  ARM_SXC_ARGS  LocalParams;
+
+  CopyMem (&LocalParams, Request, sizeof (ARM_SXC_ARGS));
+  ArmCallSvc ((ARM_SVC_ARGS *)&LocalParams);
+  CopyMem (Response, &LocalParams, sizeof (ARM_SXC_ARGS));
+}
+
+/**
+  FFA_NOTIFICATION_SET through the old path: two zeroed argument blocks and
+  a copy-in/copy-out call.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The benchmark ran.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  A call failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+CopyInOutX7Benchmark (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  ARM_SXC_ARGS  Request;
+  ARM_SXC_ARGS  Response;
+  UINT64        Start;
+  UINTN         Index;
+
+  Start = GetPerformanceCounter ();
+  for (Index = 0; Index < BENCHMARK_ITERATIONS; Index++) {
+    ZeroMem (&Request, sizeof (Request));
+    ZeroMem (&Response, sizeof (Response));
+    Request.Arg0 = ARM_FID_FFA_NOTIFICATION_SET;
+    Request.Arg1 = ((UINT32)MOCK_SPMC_CALLER_ID << 16) | BENCHMARK_VM_ID;
+    Request.Arg3 = BIT0;
+    CopyInOutCall (&Request, &Response);
+    UT_ASSERT_EQUAL (Response.Arg0, ARM_FID_FFA_SUCCESS_AARCH32);
+  }
+
+  LogResult ("Copy-in/copy-out call, x0-x7 ABI", Start, GetPerformanceCounter ());
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  FFA_NOTIFICATION_SET through FfaSvcCallX7, with only x0-x7 cleared.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The benchmark ran.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  A call failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+InPlaceX7Benchmark (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  ARM_SXC_ARGS  Args;
+  UINT64        Start;
+  UINTN         Index;
+
+  Start = GetPerformanceCounter ();
+  for (Index = 0; Index < BENCHMARK_ITERATIONS; Index++) {
+    ZeroMem (&Args, OFFSET_OF (ARM_SXC_ARGS, Arg8));
+    Args.Arg0 = ARM_FID_FFA_NOTIFICATION_SET;
+    Args.Arg1 = ((UINT32)MOCK_SPMC_CALLER_ID << 16) | BENCHMARK_VM_ID;
+    Args.Arg3 = BIT0;
+    FfaSvcCallX7 (&Args);
+    UT_ASSERT_EQUAL (Args.Arg0, ARM_FID_FFA_SUCCESS_AARCH32);
+  }
+
+  LogResult ("FfaSvcCallX7", Start, GetPerformanceCounter ());
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  FFA_MSG_SEND_DIRECT_REQ2 through the old path: two zeroed argument blocks
+  and a copy-in/copy-out call.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The benchmark ran.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  A call failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+CopyInOutX17Benchmark (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  ARM_SXC_ARGS  Request;
+  ARM_SXC_ARGS  Response;
+  UINT64        Start;
+  UINTN         Index;
+
+  Start = GetPerformanceCounter ();
+  for (Index = 0; Index < BENCHMARK_ITERATIONS; Index++) {
+    ZeroMem (&Request, sizeof (Request));
+    ZeroMem (&Response, sizeof (Response));
+    Request.Arg0 = ARM_FID_FFA_MSG_SEND_DIRECT_REQ2;
+    Request.Arg1 = ((UINT32)MOCK_SPMC_CALLER_ID << 16) | BENCHMARK_SP_ID;
+    Request.Arg4 = Index;
+    CopyInOutCall (&Request, &Response);
+    UT_ASSERT_EQUAL (Response.Arg0, ARM_FID_FFA_MSG_SEND_DIRECT_RESP2);
+  }
+
+  LogResult ("Copy-in/copy-out call, x0-x17 ABI", Start, GetPerformanceCounter ());
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  FFA_MSG_SEND_DIRECT_REQ2 through FfaSvcCallX17, on a single argument block.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The benchmark ran.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  A call failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+InPlaceX17Benchmark (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  ARM_SXC_ARGS  Args;
+  UINT64        Start;
+  UINTN         Index;
+
+  Start = GetPerformanceCounter ();
+  for (Index = 0; Index < BENCHMARK_ITERATIONS; Index++) {
+    ZeroMem (&Args, sizeof (Args));
+    Args.Arg0 = ARM_FID_FFA_MSG_SEND_DIRECT_REQ2;
+    Args.Arg1 = ((UINT32)MOCK_SPMC_CALLER_ID << 16) | BENCHMARK_SP_ID;
+    Args.Arg4 = Index;
+    FfaSvcCallX17 (&Args);
+    UT_ASSERT_EQUAL (Args.Arg0, ARM_FID_FFA_MSG_SEND_DIRECT_RESP2);
+  }
+
+  LogResult ("FfaSvcCallX17", Start, GetPerformanceCounter ());
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  FfaNotificationSet, an x0-x7 ABI.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The benchmark ran.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  A call failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+NotificationSetBenchmark (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINT64  Start;
+  UINTN   Index;
+
+  Start = GetPerformanceCounter ();
+  for (Index = 0; Index < BENCHMARK_ITERATIONS; Index++) {
+    UT_ASSERT_NOT_EFI_ERROR (FfaNotificationSet (BENCHMARK_VM_ID, 0, BIT0));
+  }
+
+  LogResult ("FfaNotificationSet", Start, GetPerformanceCounter ());
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  FfaMessageSendDirectReq2, an x0-x17 ABI.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The benchmark ran.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  A call failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DirectReq2Benchmark (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  DIRECT_MSG_ARGS_EX  Message;
+  UINT64              Start;
+  UINTN               Index;
+
+  ZeroMem (&Message, sizeof (Message));
+
+  Start = GetPerformanceCounter ();
+  for (Index = 0; Index < BENCHMARK_ITERATIONS; Index++) {
+    Message.Arg0 = Index;
+    UT_ASSERT_NOT_EFI_ERROR (FfaMessageSendDirectReq2 (BENCHMARK_SP_ID, &mBenchmarkGuid, &Message));
+  }
+
+  LogResult ("FfaMessageSendDirectReq2", Start, GetPerformanceCounter ());
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  FfaExDirectMsgSendReq2, the same ABI trapped on in place.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The benchmark ran.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  A call failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DirectMsgReq2Benchmark (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  FFA_WIRE_GUID      WireGuid;
+  FFA_EX_DIRECT_MSG  Message;
+  UINT64             Start;
+  UINTN              Index;
+
+  FfaExGuidToWireGuid (&mBenchmarkGuid, &WireGuid);
+  ZeroMem (&Message, sizeof (Message));
+
+  Start = GetPerformanceCounter ();
+  for (Index = 0; Index < BENCHMARK_ITERATIONS; Index++) {
+    FFA_EX_DIRECT_MSG_ARG (&Message, 0) = Index;
+    UT_ASSERT_NOT_EFI_ERROR (FfaExDirectMsgSendReq2 (BENCHMARK_SP_ID, &WireGuid, &Message));
+  }
+
+  LogResult ("FfaExDirectMsgSendReq2", Start, GetPerformanceCounter ());
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Packs and unpacks a FFA_MSG_SEND_DIRECT_REQ2 with FfaPackDirectMessage and
+  FfaUnpackDirectMessage, the marshalling FfaMessageSendDirectReq2 does for
+  DIRECT_MSG_ARGS_EX callers around every trap.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The benchmark ran.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The payload did not round trip.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+PackUnpackMarshalBenchmark (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  DIRECT_MSG_ARGS_EX  Message;
+  ARM_SXC_ARGS        Registers;
+  UINT64              Start;
+  UINTN               Index;
+
+  ZeroMem (&Message, sizeof (Message));
+  Message.FunctionId = ARM_FID_FFA_MSG_SEND_DIRECT_REQ2;
+
+  Start = GetPerformanceCounter ();
+  for (Index = 0; Index < BENCHMARK_ITERATIONS; Index++) {
+    Message.Arg0 = Index;
+    FfaPackDirectMessage (&Registers, &Message, NULL);
+    FfaUnpackDirectMessage (&Registers, &Message);
+  }
+
+  LogResult ("FfaPackDirectMessage/FfaUnpackDirectMessage", Start, GetPerformanceCounter ());
+  UT_ASSERT_EQUAL (Message.Arg0, BENCHMARK_ITERATIONS - 1);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Packs and unpacks a FFA_MSG_SEND_DIRECT_REQ2 through FfaExDirectMsgFromArgs
+  and FfaExDirectMsgToArgs, the cost left to DIRECT_MSG_ARGS_EX callers.
+  Callers using FFA_EX_DIRECT_MSG have nothing to marshal.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The benchmark ran.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The payload did not round trip.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+ShimMarshalBenchmark (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  DIRECT_MSG_ARGS_EX  Message;
+  FFA_EX_DIRECT_MSG   Registers;
+  UINT64              Start;
+  UINTN               Index;
+
+  ZeroMem (&Message, sizeof (Message));
+  Message.FunctionId = ARM_FID_FFA_MSG_SEND_DIRECT_REQ2;
+
+  Start = GetPerformanceCounter ();
+  for (Index = 0; Index < BENCHMARK_ITERATIONS; Index++) {
+    Message.Arg0 = Index;
+    FfaExDirectMsgFromArgs (&Message, &Registers);
+    FfaExDirectMsgToArgs (&Registers, &Message);
+  }
+
+  LogResult ("Register order shim marshalling", Start, GetPerformanceCounter ());
+  UT_ASSERT_EQUAL (Message.Arg0, BENCHMARK_ITERATIONS - 1);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  FfaExTraceReplay of a notification register/unregister pair through the
+  notification service.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The benchmark ran.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  A call failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+TraceReplayBenchmark (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC EFI_GUID      NotificationGuid = NOTIFICATION_SERVICE_UUID;
+  FFA_EX_TRACE_RECORD  Records[BENCHMARK_TRACE_RECORDS];
+  NotificationMapping  Mapping;
+  EFI_GUID             WireGuid;
+  UINTN                Count;
+  UINTN                Dispatched;
+  UINT64               Start;
+  UINTN                Index;
+
+  Mapping.Uint64      = 0;
+  Mapping.Bits.Id     = 1;
+  Mapping.Bits.Cookie = 0x55;
+
+  CopyGuid (&WireGuid, &NotificationGuid);
+  WireGuid.Data1 = SwapBytes32 (WireGuid.Data1);
+  WireGuid.Data2 = SwapBytes16 (WireGuid.Data2);
+  WireGuid.Data3 = SwapBytes16 (WireGuid.Data3);
+
+  //
+  // Synthesize the capture: two direct requests received by FFA_MSG_WAIT.
+  //
+  ZeroMem (Records, sizeof (Records));
+  for (Index = 0; Index < 2; Index++) {
+    Records[Index].Sequence      = (UINT32)Index + 1;
+    Records[Index].Request.Arg0  = ARM_FID_FFA_WAIT;
+    Records[Index].Response.Arg0 = ARM_FID_FFA_MSG_SEND_DIRECT_REQ2;
+    Records[Index].Response.Arg1 = ((UINT32)BENCHMARK_VM_ID << 16) | MOCK_SPMC_CALLER_ID;
+    CopyMem (&Records[Index].Response.Arg2, &WireGuid, sizeof (WireGuid));
+    Records[Index].Response.Arg10 = 1;
+    Records[Index].Response.Arg11 = Mapping.Uint64;
+  }
+
+  Records[0].Response.Arg9 = NOTIFICATION_OPCODE_REGISTER;
+  Records[1].Response.Arg9 = NOTIFICATION_OPCODE_UNREGISTER;
+  Count                    = 2;
+
+  Start = GetPerformanceCounter ();
+  for (Index = 0; Index < BENCHMARK_ITERATIONS; Index++) {
+    UT_ASSERT_NOT_EFI_ERROR (
+      FfaExTraceReplay (Records, Count, mReplayServices, ARRAY_SIZE (mReplayServices), &Dispatched)
+      );
+    UT_ASSERT_EQUAL (Dispatched, Count);
+  }
+
+  LogResult ("FfaExTraceReplay (2 records)", Start, GetPerformanceCounter ());
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initializes and runs the benchmarks.
+
+  @retval EFI_SUCCESS  The benchmarks ran.
+  @retval Others       The test framework could not be set up.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+UnitTestingEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      Suite;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_APP_NAME, UNIT_TEST_APP_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_APP_NAME, gEfiCallerBaseName, UNIT_TEST_APP_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (&Suite, Framework, "ArmFfaLibEx Benchmarks", "ArmFfaLibEx.Benchmark", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for ArmFfaLibEx Benchmarks\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (Suite, "Bare ArmCallSvc", "BareCall", BareCallBenchmark, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Copy-in/copy-out call, x0-x7 ABI", "CopyInOutX7", CopyInOutX7Benchmark, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "FfaSvcCallX7", "InPlaceX7", InPlaceX7Benchmark, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Copy-in/copy-out call, x0-x17 ABI", "CopyInOutX17", CopyInOutX17Benchmark, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "FfaSvcCallX17", "InPlaceX17", InPlaceX17Benchmark, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "FfaNotificationSet", "NotificationSet", NotificationSetBenchmark, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "FfaMessageSendDirectReq2", "DirectReq2", DirectReq2Benchmark, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "FfaExDirectMsgSendReq2", "DirectMsgReq2", DirectMsgReq2Benchmark, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Pack/unpack marshalling", "PackUnpackMarshal", PackUnpackMarshalBenchmark, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Register order shim marshalling", "ShimMarshal", ShimMarshalBenchmark, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "FfaExTraceReplay", "TraceReplay", TraceReplayBenchmark, ResetSpmc, NULL, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+
+  @param  argc  Unused.
+  @param  argv  Unused.
+
+  @retval 0  Always.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return UnitTestingEntry ();
+}
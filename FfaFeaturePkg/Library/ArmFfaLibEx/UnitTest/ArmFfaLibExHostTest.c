@@ -0,0 +1,2568 @@
+/** @file
+  Host based unit tests for ArmFfaLibEx.
+
+  Every FF-A call is answered by the SPMC model in MockSpmcLib, so these tests
+  exercise the library's register packing, error handling, feature snapshot,
+  partition discovery, service cache, indirect messaging, memory
+  transactions, call statistics and call trace without an SPMC.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/ArmFfaSvc.h>
+#include <IndustryStandard/ArmFfaPartInfo.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/ArmSvcLib.h>
+#include <Library/ArmSmcLib.h>
+#include <Library/ArmFfaLibEx.h>
+#include <Library/MockSpmcLib.h>
+#include <Library/NotificationServiceLib.h>
+#include <Library/TestServiceLib.h>
+#include <Library/UnitTestLib.h>
+#include <Guid/NotificationServiceFfa.h>
+#include <Guid/TestServiceFfa.h>
+
+#define UNIT_TEST_APP_NAME     "ArmFfaLibEx Host Unit Tests"
+#define UNIT_TEST_APP_VERSION  "1.0"
+
+//
+// Partition IDs modeled by the tests. The VM sends requests to the code
+// under test, the SP answers direct requests from it.
+//
+#define TEST_VM_ID  0x0001
+#define TEST_SP_ID  0x8002
+
+#define TEST_NOTIFICATION_ID      5
+#define TEST_NOTIFICATION_COOKIE  0x1234
+#define TEST_SERVICE_UUID_LO      0x1122334455667788ULL
+#define TEST_SERVICE_UUID_HI      0x99AABBCCDDEEFF00ULL
+
+#define TEST_TRACE_RECORDS  16
+
+//
+// Indirect message payload size, well above the 112 bytes of a direct
+// request.
+//
+#define TEST_INDIRECT_MSG_SIZE  1000
+
+//
+// Constituents of a memory region too scattered to fit one TX buffer.
+//
+#define TEST_MEM_CONSTITUENTS  2000
+
+//
+// Failed sends in a row, more than the SPMC model has handles.
+//
+#define TEST_MEM_ABORT_ROUNDS  20
+
+//
+// FFA_MEM_PERM_SET attributes: data access in bits[1:0], execute never in
+// bit[2].
+//
+#define TEST_PERM_RO_X   0x3
+#define TEST_PERM_RW_XN  0x5
+#define TEST_PERM_RO_XN  0x7
+
+//
+// Extra SPs added by the partition discovery tests, enough to need two
+// FFA_PARTITION_INFO_GET_REGS windows with the VM and SP above.
+//
+#define TEST_DISCOVERY_FIRST_SP_ID  0x8003
+#define TEST_DISCOVERY_SP_COUNT     5
+#define TEST_DISCOVERY_TOTAL        (TEST_DISCOVERY_SP_COUNT + 2)
+
+//
+// Interrupt IDs raised by the deferred interrupt tests.
+//
+#define TEST_INTERRUPT_ID(Index)  (32 + (Index))
+
+//
+// SP recording the service GUID of the requests it receives.
+//
+#define TEST_WIRE_SP_ID  0x8010
+
+//
+// FFA_NOTIFICATION_SET flags of a per-vCPU notification.
+#define TEST_PER_VCPU_FLAGS(VcpuId)  (BIT1 | ((UINT64)(VcpuId) << 16))
+
+//
+// Lists collected by the notification info drain handler.
+//
+typedef struct {
+  FFA_EX_NOTIFICATION_INFO    Lists[2 * FFA_EX_NOTIFICATION_INFO_MAX_LISTS];
+  UINTN                       Count;
+} TEST_NOTIFICATION_INFO_LOG;
+
+//
+// Run directly by the tests of what the constructor resolves.
+//
+RETURN_STATUS
+EFIAPI
+ArmFfaLibExConstructor (
+  VOID
+  );
+
+//
+// Thread ID register of ArmFfaLibExHost.inf, see ArmFfaLibExInternal.h.
+// Switching it switches the vCPU the test stands for.
+//
+UINTN
+FfaReadVcpuRegister (
+  VOID
+  );
+
+VOID
+FfaWriteVcpuRegister (
+  IN UINTN  Value
+  );
+
+STATIC EFI_GUID  mTestGuid = {
+  0x6d3b4d2a, 0x1f0e, 0x4a7c, { 0x9b, 0x5e, 0x21, 0x84, 0xc3, 0x6f, 0x70, 0x19 }
+};
+
+STATIC FFA_WIRE_GUID  mLastWireGuid;
+
+STATIC UINTN  mBatchLog[FFA_EX_BATCH_MAX_COMMANDS];
+STATIC UINTN  mBatchLogCount;
+
+STATIC CONST FFA_EX_TRACE_SERVICE  mReplayServices[] = {
+  { NOTIFICATION_SERVICE_UUID, NotificationServiceHandle },
+  { TEST_SERVICE_UUID,         TestServiceHandle         },
+};
+
+/**
+  Packs a service GUID into x2-x3 the way FF-A carries it on the wire.
+
+  @param  Guid  The service GUID.
+  @param  Args  The registers to update.
+
+**/
+STATIC
+VOID
+PackServiceGuid (
+  IN  CONST EFI_GUID  *Guid,
+  OUT ARM_SVC_ARGS    *Args
+  )
+{
+  EFI_GUID  WireGuid;
+
+  CopyGuid (&WireGuid, Guid);
+  WireGuid.Data1 = SwapBytes32 (WireGuid.Data1);
+  WireGuid.Data2 = SwapBytes16 (WireGuid.Data2);
+  WireGuid.Data3 = SwapBytes16 (WireGuid.Data3);
+  CopyMem (&Args->Arg2, &WireGuid, sizeof (WireGuid));
+}
+
+/**
+  Builds an FFA_MSG_SEND_DIRECT_REQ2 from the test VM to the code under test.
+
+  @param  Guid     The service GUID.
+  @param  Message  Receives the registers.
+
+**/
+STATIC
+VOID
+BuildVmRequest (
+  IN  CONST EFI_GUID  *Guid,
+  OUT ARM_SVC_ARGS    *Message
+  )
+{
+  ZeroMem (Message, sizeof (*Message));
+  Message->Arg0 = ARM_FID_FFA_MSG_SEND_DIRECT_REQ2;
+  Message->Arg1 = ((UINT32)TEST_VM_ID << 16) | MOCK_SPMC_CALLER_ID;
+  PackServiceGuid (Guid, Message);
+}
+
+/**
+  Resets the SPMC model and the library state before each test.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED  Always.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+ResetSpmc (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  MockSpmcResetAndInit ();
+  MockSpmcAddPartition (TEST_VM_ID, NULL);
+  MockSpmcAddPartition (TEST_SP_ID, NULL);
+  FfaExInvalidateServiceCache (NULL);
+  FfaExResetCallStats ();
+  FfaExTraceReset ();
+  NotificationServiceInit ();
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The version and partition ID are answered without trapping, each function
+  and feature ID traps once, on its first query.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+FeatureQueryTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN   CallCount;
+  UINT16  Major;
+  UINT16  Minor;
+  UINT16  PartitionId;
+  UINTN   Property;
+
+  CallCount = MockSpmcGetCallCount ();
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaExGetVersion (&Major, &Minor));
+  UT_ASSERT_EQUAL (Major, MOCK_SPMC_MAJOR_VERSION);
+  UT_ASSERT_EQUAL (Minor, MOCK_SPMC_MINOR_VERSION);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaExGetPartitionId (&PartitionId));
+  UT_ASSERT_EQUAL (PartitionId, MOCK_SPMC_CALLER_ID);
+  UT_ASSERT_FALSE (FfaExIsFeatureSupported (0x12345678));
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount (), CallCount);
+
+  UT_ASSERT_TRUE (FfaExIsFeatureSupported (ARM_FID_FFA_MSG_SEND_DIRECT_REQ2));
+  UT_ASSERT_TRUE (FfaExIsFeatureSupported (ARM_FID_FFA_NOTIFICATION_SET));
+  UT_ASSERT_FALSE (FfaExIsFeatureSupported (ARM_FID_FFA_NS_RES_INFO_GET));
+  UT_ASSERT_NOT_EFI_ERROR (FfaExGetFeatureProperty (ARM_FFA_FEATURE_ID_SCHEDULE_RECEIVER_INTERRUPT, &Property));
+  UT_ASSERT_EQUAL (Property, MOCK_SPMC_SRI_INTERRUPT_ID);
+  UT_ASSERT_STATUS_EQUAL (
+    FfaExGetFeatureProperty (ARM_FFA_FEATURE_ID_NOTIFICATION_PENDING_INTERRUPT, &Property),
+    EFI_UNSUPPORTED
+    );
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - CallCount, 5);
+
+  CallCount = MockSpmcGetCallCount ();
+  UT_ASSERT_TRUE (FfaExIsFeatureSupported (ARM_FID_FFA_MSG_SEND_DIRECT_REQ2));
+  UT_ASSERT_TRUE (FfaExIsFeatureSupported (ARM_FID_FFA_NOTIFICATION_SET));
+  UT_ASSERT_FALSE (FfaExIsFeatureSupported (ARM_FID_FFA_NS_RES_INFO_GET));
+  UT_ASSERT_NOT_EFI_ERROR (FfaExGetFeatureProperty (ARM_FFA_FEATURE_ID_SCHEDULE_RECEIVER_INTERRUPT, &Property));
+  UT_ASSERT_EQUAL (Property, MOCK_SPMC_SRI_INTERRUPT_ID);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount (), CallCount);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The partition ID is resolved once, by the constructor: a constructor that
+  cannot get it fails, and the calls carrying it never ask again.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+PartitionIdOnceTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINTN   Calls;
+  UINT16  PartitionId;
+
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaExGetPartitionId (&PartitionId));
+  UT_ASSERT_EQUAL (PartitionId, MOCK_SPMC_CALLER_ID);
+  UT_ASSERT_NOT_EFI_ERROR (FfaNotificationSet (TEST_VM_ID, 0, BIT1));
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+
+  MockSpmcInjectError (ARM_FID_FFA_ID_GET, ARM_FFA_RET_BUSY, 0);
+  UT_ASSERT_TRUE (RETURN_ERROR (ArmFfaLibExConstructor ()));
+
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_STATUS_EQUAL (FfaExGetPartitionId (&PartitionId), EFI_NOT_READY);
+  UT_ASSERT_STATUS_EQUAL (FfaExGetPartitionId (&PartitionId), EFI_NOT_READY);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount (), Calls);
+
+  UT_ASSERT_NOT_EFI_ERROR (ArmFfaLibExConstructor ());
+  UT_ASSERT_NOT_EFI_ERROR (FfaExGetPartitionId (&PartitionId));
+  UT_ASSERT_EQUAL (PartitionId, MOCK_SPMC_CALLER_ID);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A direct request round trips through the echoing SP, service GUID and all
+  fourteen implementation defined registers included.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DirectReq2EchoTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  DIRECT_MSG_ARGS_EX  Message;
+  UINTN               *Arg;
+  UINTN               Index;
+
+  ZeroMem (&Message, sizeof (Message));
+  Arg = &Message.Arg0;
+  for (Index = 0; Index < 14; Index++) {
+    Arg[Index] = 0xA0 + Index;
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaMessageSendDirectReq2 (TEST_SP_ID, &mTestGuid, &Message));
+
+  UT_ASSERT_EQUAL (Message.FunctionId, ARM_FID_FFA_MSG_SEND_DIRECT_RESP2);
+  UT_ASSERT_EQUAL (Message.SourceId, TEST_SP_ID);
+  UT_ASSERT_EQUAL (Message.DestinationId, MOCK_SPMC_CALLER_ID);
+  UT_ASSERT_TRUE (CompareGuid (&Message.ServiceGuid, &mTestGuid));
+  for (Index = 0; Index < 14; Index++) {
+    UT_ASSERT_EQUAL (Arg[Index], 0xA0 + Index);
+  }
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A direct request to a partition the SPMC does not know fails.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DirectReq2UnknownPartitionTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  DIRECT_MSG_ARGS_EX  Message;
+
+  ZeroMem (&Message, sizeof (Message));
+  UT_ASSERT_STATUS_EQUAL (
+    FfaMessageSendDirectReq2 (0x7FFF, &mTestGuid, &Message),
+    EFI_INVALID_PARAMETER
+    );
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Interrupts preempting a direct request are queued, and run once the
+  partition is idle, oldest first.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DeferredInterruptTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  DIRECT_MSG_ARGS_EX  Message;
+  DIRECT_MSG_ARGS_EX  Request;
+  CONST UINT32        *Handled;
+  UINTN               Index;
+
+  //
+  // The requests complete without running the handler.
+  //
+  for (Index = 0; Index < 2; Index++) {
+    MockSpmcRaiseInterrupt (ARM_FID_FFA_MSG_SEND_DIRECT_REQ2, TEST_INTERRUPT_ID (Index));
+    ZeroMem (&Message, sizeof (Message));
+    Message.Arg0 = Index;
+    UT_ASSERT_NOT_EFI_ERROR (FfaMessageSendDirectReq2 (TEST_SP_ID, &mTestGuid, &Message));
+    UT_ASSERT_EQUAL (Message.FunctionId, ARM_FID_FFA_MSG_SEND_DIRECT_RESP2);
+    UT_ASSERT_EQUAL (Message.Arg0, Index);
+  }
+
+  UT_ASSERT_EQUAL (MockSpmcGetHandledInterrupts (NULL), 0);
+
+  //
+  // An interrupt after the response was sent runs the queued ones first.
+  //
+  MockSpmcRaiseInterrupt (ARM_FID_FFA_MSG_SEND_DIRECT_RESP2, TEST_INTERRUPT_ID (2));
+  ZeroMem (&Message, sizeof (Message));
+  Message.SourceId      = MOCK_SPMC_CALLER_ID;
+  Message.DestinationId = TEST_VM_ID;
+  UT_ASSERT_NOT_EFI_ERROR (FfaMessageSendDirectResp2 (&Message, &Request));
+  UT_ASSERT_EQUAL (Request.FunctionId, ARM_FID_FFA_SUCCESS_AARCH32);
+  UT_ASSERT_EQUAL (MockSpmcGetHandledInterrupts (&Handled), 3);
+  for (Index = 0; Index < 3; Index++) {
+    UT_ASSERT_EQUAL (Handled[Index], TEST_INTERRUPT_ID (Index));
+  }
+
+  //
+  // FfaMessageWait catches up before blocking.
+  //
+  MockSpmcRaiseInterrupt (ARM_FID_FFA_MSG_SEND_DIRECT_REQ2, TEST_INTERRUPT_ID (3));
+  ZeroMem (&Message, sizeof (Message));
+  UT_ASSERT_NOT_EFI_ERROR (FfaMessageSendDirectReq2 (TEST_SP_ID, &mTestGuid, &Message));
+  UT_ASSERT_EQUAL (MockSpmcGetHandledInterrupts (NULL), 3);
+  UT_ASSERT_NOT_EFI_ERROR (FfaMessageWait (&Request));
+  UT_ASSERT_EQUAL (MockSpmcGetHandledInterrupts (&Handled), 4);
+  UT_ASSERT_EQUAL (Handled[3], TEST_INTERRUPT_ID (3));
+
+  //
+  // An interrupt while waiting is handled on the spot.
+  //
+  MockSpmcRaiseInterrupt (ARM_FID_FFA_WAIT, TEST_INTERRUPT_ID (4));
+  UT_ASSERT_NOT_EFI_ERROR (FfaMessageWait (&Request));
+  UT_ASSERT_EQUAL (Request.FunctionId, ARM_FID_FFA_SUCCESS_AARCH32);
+  UT_ASSERT_EQUAL (MockSpmcGetHandledInterrupts (&Handled), 5);
+  UT_ASSERT_EQUAL (Handled[4], TEST_INTERRUPT_ID (4));
+
+  UT_ASSERT_EQUAL (FfaExRunDeferredWork (), 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A partition that only ever idles by responding still runs the interrupts
+  queued while its own requests were pending, before it gets the next
+  request.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DeferredWorkAfterResponseTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  ARM_SVC_ARGS        Queued;
+  FFA_EX_DIRECT_MSG   Message;
+  DIRECT_MSG_ARGS_EX  Request;
+  DIRECT_MSG_ARGS_EX  Response;
+  CONST UINT32        *Handled;
+  UINTN               Index;
+
+  BuildVmRequest (&mTestGuid, &Queued);
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcQueueMessage (&Queued));
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcQueueMessage (&Queued));
+  UT_ASSERT_NOT_EFI_ERROR (FfaExDirectMsgWait (&Message));
+  UT_ASSERT_EQUAL (Message.FunctionId, ARM_FID_FFA_MSG_SEND_DIRECT_REQ2);
+
+  //
+  // Serving the request takes a request of its own, which is preempted.
+  //
+  MockSpmcRaiseInterrupt (ARM_FID_FFA_MSG_SEND_DIRECT_REQ2, TEST_INTERRUPT_ID (0));
+  ZeroMem (&Request, sizeof (Request));
+  UT_ASSERT_NOT_EFI_ERROR (FfaMessageSendDirectReq2 (TEST_SP_ID, &mTestGuid, &Request));
+  UT_ASSERT_EQUAL (MockSpmcGetHandledInterrupts (NULL), 0);
+
+  //
+  // The response hands back the next request with the queue drained.
+  //
+  Message.EndpointIds = FFA_EX_DIRECT_MSG_ENDPOINT_IDS (
+                          FFA_EX_DIRECT_MSG_DESTINATION_ID (&Message),
+                          FFA_EX_DIRECT_MSG_SOURCE_ID (&Message)
+                          );
+  UT_ASSERT_NOT_EFI_ERROR (FfaExDirectMsgSendResp2 (&Message));
+  UT_ASSERT_EQUAL (Message.FunctionId, ARM_FID_FFA_MSG_SEND_DIRECT_REQ2);
+  UT_ASSERT_EQUAL (MockSpmcGetHandledInterrupts (&Handled), 1);
+  UT_ASSERT_EQUAL (Handled[0], TEST_INTERRUPT_ID (0));
+
+  //
+  // The same holds for the DIRECT_MSG_ARGS_EX response.
+  //
+  for (Index = 1; Index < 3; Index++) {
+    MockSpmcRaiseInterrupt (ARM_FID_FFA_MSG_SEND_DIRECT_REQ2, TEST_INTERRUPT_ID (Index));
+    ZeroMem (&Request, sizeof (Request));
+    UT_ASSERT_NOT_EFI_ERROR (FfaMessageSendDirectReq2 (TEST_SP_ID, &mTestGuid, &Request));
+  }
+
+  UT_ASSERT_EQUAL (MockSpmcGetHandledInterrupts (NULL), 1);
+  ZeroMem (&Response, sizeof (Response));
+  Response.SourceId      = MOCK_SPMC_CALLER_ID;
+  Response.DestinationId = TEST_VM_ID;
+  UT_ASSERT_NOT_EFI_ERROR (FfaMessageSendDirectResp2 (&Response, &Request));
+  UT_ASSERT_EQUAL (MockSpmcGetHandledInterrupts (&Handled), 3);
+  for (Index = 1; Index < 3; Index++) {
+    UT_ASSERT_EQUAL (Handled[Index], TEST_INTERRUPT_ID (Index));
+  }
+
+  UT_ASSERT_EQUAL (FfaExRunDeferredWork (), 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A callee that yields or is preempted leaves the request in progress until
+  FFA_RUN resumes it, and the blocking request resumes it on its own.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+ResumableRequestTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  DIRECT_MSG_ARGS_EX  Message;
+  DIRECT_MSG_ARGS_EX  Response;
+  FFA_EX_DIRECT_REQ   Request;
+  UINTN               Calls;
+
+  //
+  // Two yields, then the response.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcPreemptPartition (TEST_SP_ID, ARM_FID_FFA_YIELD, 2));
+  ZeroMem (&Message, sizeof (Message));
+  Message.Arg0 = 0x1234;
+  UT_ASSERT_STATUS_EQUAL (FfaExDirectReq2Start (TEST_SP_ID, &mTestGuid, &Message, &Request), EFI_NOT_READY);
+  UT_ASSERT_TRUE (Request.Pending);
+  UT_ASSERT_EQUAL (Request.Target, (UINT32)TEST_SP_ID << 16);
+  UT_ASSERT_NOT_EQUAL (Request.Timeout, 0);
+
+  UT_ASSERT_STATUS_EQUAL (FfaExDirectReq2Resume (&Request, &Response), EFI_NOT_READY);
+  UT_ASSERT_TRUE (Request.Pending);
+  UT_ASSERT_NOT_EFI_ERROR (FfaExDirectReq2Resume (&Request, &Response));
+  UT_ASSERT_FALSE (Request.Pending);
+  UT_ASSERT_EQUAL (Response.FunctionId, ARM_FID_FFA_MSG_SEND_DIRECT_RESP2);
+  UT_ASSERT_EQUAL (Response.Arg0, 0x1234);
+  UT_ASSERT_TRUE (CompareGuid (&Response.ServiceGuid, &mTestGuid));
+
+  UT_ASSERT_STATUS_EQUAL (FfaExDirectReq2Resume (&Request, &Response), EFI_INVALID_PARAMETER);
+
+  //
+  // A preempted callee reports no timeout, and a request that is answered
+  // straight away completes in Start.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcPreemptPartition (TEST_SP_ID, ARM_FID_FFA_INTERRUPT, 1));
+  UT_ASSERT_STATUS_EQUAL (FfaExDirectReq2Start (TEST_SP_ID, &mTestGuid, &Message, &Request), EFI_NOT_READY);
+  UT_ASSERT_EQUAL (Request.Timeout, 0);
+  UT_ASSERT_EQUAL (MockSpmcGetHandledInterrupts (NULL), 0);
+  UT_ASSERT_NOT_EFI_ERROR (FfaExDirectReq2Resume (&Request, &Response));
+  UT_ASSERT_EQUAL (Response.Arg0, 0x1234);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaExDirectReq2Start (TEST_SP_ID, &mTestGuid, &Message, &Request));
+  UT_ASSERT_FALSE (Request.Pending);
+  UT_ASSERT_EQUAL (Message.Arg0, 0x1234);
+
+  //
+  // The blocking request resumes the callee until it responds.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcPreemptPartition (TEST_SP_ID, ARM_FID_FFA_YIELD, 3));
+  ZeroMem (&Message, sizeof (Message));
+  Message.Arg0 = 0x5678;
+  Calls        = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaMessageSendDirectReq2 (TEST_SP_ID, &mTestGuid, &Message));
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 4);
+  UT_ASSERT_EQUAL (Message.FunctionId, ARM_FID_FFA_MSG_SEND_DIRECT_RESP2);
+  UT_ASSERT_EQUAL (Message.Arg0, 0x5678);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Direct request handler of TEST_WIRE_SP_ID, records the service GUID as
+  received and responds with the payload.
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+STATIC
+VOID
+EFIAPI
+RecordWireGuidHandler (
+  IN OUT ARM_SVC_ARGS  *Args
+  )
+{
+  mLastWireGuid.Words[0] = Args->Arg2;
+  mLastWireGuid.Words[1] = Args->Arg3;
+
+  Args->Arg0 = ARM_FID_FFA_MSG_SEND_DIRECT_RESP2;
+  Args->Arg1 = ((Args->Arg1 & MAX_UINT16) << 16) | (Args->Arg1 >> 16);
+}
+
+/**
+  Wire GUIDs built at compile time match the converted GUIDs, go to the
+  registers as is and come back from FfaExMessageWaitWire unconverted.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+WireGuidTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC CONST EFI_GUID       TestServiceGuid         = TEST_SERVICE_UUID;
+  STATIC CONST EFI_GUID       NotificationServiceGuid = NOTIFICATION_SERVICE_UUID;
+  STATIC CONST FFA_WIRE_GUID  TestServiceWire         = TEST_SERVICE_WIRE_UUID;
+  STATIC CONST FFA_WIRE_GUID  NotificationServiceWire = NOTIFICATION_SERVICE_WIRE_UUID;
+  FFA_WIRE_GUID               WireGuid;
+  EFI_GUID                    Guid;
+  ARM_SVC_ARGS                Queued;
+  DIRECT_MSG_ARGS_EX          Message;
+
+  FfaExGuidToWireGuid (&TestServiceGuid, &WireGuid);
+  UT_ASSERT_TRUE (FFA_WIRE_GUID_EQUAL (&WireGuid, &TestServiceWire));
+  FfaExGuidToWireGuid (&NotificationServiceGuid, &WireGuid);
+  UT_ASSERT_TRUE (FFA_WIRE_GUID_EQUAL (&WireGuid, &NotificationServiceWire));
+  UT_ASSERT_FALSE (FFA_WIRE_GUID_EQUAL (&TestServiceWire, &NotificationServiceWire));
+
+  FfaExWireGuidToGuid (&TestServiceWire, &Guid);
+  UT_ASSERT_TRUE (CompareGuid (&Guid, &TestServiceGuid));
+
+  //
+  // Same registers as the ones a VM would send.
+  //
+  BuildVmRequest (&TestServiceGuid, &Queued);
+  UT_ASSERT_EQUAL (Queued.Arg2, TestServiceWire.Words[0]);
+  UT_ASSERT_EQUAL (Queued.Arg3, TestServiceWire.Words[1]);
+
+  //
+  // Sent as is.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcAddPartition (TEST_WIRE_SP_ID, RecordWireGuidHandler));
+  ZeroMem (&Message, sizeof (Message));
+  Message.Arg0  = 0x42;
+  Message.Arg13 = 0x43;
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMessageSendDirectReq2Wire (TEST_WIRE_SP_ID, &TestServiceWire, &Message));
+  UT_ASSERT_TRUE (FFA_WIRE_GUID_EQUAL (&mLastWireGuid, &TestServiceWire));
+  UT_ASSERT_EQUAL (Message.FunctionId, ARM_FID_FFA_MSG_SEND_DIRECT_RESP2);
+  UT_ASSERT_EQUAL (Message.SourceId, TEST_WIRE_SP_ID);
+  UT_ASSERT_EQUAL (Message.Arg0, 0x42);
+  UT_ASSERT_EQUAL (Message.Arg13, 0x43);
+  UT_ASSERT_TRUE (IsZeroGuid (&Message.ServiceGuid));
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMessageSendDirectReq2Wire (TEST_WIRE_SP_ID, NULL, &Message));
+  UT_ASSERT_EQUAL (mLastWireGuid.Words[0], 0);
+  UT_ASSERT_EQUAL (mLastWireGuid.Words[1], 0);
+
+  //
+  // Received as is, ready to route.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcQueueMessage (&Queued));
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMessageWaitWire (&Message, &WireGuid));
+  UT_ASSERT_EQUAL (Message.FunctionId, ARM_FID_FFA_MSG_SEND_DIRECT_REQ2);
+  UT_ASSERT_TRUE (FFA_WIRE_GUID_EQUAL (&WireGuid, &TestServiceWire));
+  UT_ASSERT_TRUE (IsZeroGuid (&Message.ServiceGuid));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Register order messages are sent and received in place, and convert to and
+  from DIRECT_MSG_ARGS_EX without loss.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+DirectMsgTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC CONST EFI_GUID       TestServiceGuid = TEST_SERVICE_UUID;
+  STATIC CONST FFA_WIRE_GUID  TestServiceWire = TEST_SERVICE_WIRE_UUID;
+  FFA_EX_DIRECT_MSG           Message;
+  FFA_EX_DIRECT_MSG           Converted;
+  DIRECT_MSG_ARGS_EX          Args;
+  ARM_SVC_ARGS                Queued;
+  UINTN                       *Arg;
+  UINTN                       Index;
+
+  //
+  // Request and response in the same buffer.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcAddPartition (TEST_WIRE_SP_ID, RecordWireGuidHandler));
+  ZeroMem (&Message, sizeof (Message));
+  for (Index = 0; Index < FFA_EX_DIRECT_MSG_PAYLOAD_COUNT; Index++) {
+    FFA_EX_DIRECT_MSG_ARG (&Message, Index) = 0xB0 + Index;
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaExDirectMsgSendReq2 (TEST_WIRE_SP_ID, &TestServiceWire, &Message));
+  UT_ASSERT_TRUE (FFA_WIRE_GUID_EQUAL (&mLastWireGuid, &TestServiceWire));
+  UT_ASSERT_EQUAL (Message.FunctionId, ARM_FID_FFA_MSG_SEND_DIRECT_RESP2);
+  UT_ASSERT_EQUAL (FFA_EX_DIRECT_MSG_SOURCE_ID (&Message), TEST_WIRE_SP_ID);
+  UT_ASSERT_EQUAL (FFA_EX_DIRECT_MSG_DESTINATION_ID (&Message), MOCK_SPMC_CALLER_ID);
+  for (Index = 0; Index < FFA_EX_DIRECT_MSG_PAYLOAD_COUNT; Index++) {
+    UT_ASSERT_EQUAL (FFA_EX_DIRECT_MSG_ARG (&Message, Index), 0xB0 + Index);
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaExDirectMsgSendReq2 (TEST_WIRE_SP_ID, NULL, &Message));
+  UT_ASSERT_EQUAL (mLastWireGuid.Words[0], 0);
+  UT_ASSERT_EQUAL (mLastWireGuid.Words[1], 0);
+
+  UT_ASSERT_STATUS_EQUAL (FfaExDirectMsgSendReq2 (0x7FFF, NULL, &Message), EFI_INVALID_PARAMETER);
+
+  //
+  // Receive a request, respond and receive the next one.
+  //
+  BuildVmRequest (&TestServiceGuid, &Queued);
+  Queued.Arg4 = 0x51;
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcQueueMessage (&Queued));
+  Queued.Arg4 = 0x52;
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcQueueMessage (&Queued));
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaExDirectMsgWait (&Message));
+  UT_ASSERT_EQUAL (Message.FunctionId, ARM_FID_FFA_MSG_SEND_DIRECT_REQ2);
+  UT_ASSERT_EQUAL (FFA_EX_DIRECT_MSG_SOURCE_ID (&Message), TEST_VM_ID);
+  UT_ASSERT_TRUE (FFA_WIRE_GUID_EQUAL (&Message.ServiceGuid, &TestServiceWire));
+  UT_ASSERT_EQUAL (FFA_EX_DIRECT_MSG_ARG (&Message, 0), 0x51);
+
+  Message.EndpointIds = FFA_EX_DIRECT_MSG_ENDPOINT_IDS (
+                          FFA_EX_DIRECT_MSG_DESTINATION_ID (&Message),
+                          FFA_EX_DIRECT_MSG_SOURCE_ID (&Message)
+                          );
+  UT_ASSERT_NOT_EFI_ERROR (FfaExDirectMsgSendResp2 (&Message));
+  UT_ASSERT_EQUAL (Message.FunctionId, ARM_FID_FFA_MSG_SEND_DIRECT_REQ2);
+  UT_ASSERT_EQUAL (FFA_EX_DIRECT_MSG_ARG (&Message, 0), 0x52);
+
+  //
+  // The shim for DIRECT_MSG_ARGS_EX callers converts both ways.
+  //
+  ZeroMem (&Args, sizeof (Args));
+  Args.FunctionId    = ARM_FID_FFA_MSG_SEND_DIRECT_REQ2;
+  Args.SourceId      = TEST_VM_ID;
+  Args.DestinationId = MOCK_SPMC_CALLER_ID;
+  CopyGuid (&Args.ServiceGuid, &TestServiceGuid);
+  Arg = &Args.Arg0;
+  for (Index = 0; Index < FFA_EX_DIRECT_MSG_PAYLOAD_COUNT; Index++) {
+    Arg[Index] = 0xC0 + Index;
+  }
+
+  FfaExDirectMsgFromArgs (&Args, &Converted);
+  UT_ASSERT_EQUAL (Converted.EndpointIds, FFA_EX_DIRECT_MSG_ENDPOINT_IDS (TEST_VM_ID, MOCK_SPMC_CALLER_ID));
+  UT_ASSERT_TRUE (FFA_WIRE_GUID_EQUAL (&Converted.ServiceGuid, &TestServiceWire));
+  for (Index = 0; Index < FFA_EX_DIRECT_MSG_PAYLOAD_COUNT; Index++) {
+    UT_ASSERT_EQUAL (FFA_EX_DIRECT_MSG_ARG (&Converted, Index), 0xC0 + Index);
+  }
+
+  FfaExDirectMsgToArgs (&Converted, &Args);
+  UT_ASSERT_EQUAL (Args.FunctionId, ARM_FID_FFA_MSG_SEND_DIRECT_REQ2);
+  UT_ASSERT_EQUAL (Args.SourceId, TEST_VM_ID);
+  UT_ASSERT_EQUAL (Args.DestinationId, MOCK_SPMC_CALLER_ID);
+  UT_ASSERT_TRUE (CompareGuid (&Args.ServiceGuid, &TestServiceGuid));
+  for (Index = 0; Index < FFA_EX_DIRECT_MSG_PAYLOAD_COUNT; Index++) {
+    UT_ASSERT_EQUAL (Arg[Index], 0xC0 + Index);
+  }
+
+  //
+  // v1 requests keep their payload in x2-x7.
+  //
+  Args.FunctionId = ARM_FID_FFA_MSG_SEND_DIRECT_REQ_AARCH64;
+  FfaExDirectMsgFromArgs (&Args, &Converted);
+  UT_ASSERT_EQUAL (Converted.ServiceGuid.Words[0], 0xC0);
+  UT_ASSERT_EQUAL (FFA_EX_DIRECT_MSG_ARG (&Converted, 3), 0xC5);
+  UT_ASSERT_EQUAL (FFA_EX_DIRECT_MSG_ARG (&Converted, 4), 0);
+
+  FfaExDirectMsgToArgs (&Converted, &Args);
+  UT_ASSERT_TRUE (IsZeroGuid (&Args.ServiceGuid));
+  UT_ASSERT_EQUAL (Args.Arg5, 0xC5);
+  UT_ASSERT_EQUAL (Args.Arg6, 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Service handler for the batch tests. Logs the command ID found in Arg1 and
+  returns the status found in Arg2.
+
+  @param  Request   The command.
+  @param  Response  The response.
+
+**/
+STATIC
+VOID
+BatchCommandHandler (
+  DIRECT_MSG_ARGS_EX  *Request,
+  DIRECT_MSG_ARGS_EX  *Response
+  )
+{
+  if (mBatchLogCount < ARRAY_SIZE (mBatchLog)) {
+    mBatchLog[mBatchLogCount++] = (Request->Arg0 == 0) ? Request->Arg1 : MAX_UINTN;
+  }
+
+  Response->Arg2 = Request->Arg2;
+}
+
+/**
+  A batch runs its commands in order through an unchanged handler and
+  returns the status of each one.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+BatchTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC CONST FFA_EX_BATCH_SERVICE  Service   = { BatchCommandHandler, 1, 2, 0 };
+  STATIC CONST UINTN                 First[]   = { 1 };
+  STATIC CONST UINTN                 Second[]  = { 2, 5 };
+  STATIC CONST UINTN                 Third[]   = { 3 };
+  STATIC CONST UINTN                 Invalid[] = { 0xFF };
+  STATIC CONST UINTN                 Full[12]  = { 0 };
+  DIRECT_MSG_ARGS_EX                 Request;
+  DIRECT_MSG_ARGS_EX                 Response;
+  UINTN                              Status;
+  UINTN                              Index;
+
+  FfaExBatchInit (&Request, 0);
+  UT_ASSERT_TRUE (FfaExIsBatchRequest (&Request));
+  UT_ASSERT_NOT_EFI_ERROR (FfaExBatchAdd (&Request, First, ARRAY_SIZE (First)));
+  UT_ASSERT_NOT_EFI_ERROR (FfaExBatchAdd (&Request, Second, ARRAY_SIZE (Second)));
+  UT_ASSERT_NOT_EFI_ERROR (FfaExBatchAdd (&Request, Third, ARRAY_SIZE (Third)));
+  UT_ASSERT_EQUAL (Request.Arg1, 1);
+  UT_ASSERT_EQUAL (Request.Arg3, 5);
+  UT_ASSERT_EQUAL (Request.Arg4, 3);
+  UT_ASSERT_STATUS_EQUAL (FfaExBatchAdd (&Request, Full, ARRAY_SIZE (Full)), EFI_BUFFER_TOO_SMALL);
+
+  //
+  // Commands run in order, each placed at Arg1 with Arg0 clear.
+  //
+  mBatchLogCount = 0;
+  UT_ASSERT_NOT_EFI_ERROR (FfaExBatchDispatch (&Service, &Request, &Response));
+  UT_ASSERT_EQUAL (mBatchLogCount, 3);
+  for (Index = 0; Index < 3; Index++) {
+    UT_ASSERT_EQUAL (mBatchLog[Index], Index + 1);
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaExBatchGetStatus (&Response, 0, &Status));
+  UT_ASSERT_EQUAL (Status, 0);
+  UT_ASSERT_NOT_EFI_ERROR (FfaExBatchGetStatus (&Response, 1, &Status));
+  UT_ASSERT_EQUAL (Status, 5);
+  UT_ASSERT_NOT_EFI_ERROR (FfaExBatchGetStatus (&Response, 2, &Status));
+  UT_ASSERT_EQUAL (Status, 0);
+  UT_ASSERT_STATUS_EQUAL (FfaExBatchGetStatus (&Response, 3, &Status), EFI_NOT_FOUND);
+
+  //
+  // Stop at the first failing command.
+  //
+  FfaExBatchInit (&Request, FFA_EX_BATCH_STOP_ON_ERROR);
+  UT_ASSERT_NOT_EFI_ERROR (FfaExBatchAdd (&Request, Second, ARRAY_SIZE (Second)));
+  UT_ASSERT_NOT_EFI_ERROR (FfaExBatchAdd (&Request, Third, ARRAY_SIZE (Third)));
+  mBatchLogCount = 0;
+  UT_ASSERT_NOT_EFI_ERROR (FfaExBatchDispatch (&Service, &Request, &Response));
+  UT_ASSERT_EQUAL (mBatchLogCount, 1);
+  UT_ASSERT_STATUS_EQUAL (FfaExBatchGetStatus (&Response, 1, &Status), EFI_NOT_FOUND);
+
+  //
+  // A malformed batch runs nothing.
+  //
+  Request.Arg0 &= ~(UINTN)0xF;
+  mBatchLogCount = 0;
+  UT_ASSERT_STATUS_EQUAL (FfaExBatchDispatch (&Service, &Request, &Response), EFI_INVALID_PARAMETER);
+  UT_ASSERT_EQUAL (mBatchLogCount, 0);
+  UT_ASSERT_STATUS_EQUAL (FfaExBatchGetStatus (&Response, 0, &Status), EFI_NOT_FOUND);
+
+  //
+  // The test service opts in, a nested batch is refused.
+  //
+  FfaExBatchInit (&Request, 0);
+  UT_ASSERT_NOT_EFI_ERROR (FfaExBatchAdd (&Request, Invalid, ARRAY_SIZE (Invalid)));
+  UT_ASSERT_NOT_EFI_ERROR (FfaExBatchAdd (&Request, Invalid, ARRAY_SIZE (Invalid)));
+  ZeroMem (&Response, sizeof (Response));
+  TestServiceHandle (&Request, &Response);
+  for (Index = 0; Index < 2; Index++) {
+    UT_ASSERT_NOT_EFI_ERROR (FfaExBatchGetStatus (&Response, Index, &Status));
+    UT_ASSERT_EQUAL (Status, (UINTN)TEST_STATUS_INVALID_PARAMETER);
+  }
+
+  Request.Arg2 = Request.Arg0;
+  TestServiceHandle (&Request, &Response);
+  UT_ASSERT_STATUS_EQUAL (FfaExBatchGetStatus (&Response, 0, &Status), EFI_NOT_FOUND);
+
+  Request.Arg0 = 0xFF;
+  TestServiceHandle (&Request, &Response);
+  UT_ASSERT_STATUS_EQUAL (FfaExBatchGetStatus (&Response, 0, &Status), EFI_UNSUPPORTED);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Adds the partitions used by the discovery tests, all implementing the test
+  service.
+
+**/
+STATIC
+VOID
+AddDiscoveryPartitions (
+  VOID
+  )
+{
+  UINT16  Index;
+
+  for (Index = 0; Index < TEST_DISCOVERY_SP_COUNT; Index++) {
+    MockSpmcAddPartition (TEST_DISCOVERY_FIRST_SP_ID + Index, NULL);
+    MockSpmcSetPartitionUuid (TEST_DISCOVERY_FIRST_SP_ID + Index, &mTestGuid);
+  }
+}
+
+/**
+  FfaPartitionInfoGetAllRegs walks every window with one trap each and fixes
+  up the UUID of every descriptor.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+PartitionInfoGetAllTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_FFA_PART_INFO_DESC  Descs[TEST_DISCOVERY_TOTAL + 1];
+  UINT32                  Count;
+  UINTN                   Calls;
+  UINTN                   Index;
+
+  AddDiscoveryPartitions ();
+
+  Count = ARRAY_SIZE (Descs);
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaPartitionInfoGetAllRegs (NULL, &Count, Descs));
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 2);
+  UT_ASSERT_EQUAL (Count, TEST_DISCOVERY_TOTAL);
+  UT_ASSERT_EQUAL (Descs[0].PartitionId, TEST_VM_ID);
+  UT_ASSERT_EQUAL (Descs[1].PartitionId, TEST_SP_ID);
+  for (Index = 2; Index < Count; Index++) {
+    UT_ASSERT_EQUAL (Descs[Index].PartitionId, TEST_DISCOVERY_FIRST_SP_ID + Index - 2);
+    UT_ASSERT_TRUE (CompareGuid ((EFI_GUID *)Descs[Index].PartitionUuid, &mTestGuid));
+  }
+
+  //
+  // Filtering on the service fits in a single window.
+  //
+  Count = ARRAY_SIZE (Descs);
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaPartitionInfoGetAllRegs (&mTestGuid, &Count, Descs));
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+  UT_ASSERT_EQUAL (Count, TEST_DISCOVERY_SP_COUNT);
+  UT_ASSERT_EQUAL (Descs[0].PartitionId, TEST_DISCOVERY_FIRST_SP_ID);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  FfaPartitionInfoGetAllRegs reports the count needed after a single trap.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+PartitionInfoGetAllTooSmallTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_FFA_PART_INFO_DESC  Descs[2];
+  UINT32                  Count;
+  UINTN                   Calls;
+
+  AddDiscoveryPartitions ();
+
+  Count = ARRAY_SIZE (Descs);
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_STATUS_EQUAL (FfaPartitionInfoGetAllRegs (NULL, &Count, Descs), EFI_BUFFER_TOO_SMALL);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+  UT_ASSERT_EQUAL (Count, TEST_DISCOVERY_TOTAL);
+
+  Count = 0;
+  UT_ASSERT_STATUS_EQUAL (FfaPartitionInfoGetAllRegs (NULL, &Count, NULL), EFI_BUFFER_TOO_SMALL);
+  UT_ASSERT_EQUAL (Count, TEST_DISCOVERY_TOTAL);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  FfaPartitionInfoGetAllRegs restarts the walk when the SPMC answers RETRY.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+PartitionInfoGetAllRetryTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  EFI_FFA_PART_INFO_DESC  Descs[TEST_DISCOVERY_TOTAL];
+  UINT32                  Count;
+  UINTN                   Calls;
+  UINT16                  Tag;
+
+  AddDiscoveryPartitions ();
+
+  //
+  // The second window is answered with RETRY, the walk restarts from 0.
+  //
+  MockSpmcInjectError (ARM_FID_FFA_PARTITION_INFO_GET_REGS, ARM_FFA_RET_RETRY, 1);
+  Count = ARRAY_SIZE (Descs);
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaPartitionInfoGetAllRegs (NULL, &Count, Descs));
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 4);
+  UT_ASSERT_EQUAL (Count, TEST_DISCOVERY_TOTAL);
+
+  //
+  // A partition added after the first window invalidates its tag.
+  //
+  Tag   = 0;
+  Count = ARRAY_SIZE (Descs);
+  UT_ASSERT_NOT_EFI_ERROR (FfaPartitionInfoGetRegs (NULL, 0, &Tag, &Count, Descs));
+  UT_ASSERT_EQUAL (Count, 5);
+  MockSpmcAddPartition (TEST_DISCOVERY_FIRST_SP_ID + TEST_DISCOVERY_SP_COUNT, NULL);
+  Count = ARRAY_SIZE (Descs);
+  UT_ASSERT_STATUS_EQUAL (FfaPartitionInfoGetRegs (NULL, 5, &Tag, &Count, Descs), EFI_NOT_READY);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  FfaExResolveService traps once per service and answers from the cache
+  until invalidated.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+ResolveServiceTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC EFI_GUID      UnknownGuid = {
+    0x0f1e2d3c, 0x4b5a, 0x6978, { 0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0 }
+  };
+  FFA_EX_SERVICE_INFO  Info;
+  UINTN                Calls;
+
+  MockSpmcSetPartitionUuid (TEST_SP_ID, &mTestGuid);
+
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaExResolveService (&mTestGuid, &Info));
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+  UT_ASSERT_EQUAL (Info.PartitionId, TEST_SP_ID);
+  UT_ASSERT_EQUAL (Info.ExecContextCount, 1);
+
+  ZeroMem (&Info, sizeof (Info));
+  UT_ASSERT_NOT_EFI_ERROR (FfaExResolveService (&mTestGuid, &Info));
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+  UT_ASSERT_EQUAL (Info.PartitionId, TEST_SP_ID);
+
+  //
+  // Unknown services are not cached.
+  //
+  UT_ASSERT_STATUS_EQUAL (FfaExResolveService (&UnknownGuid, &Info), EFI_NOT_FOUND);
+  UT_ASSERT_STATUS_EQUAL (FfaExResolveService (&UnknownGuid, &Info), EFI_NOT_FOUND);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 3);
+
+  //
+  // Once invalidated, the service is discovered again.
+  //
+  FfaExInvalidateServiceCache (&mTestGuid);
+  UT_ASSERT_NOT_EFI_ERROR (FfaExResolveService (&mTestGuid, &Info));
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 4);
+  UT_ASSERT_EQUAL (Info.PartitionId, TEST_SP_ID);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  FfaIndirectMsgPrepare/FfaIndirectMsgSend move a large payload in one trap.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+IndirectMsgSendTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC UINT8  Received[TEST_INDIRECT_MSG_SIZE];
+  UINT8         *Payload;
+  UINTN         MaxPayloadSize;
+  UINTN         Size;
+  UINTN         Calls;
+  UINTN         Index;
+  UINT16        SenderId;
+
+  //
+  // Probe FFA_MSG_SEND2 up front, so that only the send itself is counted.
+  //
+  UT_ASSERT_TRUE (FfaExIsFeatureSupported (ARM_FID_FFA_MSG_SEND2));
+
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaIndirectMsgPrepare (TEST_SP_ID, &mTestGuid, (VOID **)&Payload, &MaxPayloadSize));
+  UT_ASSERT_TRUE (MaxPayloadSize >= TEST_INDIRECT_MSG_SIZE);
+  for (Index = 0; Index < TEST_INDIRECT_MSG_SIZE; Index++) {
+    Payload[Index] = (UINT8)Index;
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaIndirectMsgSend (TEST_INDIRECT_MSG_SIZE, 0));
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+
+  Size = sizeof (Received);
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcGetIndirectMessage (TEST_SP_ID, &SenderId, Received, &Size));
+  UT_ASSERT_EQUAL (Size, TEST_INDIRECT_MSG_SIZE);
+  UT_ASSERT_EQUAL (SenderId, MOCK_SPMC_CALLER_ID);
+  for (Index = 0; Index < TEST_INDIRECT_MSG_SIZE; Index++) {
+    UT_ASSERT_EQUAL (Received[Index], (UINT8)Index);
+  }
+
+  //
+  // The receiver RX buffer is full until it is retrieved.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (FfaIndirectMsgPrepare (TEST_SP_ID, NULL, (VOID **)&Payload, &MaxPayloadSize));
+  UT_ASSERT_STATUS_EQUAL (FfaIndirectMsgSend (MaxPayloadSize + 1, 0), EFI_BAD_BUFFER_SIZE);
+  UT_ASSERT_NOT_EFI_ERROR (FfaIndirectMsgSend (16, FFA_EX_MSG_SEND2_FLAG_DELAY_SRI));
+  UT_ASSERT_STATUS_EQUAL (FfaIndirectMsgSend (16, 0), EFI_NOT_READY);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  FfaIndirectMsgReceive parses the RX buffer in place until released.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+IndirectMsgReceiveTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC UINT8  Sent[TEST_INDIRECT_MSG_SIZE];
+  CONST UINT8   *Payload;
+  UINTN         PayloadSize;
+  UINT16        SenderId;
+  EFI_GUID      ServiceGuid;
+
+  SetMem (Sent, sizeof (Sent), 0x5A);
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcDeliverIndirectMessage (TEST_SP_ID, &mTestGuid, Sent, sizeof (Sent)));
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaIndirectMsgReceive (&SenderId, &ServiceGuid, (CONST VOID **)&Payload, &PayloadSize));
+  UT_ASSERT_EQUAL (SenderId, TEST_SP_ID);
+  UT_ASSERT_TRUE (CompareGuid (&ServiceGuid, &mTestGuid));
+  UT_ASSERT_EQUAL (PayloadSize, sizeof (Sent));
+  UT_ASSERT_MEM_EQUAL (Payload, Sent, sizeof (Sent));
+
+  //
+  // A second message cannot be delivered before the RX buffer is released,
+  // and it can only be released once.
+  //
+  UT_ASSERT_STATUS_EQUAL (MockSpmcDeliverIndirectMessage (TEST_SP_ID, NULL, Sent, 1), EFI_NOT_READY);
+  UT_ASSERT_NOT_EFI_ERROR (FfaIndirectMsgRelease ());
+  UT_ASSERT_STATUS_EQUAL (FfaIndirectMsgRelease (), EFI_ACCESS_DENIED);
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcDeliverIndirectMessage (TEST_SP_ID, NULL, Sent, 1));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  FfaExMessageWaitRx folds the release of a held RX buffer into the wait, or
+  keeps it across the wait and the interrupts handled meanwhile.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+MessageWaitRxTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  DIRECT_MSG_ARGS_EX  Message;
+  CONST VOID          *Payload;
+  UINTN               PayloadSize;
+  UINT16              SenderId;
+  UINT8               Sent;
+  UINTN               Calls;
+
+  Sent = 0x5A;
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcDeliverIndirectMessage (TEST_SP_ID, NULL, &Sent, 1));
+  UT_ASSERT_NOT_EFI_ERROR (FfaIndirectMsgReceive (&SenderId, NULL, &Payload, &PayloadSize));
+
+  //
+  // One trap releases and waits.
+  //
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMessageWaitRx (&Message, TRUE));
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+  UT_ASSERT_EQUAL (Message.FunctionId, ARM_FID_FFA_SUCCESS_AARCH32);
+  UT_ASSERT_STATUS_EQUAL (FfaIndirectMsgRelease (), EFI_ACCESS_DENIED);
+
+  //
+  // A kept RX buffer survives the wait, and the FFA_MSG_WAIT ending an
+  // interrupt handled on the way.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcDeliverIndirectMessage (TEST_SP_ID, NULL, &Sent, 1));
+  UT_ASSERT_NOT_EFI_ERROR (FfaIndirectMsgReceive (&SenderId, NULL, &Payload, &PayloadSize));
+  MockSpmcRaiseInterrupt (ARM_FID_FFA_WAIT, TEST_INTERRUPT_ID (0));
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMessageWaitRx (&Message, FALSE));
+  UT_ASSERT_STATUS_EQUAL (MockSpmcDeliverIndirectMessage (TEST_SP_ID, NULL, &Sent, 1), EFI_NOT_READY);
+  UT_ASSERT_EQUAL (*(CONST UINT8 *)Payload, Sent);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaIndirectMsgRelease ());
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcDeliverIndirectMessage (TEST_SP_ID, NULL, &Sent, 1));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Notifications set by an SP are pending for the receiver until retrieved.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+NotificationSetGetTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINT64  Bitmap;
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaNotificationSet (TEST_VM_ID, 0, BIT3 | LShiftU64 (1, 40)));
+  UT_ASSERT_EQUAL (MockSpmcGetPendingNotifications (TEST_VM_ID, TRUE), BIT3 | LShiftU64 (1, 40));
+  UT_ASSERT_EQUAL (MockSpmcGetPendingNotifications (TEST_VM_ID, FALSE), 0);
+
+  UT_ASSERT_STATUS_EQUAL (FfaNotificationSet (0x7FFF, 0, BIT0), EFI_INVALID_PARAMETER);
+
+  //
+  // Nothing is pending for the caller itself.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (FfaNotificationGet (0, ARM_FFA_NOTIFICATION_FLAG_BITMAP_SP, &Bitmap));
+  UT_ASSERT_EQUAL (Bitmap, 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  FfaNotificationGetAll returns the SP and VM bitmaps from a single trap.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+NotificationGetAllTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  FFA_EX_NOTIFICATION_BITMAPS  Bitmaps;
+  ARM_SVC_ARGS                 Args;
+  UINTN                        Calls;
+
+  //
+  // One notification from the SP, one from the VM, both for the caller.
+  //
+  ZeroMem (&Args, sizeof (Args));
+  Args.Arg0 = ARM_FID_FFA_NOTIFICATION_SET;
+  Args.Arg1 = ((UINT32)TEST_SP_ID << 16) | MOCK_SPMC_CALLER_ID;
+  Args.Arg3 = BIT1;
+  ArmCallSvc (&Args);
+  UT_ASSERT_EQUAL (Args.Arg0, ARM_FID_FFA_SUCCESS_AARCH32);
+
+  ZeroMem (&Args, sizeof (Args));
+  Args.Arg0 = ARM_FID_FFA_NOTIFICATION_SET;
+  Args.Arg1 = ((UINT32)TEST_VM_ID << 16) | MOCK_SPMC_CALLER_ID;
+  Args.Arg4 = BIT2;
+  ArmCallSvc (&Args);
+  UT_ASSERT_EQUAL (Args.Arg0, ARM_FID_FFA_SUCCESS_AARCH32);
+
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (
+    FfaNotificationGetAll (
+      0,
+      ARM_FFA_NOTIFICATION_FLAG_BITMAP_SP | ARM_FFA_NOTIFICATION_FLAG_BITMAP_VM | ARM_FFA_NOTIFICATION_FLAG_BITMAP_HYP,
+      &Bitmaps
+      )
+    );
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+  UT_ASSERT_EQUAL (Bitmaps.SpBitmap, BIT1);
+  UT_ASSERT_EQUAL (Bitmaps.VmBitmap, LShiftU64 (BIT2, 32));
+  UT_ASSERT_EQUAL (Bitmaps.HypBitmap, 0);
+
+  //
+  // Both bitmaps were cleared by the retrieval.
+  //
+  UT_ASSERT_EQUAL (MockSpmcGetPendingNotifications (MOCK_SPMC_CALLER_ID, TRUE), 0);
+  UT_ASSERT_EQUAL (MockSpmcGetPendingNotifications (MOCK_SPMC_CALLER_ID, FALSE), 0);
+
+  UT_ASSERT_STATUS_EQUAL (FfaNotificationGetAll (0, 0, &Bitmaps), EFI_INVALID_PARAMETER);
+  UT_ASSERT_STATUS_EQUAL (FfaNotificationGetAll (0, BIT4, &Bitmaps), EFI_INVALID_PARAMETER);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Records a list reported by FfaNotificationInfoDrain.
+
+  @param  Info     The list.
+  @param  Context  The TEST_NOTIFICATION_INFO_LOG to append to.
+
+**/
+STATIC
+VOID
+EFIAPI
+LogNotificationInfo (
+  IN CONST FFA_EX_NOTIFICATION_INFO  *Info,
+  IN VOID                            *Context
+  )
+{
+  TEST_NOTIFICATION_INFO_LOG  *Log;
+
+  Log = (TEST_NOTIFICATION_INFO_LOG *)Context;
+  if (Log->Count < ARRAY_SIZE (Log->Lists)) {
+    CopyMem (&Log->Lists[Log->Count++], Info, sizeof (*Info));
+  }
+}
+
+/**
+  FfaNotificationInfoGet decodes the packed lists, global and per-vCPU.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+NotificationInfoGetTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  FFA_EX_NOTIFICATION_INFO  Info[FFA_EX_NOTIFICATION_INFO_MAX_LISTS];
+  UINTN                     InfoCount;
+  BOOLEAN                   MorePending;
+  UINTN                     Calls;
+  UINT16                    Vcpu;
+
+  //
+  // Nothing pending yet. A short buffer is refused before trapping.
+  //
+  InfoCount = 1;
+  Calls     = MockSpmcGetCallCount ();
+  UT_ASSERT_STATUS_EQUAL (FfaNotificationInfoGet (Info, &InfoCount, &MorePending), EFI_BUFFER_TOO_SMALL);
+  UT_ASSERT_EQUAL (InfoCount, FFA_EX_NOTIFICATION_INFO_MAX_LISTS);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount (), Calls);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaNotificationInfoGet (Info, &InfoCount, &MorePending));
+  UT_ASSERT_EQUAL (InfoCount, 0);
+  UT_ASSERT_FALSE (MorePending);
+
+  //
+  // Four vCPUs of the VM take two lists, the SP's global notification one.
+  //
+  for (Vcpu = 0; Vcpu < 4; Vcpu++) {
+    UT_ASSERT_NOT_EFI_ERROR (FfaNotificationSet (TEST_VM_ID, TEST_PER_VCPU_FLAGS (Vcpu), BIT0));
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaNotificationSet (TEST_SP_ID, 0, BIT0));
+
+  InfoCount = ARRAY_SIZE (Info);
+  UT_ASSERT_NOT_EFI_ERROR (FfaNotificationInfoGet (Info, &InfoCount, &MorePending));
+  UT_ASSERT_EQUAL (InfoCount, 3);
+  UT_ASSERT_FALSE (MorePending);
+
+  UT_ASSERT_EQUAL (Info[0].PartitionId, TEST_VM_ID);
+  UT_ASSERT_EQUAL (Info[0].VcpuCount, 3);
+  UT_ASSERT_EQUAL (Info[0].VcpuIds[0], 0);
+  UT_ASSERT_EQUAL (Info[0].VcpuIds[1], 1);
+  UT_ASSERT_EQUAL (Info[0].VcpuIds[2], 2);
+  UT_ASSERT_EQUAL (Info[1].PartitionId, TEST_VM_ID);
+  UT_ASSERT_EQUAL (Info[1].VcpuCount, 1);
+  UT_ASSERT_EQUAL (Info[1].VcpuIds[0], 3);
+  UT_ASSERT_EQUAL (Info[2].PartitionId, TEST_SP_ID);
+  UT_ASSERT_EQUAL (Info[2].VcpuCount, 0);
+
+  //
+  // Reported lists are not reported again.
+  //
+  InfoCount = ARRAY_SIZE (Info);
+  UT_ASSERT_NOT_EFI_ERROR (FfaNotificationInfoGet (Info, &InfoCount, &MorePending));
+  UT_ASSERT_EQUAL (InfoCount, 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  FfaNotificationInfoDrain follows the more pending flag with the minimum
+  number of calls.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+NotificationInfoDrainTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC TEST_NOTIFICATION_INFO_LOG  Log;
+  UINTN                              ListCount;
+  UINTN                              Calls;
+  UINT16                             PartitionId;
+  UINT16                             Vcpu;
+
+  AddDiscoveryPartitions ();
+
+  //
+  // The VM's global notification and five SPs with three vCPUs each need 21
+  // IDs. The last vCPU of the last SP spills into a second call, in a list of
+  // its own.
+  //
+  for (PartitionId = TEST_DISCOVERY_FIRST_SP_ID; PartitionId < TEST_DISCOVERY_FIRST_SP_ID + TEST_DISCOVERY_SP_COUNT; PartitionId++) {
+    for (Vcpu = 0; Vcpu < 3; Vcpu++) {
+      UT_ASSERT_NOT_EFI_ERROR (FfaNotificationSet (PartitionId, TEST_PER_VCPU_FLAGS (Vcpu), BIT0));
+    }
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaNotificationSet (TEST_VM_ID, 0, BIT0));
+
+  ZeroMem (&Log, sizeof (Log));
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaNotificationInfoDrain (LogNotificationInfo, &Log, &ListCount));
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 2);
+  UT_ASSERT_EQUAL (ListCount, TEST_DISCOVERY_SP_COUNT + 2);
+  UT_ASSERT_EQUAL (Log.Count, ListCount);
+  UT_ASSERT_EQUAL (Log.Lists[0].PartitionId, TEST_VM_ID);
+  UT_ASSERT_EQUAL (Log.Lists[0].VcpuCount, 0);
+  UT_ASSERT_EQUAL (Log.Lists[1].PartitionId, TEST_DISCOVERY_FIRST_SP_ID);
+  UT_ASSERT_EQUAL (Log.Lists[1].VcpuCount, 3);
+  UT_ASSERT_EQUAL (Log.Lists[ListCount - 1].PartitionId, TEST_DISCOVERY_FIRST_SP_ID + TEST_DISCOVERY_SP_COUNT - 1);
+  UT_ASSERT_EQUAL (Log.Lists[ListCount - 1].VcpuCount, 1);
+  UT_ASSERT_EQUAL (Log.Lists[ListCount - 1].VcpuIds[0], 2);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Shared memory gets a handle that can be reclaimed exactly once.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+MemShareReclaimTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINT64  Handle;
+  UINT32  TotalLength;
+  UINT32  FragmentLength;
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemShareRxTx (0x80, 0x80, &Handle));
+  UT_ASSERT_NOT_EQUAL (Handle, 0);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemRetrieveReqRxTx (0x80, 0x80, &TotalLength, &FragmentLength));
+  UT_ASSERT_EQUAL (TotalLength, 0x80);
+  UT_ASSERT_EQUAL (FragmentLength, 0x80);
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemRelinquish ());
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemReclaim (Handle, 0));
+  UT_ASSERT_STATUS_EQUAL (FfaMemReclaim (Handle, 0), EFI_INVALID_PARAMETER);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Fills a scattered memory region: every constituent is one page more than
+  the previous one, on a distinct address.
+
+  @param  Constituents  Receives TEST_MEM_CONSTITUENTS constituents.
+
+  @retval The total page count.
+**/
+STATIC
+UINT32
+BuildScatteredRegion (
+  OUT FFA_EX_MEM_CONSTITUENT_DESC  *Constituents
+  )
+{
+  UINT32  Index;
+  UINT32  PageCount;
+
+  PageCount = 0;
+  for (Index = 0; Index < TEST_MEM_CONSTITUENTS; Index++) {
+    Constituents[Index].Address   = 0x80000000ULL + (UINT64)Index * SIZE_2MB;
+    Constituents[Index].PageCount = Index % 4 + 1;
+    Constituents[Index].Reserved  = 0;
+    PageCount                    += Index % 4 + 1;
+  }
+
+  return PageCount;
+}
+
+/**
+  A descriptor larger than the TX buffer is streamed with FFA_MEM_FRAG_TX, one
+  trap per fragment, and reassembles to what the builder was given.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+MemTransactionFragmentedTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC FFA_EX_MEM_CONSTITUENT_DESC  Constituents[TEST_MEM_CONSTITUENTS];
+  FFA_EX_MEM_TRANSACTION              Transaction;
+  CONST FFA_EX_MEM_TRANSACTION_DESC   *Desc;
+  CONST FFA_EX_MEM_ACCESS_DESC        *Access;
+  CONST FFA_EX_MEM_COMPOSITE_DESC     *Composite;
+  CONST VOID                          *Descriptor;
+  VOID                                *TxBuffer;
+  VOID                                *RxBuffer;
+  UINTN                               BufferSize;
+  UINTN                               FirstCount;
+  UINTN                               PerFragment;
+  UINTN                               Calls;
+  UINT32                              PageCount;
+  UINT32                              Length;
+  UINT64                              Handle;
+
+  PageCount = BuildScatteredRegion (Constituents);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMemTransactionInit (&Transaction, FFA_EX_MEM_ATTR_NORMAL_WB_INNER_SHAREABLE, 0, 0x77));
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMemTransactionAddReceiver (&Transaction, TEST_SP_ID, FFA_EX_MEM_PERM_RW, 0));
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMemTransactionAddReceiver (&Transaction, TEST_VM_ID, FFA_EX_MEM_PERM_RO, 0));
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMemTransactionSetConstituents (&Transaction, Constituents, TEST_MEM_CONSTITUENTS));
+
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMemTransactionSend (&Transaction, FfaExMemTypeShare, &Handle));
+  UT_ASSERT_NOT_EQUAL (Handle, 0);
+
+  //
+  // The first fragment carries the header, both receivers and the composite
+  // descriptor, every other one a TX buffer worth of constituents.
+  //
+  MockSpmcGetRxTxBuffers (&TxBuffer, &RxBuffer, &BufferSize);
+  FirstCount = (BufferSize - sizeof (*Desc) - 2 * sizeof (*Access) - sizeof (*Composite)) /
+               sizeof (FFA_EX_MEM_CONSTITUENT_DESC);
+  PerFragment = BufferSize / sizeof (FFA_EX_MEM_CONSTITUENT_DESC);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1 + (TEST_MEM_CONSTITUENTS - FirstCount + PerFragment - 1) / PerFragment);
+
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcGetMemTransaction (Handle, &Descriptor, &Length));
+  UT_ASSERT_EQUAL (Length, sizeof (*Desc) + 2 * sizeof (*Access) + sizeof (*Composite) + sizeof (Constituents));
+
+  Desc = Descriptor;
+  UT_ASSERT_EQUAL (Desc->SenderId, MOCK_SPMC_CALLER_ID);
+  UT_ASSERT_EQUAL (Desc->Attributes, FFA_EX_MEM_ATTR_NORMAL_WB_INNER_SHAREABLE);
+  UT_ASSERT_EQUAL (Desc->Tag, 0x77);
+  UT_ASSERT_EQUAL (Desc->MemAccessDescCount, 2);
+
+  Access = (CONST FFA_EX_MEM_ACCESS_DESC *)((CONST UINT8 *)Desc + Desc->MemAccessDescOffset);
+  UT_ASSERT_EQUAL (Access[0].ReceiverId, TEST_SP_ID);
+  UT_ASSERT_EQUAL (Access[0].Permissions, FFA_EX_MEM_PERM_RW);
+  UT_ASSERT_EQUAL (Access[1].ReceiverId, TEST_VM_ID);
+  UT_ASSERT_EQUAL (Access[1].Permissions, FFA_EX_MEM_PERM_RO);
+  UT_ASSERT_EQUAL (Access[0].CompositeOffset, Access[1].CompositeOffset);
+
+  Composite = (CONST FFA_EX_MEM_COMPOSITE_DESC *)((CONST UINT8 *)Desc + Access[0].CompositeOffset);
+  UT_ASSERT_EQUAL (Composite->TotalPageCount, PageCount);
+  UT_ASSERT_EQUAL (Composite->AddressRangeCount, TEST_MEM_CONSTITUENTS);
+  UT_ASSERT_MEM_EQUAL (Composite + 1, Constituents, sizeof (Constituents));
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemReclaim (Handle, 0));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The builder rejects incomplete transactions, and an error on a later
+  fragment fails the whole transaction.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+MemTransactionErrorsTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC FFA_EX_MEM_CONSTITUENT_DESC  Constituents[TEST_MEM_CONSTITUENTS];
+  FFA_EX_MEM_TRANSACTION              Transaction;
+  UINTN                               Calls;
+  UINT64                              Handle;
+
+  BuildScatteredRegion (Constituents);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMemTransactionInit (&Transaction, FFA_EX_MEM_ATTR_NORMAL_WB_INNER_SHAREABLE, 0, 0));
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMemTransactionSetConstituents (&Transaction, Constituents, TEST_MEM_CONSTITUENTS));
+  UT_ASSERT_STATUS_EQUAL (FfaExMemTransactionSend (&Transaction, FfaExMemTypeLend, &Handle), EFI_INVALID_PARAMETER);
+
+  Constituents[1].PageCount = 0;
+  UT_ASSERT_STATUS_EQUAL (FfaExMemTransactionSetConstituents (&Transaction, Constituents, TEST_MEM_CONSTITUENTS), EFI_INVALID_PARAMETER);
+  Constituents[1].PageCount = 1;
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMemTransactionAddReceiver (&Transaction, TEST_SP_ID, FFA_EX_MEM_PERM_RW, 0));
+  MockSpmcInjectError (ARM_FID_FFA_MEM_FRAG_TX, ARM_FFA_RET_NO_MEMORY, 1);
+
+  //
+  // The transaction, the fragment that failed and the reclaim aborting it.
+  //
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_STATUS_EQUAL (FfaExMemTransactionSend (&Transaction, FfaExMemTypeLend, &Handle), EFI_OUT_OF_RESOURCES);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 4);
+  UT_ASSERT_EQUAL (Handle, 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A transaction failing on its second FFA_MEM_FRAG_TX is reclaimed, so that
+  failed sends do not use up the handles of the SPMC.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+MemTransactionAbortTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC FFA_EX_MEM_CONSTITUENT_DESC  Constituents[TEST_MEM_CONSTITUENTS];
+  FFA_EX_MEM_TRANSACTION              Transaction;
+  UINT64                              Handle;
+  UINTN                               Round;
+
+  BuildScatteredRegion (Constituents);
+
+  for (Round = 0; Round < TEST_MEM_ABORT_ROUNDS; Round++) {
+    UT_ASSERT_NOT_EFI_ERROR (FfaExMemTransactionInit (&Transaction, FFA_EX_MEM_ATTR_NORMAL_WB_INNER_SHAREABLE, 0, 0));
+    UT_ASSERT_NOT_EFI_ERROR (FfaExMemTransactionAddReceiver (&Transaction, TEST_SP_ID, FFA_EX_MEM_PERM_RW, 0));
+    UT_ASSERT_NOT_EFI_ERROR (FfaExMemTransactionSetConstituents (&Transaction, Constituents, TEST_MEM_CONSTITUENTS));
+
+    MockSpmcInjectError (ARM_FID_FFA_MEM_FRAG_TX, ARM_FFA_RET_DENIED, 1);
+    UT_ASSERT_STATUS_EQUAL (FfaExMemTransactionSend (&Transaction, FfaExMemTypeShare, &Handle), EFI_ACCESS_DENIED);
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMemTransactionInit (&Transaction, FFA_EX_MEM_ATTR_NORMAL_WB_INNER_SHAREABLE, 0, 0));
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMemTransactionAddReceiver (&Transaction, TEST_SP_ID, FFA_EX_MEM_PERM_RW, 0));
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMemTransactionSetConstituents (&Transaction, Constituents, TEST_MEM_CONSTITUENTS));
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMemTransactionSend (&Transaction, FfaExMemTypeShare, &Handle));
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemReclaim (Handle, 0));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Shares a scattered memory region with the code under test itself, so that
+  it can be retrieved.
+
+  @param  Constituents  Receives TEST_MEM_CONSTITUENTS constituents.
+  @param  Handle        Receives the handle of the region.
+  @param  Calls         Receives the number of traps the share took.
+
+  @retval EFI_SUCCESS  The region was shared.
+  @retval Others       The builder failed.
+**/
+STATIC
+EFI_STATUS
+ShareScatteredRegion (
+  OUT FFA_EX_MEM_CONSTITUENT_DESC  *Constituents,
+  OUT UINT64                       *Handle,
+  OUT UINTN                        *Calls
+  )
+{
+  EFI_STATUS              Status;
+  FFA_EX_MEM_TRANSACTION  Transaction;
+
+  BuildScatteredRegion (Constituents);
+
+  Status = FfaExMemTransactionInit (&Transaction, FFA_EX_MEM_ATTR_NORMAL_WB_INNER_SHAREABLE, 0, 0);
+  if (!EFI_ERROR (Status)) {
+    Status = FfaExMemTransactionAddReceiver (&Transaction, MOCK_SPMC_CALLER_ID, FFA_EX_MEM_PERM_RW, 0);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = FfaExMemTransactionSetConstituents (&Transaction, Constituents, TEST_MEM_CONSTITUENTS);
+  }
+
+  *Calls = MockSpmcGetCallCount ();
+  if (!EFI_ERROR (Status)) {
+    Status = FfaExMemTransactionSend (&Transaction, FfaExMemTypeShare, Handle);
+  }
+
+  *Calls = MockSpmcGetCallCount () - *Calls;
+  return Status;
+}
+
+typedef struct {
+  CONST FFA_EX_MEM_CONSTITUENT_DESC    *Expected;
+  UINT32                               Seen;
+  UINT32                               Calls;
+} TEST_RETRIEVE_CONTEXT;
+
+/**
+  Checks retrieved constituents against the shared ones, in order.
+
+  @param  Constituents      Constituents of the current fragment.
+  @param  ConstituentCount  Number of entries in Constituents.
+  @param  Context           A TEST_RETRIEVE_CONTEXT.
+
+  @retval EFI_SUCCESS    The constituents match.
+  @retval EFI_CRC_ERROR  A constituent differs from the shared one.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+CheckRetrievedConstituents (
+  IN CONST FFA_EX_MEM_CONSTITUENT_DESC  *Constituents,
+  IN UINT32                             ConstituentCount,
+  IN VOID                               *Context
+  )
+{
+  TEST_RETRIEVE_CONTEXT  *Retrieve;
+
+  Retrieve = Context;
+  if ((Retrieve->Seen + ConstituentCount > TEST_MEM_CONSTITUENTS) ||
+      (CompareMem (Constituents, &Retrieve->Expected[Retrieve->Seen], ConstituentCount * sizeof (*Constituents)) != 0))
+  {
+    return EFI_CRC_ERROR;
+  }
+
+  Retrieve->Seen += ConstituentCount;
+  Retrieve->Calls++;
+  return EFI_SUCCESS;
+}
+
+/**
+  A retrieve response larger than the RX buffer is pulled with
+  FFA_MEM_FRAG_RX, its constituents handed over as each fragment arrives.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+MemRetrieveStreamedTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC FFA_EX_MEM_CONSTITUENT_DESC  Constituents[TEST_MEM_CONSTITUENTS];
+  TEST_RETRIEVE_CONTEXT               Retrieve;
+  UINTN                               ShareCalls;
+  UINTN                               Calls;
+  UINT64                              Handle;
+
+  UT_ASSERT_NOT_EFI_ERROR (ShareScatteredRegion (Constituents, &Handle, &ShareCalls));
+  UT_ASSERT_TRUE (ShareCalls > 1);
+
+  ZeroMem (&Retrieve, sizeof (Retrieve));
+  Retrieve.Expected = Constituents;
+
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMemRetrieve (Handle, MOCK_SPMC_CALLER_ID, FFA_EX_MEM_PERM_RW, CheckRetrievedConstituents, &Retrieve, NULL, NULL));
+  UT_ASSERT_EQUAL (Retrieve.Seen, TEST_MEM_CONSTITUENTS);
+
+  //
+  // One handler call and one trap per fragment, plus FFA_RX_RELEASE.
+  //
+  UT_ASSERT_EQUAL (Retrieve.Calls, ShareCalls);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, ShareCalls + 1);
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcDeliverIndirectMessage (TEST_SP_ID, NULL, &Handle, sizeof (Handle)));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A single range shared with FfaExMemShareSingle is retrieved whole by
+  FfaExMemRetrieveSingle and relinquished with FfaExMemRelinquish. A region of
+  several ranges, or one that fails part way, is relinquished and refused.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+MemSingleRegionTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC FFA_EX_MEM_CONSTITUENT_DESC  Constituents[TEST_MEM_CONSTITUENTS];
+  STATIC UINT8                        Region[2 * SIZE_4KB];
+  FFA_EX_MEM_RELINQUISH_DESC          *Desc;
+  VOID                                *TxBuffer;
+  VOID                                *RxBuffer;
+  UINTN                               BufferSize;
+  UINTN                               Calls;
+  UINT64                              Handle;
+  UINT64                              Base;
+  UINT64                              Size;
+
+  MockSpmcGetRxTxBuffers (&TxBuffer, &RxBuffer, &BufferSize);
+  Desc = TxBuffer;
+
+  UT_ASSERT_STATUS_EQUAL (FfaExMemShareSingle (MOCK_SPMC_CALLER_ID, Region, 0, &Handle), EFI_INVALID_PARAMETER);
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMemShareSingle (MOCK_SPMC_CALLER_ID, Region, 2, &Handle));
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMemRetrieveSingle (Handle, MOCK_SPMC_CALLER_ID, &Base, &Size));
+  UT_ASSERT_EQUAL (Base, (UINTN)Region);
+  UT_ASSERT_EQUAL (Size, sizeof (Region));
+
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMemRelinquish (Handle));
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+  UT_ASSERT_EQUAL (Desc->Handle, Handle);
+  UT_ASSERT_EQUAL (Desc->EndpointCount, 1);
+  UT_ASSERT_EQUAL (Desc->EndpointId, MOCK_SPMC_CALLER_ID);
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemReclaim (Handle, 0));
+
+  UT_ASSERT_NOT_EFI_ERROR (ShareScatteredRegion (Constituents, &Handle, &Calls));
+  UT_ASSERT_STATUS_EQUAL (FfaExMemRetrieveSingle (Handle, MOCK_SPMC_CALLER_ID, &Base, &Size), EFI_UNSUPPORTED);
+  UT_ASSERT_EQUAL (Desc->Handle, Handle);
+
+  //
+  // A failure on a later fragment releases the region as well: the retrieve
+  // request, the failing FFA_MEM_FRAG_RX, FFA_RX_RELEASE and the relinquish.
+  //
+  ZeroMem (TxBuffer, BufferSize);
+  MockSpmcInjectError (ARM_FID_FFA_MEM_FRAG_RX, ARM_FFA_RET_ABORTED, 0);
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_STATUS_EQUAL (FfaExMemRetrieveSingle (Handle, MOCK_SPMC_CALLER_ID, &Base, &Size), EFI_ABORTED);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 4);
+  UT_ASSERT_EQUAL (Desc->Handle, Handle);
+  UT_ASSERT_EQUAL (Desc->EndpointId, MOCK_SPMC_CALLER_ID);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The retrieve response is reassembled into a contiguous copy only when the
+  caller passes a buffer. A too small buffer fails the retrieve once the
+  size is known, and the region is relinquished.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+MemRetrieveCopyTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC FFA_EX_MEM_CONSTITUENT_DESC  Constituents[TEST_MEM_CONSTITUENTS];
+  STATIC UINT8                        Copy[sizeof (Constituents) + SIZE_4KB];
+  TEST_RETRIEVE_CONTEXT               Retrieve;
+  FFA_EX_MEM_RELINQUISH_DESC          *Desc;
+  CONST VOID                          *Shared;
+  VOID                                *TxBuffer;
+  VOID                                *RxBuffer;
+  UINTN                               BufferSize;
+  UINTN                               Calls;
+  UINT32                              SharedLength;
+  UINT32                              Length;
+  UINT64                              Handle;
+
+  MockSpmcGetRxTxBuffers (&TxBuffer, &RxBuffer, &BufferSize);
+  Desc = TxBuffer;
+
+  UT_ASSERT_NOT_EFI_ERROR (ShareScatteredRegion (Constituents, &Handle, &Calls));
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcGetMemTransaction (Handle, &Shared, &SharedLength));
+
+  Length = sizeof (Copy);
+  UT_ASSERT_NOT_EFI_ERROR (FfaExMemRetrieve (Handle, MOCK_SPMC_CALLER_ID, FFA_EX_MEM_PERM_RW, NULL, NULL, Copy, &Length));
+  UT_ASSERT_EQUAL (Length, SharedLength);
+  UT_ASSERT_MEM_EQUAL (Copy, Shared, SharedLength);
+
+  ZeroMem (&Retrieve, sizeof (Retrieve));
+  Retrieve.Expected = Constituents;
+  Length            = SIZE_4KB;
+  UT_ASSERT_STATUS_EQUAL (
+    FfaExMemRetrieve (Handle, MOCK_SPMC_CALLER_ID, FFA_EX_MEM_PERM_RW, CheckRetrievedConstituents, &Retrieve, Copy, &Length),
+    EFI_BUFFER_TOO_SMALL
+    );
+  UT_ASSERT_EQUAL (Length, SharedLength);
+  UT_ASSERT_EQUAL (Retrieve.Seen, TEST_MEM_CONSTITUENTS);
+  UT_ASSERT_EQUAL (Desc->Handle, Handle);
+  UT_ASSERT_EQUAL (Desc->EndpointId, MOCK_SPMC_CALLER_ID);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A batch of section ranges is sorted, adjacent ranges with the same
+  attributes are merged, and a range above 4GB goes through the SMC64 call.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+MemPermSetBatchTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  FFA_EX_MEM_PERM_RANGE  Ranges[] = {
+    { 0x108000,     4,  TEST_PERM_RW_XN },
+    { 0x102000,     3,  TEST_PERM_RO_X  },
+    { 0x2000000000, 16, TEST_PERM_RW_XN },
+    { 0x105000,     1,  TEST_PERM_RO_XN },
+    { 0x100000,     2,  TEST_PERM_RO_X  },
+    { 0x106000,     2,  TEST_PERM_RO_XN },
+  };
+  UINTN                  CallsSaved;
+  UINTN                  Calls;
+  UINTN                  Index;
+  UINT32                 MemoryPerm;
+
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemPermSetBatch (Ranges, ARRAY_SIZE (Ranges), &CallsSaved));
+
+  //
+  // Text, read-only data, data, and the range above 4GB.
+  //
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 4);
+  UT_ASSERT_EQUAL (CallsSaved, 2);
+
+  for (Index = 1; Index < ARRAY_SIZE (Ranges); Index++) {
+    UT_ASSERT_TRUE (Ranges[Index - 1].BaseAddress < Ranges[Index].BaseAddress);
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcGetMemPerm (0x104000, &MemoryPerm));
+  UT_ASSERT_EQUAL (MemoryPerm, TEST_PERM_RO_X);
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcGetMemPerm (0x107000, &MemoryPerm));
+  UT_ASSERT_EQUAL (MemoryPerm, TEST_PERM_RO_XN);
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcGetMemPerm (0x10B000, &MemoryPerm));
+  UT_ASSERT_EQUAL (MemoryPerm, TEST_PERM_RW_XN);
+  UT_ASSERT_STATUS_EQUAL (MockSpmcGetMemPerm (0x10C000, &MemoryPerm), EFI_NOT_FOUND);
+
+  //
+  // The 32-bit call would have truncated the base to 0.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcGetMemPerm (0x200000F000, &MemoryPerm));
+  UT_ASSERT_EQUAL (MemoryPerm, TEST_PERM_RW_XN);
+  UT_ASSERT_STATUS_EQUAL (MockSpmcGetMemPerm (0, &MemoryPerm), EFI_NOT_FOUND);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemPermSetBatch (NULL, 0, &CallsSaved));
+  UT_ASSERT_EQUAL (CallsSaved, 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  FfaMemPermGet answers from the permissions shadowed by earlier calls, and
+  traps again once they may be stale.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+MemPermShadowTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  FFA_EX_MEM_PERM_RANGE  Ranges[] = {
+    { 0x102000, 1, TEST_PERM_RO_XN },
+    { 0x106000, 2, TEST_PERM_RO_XN },
+  };
+  UINTN                  Calls;
+  UINT32                 MemoryPerm;
+
+  //
+  // Seeded lazily, one granule per trap.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcSetMemPerm (0x100000, 8, TEST_PERM_RO_X));
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemPermGet ((VOID *)0x100800, &MemoryPerm));
+  UT_ASSERT_EQUAL (MemoryPerm, TEST_PERM_RO_X);
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemPermGet ((VOID *)0x100000, &MemoryPerm));
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemPermGet ((VOID *)0x101000, &MemoryPerm));
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 2);
+
+  //
+  // Every page set is shadowed, the split of a batch included.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemPermSet ((VOID *)0x100000, 8, TEST_PERM_RW_XN));
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemPermSetBatch (Ranges, ARRAY_SIZE (Ranges), NULL));
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemPermGet ((VOID *)0x101000, &MemoryPerm));
+  UT_ASSERT_EQUAL (MemoryPerm, TEST_PERM_RW_XN);
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemPermGet ((VOID *)0x102000, &MemoryPerm));
+  UT_ASSERT_EQUAL (MemoryPerm, TEST_PERM_RO_XN);
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemPermGet ((VOID *)0x105FFF, &MemoryPerm));
+  UT_ASSERT_EQUAL (MemoryPerm, TEST_PERM_RW_XN);
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemPermGet ((VOID *)0x107000, &MemoryPerm));
+  UT_ASSERT_EQUAL (MemoryPerm, TEST_PERM_RO_XN);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount (), Calls);
+
+  //
+  // Pages outside the shadow still trap, and failures are not shadowed.
+  //
+  UT_ASSERT_STATUS_EQUAL (FfaMemPermGet ((VOID *)0x108000, &MemoryPerm), EFI_INVALID_PARAMETER);
+  UT_ASSERT_STATUS_EQUAL (FfaMemPermGet ((VOID *)0x108000, &MemoryPerm), EFI_INVALID_PARAMETER);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 2);
+
+  //
+  // A failed FFA_MEM_PERM_SET may have changed part of its range.
+  //
+  MockSpmcInjectError (ARM_FID_FFA_MEM_PERM_SET_AARCH32, ARM_FFA_RET_DENIED, 0);
+  UT_ASSERT_STATUS_EQUAL (FfaMemPermSet ((VOID *)0x103000, 1, TEST_PERM_RO_X), EFI_ACCESS_DENIED);
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemPermGet ((VOID *)0x103000, &MemoryPerm));
+  UT_ASSERT_EQUAL (MemoryPerm, TEST_PERM_RW_XN);
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemPermGet ((VOID *)0x104000, &MemoryPerm));
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+
+  //
+  // Changes made behind the library's back need an explicit invalidation.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcSetMemPerm (0x100000, 1, TEST_PERM_RO_X));
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemPermGet ((VOID *)0x100000, &MemoryPerm));
+  UT_ASSERT_EQUAL (MemoryPerm, TEST_PERM_RW_XN);
+  FfaExInvalidatePermShadow ();
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemPermGet ((VOID *)0x100000, &MemoryPerm));
+  UT_ASSERT_EQUAL (MemoryPerm, TEST_PERM_RO_X);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  An invalid batch is rejected before any call, and a failing call stops the
+  batch with the ranges below it set.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+MemPermSetBatchErrorsTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  FFA_EX_MEM_PERM_RANGE  Overlapping[] = {
+    { 0x100000, 4, TEST_PERM_RO_X  },
+    { 0x103000, 1, TEST_PERM_RW_XN },
+  };
+  FFA_EX_MEM_PERM_RANGE  Unaligned[] = {
+    { 0x100800, 1, TEST_PERM_RO_X },
+  };
+  FFA_EX_MEM_PERM_RANGE  Disjoint[] = {
+    { 0x200000, 1, TEST_PERM_RW_XN },
+    { 0x100000, 1, TEST_PERM_RO_X  },
+  };
+  UINTN                  Calls;
+  UINT32                 MemoryPerm;
+
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_STATUS_EQUAL (FfaMemPermSetBatch (Overlapping, ARRAY_SIZE (Overlapping), NULL), EFI_INVALID_PARAMETER);
+  UT_ASSERT_STATUS_EQUAL (FfaMemPermSetBatch (Unaligned, ARRAY_SIZE (Unaligned), NULL), EFI_INVALID_PARAMETER);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount (), Calls);
+
+  MockSpmcInjectError (ARM_FID_FFA_MEM_PERM_SET_AARCH32, ARM_FFA_RET_DENIED, 1);
+  UT_ASSERT_STATUS_EQUAL (FfaMemPermSetBatch (Disjoint, ARRAY_SIZE (Disjoint), NULL), EFI_ACCESS_DENIED);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 2);
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcGetMemPerm (0x100000, &MemoryPerm));
+  UT_ASSERT_EQUAL (MemoryPerm, TEST_PERM_RO_X);
+  UT_ASSERT_STATUS_EQUAL (MockSpmcGetMemPerm (0x200000, &MemoryPerm), EFI_NOT_FOUND);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Both console log ABIs deliver the message characters in order.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+ConsoleLogTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC CONST CHAR8  Short[] = "Hello, SPMC\n";
+  STATIC CONST CHAR8  Long[]  = "A message longer than the 24 characters FFA_CONSOLE_LOG32 can carry\n";
+  CONST CHAR8         *Log;
+  UINTN               Length;
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaConsoleLog32 (Short, sizeof (Short) - 1));
+  UT_ASSERT_NOT_EFI_ERROR (FfaConsoleLog64 (Long, sizeof (Long) - 1));
+
+  Log = MockSpmcGetConsoleLog (&Length);
+  UT_ASSERT_EQUAL (Length, sizeof (Short) - 1 + sizeof (Long) - 1);
+  UT_ASSERT_MEM_EQUAL (Log, Short, sizeof (Short) - 1);
+  UT_ASSERT_MEM_EQUAL (Log + sizeof (Short) - 1, Long, sizeof (Long) - 1);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Call statistics count calls and errors per function ID.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+CallStatsTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  FFA_EX_CALL_STATS  Stats;
+  UINTN              Index;
+  UINT64             Samples;
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaNotificationSet (TEST_VM_ID, 0, BIT0));
+  UT_ASSERT_NOT_EFI_ERROR (FfaNotificationSet (TEST_VM_ID, 0, BIT1));
+  UT_ASSERT_STATUS_EQUAL (FfaNotificationSet (0x7FFF, 0, BIT0), EFI_INVALID_PARAMETER);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaExGetCallStats (ARM_FID_FFA_NOTIFICATION_SET, &Stats));
+  UT_ASSERT_EQUAL (Stats.CallCount, 3);
+  UT_ASSERT_EQUAL (Stats.ErrorCount, 1);
+  UT_ASSERT_EQUAL (Stats.InterruptCount, 0);
+
+  Samples = 0;
+  for (Index = 0; Index < FFA_EX_LATENCY_BUCKETS; Index++) {
+    Samples += Stats.LatencyHistogram[Index];
+  }
+
+  UT_ASSERT_EQUAL (Samples, 3);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaExResetCallStats ());
+  UT_ASSERT_NOT_EFI_ERROR (FfaExGetCallStats (ARM_FID_FFA_NOTIFICATION_SET, &Stats));
+  UT_ASSERT_EQUAL (Stats.CallCount, 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Each bound vCPU gets a context of its own, carrying its call statistics,
+  and the statistics add up across vCPUs. An index bound to one vCPU cannot
+  be taken by another.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+VcpuContextTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  FFA_EX_CALL_STATS  Stats;
+  UINT16             PartitionId;
+  UINTN              Vcpu2;
+
+  UT_ASSERT_EQUAL (FfaExGetCurrentVcpuId (), 0);
+  UT_ASSERT_STATUS_EQUAL (FfaExBindCurrentVcpu (MAX_UINT16), EFI_INVALID_PARAMETER);
+  UT_ASSERT_EQUAL (FfaExGetCurrentVcpuId (), 0);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaNotificationSet (TEST_VM_ID, 0, BIT0));
+
+  //
+  // The host test runs on one thread, switching the thread ID register
+  // switches the vCPU it stands for.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (FfaExBindCurrentVcpu (2));
+  UT_ASSERT_EQUAL (FfaExGetCurrentVcpuId (), 2);
+  UT_ASSERT_NOT_EFI_ERROR (FfaExBindCurrentVcpu (2));
+  UT_ASSERT_NOT_EFI_ERROR (FfaExGetPartitionId (&PartitionId));
+  UT_ASSERT_EQUAL (PartitionId, MOCK_SPMC_CALLER_ID);
+  UT_ASSERT_NOT_EFI_ERROR (FfaNotificationSet (TEST_VM_ID, 0, BIT1));
+
+  Vcpu2 = FfaReadVcpuRegister ();
+  FfaWriteVcpuRegister (0);
+  UT_ASSERT_NOT_EFI_ERROR (FfaExBindCurrentVcpu (1));
+  UT_ASSERT_EQUAL (FfaExGetCurrentVcpuId (), 1);
+  UT_ASSERT_NOT_EFI_ERROR (FfaExGetPartitionId (&PartitionId));
+  UT_ASSERT_EQUAL (PartitionId, MOCK_SPMC_CALLER_ID);
+  UT_ASSERT_STATUS_EQUAL (FfaNotificationSet (0x7FFF, 0, BIT0), EFI_INVALID_PARAMETER);
+  UT_ASSERT_STATUS_EQUAL (FfaExBindCurrentVcpu (2), EFI_ACCESS_DENIED);
+  UT_ASSERT_EQUAL (FfaExGetCurrentVcpuId (), 1);
+
+  FfaWriteVcpuRegister (Vcpu2);
+  UT_ASSERT_EQUAL (FfaExGetCurrentVcpuId (), 2);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaExGetCallStats (ARM_FID_FFA_NOTIFICATION_SET, &Stats));
+  UT_ASSERT_EQUAL (Stats.CallCount, 3);
+  UT_ASSERT_EQUAL (Stats.ErrorCount, 1);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaExResetCallStats ());
+  UT_ASSERT_NOT_EFI_ERROR (FfaExGetCallStats (ARM_FID_FFA_NOTIFICATION_SET, &Stats));
+  UT_ASSERT_EQUAL (Stats.CallCount, 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Fills a stretch of the stack below the caller with a non-zero pattern, so
+  that an argument block a later call leaves partly uninitialized holds
+  garbage rather than zeroes.
+
+**/
+STATIC
+VOID
+ScribbleStack (
+  VOID
+  )
+{
+  volatile UINT8  Scribble[1024];
+  UINTN           Index;
+
+  for (Index = 0; Index < sizeof (Scribble); Index++) {
+    Scribble[Index] = 0xA5;
+  }
+}
+
+//
+// Called through a pointer so that ScribbleStack keeps its own frame rather
+// than being inlined into the test's.
+//
+STATIC VOID (*volatile  mScribbleStack)(
+  VOID
+  ) = ScribbleStack;
+
+/**
+  The trace ring records the request and response registers of each call,
+  oldest first. Registers past x7 of a call taking and returning x0-x7 only
+  are recorded as zero.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+TraceDumpTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  FFA_EX_TRACE_RECORD  Records[TEST_TRACE_RECORDS];
+  UINTN                Count;
+  UINTN                Index;
+
+  mScribbleStack ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaNotificationSet (TEST_VM_ID, 0, BIT2));
+  UT_ASSERT_NOT_EFI_ERROR (FfaMemRelinquish ());
+
+  Count = ARRAY_SIZE (Records);
+  UT_ASSERT_NOT_EFI_ERROR (FfaExTraceDump (Records, &Count));
+  UT_ASSERT_EQUAL (Count, 2);
+
+  UT_ASSERT_EQUAL (Records[0].Request.Arg0, ARM_FID_FFA_NOTIFICATION_SET);
+  UT_ASSERT_EQUAL (Records[0].Request.Arg1, ((UINT32)MOCK_SPMC_CALLER_ID << 16) | TEST_VM_ID);
+  UT_ASSERT_EQUAL (Records[0].Request.Arg3, BIT2);
+  UT_ASSERT_EQUAL (Records[0].Response.Arg0, ARM_FID_FFA_SUCCESS_AARCH32);
+  UT_ASSERT_EQUAL (Records[1].Request.Arg0, ARM_FID_FFA_MEM_RETRIEVE_RELINQUISH);
+  UT_ASSERT_TRUE (Records[0].Sequence < Records[1].Sequence);
+
+  for (Index = 8; Index < 18; Index++) {
+    UT_ASSERT_EQUAL (((UINTN *)&Records[0].Request)[Index], 0);
+    UT_ASSERT_EQUAL (((UINTN *)&Records[0].Response)[Index], 0);
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaExTraceReset ());
+  Count = ARRAY_SIZE (Records);
+  UT_ASSERT_NOT_EFI_ERROR (FfaExTraceDump (Records, &Count));
+  UT_ASSERT_EQUAL (Count, 0);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  End to end: the partition receives a notification registration and a test
+  notification request from a VM, the trace of that session is replayed
+  through the real service handlers and the replay raises the registered
+  notification in the SPMC.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+TraceReplayTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC EFI_GUID      NotificationGuid = NOTIFICATION_SERVICE_UUID;
+  STATIC EFI_GUID      TestGuid         = TEST_SERVICE_UUID;
+  ARM_SVC_ARGS         Message;
+  NotificationMapping  Mapping;
+  DIRECT_MSG_ARGS_EX   Request;
+  DIRECT_MSG_ARGS_EX   Response;
+  FFA_EX_TRACE_RECORD  Records[TEST_TRACE_RECORDS];
+  UINTN                Count;
+  UINTN                Dispatched;
+
+  //
+  // Register cookie TEST_NOTIFICATION_COOKIE as notification
+  // TEST_NOTIFICATION_ID of the service TEST_SERVICE_UUID_*.
+  //
+  Mapping.Uint64      = 0;
+  Mapping.Bits.Id     = TEST_NOTIFICATION_ID;
+  Mapping.Bits.Cookie = TEST_NOTIFICATION_COOKIE;
+
+  BuildVmRequest (&NotificationGuid, &Message);
+  Message.Arg7  = TEST_SERVICE_UUID_LO;
+  Message.Arg8  = TEST_SERVICE_UUID_HI;
+  Message.Arg9  = NOTIFICATION_OPCODE_REGISTER;
+  Message.Arg10 = 1;
+  Message.Arg11 = Mapping.Uint64;
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcQueueMessage (&Message));
+
+  //
+  // Then ask the test service to raise it.
+  //
+  BuildVmRequest (&TestGuid, &Message);
+  Message.Arg4 = TEST_OPCODE_TEST_NOTIFICATION;
+  Message.Arg5 = TEST_SERVICE_UUID_LO;
+  Message.Arg6 = TEST_SERVICE_UUID_HI;
+  Message.Arg7 = TEST_NOTIFICATION_COOKIE;
+  UT_ASSERT_NOT_EFI_ERROR (MockSpmcQueueMessage (&Message));
+
+  //
+  // Capture: receive both requests without handling them.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (FfaMessageWait (&Request));
+  UT_ASSERT_EQUAL (Request.FunctionId, ARM_FID_FFA_MSG_SEND_DIRECT_REQ2);
+  UT_ASSERT_TRUE (CompareGuid (&Request.ServiceGuid, &NotificationGuid));
+
+  ZeroMem (&Response, sizeof (Response));
+  Response.SourceId      = Request.DestinationId;
+  Response.DestinationId = Request.SourceId;
+  UT_ASSERT_NOT_EFI_ERROR (FfaMessageSendDirectResp2 (&Response, &Request));
+  UT_ASSERT_TRUE (CompareGuid (&Request.ServiceGuid, &TestGuid));
+
+  UT_ASSERT_EQUAL (MockSpmcGetPendingNotifications (TEST_VM_ID, TRUE), 0);
+
+  //
+  // Replay the capture through the service handlers.
+  //
+  Count = ARRAY_SIZE (Records);
+  UT_ASSERT_NOT_EFI_ERROR (FfaExTraceDump (Records, &Count));
+  UT_ASSERT_EQUAL (Count, 2);
+
+  UT_ASSERT_NOT_EFI_ERROR (
+    FfaExTraceReplay (Records, Count, mReplayServices, ARRAY_SIZE (mReplayServices), &Dispatched)
+    );
+  UT_ASSERT_EQUAL (Dispatched, 2);
+
+  UT_ASSERT_EQUAL (
+    MockSpmcGetPendingNotifications (TEST_VM_ID, TRUE),
+    LShiftU64 (1, TEST_NOTIFICATION_ID)
+    );
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initializes and runs the unit tests.
+
+  @retval EFI_SUCCESS  The tests ran.
+  @retval Others       The test framework could not be set up.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+UnitTestingEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      Suite;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_APP_NAME, UNIT_TEST_APP_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_APP_NAME, gEfiCallerBaseName, UNIT_TEST_APP_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (&Suite, Framework, "ArmFfaLibEx Tests", "ArmFfaLibEx", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for ArmFfaLibEx Tests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (Suite, "Feature IDs are probed once, on first query", "FeatureQuery", FeatureQueryTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Partition ID is resolved once", "PartitionIdOnce", PartitionIdOnceTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Direct request 2 round trips", "DirectReq2Echo", DirectReq2EchoTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Direct request 2 to an unknown partition fails", "DirectReq2Unknown", DirectReq2UnknownPartitionTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Interrupts preempting a request are deferred", "DeferredInterrupt", DeferredInterruptTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Deferred interrupts run once a response completes", "DeferredWorkAfterResponse", DeferredWorkAfterResponseTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Yielded and preempted requests resume", "ResumableRequest", ResumableRequestTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Wire GUIDs skip the byte swaps", "WireGuid", WireGuidTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Register order direct messages", "DirectMsg", DirectMsgTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Batched commands", "Batch", BatchTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Partition discovery walks every window", "PartitionInfoGetAll", PartitionInfoGetAllTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Partition discovery reports the count needed", "PartitionInfoGetAllTooSmall", PartitionInfoGetAllTooSmallTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Partition discovery restarts on RETRY", "PartitionInfoGetAllRetry", PartitionInfoGetAllRetryTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Service resolution is cached", "ResolveService", ResolveServiceTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Indirect message send", "IndirectMsgSend", IndirectMsgSendTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Indirect message receive and release", "IndirectMsgReceive", IndirectMsgReceiveTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "RX release folded into the wait", "MessageWaitRx", MessageWaitRxTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Notifications set and get", "NotificationSetGet", NotificationSetGetTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "All notification bitmaps in one call", "NotificationGetAll", NotificationGetAllTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Notification info decoding", "NotificationInfoGet", NotificationInfoGetTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Notification info drain", "NotificationInfoDrain", NotificationInfoDrainTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Memory share, retrieve and reclaim", "MemShareReclaim", MemShareReclaimTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Fragmented memory transaction", "MemTransactionFragmented", MemTransactionFragmentedTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Memory transaction errors", "MemTransactionErrors", MemTransactionErrorsTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Failed fragmented sends are reclaimed", "MemTransactionAbort", MemTransactionAbortTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Streamed memory retrieve", "MemRetrieveStreamed", MemRetrieveStreamedTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Memory retrieve into a contiguous copy", "MemRetrieveCopy", MemRetrieveCopyTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Single range share, retrieve and relinquish", "MemSingleRegion", MemSingleRegionTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Batched permission changes are merged", "MemPermSetBatch", MemPermSetBatchTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Batched permission change errors", "MemPermSetBatchErrors", MemPermSetBatchErrorsTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Permission queries answered from the shadow", "MemPermShadow", MemPermShadowTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Console log 32 and 64", "ConsoleLog", ConsoleLogTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Call statistics", "CallStats", CallStatsTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Per-vCPU contexts", "VcpuContext", VcpuContextTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Trace dump", "TraceDump", TraceDumpTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Trace replay through the service handlers", "TraceReplay", TraceReplayTest, ResetSpmc, NULL, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+
+  @param  argc  Unused.
+  @param  argv  Unused.
+
+  @retval 0  Always.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return UnitTestingEntry ();
+}
@@ -0,0 +1,307 @@
+/** @file
+  SerialPortLib instance writing to the FF-A console.
+
+  FFA_CONSOLE_LOG carries at most 128 characters per call, and a DebugLib
+  writing straight to it traps every few characters. This instance collects
+  output in a buffer per bound vCPU and only issues a full FFA_CONSOLE_LOG_64 when
+  a line ends, when the buffer reaches FFA_CONSOLE_FLUSH_THRESHOLD characters
+  or when SerialPortWrite is called with NumberOfBytes set to zero. Paired
+  with BaseDebugLibSerialPort, a DEBUG message usually costs a single trap.
+
+  Only vCPUs bound with FfaExBindCurrentVcpu have a buffer: the others cannot
+  be told apart, so their output is written through unbuffered.
+
+  If the SPMC does not implement FFA_CONSOLE_LOG_64, output falls back to
+  FFA_CONSOLE_LOG_32 after the first failed call.
+
+  This library does not depend on DebugLib, so that ArmFfaLibEx can be built
+  against a DebugLib routed through it. For the same reason it has no
+  constructor and SerialPortInitialize does not call into the SPMC.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/ArmFfaSvc.h>
+#include <IndustryStandard/ArmFfaPartInfo.h>
+#include <Library/ArmSvcLib.h>
+#include <Library/ArmSmcLib.h>
+#include <Library/ArmFfaLibEx.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/SerialPortLib.h>
+#include <Library/SynchronizationLib.h>
+
+//
+// Number of vCPUs with a buffer of their own. Output from any other vCPU is
+// written through unbuffered. Can be overridden from the build options.
+//
+#ifndef FFA_CONSOLE_MAX_VCPUS
+  #define FFA_CONSOLE_MAX_VCPUS  8
+#endif
+
+//
+// Number of buffered characters that forces a flush without a line end. Can
+// be overridden from the build options.
+//
+#ifndef FFA_CONSOLE_FLUSH_THRESHOLD
+  #define FFA_CONSOLE_FLUSH_THRESHOLD  FFA_CONSOLE_LOG_64_MAX_LENGTH
+#endif
+
+STATIC_ASSERT (
+  (FFA_CONSOLE_FLUSH_THRESHOLD > 0) && (FFA_CONSOLE_FLUSH_THRESHOLD <= FFA_CONSOLE_LOG_64_MAX_LENGTH),
+  "FFA_CONSOLE_FLUSH_THRESHOLD must be within one FFA_CONSOLE_LOG_64 call"
+  );
+
+typedef struct {
+  UINT8              Buffer[FFA_CONSOLE_FLUSH_THRESHOLD];
+  UINTN              Length;
+  //
+  // Claimed with a compare exchange while a writer uses the buffer. A write
+  // that finds it claimed, e.g. from an interrupt handler or from another
+  // vCPU bound with the same index, goes around the buffer.
+  //
+  volatile UINT32    Busy;
+} FFA_CONSOLE_BUFFER;
+
+STATIC FFA_CONSOLE_BUFFER  mFfaConsole[FFA_CONSOLE_MAX_VCPUS];
+
+//
+// Set once FFA_CONSOLE_LOG_64 was reported as not supported.
+//
+STATIC BOOLEAN  mFfaConsoleLog32Only;
+
+/**
+  Writes characters to the FF-A console, in as few calls as possible.
+
+  Output is best effort: characters the SPMC refuses are dropped.
+
+  @param  Data    The characters.
+  @param  Length  Number of characters.
+
+**/
+STATIC
+VOID
+FfaConsoleEmit (
+  IN CONST UINT8  *Data,
+  IN UINTN        Length
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Chunk;
+
+  while (Length > 0) {
+    if (!mFfaConsoleLog32Only) {
+      Chunk  = MIN (Length, FFA_CONSOLE_LOG_64_MAX_LENGTH);
+      Status = FfaConsoleLog64 ((CONST CHAR8 *)Data, Chunk);
+      if (Status != EFI_UNSUPPORTED) {
+        Data   += Chunk;
+        Length -= Chunk;
+        continue;
+      }
+
+      mFfaConsoleLog32Only = TRUE;
+    }
+
+    Chunk = MIN (Length, FFA_CONSOLE_LOG_32_MAX_LENGTH);
+    FfaConsoleLog32 ((CONST CHAR8 *)Data, Chunk);
+    Data   += Chunk;
+    Length -= Chunk;
+  }
+}
+
+/**
+  Writes out and empties the buffer of a vCPU.
+
+  @param  Console  The buffer.
+
+**/
+STATIC
+VOID
+FfaConsoleFlush (
+  IN FFA_CONSOLE_BUFFER  *Console
+  )
+{
+  FfaConsoleEmit (Console->Buffer, Console->Length);
+  Console->Length = 0;
+}
+
+/**
+  Initializes the serial device.
+
+  Nothing needs to be set up, and this may run before the ArmFfaLibEx
+  constructor, so no FF-A call is made here.
+
+  @retval RETURN_SUCCESS  Always.
+**/
+RETURN_STATUS
+EFIAPI
+SerialPortInitialize (
+  VOID
+  )
+{
+  return RETURN_SUCCESS;
+}
+
+/**
+  Writes data to the FF-A console.
+
+  The data is buffered per bound vCPU until a line ends or the buffer is
+  full.
+
+  @param  Buffer         The data to write.
+  @param  NumberOfBytes  Number of bytes to write. If zero, the buffer of the
+                         calling vCPU is flushed.
+
+  @retval The number of bytes written, NumberOfBytes unless Buffer is NULL.
+**/
+UINTN
+EFIAPI
+SerialPortWrite (
+  IN UINT8  *Buffer,
+  IN UINTN  NumberOfBytes
+  )
+{
+  FFA_CONSOLE_BUFFER  *Console;
+  UINT16              VcpuId;
+  UINTN               Index;
+  UINTN               Chunk;
+  CONST UINT8         *LineEnd;
+
+  if (Buffer == NULL) {
+    return 0;
+  }
+
+  if (EFI_ERROR (FfaExGetBoundVcpuId (&VcpuId)) || (VcpuId >= FFA_CONSOLE_MAX_VCPUS) ||
+      (InterlockedCompareExchange32 (&mFfaConsole[VcpuId].Busy, FALSE, TRUE) != FALSE))
+  {
+    FfaConsoleEmit (Buffer, NumberOfBytes);
+    return NumberOfBytes;
+  }
+
+  Console = &mFfaConsole[VcpuId];
+
+  if (NumberOfBytes == 0) {
+    FfaConsoleFlush (Console);
+  }
+
+  for (Index = 0; Index < NumberOfBytes; Index += Chunk) {
+    Chunk   = MIN (NumberOfBytes - Index, FFA_CONSOLE_FLUSH_THRESHOLD - Console->Length);
+    LineEnd = ScanMem8 (&Buffer[Index], Chunk, '\n');
+    if (LineEnd != NULL) {
+      Chunk = LineEnd - &Buffer[Index] + 1;
+    }
+
+    CopyMem (&Console->Buffer[Console->Length], &Buffer[Index], Chunk);
+    Console->Length += Chunk;
+    if ((LineEnd != NULL) || (Console->Length == FFA_CONSOLE_FLUSH_THRESHOLD)) {
+      FfaConsoleFlush (Console);
+    }
+  }
+
+  MemoryFence ();
+  Console->Busy = FALSE;
+  return NumberOfBytes;
+}
+
+/**
+  Reads data from the serial device. The FF-A console has no input.
+
+  @param  Buffer         Unused.
+  @param  NumberOfBytes  Unused.
+
+  @retval 0  Always.
+**/
+UINTN
+EFIAPI
+SerialPortRead (
+  OUT UINT8  *Buffer,
+  IN  UINTN  NumberOfBytes
+  )
+{
+  return 0;
+}
+
+/**
+  Polls the serial device for input. The FF-A console has no input.
+
+  @retval FALSE  Always.
+**/
+BOOLEAN
+EFIAPI
+SerialPortPoll (
+  VOID
+  )
+{
+  return FALSE;
+}
+
+/**
+  Sets the control bits of the serial device. The FF-A console has none.
+
+  @param  Control  Unused.
+
+  @retval RETURN_UNSUPPORTED  Always.
+**/
+RETURN_STATUS
+EFIAPI
+SerialPortSetControl (
+  IN UINT32  Control
+  )
+{
+  return RETURN_UNSUPPORTED;
+}
+
+/**
+  Returns the control bits of the serial device.
+
+  @param  Control  Receives EFI_SERIAL_OUTPUT_BUFFER_EMPTY if the calling vCPU
+                   has no buffered output.
+
+  @retval RETURN_SUCCESS  Always.
+**/
+RETURN_STATUS
+EFIAPI
+SerialPortGetControl (
+  OUT UINT32  *Control
+  )
+{
+  UINT16  VcpuId;
+
+  *Control = 0;
+  if (EFI_ERROR (FfaExGetBoundVcpuId (&VcpuId)) || (VcpuId >= FFA_CONSOLE_MAX_VCPUS) ||
+      (mFfaConsole[VcpuId].Length == 0))
+  {
+    *Control = EFI_SERIAL_OUTPUT_BUFFER_EMPTY;
+  }
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Sets the attributes of the serial device. The FF-A console has none.
+
+  @param  BaudRate          Unused.
+  @param  ReceiveFifoDepth  Unused.
+  @param  Timeout           Unused.
+  @param  Parity            Unused.
+  @param  DataBits          Unused.
+  @param  StopBits          Unused.
+
+  @retval RETURN_UNSUPPORTED  Always.
+**/
+RETURN_STATUS
+EFIAPI
+SerialPortSetAttributes (
+  IN OUT UINT64              *BaudRate,
+  IN OUT UINT32              *ReceiveFifoDepth,
+  IN OUT UINT32              *Timeout,
+  IN OUT EFI_PARITY_TYPE     *Parity,
+  IN OUT UINT8               *DataBits,
+  IN OUT EFI_STOP_BITS_TYPE  *StopBits
+  )
+{
+  return RETURN_UNSUPPORTED;
+}
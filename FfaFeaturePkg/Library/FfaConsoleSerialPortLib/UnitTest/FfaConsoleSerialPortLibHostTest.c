@@ -0,0 +1,334 @@
+/** @file
+  Host based unit tests for FfaConsoleSerialPortLib.
+
+  Checks that output is buffered per bound vCPU and only logged at the end of
+  a line, on a full buffer or on a flush, that unbound vCPUs write through,
+  that FFA_CONSOLE_LOG_32 is used when the 64-bit call is missing, and that
+  the logged characters arrive intact.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/ArmFfaSvc.h>
+#include <IndustryStandard/ArmFfaPartInfo.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/ArmSvcLib.h>
+#include <Library/ArmSmcLib.h>
+#include <Library/ArmFfaLibEx.h>
+#include <Library/SerialPortLib.h>
+#include <Library/MockSpmcLib.h>
+#include <Library/UnitTestLib.h>
+
+#define UNIT_TEST_APP_NAME     "FfaConsoleSerialPortLib Host Unit Tests"
+#define UNIT_TEST_APP_VERSION  "1.0"
+
+/**
+  Resets the SPMC model and the library state before each test.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED  Always.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+ResetSpmc (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  MockSpmcResetAndInit ();
+  FfaExBindCurrentVcpu (0);
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Writes a string to the serial port.
+
+  @param  String  The string.
+
+**/
+STATIC
+VOID
+WriteString (
+  IN CONST CHAR8  *String
+  )
+{
+  SerialPortWrite ((UINT8 *)String, AsciiStrLen (String));
+}
+
+/**
+  Output is held until a line ends, then logged in one call.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+LineBufferedTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC CONST CHAR8  Expected[] = "Service started, 3 handlers\n";
+  CONST CHAR8         *Log;
+  UINTN               Length;
+  UINTN               Calls;
+  UINT32              Control;
+
+  UT_ASSERT_NOT_EFI_ERROR (SerialPortInitialize ());
+
+  Calls = MockSpmcGetCallCount ();
+  WriteString ("Service started");
+  WriteString (", 3 ");
+  WriteString ("handlers");
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount (), Calls);
+  UT_ASSERT_NOT_EFI_ERROR (SerialPortGetControl (&Control));
+  UT_ASSERT_EQUAL (Control & EFI_SERIAL_OUTPUT_BUFFER_EMPTY, 0);
+
+  WriteString ("\n");
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+  UT_ASSERT_NOT_EFI_ERROR (SerialPortGetControl (&Control));
+  UT_ASSERT_EQUAL (Control & EFI_SERIAL_OUTPUT_BUFFER_EMPTY, EFI_SERIAL_OUTPUT_BUFFER_EMPTY);
+
+  Log = MockSpmcGetConsoleLog (&Length);
+  UT_ASSERT_EQUAL (Length, sizeof (Expected) - 1);
+  UT_ASSERT_MEM_EQUAL (Log, Expected, sizeof (Expected) - 1);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A write holding several lines logs each of them and keeps the unfinished
+  one.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+SeveralLinesTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC CONST CHAR8  Expected[] = "one\ntwo\nthree\n";
+  CONST CHAR8         *Log;
+  UINTN               Length;
+  UINTN               Calls;
+
+  Calls = MockSpmcGetCallCount ();
+  WriteString ("one\ntwo\nthr");
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 2);
+  WriteString ("ee\n");
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 3);
+
+  Log = MockSpmcGetConsoleLog (&Length);
+  UT_ASSERT_EQUAL (Length, sizeof (Expected) - 1);
+  UT_ASSERT_MEM_EQUAL (Log, Expected, sizeof (Expected) - 1);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Output without a line end is logged in full FFA_CONSOLE_LOG_64 calls, and
+  the rest on an explicit flush.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+FullBufferTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  UINT8        Data[300];
+  CONST CHAR8  *Log;
+  UINTN        Length;
+  UINTN        Calls;
+  UINTN        Index;
+
+  for (Index = 0; Index < sizeof (Data); Index++) {
+    Data[Index] = (UINT8)('a' + Index % 26);
+  }
+
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_EQUAL (SerialPortWrite (Data, sizeof (Data)), sizeof (Data));
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, sizeof (Data) / FFA_CONSOLE_LOG_64_MAX_LENGTH);
+
+  UT_ASSERT_EQUAL (SerialPortWrite (Data, 0), 0);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, sizeof (Data) / FFA_CONSOLE_LOG_64_MAX_LENGTH + 1);
+
+  //
+  // Flushing an empty buffer does not trap.
+  //
+  UT_ASSERT_EQUAL (SerialPortWrite (Data, 0), 0);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, sizeof (Data) / FFA_CONSOLE_LOG_64_MAX_LENGTH + 1);
+
+  Log = MockSpmcGetConsoleLog (&Length);
+  UT_ASSERT_EQUAL (Length, sizeof (Data));
+  UT_ASSERT_MEM_EQUAL (Log, Data, sizeof (Data));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A vCPU that was not bound has no buffer, its output is written through.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+UnboundVcpuTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  CONST CHAR8  *Log;
+  UINTN        Length;
+  UINTN        Calls;
+  UINT32       Control;
+
+  //
+  // Initializing the library again unbinds the vCPU bound by ResetSpmc.
+  //
+  MockSpmcResetAndInit ();
+
+  Calls = MockSpmcGetCallCount ();
+  WriteString ("no line end");
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+  UT_ASSERT_NOT_EFI_ERROR (SerialPortGetControl (&Control));
+  UT_ASSERT_EQUAL (Control & EFI_SERIAL_OUTPUT_BUFFER_EMPTY, EFI_SERIAL_OUTPUT_BUFFER_EMPTY);
+
+  Log = MockSpmcGetConsoleLog (&Length);
+  UT_ASSERT_EQUAL (Length, 11);
+  UT_ASSERT_MEM_EQUAL (Log, "no line end", 11);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Output falls back to FFA_CONSOLE_LOG_32 when FFA_CONSOLE_LOG_64 is not
+  supported.
+
+  The fallback is kept for the life of the library, so this test runs last.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+Log32FallbackTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  STATIC CONST CHAR8  Line[] = "A line longer than one FFA_CONSOLE_LOG_32\n";
+  CONST CHAR8         *Log;
+  UINTN               Length;
+  UINTN               Calls;
+
+  MockSpmcInjectError (ARM_FID_FFA_CONSOLE_LOG_AARCH64, ARM_FFA_RET_NOT_SUPPORTED, 0);
+
+  //
+  // One failed FFA_CONSOLE_LOG_64, then two FFA_CONSOLE_LOG_32.
+  //
+  Calls = MockSpmcGetCallCount ();
+  WriteString (Line);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 3);
+
+  Calls = MockSpmcGetCallCount ();
+  WriteString ("ok\n");
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+
+  Log = MockSpmcGetConsoleLog (&Length);
+  UT_ASSERT_EQUAL (Length, sizeof (Line) - 1 + 3);
+  UT_ASSERT_MEM_EQUAL (Log, Line, sizeof (Line) - 1);
+  UT_ASSERT_MEM_EQUAL (Log + sizeof (Line) - 1, "ok\n", 3);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initializes and runs the unit tests.
+
+  @retval EFI_SUCCESS  The tests ran.
+  @retval Others       The test framework could not be set up.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+UnitTestingEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      Suite;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_APP_NAME, UNIT_TEST_APP_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_APP_NAME, gEfiCallerBaseName, UNIT_TEST_APP_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (&Suite, Framework, "FfaConsoleSerialPortLib Tests", "FfaConsoleSerialPortLib", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for FfaConsoleSerialPortLib Tests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (Suite, "Output is buffered until a line ends", "LineBuffered", LineBufferedTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Each line of a write is logged", "SeveralLines", SeveralLinesTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Full buffers and explicit flush", "FullBuffer", FullBufferTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Unbound vCPUs write through", "UnboundVcpu", UnboundVcpuTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Fallback to FFA_CONSOLE_LOG_32", "Log32Fallback", Log32FallbackTest, ResetSpmc, NULL, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+
+  @param  argc  Unused.
+  @param  argv  Unused.
+
+  @retval 0  Always.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return UnitTestingEntry ();
+}
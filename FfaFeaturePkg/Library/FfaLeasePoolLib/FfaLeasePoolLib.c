@@ -0,0 +1,578 @@
+/** @file
+  Shared memory lease pool over FF-A.
+
+  A pool owns up to FFA_LEASE_POOL_MAX_REGIONS regions shared with a single
+  receiver, each cut into BuffersPerRegion buffers. Free buffers of all
+  regions are chained in one LIFO free list threaded through an index array,
+  so that the most recently returned buffer, still warm in the cache, is
+  leased next and acquire and release are O(1) without a trap.
+
+  The spin locks only guard the bookkeeping. Growing a pool and retrieving a
+  region trap to the SPMC, so they run unlocked: the lock is taken to reserve
+  the slot they fill and again to publish the result.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/ArmFfaSvc.h>
+#include <IndustryStandard/ArmFfaPartInfo.h>
+#include <Library/ArmSvcLib.h>
+#include <Library/ArmSmcLib.h>
+#include <Library/ArmFfaLib.h>
+#include <Library/ArmFfaLibEx.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/FfaLeasePoolLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/SynchronizationLib.h>
+
+//
+// Leased buffers start on a cache line so that neither side needs to clean
+// or invalidate a line another lease shares.
+//
+#define FFA_LEASE_BUFFER_ALIGNMENT  64
+
+//
+// Free list links: end of the list, and marker of a leased buffer.
+//
+#define FFA_LEASE_FREE_END  MAX_UINT32
+#define FFA_LEASE_LEASED    (MAX_UINT32 - 1)
+
+typedef struct {
+  VOID      *Base;        // NULL while the region is not shared
+  UINT64    Handle;
+  UINT32    LeaseCount;   // Buffers of the region currently leased
+} FFA_LEASE_REGION;
+
+struct _FFA_LEASE_POOL {
+  SPIN_LOCK           Lock;
+  volatile UINT32     Growing; // Set while a vCPU shares a new region
+  UINT16              ReceiverId;
+  UINT32              BufferSize;
+  UINT32              Stride;
+  UINT32              BuffersPerRegion;
+  UINTN               PagesPerRegion;
+  UINT32              MaxRegions;
+  UINT32              FreeHead;
+  UINT32              *Next;   // MaxRegions * BuffersPerRegion links
+  FFA_LEASE_REGION    Regions[FFA_LEASE_POOL_MAX_REGIONS];
+};
+
+typedef struct {
+  UINT16     SenderId;
+  BOOLEAN    Busy;     // The region is being retrieved or relinquished
+  UINT64     Handle;   // 0 if the slot is free
+  UINT64     Base;
+  UINT64     Size;
+} FFA_LEASE_MAPPING;
+
+STATIC SPIN_LOCK          mFfaLeaseMapLock;
+STATIC FFA_LEASE_MAPPING  mFfaLeaseMaps[FFA_LEASE_MAP_MAX_REGIONS];
+
+/**
+  Pushes the free buffers of every shared region back on the free list,
+  leased buffers excepted.
+
+  @param  Pool  The pool, locked.
+
+**/
+STATIC
+VOID
+FfaLeasePoolRebuildFreeList (
+  IN FFA_LEASE_POOL  *Pool
+  )
+{
+  UINT32  Region;
+  UINT32  Slot;
+  UINT32  Index;
+
+  Pool->FreeHead = FFA_LEASE_FREE_END;
+  for (Region = Pool->MaxRegions; Region-- > 0;) {
+    if (Pool->Regions[Region].Base == NULL) {
+      continue;
+    }
+
+    for (Slot = Pool->BuffersPerRegion; Slot-- > 0;) {
+      Index = Region * Pool->BuffersPerRegion + Slot;
+      if (Pool->Next[Index] != FFA_LEASE_LEASED) {
+        Pool->Next[Index] = Pool->FreeHead;
+        Pool->FreeHead    = Index;
+      }
+    }
+  }
+}
+
+/**
+  Allocates a new region and shares it with the receiver of the pool.
+
+  The caller owns Pool->Growing, so the free region slot found here stays
+  free until the region is published in it.
+
+  @param  Pool  The pool, unlocked.
+
+  @retval EFI_SUCCESS           The buffers of the region are on the free
+                                list, or another vCPU already added some.
+  @retval EFI_OUT_OF_RESOURCES  The pool is at its maximum size or the region
+                                could not be allocated.
+  @retval Others                Sharing the region failed.
+**/
+STATIC
+EFI_STATUS
+FfaLeasePoolGrow (
+  IN FFA_LEASE_POOL  *Pool
+  )
+{
+  EFI_STATUS        Status;
+  FFA_LEASE_REGION  *Region;
+  VOID              *Base;
+  UINT64            Handle;
+  UINT32            RegionIndex;
+  UINT32            Slot;
+  UINT32            Index;
+
+  AcquireSpinLock (&Pool->Lock);
+
+  if (Pool->FreeHead != FFA_LEASE_FREE_END) {
+    ReleaseSpinLock (&Pool->Lock);
+    return EFI_SUCCESS;
+  }
+
+  for (RegionIndex = 0; RegionIndex < Pool->MaxRegions; RegionIndex++) {
+    if (Pool->Regions[RegionIndex].Base == NULL) {
+      break;
+    }
+  }
+
+  ReleaseSpinLock (&Pool->Lock);
+
+  if (RegionIndex == Pool->MaxRegions) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Base = AllocatePages (Pool->PagesPerRegion);
+  if (Base == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = FfaExMemShareSingle (Pool->ReceiverId, Base, Pool->PagesPerRegion, &Handle);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: Failed to share a region with 0x%x - %r\n", __func__, Pool->ReceiverId, Status));
+    FreePages (Base, Pool->PagesPerRegion);
+    return Status;
+  }
+
+  AcquireSpinLock (&Pool->Lock);
+
+  Region         = &Pool->Regions[RegionIndex];
+  Region->Base   = Base;
+  Region->Handle = Handle;
+
+  //
+  // Push in reverse so that the start of the region is leased first.
+  //
+  for (Slot = Pool->BuffersPerRegion; Slot-- > 0;) {
+    Index             = RegionIndex * Pool->BuffersPerRegion + Slot;
+    Pool->Next[Index] = Pool->FreeHead;
+    Pool->FreeHead    = Index;
+  }
+
+  ReleaseSpinLock (&Pool->Lock);
+  return EFI_SUCCESS;
+}
+
+/**
+  Reclaims and frees the regions of a pool that have no buffer leased.
+
+  @param  Pool  The pool, locked.
+
+  @retval The number of regions reclaimed.
+**/
+STATIC
+UINTN
+FfaLeasePoolReclaimIdle (
+  IN FFA_LEASE_POOL  *Pool
+  )
+{
+  EFI_STATUS        Status;
+  FFA_LEASE_REGION  *Region;
+  UINT32            RegionIndex;
+  UINTN             Reclaimed;
+
+  Reclaimed = 0;
+  for (RegionIndex = 0; RegionIndex < Pool->MaxRegions; RegionIndex++) {
+    Region = &Pool->Regions[RegionIndex];
+    if ((Region->Base == NULL) || (Region->LeaseCount != 0)) {
+      continue;
+    }
+
+    Status = FfaMemReclaim (Region->Handle, 0);
+    if (EFI_ERROR (Status)) {
+      //
+      // Most likely still retrieved by the receiver, try again later.
+      //
+      DEBUG ((DEBUG_INFO, "%a: Region 0x%lx not reclaimed - %r\n", __func__, Region->Handle, Status));
+      continue;
+    }
+
+    FreePages (Region->Base, Pool->PagesPerRegion);
+    ZeroMem (Region, sizeof (*Region));
+    Reclaimed++;
+  }
+
+  if (Reclaimed != 0) {
+    FfaLeasePoolRebuildFreeList (Pool);
+  }
+
+  return Reclaimed;
+}
+
+EFI_STATUS
+EFIAPI
+FfaLeasePoolCreate (
+  IN  UINT16          ReceiverId,
+  IN  UINT32          BufferSize,
+  IN  UINT32          BuffersPerRegion,
+  IN  UINT32          MaxRegions,
+  OUT FFA_LEASE_POOL  **Pool
+  )
+{
+  FFA_LEASE_POOL  *NewPool;
+  UINT64          Stride;
+  UINT64          RegionSize;
+
+  if ((Pool == NULL) || (BufferSize == 0) || (BuffersPerRegion == 0) ||
+      (MaxRegions == 0) || (MaxRegions > FFA_LEASE_POOL_MAX_REGIONS))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Lease offsets are 32-bit, and the free list links must stay clear of
+  // the two markers.
+  //
+  Stride     = ALIGN_VALUE ((UINT64)BufferSize, FFA_LEASE_BUFFER_ALIGNMENT);
+  RegionSize = Stride * BuffersPerRegion;
+  if ((RegionSize > MAX_UINT32) || ((UINT64)BuffersPerRegion * MaxRegions >= FFA_LEASE_LEASED)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  NewPool = AllocateZeroPool (sizeof (*NewPool));
+  if (NewPool == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  NewPool->Next = AllocatePool (sizeof (UINT32) * BuffersPerRegion * MaxRegions);
+  if (NewPool->Next == NULL) {
+    FreePool (NewPool);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  InitializeSpinLock (&NewPool->Lock);
+  NewPool->ReceiverId       = ReceiverId;
+  NewPool->BufferSize       = BufferSize;
+  NewPool->Stride           = (UINT32)Stride;
+  NewPool->BuffersPerRegion = BuffersPerRegion;
+  NewPool->PagesPerRegion   = EFI_SIZE_TO_PAGES ((UINTN)RegionSize);
+  NewPool->MaxRegions       = MaxRegions;
+  NewPool->FreeHead         = FFA_LEASE_FREE_END;
+
+  *Pool = NewPool;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaLeasePoolAcquire (
+  IN  FFA_LEASE_POOL  *Pool,
+  OUT VOID            **Buffer,
+  OUT FFA_LEASE       *Lease
+  )
+{
+  EFI_STATUS        Status;
+  FFA_LEASE_REGION  *Region;
+  UINT32            Index;
+  UINT32            Offset;
+
+  if ((Pool == NULL) || (Buffer == NULL) || (Lease == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  AcquireSpinLock (&Pool->Lock);
+
+  while (Pool->FreeHead == FFA_LEASE_FREE_END) {
+    ReleaseSpinLock (&Pool->Lock);
+
+    //
+    // One vCPU grows the pool at a time, the others wait for its buffers.
+    //
+    if (InterlockedCompareExchange32 (&Pool->Growing, 0, 1) == 0) {
+      Status = FfaLeasePoolGrow (Pool);
+      InterlockedCompareExchange32 (&Pool->Growing, 1, 0);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+    } else {
+      CpuPause ();
+    }
+
+    AcquireSpinLock (&Pool->Lock);
+  }
+
+  Index             = Pool->FreeHead;
+  Pool->FreeHead    = Pool->Next[Index];
+  Pool->Next[Index] = FFA_LEASE_LEASED;
+
+  Region = &Pool->Regions[Index / Pool->BuffersPerRegion];
+  Region->LeaseCount++;
+  Offset = (Index % Pool->BuffersPerRegion) * Pool->Stride;
+
+  Lease->Handle = Region->Handle;
+  Lease->Offset = Offset;
+  Lease->Size   = Pool->BufferSize;
+  *Buffer       = (UINT8 *)Region->Base + Offset;
+
+  ReleaseSpinLock (&Pool->Lock);
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaLeasePoolRelease (
+  IN FFA_LEASE_POOL   *Pool,
+  IN CONST FFA_LEASE  *Lease
+  )
+{
+  FFA_LEASE_REGION  *Region;
+  UINT32            RegionIndex;
+  UINT32            Index;
+
+  if ((Pool == NULL) || (Lease == NULL) || (Lease->Handle == 0) ||
+      ((Lease->Offset % Pool->Stride) != 0) ||
+      (Lease->Offset / Pool->Stride >= Pool->BuffersPerRegion))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  AcquireSpinLock (&Pool->Lock);
+
+  for (RegionIndex = 0; RegionIndex < Pool->MaxRegions; RegionIndex++) {
+    Region = &Pool->Regions[RegionIndex];
+    if ((Region->Base != NULL) && (Region->Handle == Lease->Handle)) {
+      break;
+    }
+  }
+
+  Index = RegionIndex * Pool->BuffersPerRegion + Lease->Offset / Pool->Stride;
+  if ((RegionIndex == Pool->MaxRegions) || (Pool->Next[Index] != FFA_LEASE_LEASED)) {
+    ReleaseSpinLock (&Pool->Lock);
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Pool->Next[Index] = Pool->FreeHead;
+  Pool->FreeHead    = Index;
+  Region->LeaseCount--;
+
+  ReleaseSpinLock (&Pool->Lock);
+  return EFI_SUCCESS;
+}
+
+UINTN
+EFIAPI
+FfaLeasePoolTrim (
+  IN FFA_LEASE_POOL  *Pool
+  )
+{
+  UINTN  Reclaimed;
+
+  if (Pool == NULL) {
+    return 0;
+  }
+
+  AcquireSpinLock (&Pool->Lock);
+  Reclaimed = FfaLeasePoolReclaimIdle (Pool);
+  ReleaseSpinLock (&Pool->Lock);
+
+  return Reclaimed;
+}
+
+EFI_STATUS
+EFIAPI
+FfaLeasePoolDestroy (
+  IN FFA_LEASE_POOL  *Pool
+  )
+{
+  UINT32  RegionIndex;
+
+  if (Pool == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  AcquireSpinLock (&Pool->Lock);
+
+  FfaLeasePoolReclaimIdle (Pool);
+  for (RegionIndex = 0; RegionIndex < Pool->MaxRegions; RegionIndex++) {
+    if (Pool->Regions[RegionIndex].Base != NULL) {
+      ReleaseSpinLock (&Pool->Lock);
+      return EFI_ACCESS_DENIED;
+    }
+  }
+
+  ReleaseSpinLock (&Pool->Lock);
+
+  FreePool (Pool->Next);
+  FreePool (Pool);
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaLeaseMap (
+  IN  UINT16           SenderId,
+  IN  CONST FFA_LEASE  *Lease,
+  OUT VOID             **Buffer
+  )
+{
+  EFI_STATUS         Status;
+  FFA_LEASE_MAPPING  *Map;
+  FFA_LEASE_MAPPING  *Free;
+  UINT64             Base;
+  UINT64             Size;
+  UINTN              Index;
+
+  if ((Lease == NULL) || (Buffer == NULL) || (Lease->Handle == 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  AcquireSpinLock (&mFfaLeaseMapLock);
+
+  while (TRUE) {
+    Map  = NULL;
+    Free = NULL;
+    for (Index = 0; Index < ARRAY_SIZE (mFfaLeaseMaps); Index++) {
+      if ((mFfaLeaseMaps[Index].Handle == Lease->Handle) && (mFfaLeaseMaps[Index].SenderId == SenderId)) {
+        Map = &mFfaLeaseMaps[Index];
+        break;
+      }
+
+      if ((Free == NULL) && (mFfaLeaseMaps[Index].Handle == 0)) {
+        Free = &mFfaLeaseMaps[Index];
+      }
+    }
+
+    if ((Map != NULL) && !Map->Busy) {
+      break;
+    }
+
+    if (Map != NULL) {
+      //
+      // Another vCPU is retrieving or relinquishing the region, look again
+      // once it is done.
+      //
+      ReleaseSpinLock (&mFfaLeaseMapLock);
+      CpuPause ();
+      AcquireSpinLock (&mFfaLeaseMapLock);
+      continue;
+    }
+
+    if (Free == NULL) {
+      ReleaseSpinLock (&mFfaLeaseMapLock);
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    //
+    // First lease seen in this region. Pool regions are a single physically
+    // contiguous allocation, anything else is not a lease region.
+    //
+    Free->SenderId = SenderId;
+    Free->Handle   = Lease->Handle;
+    Free->Busy     = TRUE;
+    ReleaseSpinLock (&mFfaLeaseMapLock);
+
+    Status = FfaExMemRetrieveSingle (Lease->Handle, SenderId, &Base, &Size);
+
+    AcquireSpinLock (&mFfaLeaseMapLock);
+    if (EFI_ERROR (Status)) {
+      ZeroMem (Free, sizeof (*Free));
+      ReleaseSpinLock (&mFfaLeaseMapLock);
+      return Status;
+    }
+
+    Map       = Free;
+    Map->Base = Base;
+    Map->Size = Size;
+    Map->Busy = FALSE;
+    break;
+  }
+
+  if ((Lease->Offset > Map->Size) || (Lease->Size > Map->Size - Lease->Offset)) {
+    ReleaseSpinLock (&mFfaLeaseMapLock);
+    return EFI_INVALID_PARAMETER;
+  }
+
+  *Buffer = (VOID *)(UINTN)(Map->Base + Lease->Offset);
+
+  ReleaseSpinLock (&mFfaLeaseMapLock);
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaLeaseUnmap (
+  IN UINT16  SenderId,
+  IN UINT64  Handle
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Index;
+
+  if (Handle == 0) {
+    return EFI_NOT_FOUND;
+  }
+
+  AcquireSpinLock (&mFfaLeaseMapLock);
+
+  for (Index = 0; Index < ARRAY_SIZE (mFfaLeaseMaps); Index++) {
+    if ((mFfaLeaseMaps[Index].Handle == Handle) && (mFfaLeaseMaps[Index].SenderId == SenderId)) {
+      break;
+    }
+  }
+
+  if ((Index == ARRAY_SIZE (mFfaLeaseMaps)) || mFfaLeaseMaps[Index].Busy) {
+    ReleaseSpinLock (&mFfaLeaseMapLock);
+    return EFI_NOT_FOUND;
+  }
+
+  mFfaLeaseMaps[Index].Busy = TRUE;
+  ReleaseSpinLock (&mFfaLeaseMapLock);
+
+  Status = FfaExMemRelinquish (Handle);
+
+  AcquireSpinLock (&mFfaLeaseMapLock);
+  if (EFI_ERROR (Status)) {
+    mFfaLeaseMaps[Index].Busy = FALSE;
+  } else {
+    ZeroMem (&mFfaLeaseMaps[Index], sizeof (mFfaLeaseMaps[Index]));
+  }
+
+  ReleaseSpinLock (&mFfaLeaseMapLock);
+  return Status;
+}
+
+/**
+  Initializes the receiver side mapping table.
+
+  @retval RETURN_SUCCESS  Always.
+**/
+RETURN_STATUS
+EFIAPI
+FfaLeasePoolLibConstructor (
+  VOID
+  )
+{
+  InitializeSpinLock (&mFfaLeaseMapLock);
+  return RETURN_SUCCESS;
+}
@@ -0,0 +1,367 @@
+/** @file
+  Host based unit tests for FfaLeasePoolLib.
+
+  Checks that steady state leases never trap, that a pool grows one region
+  at a time up to its limit, that trimming reclaims only idle regions, and
+  that a receiver maps a region once and sees the buffers the owner leased.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/ArmFfaSvc.h>
+#include <IndustryStandard/ArmFfaPartInfo.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/ArmSvcLib.h>
+#include <Library/ArmSmcLib.h>
+#include <Library/ArmFfaLibEx.h>
+#include <Library/FfaLeasePoolLib.h>
+#include <Library/MockSpmcLib.h>
+#include <Library/UnitTestLib.h>
+
+#define UNIT_TEST_APP_NAME     "FfaLeasePoolLib Host Unit Tests"
+#define UNIT_TEST_APP_VERSION  "1.0"
+
+//
+// Receiver of the pools under test.
+//
+#define TEST_SP_ID  0x8002
+
+#define TEST_BUFFER_SIZE         200
+#define TEST_BUFFERS_PER_REGION  4
+#define TEST_MAX_REGIONS         2
+#define TEST_ITERATIONS          100
+
+//
+// Receiver side mapping table, set up by the library constructor.
+//
+RETURN_STATUS
+EFIAPI
+FfaLeasePoolLibConstructor (
+  VOID
+  );
+
+/**
+  Resets the SPMC model and the library state before each test.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED  Always.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+ResetSpmc (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  MockSpmcResetAndInit ();
+  MockSpmcAddPartition (TEST_SP_ID, NULL);
+  FfaLeasePoolLibConstructor ();
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Only the first acquire shares a region, acquiring and releasing leases
+  afterwards never traps.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+SteadyStateTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  FFA_LEASE_POOL  *Pool;
+  FFA_LEASE       Lease;
+  FFA_LEASE       First;
+  VOID            *Buffer;
+  VOID            *FirstBuffer;
+  UINTN           Calls;
+  UINTN           Index;
+
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolCreate (TEST_SP_ID, TEST_BUFFER_SIZE, TEST_BUFFERS_PER_REGION, TEST_MAX_REGIONS, &Pool));
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount (), Calls);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolAcquire (Pool, &FirstBuffer, &First));
+  UT_ASSERT_NOT_EQUAL (First.Handle, 0);
+  UT_ASSERT_EQUAL (First.Offset, 0);
+  UT_ASSERT_EQUAL (First.Size, TEST_BUFFER_SIZE);
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolRelease (Pool, &First));
+
+  //
+  // The buffer just released is leased again, still warm in the cache.
+  //
+  Calls = MockSpmcGetCallCount ();
+  for (Index = 0; Index < TEST_ITERATIONS; Index++) {
+    UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolAcquire (Pool, &Buffer, &Lease));
+    UT_ASSERT_EQUAL ((UINTN)Buffer, (UINTN)FirstBuffer);
+    UT_ASSERT_MEM_EQUAL (&Lease, &First, sizeof (Lease));
+    SetMem (Buffer, TEST_BUFFER_SIZE, (UINT8)Index);
+    UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolRelease (Pool, &Lease));
+  }
+
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount (), Calls);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolDestroy (Pool));
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The pool grows by one shared region when every buffer is leased, up to its
+  maximum, and rejects a lease that is not outstanding.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+GrowExhaustTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  FFA_LEASE_POOL  *Pool;
+  FFA_LEASE       Leases[TEST_BUFFERS_PER_REGION * TEST_MAX_REGIONS];
+  VOID            *Buffers[TEST_BUFFERS_PER_REGION * TEST_MAX_REGIONS];
+  FFA_LEASE       Lease;
+  VOID            *Buffer;
+  UINTN           Calls;
+  UINTN           Index;
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolCreate (TEST_SP_ID, TEST_BUFFER_SIZE, TEST_BUFFERS_PER_REGION, TEST_MAX_REGIONS, &Pool));
+
+  Calls = MockSpmcGetCallCount ();
+  for (Index = 0; Index < ARRAY_SIZE (Leases); Index++) {
+    UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolAcquire (Pool, &Buffers[Index], &Leases[Index]));
+    UT_ASSERT_EQUAL (Leases[Index].Handle, Leases[Index - Index % TEST_BUFFERS_PER_REGION].Handle);
+    UT_ASSERT_EQUAL (Leases[Index].Offset % 64, 0);
+    UT_ASSERT_TRUE (Leases[Index].Offset >= (Index % TEST_BUFFERS_PER_REGION) * TEST_BUFFER_SIZE);
+  }
+
+  //
+  // One FFA_MEM_SHARE per region.
+  //
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, TEST_MAX_REGIONS);
+  UT_ASSERT_NOT_EQUAL (Leases[0].Handle, Leases[TEST_BUFFERS_PER_REGION].Handle);
+
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_STATUS_EQUAL (FfaLeasePoolAcquire (Pool, &Buffer, &Lease), EFI_OUT_OF_RESOURCES);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount (), Calls);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolRelease (Pool, &Leases[1]));
+  UT_ASSERT_STATUS_EQUAL (FfaLeasePoolRelease (Pool, &Leases[1]), EFI_INVALID_PARAMETER);
+
+  CopyMem (&Lease, &Leases[2], sizeof (Lease));
+  Lease.Offset++;
+  UT_ASSERT_STATUS_EQUAL (FfaLeasePoolRelease (Pool, &Lease), EFI_INVALID_PARAMETER);
+  Lease.Offset = Leases[2].Offset;
+  Lease.Handle = ~Lease.Handle;
+  UT_ASSERT_STATUS_EQUAL (FfaLeasePoolRelease (Pool, &Lease), EFI_INVALID_PARAMETER);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolAcquire (Pool, &Buffer, &Lease));
+  UT_ASSERT_EQUAL ((UINTN)Buffer, (UINTN)Buffers[1]);
+
+  for (Index = 0; Index < ARRAY_SIZE (Leases); Index++) {
+    UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolRelease (Pool, &Leases[Index]));
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolDestroy (Pool));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Trimming reclaims only idle regions, keeps a region the SPMC refuses to
+  reclaim, and a pool with a buffer leased cannot be destroyed.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+TrimTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  FFA_LEASE_POOL  *Pool;
+  FFA_LEASE       Leases[TEST_BUFFERS_PER_REGION + 1];
+  VOID            *Buffer;
+  UINTN           Calls;
+  UINTN           Index;
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolCreate (TEST_SP_ID, TEST_BUFFER_SIZE, TEST_BUFFERS_PER_REGION, TEST_MAX_REGIONS, &Pool));
+  for (Index = 0; Index < ARRAY_SIZE (Leases); Index++) {
+    UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolAcquire (Pool, &Buffer, &Leases[Index]));
+  }
+
+  //
+  // Free the first region, the second one keeps a lease.
+  //
+  for (Index = 0; Index < TEST_BUFFERS_PER_REGION; Index++) {
+    UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolRelease (Pool, &Leases[Index]));
+  }
+
+  MockSpmcInjectError (ARM_FID_FFA_MEM_RETRIEVE_RECLAIM, ARM_FFA_RET_DENIED, 0);
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_EQUAL (FfaLeasePoolTrim (Pool), 0);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+
+  UT_ASSERT_STATUS_EQUAL (FfaLeasePoolDestroy (Pool), EFI_ACCESS_DENIED);
+  UT_ASSERT_STATUS_EQUAL (FfaMemReclaim (Leases[0].Handle, 0), EFI_INVALID_PARAMETER);
+
+  //
+  // The pool is intact, the remaining lease can still be returned and the
+  // last region reclaimed.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolRelease (Pool, &Leases[TEST_BUFFERS_PER_REGION]));
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_EQUAL (FfaLeasePoolTrim (Pool), 1);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+  UT_ASSERT_STATUS_EQUAL (FfaMemReclaim (Leases[TEST_BUFFERS_PER_REGION].Handle, 0), EFI_INVALID_PARAMETER);
+
+  //
+  // An empty pool grows again on demand.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolAcquire (Pool, &Buffer, &Leases[0]));
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolRelease (Pool, &Leases[0]));
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolDestroy (Pool));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  The receiver retrieves a region on the first lease it maps and resolves
+  every later lease of that region without a trap.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+ReceiverMapTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  FFA_LEASE_POOL  *Pool;
+  FFA_LEASE       Leases[2];
+  FFA_LEASE       Lease;
+  VOID            *Buffers[2];
+  VOID            *Mapped;
+  UINTN           Calls;
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolCreate (TEST_SP_ID, TEST_BUFFER_SIZE, TEST_BUFFERS_PER_REGION, TEST_MAX_REGIONS, &Pool));
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolAcquire (Pool, &Buffers[0], &Leases[0]));
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolAcquire (Pool, &Buffers[1], &Leases[1]));
+
+  //
+  // The model shares memory with the caller itself, so both sides see the
+  // same address.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeaseMap (MOCK_SPMC_CALLER_ID, &Leases[0], &Mapped));
+  UT_ASSERT_EQUAL ((UINTN)Mapped, (UINTN)Buffers[0]);
+
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeaseMap (MOCK_SPMC_CALLER_ID, &Leases[1], &Mapped));
+  UT_ASSERT_EQUAL ((UINTN)Mapped, (UINTN)Buffers[1]);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount (), Calls);
+
+  CopyMem (&Lease, &Leases[1], sizeof (Lease));
+  Lease.Offset = EFI_PAGE_SIZE;
+  UT_ASSERT_STATUS_EQUAL (FfaLeaseMap (MOCK_SPMC_CALLER_ID, &Lease, &Mapped), EFI_INVALID_PARAMETER);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeaseUnmap (MOCK_SPMC_CALLER_ID, Leases[0].Handle));
+  UT_ASSERT_STATUS_EQUAL (FfaLeaseUnmap (MOCK_SPMC_CALLER_ID, Leases[0].Handle), EFI_NOT_FOUND);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolRelease (Pool, &Leases[0]));
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolRelease (Pool, &Leases[1]));
+  UT_ASSERT_NOT_EFI_ERROR (FfaLeasePoolDestroy (Pool));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initializes and runs the unit tests.
+
+  @retval EFI_SUCCESS  The tests ran.
+  @retval Others       The test framework could not be set up.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+UnitTestingEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      Suite;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_APP_NAME, UNIT_TEST_APP_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_APP_NAME, gEfiCallerBaseName, UNIT_TEST_APP_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (&Suite, Framework, "FfaLeasePoolLib Tests", "FfaLeasePoolLib", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for FfaLeasePoolLib Tests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (Suite, "Steady state leases do not trap", "SteadyState", SteadyStateTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Pool grows one region at a time", "GrowExhaust", GrowExhaustTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Trim reclaims idle regions", "Trim", TrimTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Receiver maps a region once", "ReceiverMap", ReceiverMapTest, ResetSpmc, NULL, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+
+  @param  argc  Unused.
+  @param  argv  Unused.
+
+  @retval 0  Always.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return UnitTestingEntry ();
+}
@@ -0,0 +1,660 @@
+/** @file
+  Shared memory ring transport over FF-A.
+
+  Each side keeps private copies of the indices it owns and of the ring
+  geometry, and never trusts the copy in the shared region: the peer can
+  rewrite it at any time. Indices read from the peer are checked against
+  the geometry before use.
+
+  A doorbell is rung when the consumer of a ring had caught up with the
+  producer before the new entries were published. The consumer publishes
+  its index and re-reads the producer index before going idle, and the
+  producer publishes its index before reading the consumer index, so at
+  least one side always sees the other's update and no wakeup is lost.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/ArmFfaSvc.h>
+#include <IndustryStandard/ArmFfaPartInfo.h>
+#include <Library/ArmSvcLib.h>
+#include <Library/ArmSmcLib.h>
+#include <Library/ArmFfaLib.h>
+#include <Library/ArmFfaLibEx.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/FfaRingTransportLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+STATIC_ASSERT (
+  (OFFSET_OF (FFA_RING_HEADER, Requests) == 64) && (sizeof (FFA_RING_INDICES) == 128),
+  "The indices of each ring must start on a cache line"
+  );
+
+struct _FFA_RING_TRANSPORT {
+  FFA_RING_HEADER    *Header;
+  FFA_RING_ENTRY     *Requests;
+  FFA_RING_ENTRY     *Completions;
+  UINTN              Pages;
+  UINT64             Handle;
+  BOOLEAN            IsServer;
+  UINT16             PeerId;
+  UINT32             EntryCount;
+  UINT32             RequestDoorbell;
+  UINT32             CompletionDoorbell;
+  //
+  // Indices owned by this side. On the client, Submit reads the completion
+  // consumer index Reap advances, possibly from another vCPU.
+  //
+  UINT32             RequestProducer;      // Client
+  volatile UINT32    CompletionConsumer;   // Client
+  UINT32             RequestConsumer;      // Server
+  UINT32             CompletionProducer;   // Server
+};
+
+/**
+  Returns the size of the region holding rings of a given number of entries.
+
+  @param  EntryCount  Number of entries of each ring.
+
+  @retval The size in bytes.
+**/
+STATIC
+UINTN
+FfaRingRegionSize (
+  IN UINT32  EntryCount
+  )
+{
+  return sizeof (FFA_RING_HEADER) + 2 * (UINTN)EntryCount * sizeof (FFA_RING_ENTRY);
+}
+
+/**
+  Allocates a transport over a mapped region.
+
+  @param  Base        The region.
+  @param  EntryCount  Number of entries of each ring, validated.
+
+  @retval The transport, or NULL if it could not be allocated.
+**/
+STATIC
+FFA_RING_TRANSPORT *
+FfaRingAllocate (
+  IN VOID    *Base,
+  IN UINT32  EntryCount
+  )
+{
+  FFA_RING_TRANSPORT  *Transport;
+
+  Transport = AllocateZeroPool (sizeof (*Transport));
+  if (Transport == NULL) {
+    return NULL;
+  }
+
+  Transport->Header      = Base;
+  Transport->Requests    = (FFA_RING_ENTRY *)(Transport->Header + 1);
+  Transport->Completions = Transport->Requests + EntryCount;
+  Transport->EntryCount  = EntryCount;
+  return Transport;
+}
+
+/**
+  Rings a doorbell of the peer.
+
+  @param  Transport  The transport.
+  @param  Doorbell   Notification ID, or FFA_RING_NO_DOORBELL.
+
+  @retval EFI_SUCCESS  The doorbell was rung, or there is none.
+  @retval Others       FFA_NOTIFICATION_SET failed.
+**/
+STATIC
+EFI_STATUS
+FfaRingDoorbell (
+  IN FFA_RING_TRANSPORT  *Transport,
+  IN UINT32              Doorbell
+  )
+{
+  EFI_STATUS  Status;
+
+  if (Doorbell == FFA_RING_NO_DOORBELL) {
+    return EFI_SUCCESS;
+  }
+
+  Status = FfaNotificationSet (Transport->PeerId, 0, LShiftU64 (1, Doorbell));
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: Doorbell %u of 0x%x not rung - %r\n", __func__, Doorbell, Transport->PeerId, Status));
+  }
+
+  return Status;
+}
+
+/**
+  Binds a doorbell rung by the peer.
+
+  @param  PeerId    Partition ID of the peer.
+  @param  Doorbell  Notification ID, or FFA_RING_NO_DOORBELL.
+  @param  Bind      TRUE to bind the doorbell, FALSE to unbind it.
+
+  @retval EFI_SUCCESS  The doorbell was bound or unbound, or there is none.
+  @retval Others       FFA_NOTIFICATION_BIND or FFA_NOTIFICATION_UNBIND
+                       failed.
+**/
+STATIC
+EFI_STATUS
+FfaRingBindDoorbell (
+  IN UINT16   PeerId,
+  IN UINT32   Doorbell,
+  IN BOOLEAN  Bind
+  )
+{
+  if (Doorbell == FFA_RING_NO_DOORBELL) {
+    return EFI_SUCCESS;
+  }
+
+  if (Bind) {
+    return FfaNotificationBind (PeerId, 0, LShiftU64 (1, Doorbell));
+  }
+
+  return FfaNotificationUnbind (PeerId, LShiftU64 (1, Doorbell));
+}
+
+/**
+  Finds the handler of a service.
+
+  @param  Services      Service GUID to handler table.
+  @param  ServiceCount  Number of entries in Services.
+  @param  ServiceGuid   The service GUID.
+
+  @retval The handler, or NULL if the service is not in the table.
+**/
+STATIC
+FFA_EX_SERVICE_HANDLER
+FfaRingFindService (
+  IN CONST FFA_RING_SERVICE  *Services,
+  IN UINTN                   ServiceCount,
+  IN CONST EFI_GUID          *ServiceGuid
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < ServiceCount; Index++) {
+    if (CompareGuid (&Services[Index].ServiceGuid, ServiceGuid)) {
+      return Services[Index].Handler;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Runs one request through the handler of its service.
+
+  The request is copied out of the shared region first, so that the client
+  cannot change it while the handler reads it.
+
+  @param  Transport     The transport.
+  @param  PartitionId   Partition ID of the server.
+  @param  Services      Service GUID to handler table.
+  @param  ServiceCount  Number of entries in Services.
+  @param  Request       The request, in the shared region.
+  @param  Completion    Receives the completion, in the shared region.
+
+**/
+STATIC
+VOID
+FfaRingServeOne (
+  IN  FFA_RING_TRANSPORT      *Transport,
+  IN  UINT16                  PartitionId,
+  IN  CONST FFA_RING_SERVICE  *Services,
+  IN  UINTN                   ServiceCount,
+  IN  CONST FFA_RING_ENTRY    *Request,
+  OUT FFA_RING_ENTRY          *Completion
+  )
+{
+  FFA_RING_ENTRY          Entry;
+  FFA_EX_SERVICE_HANDLER  Handler;
+  DIRECT_MSG_ARGS_EX      DirectRequest;
+  DIRECT_MSG_ARGS_EX      DirectResponse;
+  UINTN                   Index;
+
+  CopyMem (&Entry, Request, sizeof (Entry));
+  Entry.Status   = FFA_RING_STATUS_NO_SERVICE;
+  Entry.Reserved = 0;
+
+  Handler = FfaRingFindService (Services, ServiceCount, &Entry.ServiceGuid);
+  if (Handler != NULL) {
+    ZeroMem (&DirectRequest, sizeof (DirectRequest));
+    DirectRequest.FunctionId    = ARM_FID_FFA_MSG_SEND_DIRECT_REQ2;
+    DirectRequest.SourceId      = Transport->PeerId;
+    DirectRequest.DestinationId = PartitionId;
+    CopyGuid (&DirectRequest.ServiceGuid, &Entry.ServiceGuid);
+    for (Index = 0; Index < FFA_EX_DIRECT_MSG_PAYLOAD_COUNT; Index++) {
+      (&DirectRequest.Arg0)[Index] = (UINTN)Entry.Args[Index];
+    }
+
+    ZeroMem (&DirectResponse, sizeof (DirectResponse));
+    DirectResponse.FunctionId    = ARM_FID_FFA_MSG_SEND_DIRECT_RESP2;
+    DirectResponse.SourceId      = PartitionId;
+    DirectResponse.DestinationId = Transport->PeerId;
+    CopyGuid (&DirectResponse.ServiceGuid, &Entry.ServiceGuid);
+
+    Handler (&DirectRequest, &DirectResponse);
+
+    for (Index = 0; Index < FFA_EX_DIRECT_MSG_PAYLOAD_COUNT; Index++) {
+      Entry.Args[Index] = (&DirectResponse.Arg0)[Index];
+    }
+
+    Entry.Status = FFA_RING_STATUS_SUCCESS;
+  } else {
+    ZeroMem (Entry.Args, sizeof (Entry.Args));
+  }
+
+  CopyMem (Completion, &Entry, sizeof (Entry));
+}
+
+EFI_STATUS
+EFIAPI
+FfaRingTransportCreate (
+  IN  UINT16              ServerId,
+  IN  UINT32              EntryCount,
+  IN  UINT32              RequestDoorbell,
+  IN  UINT32              CompletionDoorbell,
+  OUT FFA_RING_TRANSPORT  **Transport,
+  OUT UINT64              *Handle
+  )
+{
+  EFI_STATUS          Status;
+  FFA_RING_TRANSPORT  *NewTransport;
+  FFA_RING_HEADER     *Header;
+  UINTN               Pages;
+
+  if ((Transport == NULL) || (Handle == NULL) || (EntryCount == 0) ||
+      (EntryCount > FFA_RING_MAX_ENTRIES) || ((EntryCount & (EntryCount - 1)) != 0) ||
+      (RequestDoorbell >= 64) || ((CompletionDoorbell >= 64) && (CompletionDoorbell != FFA_RING_NO_DOORBELL)))
+  {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Pages  = EFI_SIZE_TO_PAGES (FfaRingRegionSize (EntryCount));
+  Header = AllocatePages (Pages);
+  if (Header == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  NewTransport = FfaRingAllocate (Header, EntryCount);
+  if (NewTransport == NULL) {
+    FreePages (Header, Pages);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  ZeroMem (Header, EFI_PAGES_TO_SIZE (Pages));
+  Header->Signature          = FFA_RING_SIGNATURE;
+  Header->EntryCount         = EntryCount;
+  Header->RequestDoorbell    = RequestDoorbell;
+  Header->CompletionDoorbell = CompletionDoorbell;
+
+  NewTransport->Pages              = Pages;
+  NewTransport->PeerId             = ServerId;
+  NewTransport->RequestDoorbell    = RequestDoorbell;
+  NewTransport->CompletionDoorbell = CompletionDoorbell;
+
+  Status = FfaExMemShareSingle (ServerId, Header, Pages, &NewTransport->Handle);
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: Failed to share the rings with 0x%x - %r\n", __func__, ServerId, Status));
+    FreePool (NewTransport);
+    FreePages (Header, Pages);
+    return Status;
+  }
+
+  Status = FfaRingBindDoorbell (ServerId, CompletionDoorbell, TRUE);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: Failed to bind doorbell %u - %r\n", __func__, CompletionDoorbell, Status));
+    FfaMemReclaim (NewTransport->Handle, 0);
+    FreePool (NewTransport);
+    FreePages (Header, Pages);
+    return Status;
+  }
+
+  *Handle    = NewTransport->Handle;
+  *Transport = NewTransport;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaRingTransportDestroy (
+  IN FFA_RING_TRANSPORT  *Transport
+  )
+{
+  EFI_STATUS  Status;
+
+  if ((Transport == NULL) || Transport->IsServer) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = FfaMemReclaim (Transport->Handle, 0);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "%a: Rings 0x%lx not reclaimed - %r\n", __func__, Transport->Handle, Status));
+    return EFI_ACCESS_DENIED;
+  }
+
+  FfaRingBindDoorbell (Transport->PeerId, Transport->CompletionDoorbell, FALSE);
+  FreePages (Transport->Header, Transport->Pages);
+  FreePool (Transport);
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaRingTransportSubmit (
+  IN  FFA_RING_TRANSPORT    *Transport,
+  IN  CONST FFA_RING_ENTRY  *Requests,
+  IN  UINTN                 Count,
+  OUT UINTN                 *Submitted
+  )
+{
+  FFA_RING_ENTRY  *Entry;
+  UINT32          Producer;
+  UINT32          Credit;
+  UINTN           Index;
+
+  if ((Transport == NULL) || (Requests == NULL) || (Submitted == NULL) || Transport->IsServer) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  *Submitted = 0;
+  if (Count == 0) {
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Requests not reaped yet are either still queued or hold a slot of the
+  // completion ring, so limiting them to the ring size keeps both rings
+  // from overflowing.
+  //
+  Producer = Transport->RequestProducer;
+  Credit   = Transport->EntryCount - (Producer - Transport->CompletionConsumer);
+  if (Credit == 0) {
+    return EFI_NOT_READY;
+  }
+
+  Count = MIN (Count, Credit);
+  for (Index = 0; Index < Count; Index++) {
+    Entry = &Transport->Requests[(Producer + Index) & (Transport->EntryCount - 1)];
+    CopyMem (Entry, &Requests[Index], sizeof (*Entry));
+    Entry->Status   = 0;
+    Entry->Reserved = 0;
+  }
+
+  MemoryFence ();
+  Transport->RequestProducer           = Producer + (UINT32)Count;
+  Transport->Header->Requests.Producer = Transport->RequestProducer;
+  MemoryFence ();
+
+  *Submitted = Count;
+  if (Transport->Header->Requests.Consumer != Producer) {
+    //
+    // The server has not caught up with the earlier requests yet and will
+    // see these before going idle.
+    //
+    return EFI_SUCCESS;
+  }
+
+  return FfaRingDoorbell (Transport, Transport->RequestDoorbell);
+}
+
+EFI_STATUS
+EFIAPI
+FfaRingTransportReap (
+  IN     FFA_RING_TRANSPORT  *Transport,
+  OUT    FFA_RING_ENTRY      *Completions,
+  IN OUT UINTN               *Count
+  )
+{
+  UINT32  Producer;
+  UINT32  Consumer;
+  UINTN   Capacity;
+  UINTN   Reaped;
+
+  if ((Transport == NULL) || (Completions == NULL) || (Count == NULL) || Transport->IsServer) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Capacity = *Count;
+  Reaped   = 0;
+  Consumer = Transport->CompletionConsumer;
+  while (Reaped < Capacity) {
+    Producer = Transport->Header->Completions.Producer;
+    if ((UINT32)(Producer - Consumer) > Transport->EntryCount) {
+      *Count = Reaped;
+      return EFI_PROTOCOL_ERROR;
+    }
+
+    if (Producer == Consumer) {
+      break;
+    }
+
+    MemoryFence ();
+    while ((Consumer != Producer) && (Reaped < Capacity)) {
+      CopyMem (
+        &Completions[Reaped],
+        &Transport->Completions[Consumer & (Transport->EntryCount - 1)],
+        sizeof (FFA_RING_ENTRY)
+        );
+      Consumer++;
+      Reaped++;
+    }
+
+    //
+    // Publish before checking for more, see the file header.
+    //
+    MemoryFence ();
+    Transport->CompletionConsumer           = Consumer;
+    Transport->Header->Completions.Consumer = Consumer;
+    MemoryFence ();
+  }
+
+  *Count = Reaped;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaRingTransportAttach (
+  IN  UINT16              ClientId,
+  IN  UINT64              Handle,
+  OUT FFA_RING_TRANSPORT  **Transport
+  )
+{
+  EFI_STATUS          Status;
+  FFA_RING_TRANSPORT  *NewTransport;
+  FFA_RING_HEADER     *Header;
+  UINT64              Base;
+  UINT64              Size;
+  UINT32              EntryCount;
+
+  if (Transport == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = FfaExMemRetrieveSingle (Handle, ClientId, &Base, &Size);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // The rings are a single physically contiguous allocation. The geometry is
+  // read once here and never again from the shared region.
+  //
+  Header     = (FFA_RING_HEADER *)(UINTN)Base;
+  EntryCount = 0;
+  if ((Size >= sizeof (*Header)) && (Header->Signature == FFA_RING_SIGNATURE)) {
+    EntryCount = Header->EntryCount;
+  }
+
+  if ((EntryCount == 0) || (EntryCount > FFA_RING_MAX_ENTRIES) || ((EntryCount & (EntryCount - 1)) != 0) ||
+      (FfaRingRegionSize (EntryCount) > Size) || (Header->RequestDoorbell >= 64) ||
+      ((Header->CompletionDoorbell >= 64) && (Header->CompletionDoorbell != FFA_RING_NO_DOORBELL)))
+  {
+    DEBUG ((DEBUG_ERROR, "%a: Region 0x%lx of 0x%x does not hold rings\n", __func__, Handle, ClientId));
+    FfaExMemRelinquish (Handle);
+    return EFI_UNSUPPORTED;
+  }
+
+  NewTransport = FfaRingAllocate (Header, EntryCount);
+  if (NewTransport == NULL) {
+    FfaExMemRelinquish (Handle);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  NewTransport->Handle             = Handle;
+  NewTransport->IsServer           = TRUE;
+  NewTransport->PeerId             = ClientId;
+  NewTransport->RequestDoorbell    = Header->RequestDoorbell;
+  NewTransport->CompletionDoorbell = Header->CompletionDoorbell;
+  NewTransport->RequestConsumer    = Header->Requests.Consumer;
+  NewTransport->CompletionProducer = Header->Completions.Producer;
+
+  Status = FfaRingBindDoorbell (ClientId, NewTransport->RequestDoorbell, TRUE);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: Failed to bind doorbell %u - %r\n", __func__, NewTransport->RequestDoorbell, Status));
+    FfaExMemRelinquish (Handle);
+    FreePool (NewTransport);
+    return Status;
+  }
+
+  *Transport = NewTransport;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaRingTransportDetach (
+  IN FFA_RING_TRANSPORT  *Transport
+  )
+{
+  EFI_STATUS  Status;
+
+  if ((Transport == NULL) || !Transport->IsServer) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = FfaExMemRelinquish (Transport->Handle);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  FfaRingBindDoorbell (Transport->PeerId, Transport->RequestDoorbell, FALSE);
+  FreePool (Transport);
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+EFIAPI
+FfaRingTransportServe (
+  IN  FFA_RING_TRANSPORT      *Transport,
+  IN  CONST FFA_RING_SERVICE  *Services,
+  IN  UINTN                   ServiceCount,
+  OUT UINTN                   *Served OPTIONAL
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      Producer;
+  UINT32      Consumer;
+  UINT32      CompletionProducer;
+  UINT32      CompletionConsumer;
+  UINT32      Mask;
+  UINT16      PartitionId;
+  UINTN       Count;
+
+  if (Served != NULL) {
+    *Served = 0;
+  }
+
+  if ((Transport == NULL) || ((Services == NULL) && (ServiceCount != 0)) || !Transport->IsServer) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = FfaExGetPartitionId (&PartitionId);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Mask     = Transport->EntryCount - 1;
+  Consumer = Transport->RequestConsumer;
+  Count    = 0;
+  for ( ; ;) {
+    Producer = Transport->Header->Requests.Producer;
+    if ((UINT32)(Producer - Consumer) > Transport->EntryCount) {
+      Status = EFI_PROTOCOL_ERROR;
+      break;
+    }
+
+    if (Producer == Consumer) {
+      break;
+    }
+
+    MemoryFence ();
+    CompletionProducer = Transport->CompletionProducer;
+    while (Consumer != Producer) {
+      //
+      // The client never has more requests in flight than the ring holds,
+      // so a full completion ring means the client broke the protocol.
+      //
+      CompletionConsumer = Transport->Header->Completions.Consumer;
+      if ((UINT32)(CompletionProducer - CompletionConsumer) >= Transport->EntryCount) {
+        Status = EFI_PROTOCOL_ERROR;
+        break;
+      }
+
+      FfaRingServeOne (
+        Transport,
+        PartitionId,
+        Services,
+        ServiceCount,
+        &Transport->Requests[Consumer & Mask],
+        &Transport->Completions[CompletionProducer & Mask]
+        );
+      Consumer++;
+      CompletionProducer++;
+      Count++;
+    }
+
+    //
+    // Post the completions of this pass, then publish the request consumer
+    // index before checking for more, see the file header.
+    //
+    if (CompletionProducer != Transport->CompletionProducer) {
+      MemoryFence ();
+      Transport->Header->Completions.Producer = CompletionProducer;
+      MemoryFence ();
+      if (Transport->Header->Completions.Consumer == Transport->CompletionProducer) {
+        FfaRingDoorbell (Transport, Transport->CompletionDoorbell);
+      }
+
+      Transport->CompletionProducer = CompletionProducer;
+    }
+
+    Transport->RequestConsumer           = Consumer;
+    Transport->Header->Requests.Consumer = Consumer;
+    MemoryFence ();
+
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+  }
+
+  if (Served != NULL) {
+    *Served = Count;
+  }
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "%a: Rings of 0x%x corrupted - %r\n", __func__, Transport->PeerId, Status));
+  }
+
+  return Status;
+}
@@ -0,0 +1,560 @@
+/** @file
+  Host based unit tests for FfaRingTransportLib.
+
+  The client and the server of a transport both run in this process, the
+  SPMC model sharing the ring region with its own caller. Checks that
+  requests reach the service handlers, that doorbells are only rung when a
+  ring goes from empty to non-empty, that requests in flight never exceed the
+  ring, and that corrupt indices and regions without rings are refused.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/ArmFfaSvc.h>
+#include <IndustryStandard/ArmFfaPartInfo.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/ArmSvcLib.h>
+#include <Library/ArmSmcLib.h>
+#include <Library/ArmFfaLibEx.h>
+#include <Library/FfaRingTransportLib.h>
+#include <Library/MockSpmcLib.h>
+#include <Library/TestServiceLib.h>
+#include <Library/UnitTestLib.h>
+#include <Guid/TestServiceFfa.h>
+
+#define UNIT_TEST_APP_NAME     "FfaRingTransportLib Host Unit Tests"
+#define UNIT_TEST_APP_VERSION  "1.0"
+
+//
+// Server of the transports under test. The client is the caller of the
+// model, MOCK_SPMC_CALLER_ID.
+//
+#define TEST_SP_ID  0x8002
+
+#define TEST_ENTRY_COUNT          8
+#define TEST_REQUEST_DOORBELL     3
+#define TEST_COMPLETION_DOORBELL  5
+
+#define TEST_ECHO_GUID \
+  { 0x5d1a7c39, 0x2b84, 0x4e6f, { 0x91, 0x0c, 0x3e, 0x7a, 0x58, 0xd2, 0x46, 0xb1 } }
+
+STATIC CONST EFI_GUID  mTestEchoGuid    = TEST_ECHO_GUID;
+STATIC CONST EFI_GUID  mTestServiceGuid = TEST_SERVICE_UUID;
+
+//
+// Requests seen by EchoHandler since the last reset.
+//
+STATIC UINTN  mEchoCount;
+
+/**
+  Resets the SPMC model and the library state before each test.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED  Always.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+ResetSpmc (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  MockSpmcResetAndInit ();
+  MockSpmcAddPartition (TEST_SP_ID, NULL);
+  mEchoCount = 0;
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Service handler answering each request with its payload plus one.
+
+  @param  Request   The request.
+  @param  Response  The response.
+
+**/
+STATIC
+VOID
+EchoHandler (
+  IN  DIRECT_MSG_ARGS_EX  *Request,
+  OUT DIRECT_MSG_ARGS_EX  *Response
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < FFA_EX_DIRECT_MSG_PAYLOAD_COUNT; Index++) {
+    (&Response->Arg0)[Index] = (&Request->Arg0)[Index] + 1;
+  }
+
+  Response->Arg13 = Request->SourceId;
+  mEchoCount++;
+}
+
+STATIC CONST FFA_RING_SERVICE  mTestServices[] = {
+  { TEST_ECHO_GUID,    EchoHandler       },
+  { TEST_SERVICE_UUID, TestServiceHandle },
+};
+
+/**
+  Fills a request for the echo service.
+
+  @param  Request  The request.
+  @param  Cookie   Cookie and first payload register of the request.
+
+**/
+STATIC
+VOID
+EchoRequest (
+  OUT FFA_RING_ENTRY  *Request,
+  IN  UINT64          Cookie
+  )
+{
+  ZeroMem (Request, sizeof (*Request));
+  Request->Cookie = Cookie;
+  CopyGuid (&Request->ServiceGuid, &mTestEchoGuid);
+  Request->Args[0] = Cookie;
+}
+
+/**
+  Records the base of a retrieved region.
+
+  @param  Constituents      Constituents of the current fragment.
+  @param  ConstituentCount  Number of entries in Constituents.
+  @param  Context           Receives the base address.
+
+  @retval EFI_SUCCESS  Always.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+GetBaseHandler (
+  IN CONST FFA_EX_MEM_CONSTITUENT_DESC  *Constituents,
+  IN UINT32                             ConstituentCount,
+  IN VOID                               *Context
+  )
+{
+  *(UINT64 *)Context = Constituents[0].Address;
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns the header of the rings shared last, as the server would map it.
+
+  @param  Handle  Handle of the region.
+
+  @retval The header, or NULL if the region could not be retrieved.
+**/
+STATIC
+FFA_RING_HEADER *
+GetHeader (
+  IN UINT64  Handle
+  )
+{
+  UINT64  Base;
+
+  Base = 0;
+  if (EFI_ERROR (FfaExMemRetrieve (Handle, MOCK_SPMC_CALLER_ID, FFA_EX_MEM_PERM_RW, GetBaseHandler, &Base, NULL, NULL))) {
+    return NULL;
+  }
+
+  return (FFA_RING_HEADER *)(UINTN)Base;
+}
+
+/**
+  Creates a transport to TEST_SP_ID and attaches to it as the server.
+
+  @param  Client  Receives the client end.
+  @param  Server  Receives the server end.
+  @param  Header  Optional, receives the header of the rings.
+
+  @retval EFI_SUCCESS  Both ends are ready.
+  @retval Others       Creating or attaching failed.
+**/
+STATIC
+EFI_STATUS
+CreatePair (
+  OUT FFA_RING_TRANSPORT  **Client,
+  OUT FFA_RING_TRANSPORT  **Server,
+  OUT FFA_RING_HEADER     **Header OPTIONAL
+  )
+{
+  EFI_STATUS  Status;
+  UINT64      Handle;
+
+  Status = FfaRingTransportCreate (TEST_SP_ID, TEST_ENTRY_COUNT, TEST_REQUEST_DOORBELL, TEST_COMPLETION_DOORBELL, Client, &Handle);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (Header != NULL) {
+    *Header = GetHeader (Handle);
+  }
+
+  return FfaRingTransportAttach (MOCK_SPMC_CALLER_ID, Handle, Server);
+}
+
+/**
+  Requests reach their handler and complete in order, and a burst costs one
+  doorbell each way.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+RoundTripTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  FFA_RING_TRANSPORT  *Client;
+  FFA_RING_TRANSPORT  *Server;
+  FFA_RING_ENTRY      Requests[5];
+  FFA_RING_ENTRY      Completions[TEST_ENTRY_COUNT];
+  UINTN               Count;
+  UINTN               Calls;
+  UINTN               Index;
+
+  UT_ASSERT_NOT_EFI_ERROR (CreatePair (&Client, &Server, NULL));
+
+  for (Index = 0; Index < ARRAY_SIZE (Requests); Index++) {
+    EchoRequest (&Requests[Index], 100 + Index);
+  }
+
+  CopyGuid (&Requests[4].ServiceGuid, &mTestServiceGuid);
+  Requests[4].Args[0] = MAX_UINT32;
+
+  //
+  // The first submission rings the doorbell, later ones find the server
+  // busy and do not trap at all.
+  //
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportSubmit (Client, &Requests[0], 2, &Count));
+  UT_ASSERT_EQUAL (Count, 2);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+  UT_ASSERT_EQUAL (MockSpmcGetPendingNotifications (TEST_SP_ID, TRUE), BIT3);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportSubmit (Client, &Requests[2], 3, &Count));
+  UT_ASSERT_EQUAL (Count, 3);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+
+  //
+  // One wakeup drains the whole burst.
+  //
+  Calls = MockSpmcGetCallCount ();
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportServe (Server, mTestServices, ARRAY_SIZE (mTestServices), &Count));
+  UT_ASSERT_EQUAL (Count, ARRAY_SIZE (Requests));
+  UT_ASSERT_EQUAL (mEchoCount, 4);
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 1);
+  UT_ASSERT_EQUAL (MockSpmcGetPendingNotifications (MOCK_SPMC_CALLER_ID, TRUE), BIT5);
+
+  Calls = MockSpmcGetCallCount ();
+  Count = ARRAY_SIZE (Completions);
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportReap (Client, Completions, &Count));
+  UT_ASSERT_EQUAL (Count, ARRAY_SIZE (Requests));
+  UT_ASSERT_EQUAL (MockSpmcGetCallCount (), Calls);
+
+  for (Index = 0; Index < 4; Index++) {
+    UT_ASSERT_EQUAL (Completions[Index].Cookie, 100 + Index);
+    UT_ASSERT_EQUAL (Completions[Index].Status, FFA_RING_STATUS_SUCCESS);
+    UT_ASSERT_EQUAL (Completions[Index].Args[0], 101 + Index);
+    UT_ASSERT_EQUAL (Completions[Index].Args[13], MOCK_SPMC_CALLER_ID);
+  }
+
+  UT_ASSERT_EQUAL (Completions[4].Status, FFA_RING_STATUS_SUCCESS);
+  UT_ASSERT_EQUAL (Completions[4].Args[0], (UINT64)TEST_STATUS_INVALID_PARAMETER);
+
+  Count = ARRAY_SIZE (Completions);
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportReap (Client, Completions, &Count));
+  UT_ASSERT_EQUAL (Count, 0);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportDetach (Server));
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportDestroy (Client));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A request for a service the server does not offer completes with
+  FFA_RING_STATUS_NO_SERVICE.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+NoServiceTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  FFA_RING_TRANSPORT  *Client;
+  FFA_RING_TRANSPORT  *Server;
+  FFA_RING_ENTRY      Request;
+  FFA_RING_ENTRY      Completion;
+  UINTN               Count;
+
+  UT_ASSERT_NOT_EFI_ERROR (CreatePair (&Client, &Server, NULL));
+
+  EchoRequest (&Request, 7);
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportSubmit (Client, &Request, 1, &Count));
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportServe (Server, &mTestServices[1], 1, &Count));
+  UT_ASSERT_EQUAL (Count, 1);
+  UT_ASSERT_EQUAL (mEchoCount, 0);
+
+  Count = 1;
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportReap (Client, &Completion, &Count));
+  UT_ASSERT_EQUAL (Count, 1);
+  UT_ASSERT_EQUAL (Completion.Cookie, 7);
+  UT_ASSERT_EQUAL (Completion.Status, FFA_RING_STATUS_NO_SERVICE);
+  UT_ASSERT_EQUAL (Completion.Args[0], 0);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportDetach (Server));
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportDestroy (Client));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A client cannot have more requests in flight than the ring holds, and the
+  doorbells ring again once a ring was drained.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+CreditTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  FFA_RING_TRANSPORT  *Client;
+  FFA_RING_TRANSPORT  *Server;
+  FFA_RING_ENTRY      Requests[TEST_ENTRY_COUNT + 2];
+  FFA_RING_ENTRY      Completions[TEST_ENTRY_COUNT];
+  UINTN               Count;
+  UINTN               Calls;
+  UINTN               Index;
+  UINTN               Lap;
+
+  UT_ASSERT_NOT_EFI_ERROR (CreatePair (&Client, &Server, NULL));
+
+  for (Index = 0; Index < ARRAY_SIZE (Requests); Index++) {
+    EchoRequest (&Requests[Index], Index);
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportSubmit (Client, Requests, ARRAY_SIZE (Requests), &Count));
+  UT_ASSERT_EQUAL (Count, TEST_ENTRY_COUNT);
+  UT_ASSERT_STATUS_EQUAL (FfaRingTransportSubmit (Client, Requests, 1, &Count), EFI_NOT_READY);
+  UT_ASSERT_EQUAL (Count, 0);
+
+  //
+  // Served but not reaped requests still hold their credit.
+  //
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportServe (Server, mTestServices, ARRAY_SIZE (mTestServices), &Count));
+  UT_ASSERT_EQUAL (Count, TEST_ENTRY_COUNT);
+  UT_ASSERT_STATUS_EQUAL (FfaRingTransportSubmit (Client, Requests, 1, &Count), EFI_NOT_READY);
+
+  Count = 3;
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportReap (Client, Completions, &Count));
+  UT_ASSERT_EQUAL (Count, 3);
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportSubmit (Client, &Requests[TEST_ENTRY_COUNT], 2, &Count));
+  UT_ASSERT_EQUAL (Count, 2);
+
+  //
+  // Several laps of the rings, each ringing both doorbells once since both
+  // rings were drained in between.
+  //
+  Count = ARRAY_SIZE (Completions);
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportServe (Server, mTestServices, ARRAY_SIZE (mTestServices), NULL));
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportReap (Client, Completions, &Count));
+  UT_ASSERT_EQUAL (Count, TEST_ENTRY_COUNT - 1);
+  UT_ASSERT_EQUAL (Completions[Count - 1].Cookie, TEST_ENTRY_COUNT + 1);
+
+  for (Lap = 0; Lap < 3; Lap++) {
+    Calls = MockSpmcGetCallCount ();
+    UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportSubmit (Client, Requests, TEST_ENTRY_COUNT - 1, &Count));
+    UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportServe (Server, mTestServices, ARRAY_SIZE (mTestServices), NULL));
+    Count = ARRAY_SIZE (Completions);
+    UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportReap (Client, Completions, &Count));
+    UT_ASSERT_EQUAL (Count, TEST_ENTRY_COUNT - 1);
+    UT_ASSERT_EQUAL (MockSpmcGetCallCount () - Calls, 2);
+    for (Index = 0; Index < Count; Index++) {
+      UT_ASSERT_EQUAL (Completions[Index].Args[0], Index + 1);
+    }
+  }
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportDetach (Server));
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportDestroy (Client));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Indices rewritten by the peer are refused rather than followed out of the
+  rings.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+CorruptIndicesTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  FFA_RING_TRANSPORT  *Client;
+  FFA_RING_TRANSPORT  *Server;
+  FFA_RING_HEADER     *Header;
+  FFA_RING_ENTRY      Completions[TEST_ENTRY_COUNT];
+  UINTN               Count;
+
+  UT_ASSERT_NOT_EFI_ERROR (CreatePair (&Client, &Server, &Header));
+  UT_ASSERT_NOT_NULL (Header);
+
+  Header->Requests.Producer = TEST_ENTRY_COUNT + 1;
+  UT_ASSERT_STATUS_EQUAL (FfaRingTransportServe (Server, mTestServices, ARRAY_SIZE (mTestServices), &Count), EFI_PROTOCOL_ERROR);
+  UT_ASSERT_EQUAL (Count, 0);
+  UT_ASSERT_EQUAL (mEchoCount, 0);
+
+  Header->Completions.Producer = MAX_UINT32;
+  Count                        = ARRAY_SIZE (Completions);
+  UT_ASSERT_STATUS_EQUAL (FfaRingTransportReap (Client, Completions, &Count), EFI_PROTOCOL_ERROR);
+  UT_ASSERT_EQUAL (Count, 0);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportDetach (Server));
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportDestroy (Client));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  A region that does not hold rings is refused by the server.
+
+  @param  Context  Unused.
+
+  @retval UNIT_TEST_PASSED             The test passed.
+  @retval UNIT_TEST_ERROR_TEST_FAILED  The test failed.
+**/
+STATIC
+UNIT_TEST_STATUS
+EFIAPI
+AttachTest (
+  IN UNIT_TEST_CONTEXT  Context
+  )
+{
+  FFA_RING_TRANSPORT  *Client;
+  FFA_RING_TRANSPORT  *Server;
+  FFA_RING_HEADER     *Header;
+  UINT64              Handle;
+
+  UT_ASSERT_STATUS_EQUAL (FfaRingTransportCreate (TEST_SP_ID, 6, 0, 1, &Client, &Handle), EFI_INVALID_PARAMETER);
+  UT_ASSERT_STATUS_EQUAL (FfaRingTransportCreate (TEST_SP_ID, 8, 64, 1, &Client, &Handle), EFI_INVALID_PARAMETER);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportCreate (TEST_SP_ID, TEST_ENTRY_COUNT, 0, FFA_RING_NO_DOORBELL, &Client, &Handle));
+  Header = GetHeader (Handle);
+  UT_ASSERT_NOT_NULL (Header);
+
+  Header->EntryCount = FFA_RING_MAX_ENTRIES;
+  UT_ASSERT_STATUS_EQUAL (FfaRingTransportAttach (MOCK_SPMC_CALLER_ID, Handle, &Server), EFI_UNSUPPORTED);
+
+  Header->EntryCount = TEST_ENTRY_COUNT;
+  Header->Signature  = 0;
+  UT_ASSERT_STATUS_EQUAL (FfaRingTransportAttach (MOCK_SPMC_CALLER_ID, Handle, &Server), EFI_UNSUPPORTED);
+
+  Header->Signature = FFA_RING_SIGNATURE;
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportAttach (MOCK_SPMC_CALLER_ID, Handle, &Server));
+
+  //
+  // Each end only takes the calls of its own side.
+  //
+  UT_ASSERT_STATUS_EQUAL (FfaRingTransportDestroy (Server), EFI_INVALID_PARAMETER);
+  UT_ASSERT_STATUS_EQUAL (FfaRingTransportDetach (Client), EFI_INVALID_PARAMETER);
+
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportDetach (Server));
+  UT_ASSERT_NOT_EFI_ERROR (FfaRingTransportDestroy (Client));
+
+  return UNIT_TEST_PASSED;
+}
+
+/**
+  Initializes and runs the unit tests.
+
+  @retval EFI_SUCCESS  The tests ran.
+  @retval Others       The test framework could not be set up.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+UnitTestingEntry (
+  VOID
+  )
+{
+  EFI_STATUS                  Status;
+  UNIT_TEST_FRAMEWORK_HANDLE  Framework;
+  UNIT_TEST_SUITE_HANDLE      Suite;
+
+  Framework = NULL;
+
+  DEBUG ((DEBUG_INFO, "%a v%a\n", UNIT_TEST_APP_NAME, UNIT_TEST_APP_VERSION));
+
+  Status = InitUnitTestFramework (&Framework, UNIT_TEST_APP_NAME, gEfiCallerBaseName, UNIT_TEST_APP_VERSION);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in InitUnitTestFramework. Status = %r\n", Status));
+    goto EXIT;
+  }
+
+  Status = CreateUnitTestSuite (&Suite, Framework, "FfaRingTransportLib Tests", "FfaRingTransportLib", NULL, NULL);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "Failed in CreateUnitTestSuite for FfaRingTransportLib Tests\n"));
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  AddTestCase (Suite, "Requests reach their handler", "RoundTrip", RoundTripTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Unknown services complete with an error", "NoService", NoServiceTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Requests in flight are limited", "Credit", CreditTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Corrupt indices are refused", "CorruptIndices", CorruptIndicesTest, ResetSpmc, NULL, NULL);
+  AddTestCase (Suite, "Regions without rings are refused", "Attach", AttachTest, ResetSpmc, NULL, NULL);
+
+  Status = RunAllTestSuites (Framework);
+
+EXIT:
+  if (Framework) {
+    FreeUnitTestFramework (Framework);
+  }
+
+  return Status;
+}
+
+/**
+  Standard POSIX C entry point for host based unit test execution.
+
+  @param  argc  Unused.
+  @param  argv  Unused.
+
+  @retval 0  Always.
+**/
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  return UnitTestingEntry ();
+}
@@ -381,6 +381,14 @@ NotificationServiceDeInit (
   /* Nothing to DeInit */
 }
 
+/* Batched commands start at the UUID in x7 (i.e. Arg3) and return the status in x10 (i.e. Arg6) */
+STATIC CONST FFA_EX_BATCH_SERVICE  mNotificationBatchService = {
+  NotificationServiceHandle,
+  3,
+  6,
+  NOTIFICATION_STATUS_SUCCESS
+};
+
 /**
   Handler for Notification service commands
 
@@ -401,6 +409,11 @@ NotificationServiceHandle (
     return;
   }
 
+  if (FfaExIsBatchRequest (Request)) {
+    FfaExBatchDispatch (&mNotificationBatchService, Request, Response);
+    return;
+  }
+
   /* TODO: Figure out how to set x5-x8 */
   /* Set common response register values */
   Response->Arg1 = Request->Arg1;
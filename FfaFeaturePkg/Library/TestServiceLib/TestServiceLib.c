@@ -85,6 +85,14 @@ TestServiceDeInit (
   /* Nothing to Deinit */
 }
 
+/* Batched commands carry the opcode first and return the status in x4 (i.e. Arg0) */
+STATIC CONST FFA_EX_BATCH_SERVICE  mTestBatchService = {
+  TestServiceHandle,
+  0,
+  0,
+  (UINTN)TEST_STATUS_SUCCESS
+};
+
 /**
   Handler for Test service commands
 
@@ -103,6 +111,11 @@ TestServiceHandle (
     return;
   }
 
+  if (FfaExIsBatchRequest (Request)) {
+    FfaExBatchDispatch (&mTestBatchService, Request, Response);
+    return;
+  }
+
   /* Command Opcode = x4 (i.e. Arg0)*/
   switch (Request->Arg0) {
     case TEST_OPCODE_TEST_NOTIFICATION:
@@ -689,6 +689,14 @@ TpmServiceDeInit (
   /* Nothing to DeInit */
 }
 
+/* Batched commands carry the opcode first and return the status in x4 (i.e. Arg0) */
+STATIC CONST FFA_EX_BATCH_SERVICE  mTpmBatchService = {
+  TpmServiceHandle,
+  0,
+  0,
+  TPM2_FFA_SUCCESS_OK
+};
+
 /**
   Handler for TPM service commands
 
@@ -709,6 +717,11 @@ TpmServiceHandle (
     return;
   }
 
+  if (FfaExIsBatchRequest (Request)) {
+    FfaExBatchDispatch (&mTpmBatchService, Request, Response);
+    return;
+  }
+
   Opcode = Request->Arg0;
 
   switch (Opcode) {
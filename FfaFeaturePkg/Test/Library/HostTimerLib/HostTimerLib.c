@@ -0,0 +1,121 @@
+/** @file
+  TimerLib instance for host based unit tests, backed by the C library wall
+  clock. One performance counter tick is one nanosecond.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <time.h>
+
+#include <Base.h>
+#include <Library/TimerLib.h>
+
+#define HOST_TIMER_FREQUENCY  1000000000ULL
+
+/**
+  Stalls the CPU for at least the given number of nanoseconds.
+
+  @param  NanoSeconds The minimum number of nanoseconds to delay.
+
+  @return The value of NanoSeconds inputted.
+
+**/
+UINTN
+EFIAPI
+NanoSecondDelay (
+  IN UINTN  NanoSeconds
+  )
+{
+  UINT64  End;
+
+  End = GetPerformanceCounter () + NanoSeconds;
+  while (GetPerformanceCounter () < End) {
+  }
+
+  return NanoSeconds;
+}
+
+/**
+  Stalls the CPU for at least the given number of microseconds.
+
+  @param  MicroSeconds  The minimum number of microseconds to delay.
+
+  @return The value of MicroSeconds inputted.
+
+**/
+UINTN
+EFIAPI
+MicroSecondDelay (
+  IN UINTN  MicroSeconds
+  )
+{
+  NanoSecondDelay (MicroSeconds * 1000);
+  return MicroSeconds;
+}
+
+/**
+  Retrieves the current value of the performance counter.
+
+  @return The current value of the performance counter, in nanoseconds.
+
+**/
+UINT64
+EFIAPI
+GetPerformanceCounter (
+  VOID
+  )
+{
+  struct timespec  Now;
+
+  timespec_get (&Now, TIME_UTC);
+  return (UINT64)Now.tv_sec * HOST_TIMER_FREQUENCY + (UINT64)Now.tv_nsec;
+}
+
+/**
+  Retrieves the 64-bit frequency in Hz and the range of performance counter
+  values.
+
+  @param  StartValue  The value the performance counter starts with when it
+                      rolls over.
+  @param  EndValue    The value that the performance counter ends with before
+                      it rolls over.
+
+  @return The frequency in Hz.
+
+**/
+UINT64
+EFIAPI
+GetPerformanceCounterProperties (
+  OUT UINT64  *StartValue   OPTIONAL,
+  OUT UINT64  *EndValue     OPTIONAL
+  )
+{
+  if (StartValue != NULL) {
+    *StartValue = 0;
+  }
+
+  if (EndValue != NULL) {
+    *EndValue = MAX_UINT64;
+  }
+
+  return HOST_TIMER_FREQUENCY;
+}
+
+/**
+  Converts elapsed ticks of performance counter to time in nanoseconds.
+
+  @param  Ticks     The number of elapsed ticks of running performance counter.
+
+  @return The elapsed time in nanoseconds.
+
+**/
+UINT64
+EFIAPI
+GetTimeInNanoSecond (
+  IN UINT64  Ticks
+  )
+{
+  return Ticks;
+}
@@ -0,0 +1,370 @@
+/** @file
+  In-process model of an SPMC for host based unit tests.
+
+  The MockSpmcLib instance also provides the ArmSvcLib and ArmSmcLib library
+  classes. Every FF-A call the code under test issues through either conduit is
+  answered by this model instead of trapping, which lets ArmFfaLibEx and the
+  services built on top of it run on a workstation.
+
+  The model covers FFA_VERSION, FFA_FEATURES, FFA_ID_GET,
+  FFA_PARTITION_INFO_GET_REGS, the direct messaging ABIs, FFA_MSG_WAIT, the
+  notification ABIs including FFA_NOTIFICATION_INFO_GET, FFA_MSG_SEND2 and
+  FFA_RX_RELEASE, the memory share, lend, donate, retrieve, relinquish and
+  reclaim ABIs including FFA_MEM_FRAG_TX and FFA_MEM_FRAG_RX,
+  FFA_MEM_PERM_GET, FFA_MEM_PERM_SET and FFA_CONSOLE_LOG. Any other function
+  ID is answered with FFA_ERROR(NOT_SUPPORTED). A blocking call can also be
+  preempted by FFA_INTERRUPT, and the instance provides the
+  PlatformFfaInterruptLib library class to record the interrupts handled.
+
+  A memory transaction passed in the TX buffer is reassembled from its
+  fragments, and a retrieve request for it is answered with the same
+  descriptor, fragmented to fit the RX buffer.
+
+  Adding a partition or changing its UUID invalidates a partition discovery in
+  progress: FFA_PARTITION_INFO_GET_REGS past the first window is then answered
+  with RETRY, as a real SPMC does when the tag no longer matches.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef MOCK_SPMC_LIB_H_
+#define MOCK_SPMC_LIB_H_
+
+#include <Library/ArmSvcLib.h>
+
+///
+/// Partition ID reported to the code under test by FFA_ID_GET.
+///
+#define MOCK_SPMC_CALLER_ID  0x8001
+
+///
+/// FF-A version reported by FFA_VERSION.
+///
+#define MOCK_SPMC_MAJOR_VERSION  1
+#define MOCK_SPMC_MINOR_VERSION  2
+
+///
+/// Interrupt ID reported by FFA_FEATURES for the schedule receiver interrupt.
+///
+#define MOCK_SPMC_SRI_INTERRUPT_ID  8
+
+/**
+  Handler answering direct requests sent to a modeled partition.
+
+  On input Args holds the registers of the FFA_MSG_SEND_DIRECT_REQ* call. On
+  output it must hold the registers returned to the sender, usually a
+  FFA_MSG_SEND_DIRECT_RESP* or an FFA_ERROR.
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+typedef
+VOID
+(EFIAPI *MOCK_SPMC_DIRECT_REQ_HANDLER)(
+  IN OUT ARM_SVC_ARGS  *Args
+  );
+
+/**
+  Restores the model to its initial state: no partitions, no pending
+  notifications, no shared memory, no queued requests and an empty console.
+
+**/
+VOID
+EFIAPI
+MockSpmcReset (
+  VOID
+  );
+
+/**
+  Restores the model to its initial state and initializes ArmFfaLibEx
+  against it, the common fixture of the host tests.
+
+  @retval The status of the ArmFfaLibEx constructor.
+**/
+RETURN_STATUS
+EFIAPI
+MockSpmcResetAndInit (
+  VOID
+  );
+
+/**
+  Adds a partition that direct requests can be sent to.
+
+  @param  PartitionId  The partition ID.
+  @param  Handler      Handler answering its direct requests. If NULL, the
+                       partition echoes every request back as a response.
+
+  @retval EFI_SUCCESS           The partition was added.
+  @retval EFI_OUT_OF_RESOURCES  The partition table is full.
+**/
+EFI_STATUS
+EFIAPI
+MockSpmcAddPartition (
+  IN UINT16                        PartitionId,
+  IN MOCK_SPMC_DIRECT_REQ_HANDLER  Handler OPTIONAL
+  );
+
+/**
+  Sets the UUID a partition reports through FFA_PARTITION_INFO_GET_REGS.
+
+  @param  PartitionId  The partition ID.
+  @param  Uuid         The UUID, in EFI_GUID byte order.
+
+  @retval EFI_SUCCESS    The UUID was set.
+  @retval EFI_NOT_FOUND  The partition is not modeled.
+**/
+EFI_STATUS
+EFIAPI
+MockSpmcSetPartitionUuid (
+  IN UINT16          PartitionId,
+  IN CONST EFI_GUID  *Uuid
+  );
+
+/**
+  Makes one future call fail with FFA_ERROR.
+
+  @param  FunctionId  The function ID of the call to fail.
+  @param  Status      The FF-A status code to return.
+  @param  AfterCalls  Number of calls with FunctionId to answer normally
+                      before the failing one.
+
+**/
+VOID
+EFIAPI
+MockSpmcInjectError (
+  IN UINT32  FunctionId,
+  IN INT32   Status,
+  IN UINTN   AfterCalls
+  );
+
+/**
+  Makes one future call be preempted by an interrupt.
+
+  The call is answered with FFA_INTERRUPT. The FFA_MSG_WAIT that ends the
+  interrupt handling is then answered as the preempted call would have been.
+
+  @param  FunctionId   The function ID of the call to preempt.
+  @param  InterruptId  The interrupt ID to report.
+
+**/
+VOID
+EFIAPI
+MockSpmcRaiseInterrupt (
+  IN UINT32  FunctionId,
+  IN UINT32  InterruptId
+  );
+
+/**
+  Makes a partition hold back its response to the next direct requests.
+
+  The request is answered with FunctionId, FFA_YIELD or FFA_INTERRUPT, naming
+  the partition. Each FFA_RUN resuming the partition is answered the same way
+  until Count preemptions were reported, then with the response.
+
+  @param  PartitionId  The partition ID.
+  @param  FunctionId   ARM_FID_FFA_YIELD or ARM_FID_FFA_INTERRUPT.
+  @param  Count        Number of preemptions to report.
+
+  @retval EFI_SUCCESS    The preemptions were set up.
+  @retval EFI_NOT_FOUND  The partition is not modeled.
+**/
+EFI_STATUS
+EFIAPI
+MockSpmcPreemptPartition (
+  IN UINT16  PartitionId,
+  IN UINT32  FunctionId,
+  IN UINTN   Count
+  );
+
+/**
+  Returns the interrupts handed to SecurePartitionInterruptHandler since the
+  last reset.
+
+  @param  InterruptIds  Optional, receives the interrupt IDs in the order they
+                        were handled.
+
+  @retval The number of interrupts handled.
+**/
+UINTN
+EFIAPI
+MockSpmcGetHandledInterrupts (
+  OUT CONST UINT32  **InterruptIds OPTIONAL
+  );
+
+/**
+  Queues a message for the code under test. It is returned by the next
+  FFA_MSG_WAIT or direct response the code under test issues.
+
+  @param  Message  The registers to return.
+
+  @retval EFI_SUCCESS           The message was queued.
+  @retval EFI_OUT_OF_RESOURCES  The queue is full.
+**/
+EFI_STATUS
+EFIAPI
+MockSpmcQueueMessage (
+  IN CONST ARM_SVC_ARGS  *Message
+  );
+
+/**
+  Returns the RX/TX buffers the model maps for the code under test.
+
+  @param  TxBuffer  Receives the TX buffer.
+  @param  RxBuffer  Receives the RX buffer.
+  @param  Size      Receives the size of each buffer.
+
+**/
+VOID
+EFIAPI
+MockSpmcGetRxTxBuffers (
+  OUT VOID   **TxBuffer,
+  OUT VOID   **RxBuffer,
+  OUT UINTN  *Size
+  );
+
+/**
+  Delivers an indirect message to the RX buffer of the code under test, as
+  FFA_MSG_SEND2 from another partition would.
+
+  @param  SenderId     The sender partition ID.
+  @param  ServiceGuid  Optional, the service GUID, in EFI_GUID byte order.
+  @param  Payload      The payload.
+  @param  PayloadSize  The size of the payload.
+
+  @retval EFI_SUCCESS           The message was delivered.
+  @retval EFI_NOT_READY         The RX buffer was not released since the last
+                                delivery.
+  @retval EFI_BAD_BUFFER_SIZE   The payload does not fit.
+**/
+EFI_STATUS
+EFIAPI
+MockSpmcDeliverIndirectMessage (
+  IN UINT16          SenderId,
+  IN CONST EFI_GUID  *ServiceGuid OPTIONAL,
+  IN CONST VOID      *Payload,
+  IN UINTN           PayloadSize
+  );
+
+/**
+  Retrieves the indirect message last sent to a partition and empties its RX
+  buffer.
+
+  @param  ReceiverId   The receiver partition ID.
+  @param  SenderId     Optional, receives the sender partition ID.
+  @param  Payload      Receives the payload.
+  @param  PayloadSize  On input the size of Payload, on output the size of the
+                       message payload.
+
+  @retval EFI_SUCCESS           The message was retrieved.
+  @retval EFI_NOT_FOUND         No message is pending for the receiver.
+  @retval EFI_BUFFER_TOO_SMALL  Payload is too small, PayloadSize has the size
+                                needed.
+**/
+EFI_STATUS
+EFIAPI
+MockSpmcGetIndirectMessage (
+  IN     UINT16  ReceiverId,
+  OUT    UINT16  *SenderId OPTIONAL,
+  OUT    VOID    *Payload,
+  IN OUT UINTN   *PayloadSize
+  );
+
+/**
+  Returns the descriptor of a memory transaction passed in the TX buffer, as
+  reassembled from all of its fragments.
+
+  @param  Handle      The handle of the memory region.
+  @param  Descriptor  Receives the memory transaction descriptor.
+  @param  Length      Receives the length of the descriptor.
+
+  @retval EFI_SUCCESS    The descriptor was returned.
+  @retval EFI_NOT_FOUND  Handle is not the last transaction passed in the TX
+                         buffer, or some of its fragments are still due.
+**/
+EFI_STATUS
+EFIAPI
+MockSpmcGetMemTransaction (
+  IN  UINT64      Handle,
+  OUT CONST VOID  **Descriptor,
+  OUT UINT32      *Length
+  );
+
+/**
+  Sets the permissions of a range of pages behind the back of the code under
+  test, as the SPMC does when it maps a partition.
+
+  @param  BaseAddress  Base of the range, page aligned.
+  @param  PageCount    Number of 4K pages in the range.
+  @param  MemoryPerm   The permission attributes.
+
+  @retval EFI_SUCCESS           The permissions were set.
+  @retval EFI_OUT_OF_RESOURCES  Too many ranges were set since the last reset.
+**/
+EFI_STATUS
+EFIAPI
+MockSpmcSetMemPerm (
+  IN UINT64  BaseAddress,
+  IN UINT64  PageCount,
+  IN UINT32  MemoryPerm
+  );
+
+/**
+  Returns the permissions last set on a page, without counting as a call.
+
+  @param  Address     An address in the page.
+  @param  MemoryPerm  Receives the permission attributes.
+
+  @retval EFI_SUCCESS    The permissions were returned.
+  @retval EFI_NOT_FOUND  No permissions were ever set on the page.
+**/
+EFI_STATUS
+EFIAPI
+MockSpmcGetMemPerm (
+  IN  UINT64  Address,
+  OUT UINT32  *MemoryPerm
+  );
+
+/**
+  Returns the notifications pending for a receiver without clearing them.
+
+  @param  ReceiverId  The receiver partition ID.
+  @param  FromSp      TRUE for the notifications set by secure partitions,
+                      FALSE for the ones set by VMs.
+
+  @retval The pending notification bitmap.
+**/
+UINT64
+EFIAPI
+MockSpmcGetPendingNotifications (
+  IN UINT16   ReceiverId,
+  IN BOOLEAN  FromSp
+  );
+
+/**
+  Returns the characters logged through FFA_CONSOLE_LOG since the last reset.
+
+  @param  Length  Optional, receives the number of characters logged.
+
+  @retval A NUL-terminated string owned by the model.
+**/
+CONST CHAR8 *
+EFIAPI
+MockSpmcGetConsoleLog (
+  OUT UINTN  *Length OPTIONAL
+  );
+
+/**
+  Returns the number of FF-A calls the model has answered since the last
+  reset.
+
+  @retval The number of calls.
+**/
+UINTN
+EFIAPI
+MockSpmcGetCallCount (
+  VOID
+  );
+
+#endif /* MOCK_SPMC_LIB_H_ */
@@ -0,0 +1,244 @@
+/** @file
+  Host instance of the subset of ArmFfaLib used by ArmFfaLibEx.
+
+  Calls are issued through ArmCallSvc, which the host test platform maps to
+  the SPMC model in MockSpmcLib.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/ArmFfaSvc.h>
+#include <Library/ArmFfaLib.h>
+#include <Library/ArmSvcLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MockSpmcLib.h>
+
+/**
+  Convert EFI_STATUS to FFA return code.
+
+  @param [in] FfaStatus          FF-A return code.
+
+  @retval EFI_STATUS             Matched EFI_STATUS value.
+**/
+EFI_STATUS
+EFIAPI
+FfaStatusToEfiStatus (
+  IN UINTN  FfaStatus
+  )
+{
+  switch ((UINT32)FfaStatus) {
+    case ARM_FFA_RET_SUCCESS:
+      return EFI_SUCCESS;
+    case ARM_FFA_RET_NOT_SUPPORTED:
+      return EFI_UNSUPPORTED;
+    case ARM_FFA_RET_INVALID_PARAMETERS:
+      return EFI_INVALID_PARAMETER;
+    case ARM_FFA_RET_NO_MEMORY:
+      return EFI_OUT_OF_RESOURCES;
+    case ARM_FFA_RET_BUSY:
+      return EFI_ALREADY_STARTED;
+    case ARM_FFA_RET_INTERRUPTED:
+      return EFI_INTERRUPT_PENDING;
+    case ARM_FFA_RET_DENIED:
+      return EFI_ACCESS_DENIED;
+    case ARM_FFA_RET_RETRY:
+      return EFI_NOT_READY;
+    case ARM_FFA_RET_ABORTED:
+      return EFI_ABORTED;
+    case ARM_FFA_RET_NODATA:
+      return EFI_NOT_FOUND;
+    default:
+      return EFI_UNSUPPORTED;
+  }
+}
+
+/**
+  Get FF-A version.
+
+  @param [in]   RequestMajorVersion   Minimal request major version
+  @param [in]   RequestMinorVersion   Minimal request minor version
+  @param [out]  CurrentMajorVersion   Current major version
+  @param [out]  CurrentMinorVersion   Current minor version
+
+  @retval EFI_SUCCESS                 Success
+  @retval Others                      Error
+**/
+EFI_STATUS
+EFIAPI
+ArmFfaLibGetVersion (
+  IN  UINT16  RequestMajorVersion,
+  IN  UINT16  RequestMinorVersion,
+  OUT UINT16  *CurrentMajorVersion,
+  OUT UINT16  *CurrentMinorVersion
+  )
+{
+  ARM_SVC_ARGS  Args;
+
+  ZeroMem (&Args, sizeof (Args));
+  Args.Arg0 = ARM_FID_FFA_VERSION;
+  Args.Arg1 = ((UINT32)RequestMajorVersion << 16) | RequestMinorVersion;
+  ArmCallSvc (&Args);
+
+  if ((INT32)Args.Arg0 == ARM_FFA_RET_NOT_SUPPORTED) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (CurrentMajorVersion != NULL) {
+    *CurrentMajorVersion = (UINT16)((Args.Arg0 >> 16) & 0x7FFF);
+  }
+
+  if (CurrentMinorVersion != NULL) {
+    *CurrentMinorVersion = (UINT16)Args.Arg0;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Get FF-A features.
+
+  @param [in]   Id              Feature id or function id
+  @param [in]   InputProperties Input properties according to id
+  @param [out]  Property1       First property.
+  @param [out]  Property2       Second property.
+
+  @retval EFI_SUCCESS           Success
+  @retval Others                Error
+**/
+EFI_STATUS
+EFIAPI
+ArmFfaLibGetFeatures (
+  IN  UINT32  Id,
+  IN  UINT32  InputProperties,
+  OUT UINTN   *Property1,
+  OUT UINTN   *Property2
+  )
+{
+  ARM_SVC_ARGS  Args;
+
+  if ((Property1 == NULL) || (Property2 == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  ZeroMem (&Args, sizeof (Args));
+  Args.Arg0 = ARM_FID_FFA_FEATURES;
+  Args.Arg1 = Id;
+  Args.Arg2 = InputProperties;
+  ArmCallSvc (&Args);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    return FfaStatusToEfiStatus (Args.Arg2);
+  }
+
+  *Property1 = Args.Arg2;
+  *Property2 = Args.Arg3;
+  return EFI_SUCCESS;
+}
+
+/**
+  Get partition id.
+
+  @param [out]  PartId        Partition id
+
+  @retval EFI_SUCCESS           Success
+  @retval Others                Error
+**/
+EFI_STATUS
+EFIAPI
+ArmFfaLibPartitionIdGet (
+  OUT UINT16  *PartId
+  )
+{
+  ARM_SVC_ARGS  Args;
+
+  if (PartId == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  ZeroMem (&Args, sizeof (Args));
+  Args.Arg0 = ARM_FID_FFA_ID_GET;
+  ArmCallSvc (&Args);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    return FfaStatusToEfiStatus (Args.Arg2);
+  }
+
+  *PartId = (UINT16)Args.Arg2;
+  return EFI_SUCCESS;
+}
+
+/**
+  Get the RX/TX buffers, here the ones the SPMC model maps for the code under
+  test.
+
+  @param [out] TxBuffer       Address of TxBuffer
+  @param [out] TxBufferSize   Size of TxBuffer
+  @param [out] RxBuffer       Address of RxBuffer
+  @param [out] RxBufferSize   Size of RxBuffer
+
+  @retval EFI_SUCCESS           Success
+**/
+EFI_STATUS
+EFIAPI
+ArmFfaLibGetRxTxBuffers (
+  OUT VOID    **TxBuffer OPTIONAL,
+  OUT UINT64  *TxBufferSize OPTIONAL,
+  OUT VOID    **RxBuffer OPTIONAL,
+  OUT UINT64  *RxBufferSize OPTIONAL
+  )
+{
+  VOID   *Tx;
+  VOID   *Rx;
+  UINTN  Size;
+
+  MockSpmcGetRxTxBuffers (&Tx, &Rx, &Size);
+
+  if (TxBuffer != NULL) {
+    *TxBuffer = Tx;
+  }
+
+  if (TxBufferSize != NULL) {
+    *TxBufferSize = Size;
+  }
+
+  if (RxBuffer != NULL) {
+    *RxBuffer = Rx;
+  }
+
+  if (RxBufferSize != NULL) {
+    *RxBufferSize = Size;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Release ownership of the RX buffer.
+
+  @param [in] PartId         Partition id
+
+  @retval EFI_SUCCESS           Success
+  @retval Others                Error
+**/
+EFI_STATUS
+EFIAPI
+ArmFfaLibRxRelease (
+  IN UINT16  PartId
+  )
+{
+  ARM_SVC_ARGS  Args;
+
+  ZeroMem (&Args, sizeof (Args));
+  Args.Arg0 = ARM_FID_FFA_RX_RELEASE;
+  Args.Arg1 = PartId;
+  ArmCallSvc (&Args);
+
+  if (Args.Arg0 == ARM_FID_FFA_ERROR) {
+    return FfaStatusToEfiStatus (Args.Arg2);
+  }
+
+  return EFI_SUCCESS;
+}
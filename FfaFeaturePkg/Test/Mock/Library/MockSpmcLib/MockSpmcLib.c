@@ -0,0 +1,2091 @@
+/** @file
+  In-process model of an SPMC for host based unit tests.
+
+  Copyright (c), Microsoft Corporation.
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <IndustryStandard/ArmFfaSvc.h>
+#include <IndustryStandard/ArmFfaPartInfo.h>
+#include <Library/ArmSvcLib.h>
+#include <Library/ArmSmcLib.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MockSpmcLib.h>
+#include <Library/PlatformFfaInterruptLib.h>
+
+#define MOCK_SPMC_MAX_PARTITIONS   16
+#define MOCK_SPMC_MAX_MESSAGES     16
+#define MOCK_SPMC_MAX_HANDLES      16
+#define MOCK_SPMC_CONSOLE_SIZE     4096
+#define MOCK_SPMC_RXTX_SIZE        4096
+#define MOCK_SPMC_MEM_DESC_SIZE    0x10000
+#define MOCK_SPMC_MAX_PERM_RANGES  32
+#define MOCK_SPMC_MAX_INTERRUPTS   16
+
+//
+// Partition IDs with bit 15 set belong to secure partitions, the others to
+// VMs. The model uses this to pick the bitmap a notification lands in.
+//
+#define MOCK_SPMC_IS_SP_ID(Id)  (((Id) & BIT15) != 0)
+
+//
+// FFA_PARTITION_INFO_GET_REGS returns at most this many descriptors per call.
+//
+#define MOCK_SPMC_PART_INFO_REGS_MAX_DESCS  5
+
+//
+// FFA_NOTIFICATION_INFO_GET returns at most this many IDs per call, and at
+// most this many vCPU IDs per list.
+//
+#define MOCK_SPMC_NOTIFICATION_INFO_MAX_IDS           20
+#define MOCK_SPMC_NOTIFICATION_INFO_MAX_VCPUS         3
+#define MOCK_SPMC_NOTIFICATION_INFO_LIST_COUNT_SHIFT  7
+#define MOCK_SPMC_NOTIFICATION_INFO_LIST_SIZE_SHIFT   12
+
+#ifndef ARM_FID_FFA_NOTIFICATION_INFO_GET_AARCH64
+#define ARM_FID_FFA_NOTIFICATION_INFO_GET_AARCH64  0xC4000083
+#endif
+
+#ifndef ARM_FID_FFA_MSG_SEND2
+#define ARM_FID_FFA_MSG_SEND2  0x84000086
+#endif
+
+#ifndef ARM_FID_FFA_YIELD
+#define ARM_FID_FFA_YIELD  0x8400006C
+#endif
+
+#ifndef ARM_FID_FFA_RUN
+#define ARM_FID_FFA_RUN  0x8400006D
+#endif
+
+//
+// Timeout hint, in nanoseconds, a partition yields with.
+//
+#define MOCK_SPMC_YIELD_TIMEOUT  1000000
+
+#ifndef ARM_FID_FFA_MEM_FRAG_RX
+#define ARM_FID_FFA_MEM_FRAG_RX  0x8400007A
+#endif
+
+#ifndef ARM_FID_FFA_MEM_FRAG_TX
+#define ARM_FID_FFA_MEM_FRAG_TX  0x8400007B
+#endif
+
+//
+// Fragments after the first one of a memory transaction descriptor hold whole
+// constituent memory region descriptors. The offsets locate the first one.
+//
+#define MOCK_SPMC_MEM_CONSTITUENT_SIZE         16
+#define MOCK_SPMC_MEM_COMPOSITE_SIZE           16
+#define MOCK_SPMC_MEM_HANDLE_OFFSET            8
+#define MOCK_SPMC_MEM_ACCESS_OFFSET_OFFSET     32
+#define MOCK_SPMC_MEM_COMPOSITE_OFFSET_OFFSET  4
+
+//
+// Partition message header preceding an indirect message in an RX/TX buffer.
+//
+#pragma pack(1)
+typedef struct {
+  UINT32      Flags;
+  UINT32      Reserved1;
+  UINT32      PayloadOffset;
+  UINT16      ReceiverId;
+  UINT16      SenderId;
+  UINT32      PayloadSize;
+  UINT32      Reserved2;
+  EFI_GUID    ServiceGuid;
+} MOCK_SPMC_MSG_HEADER;
+#pragma pack()
+
+//
+// FFA_NOTIFICATION_SET flags.
+//
+#define MOCK_SPMC_NOTIFICATION_FLAG_PER_VCPU  BIT1
+#define MOCK_SPMC_NOTIFICATION_VCPU_SHIFT     16
+
+//
+// FFA_MSG_WAIT flag keeping the RX buffer with the caller.
+//
+#define MOCK_SPMC_MSG_WAIT_FLAG_RETAIN_RX  BIT0
+
+typedef struct {
+  UINT16                          PartitionId;
+  MOCK_SPMC_DIRECT_REQ_HANDLER    Handler;
+  EFI_GUID                        Uuid;      // In FF-A byte order
+  UINT64                          PendingFromSp;
+  UINT64                          PendingFromVm;
+
+  //
+  // Pending notifications not yet reported by FFA_NOTIFICATION_INFO_GET:
+  // global ones, and per-vCPU ones as a mask of vCPU IDs.
+  //
+  BOOLEAN                         InfoGlobal;
+  UINT32                          InfoVcpus;
+
+  //
+  // RX buffer of the partition, holding the last indirect message sent to it
+  // until the test retrieves it.
+  //
+  BOOLEAN                         MailboxFull;
+  UINT8                           Mailbox[MOCK_SPMC_RXTX_SIZE];
+
+  //
+  // Preemptions still to report before the partition responds, and the
+  // request it holds back until FFA_RUN resumes it.
+  //
+  UINT32                          PreemptFunctionId;
+  UINTN                           PreemptCount;
+  BOOLEAN                         RequestPending;
+  ARM_SVC_ARGS                    Request;
+} MOCK_SPMC_PARTITION;
+
+typedef struct {
+  UINT64    Handle;
+  UINT32    TotalLength;
+  UINT32    ReceivedLength;   // Less than TotalLength while fragments are due
+} MOCK_SPMC_MEM_REGION;
+
+typedef struct {
+  UINT64    BaseAddress;
+  UINT64    PageCount;
+  UINT32    MemoryPerm;
+} MOCK_SPMC_PERM_RANGE;
+
+typedef struct {
+  MOCK_SPMC_PARTITION     Partitions[MOCK_SPMC_MAX_PARTITIONS];
+  UINTN                   PartitionCount;
+
+  //
+  // Bumped whenever the partition table changes, so that a discovery that
+  // straddles the change is answered with RETRY.
+  //
+  UINT16                  PartInfoTag;
+
+  //
+  // Notifications pending for the code under test, which is not in the
+  // partition table.
+  //
+  UINT64                  CallerPendingFromSp;
+  UINT64                  CallerPendingFromVm;
+
+  ARM_SVC_ARGS            Messages[MOCK_SPMC_MAX_MESSAGES];
+  UINTN                   MessageHead;
+  UINTN                   MessageCount;
+
+  MOCK_SPMC_MEM_REGION    Regions[MOCK_SPMC_MAX_HANDLES];
+  UINT64                  NextHandle;
+
+  //
+  // Descriptor of the last memory transaction passed in the TX buffer, as
+  // reassembled from its fragments.
+  //
+  UINT8                   MemDesc[MOCK_SPMC_MEM_DESC_SIZE];
+  UINT64                  MemDescHandle;
+
+  //
+  // Bytes of MemDesc already placed in the RX buffer by a retrieve in
+  // progress.
+  //
+  UINT32                  RetrieveOffset;
+
+  //
+  // Stage-1 permissions of the code under test, in the order they were set.
+  // A range overrides the earlier ones it overlaps.
+  //
+  MOCK_SPMC_PERM_RANGE    PermRanges[MOCK_SPMC_MAX_PERM_RANGES];
+  UINTN                   PermRangeCount;
+
+  //
+  // RX/TX buffers of the code under test. RxFull is set while it owns the RX
+  // buffer, i.e. from a delivery to FFA_RX_RELEASE or to an FFA_MSG_WAIT
+  // that does not retain it.
+  //
+  UINT64                  TxBuffer[MOCK_SPMC_RXTX_SIZE / sizeof (UINT64)];
+  UINT64                  RxBuffer[MOCK_SPMC_RXTX_SIZE / sizeof (UINT64)];
+  BOOLEAN                 RxFull;
+
+  CHAR8                   Console[MOCK_SPMC_CONSOLE_SIZE];
+  UINTN                   ConsoleLength;
+
+  UINTN                   CallCount;
+
+  //
+  // One shot error injected by MockSpmcInjectError.
+  //
+  BOOLEAN                 InjectArmed;
+  UINT32                  InjectFunctionId;
+  INT32                   InjectStatus;
+  UINTN                   InjectAfterCalls;
+
+  //
+  // One shot interrupt raised by MockSpmcRaiseInterrupt, and the call it
+  // preempted, resumed by the FFA_MSG_WAIT that ends the interrupt handling.
+  //
+  BOOLEAN                 InterruptArmed;
+  UINT32                  InterruptFunctionId;
+  UINT32                  InterruptId;
+  BOOLEAN                 InterruptedCallPending;
+  ARM_SVC_ARGS            InterruptedCall;
+
+  //
+  // Interrupts handed to SecurePartitionInterruptHandler, in order.
+  //
+  UINT32                  HandledInterrupts[MOCK_SPMC_MAX_INTERRUPTS];
+  UINTN                   HandledInterruptCount;
+} MOCK_SPMC;
+
+STATIC MOCK_SPMC  mSpmc = { .NextHandle = 1, .PartInfoTag = 1 };
+
+//
+// HOST_APPLICATION modules do not run library constructors, so
+// MockSpmcResetAndInit runs the one of ArmFfaLibEx for the tests.
+//
+RETURN_STATUS
+EFIAPI
+ArmFfaLibExConstructor (
+  VOID
+  );
+
+//
+// Function IDs FFA_FEATURES reports as supported.
+//
+STATIC CONST UINT32  mSupportedFids[] = {
+  ARM_FID_FFA_VERSION,
+  ARM_FID_FFA_FEATURES,
+  ARM_FID_FFA_ID_GET,
+  ARM_FID_FFA_PARTITION_INFO_GET_REGS,
+  ARM_FID_FFA_WAIT,
+  ARM_FID_FFA_RUN,
+  ARM_FID_FFA_RX_RELEASE,
+  ARM_FID_FFA_MSG_SEND2,
+  ARM_FID_FFA_MEM_FRAG_RX,
+  ARM_FID_FFA_MEM_FRAG_TX,
+  ARM_FID_FFA_MSG_SEND_DIRECT_REQ_AARCH32,
+  ARM_FID_FFA_MSG_SEND_DIRECT_REQ_AARCH64,
+  ARM_FID_FFA_MSG_SEND_DIRECT_RESP_AARCH32,
+  ARM_FID_FFA_MSG_SEND_DIRECT_RESP_AARCH64,
+  ARM_FID_FFA_MSG_SEND_DIRECT_REQ2,
+  ARM_FID_FFA_MSG_SEND_DIRECT_RESP2,
+  ARM_FID_FFA_MEM_DONATE_AARCH32,
+  ARM_FID_FFA_MEM_DONATE_AARCH64,
+  ARM_FID_FFA_MEM_LEND_AARCH32,
+  ARM_FID_FFA_MEM_LEND_AARCH64,
+  ARM_FID_FFA_MEM_SHARE_AARCH32,
+  ARM_FID_FFA_MEM_SHARE_AARCH64,
+  ARM_FID_FFA_MEM_RETRIEVE_REQ_AARCH32,
+  ARM_FID_FFA_MEM_RETRIEVE_REQ_AARCH64,
+  ARM_FID_FFA_MEM_RETRIEVE_RELINQUISH,
+  ARM_FID_FFA_MEM_RETRIEVE_RECLAIM,
+  ARM_FID_FFA_MEM_PERM_GET_AARCH32,
+  ARM_FID_FFA_MEM_PERM_GET_AARCH64,
+  ARM_FID_FFA_MEM_PERM_SET_AARCH32,
+  ARM_FID_FFA_MEM_PERM_SET_AARCH64,
+  ARM_FID_FFA_NOTIFICATION_BITMAP_CREATE,
+  ARM_FID_FFA_NOTIFICATION_BITMAP_DESTROY,
+  ARM_FID_FFA_NOTIFICATION_BIND,
+  ARM_FID_FFA_NOTIFICATION_UNBIND,
+  ARM_FID_FFA_NOTIFICATION_SET,
+  ARM_FID_FFA_NOTIFICATION_GET,
+  ARM_FID_FFA_NOTIFICATION_INFO_GET_AARCH64,
+  ARM_FID_FFA_CONSOLE_LOG_AARCH32,
+  ARM_FID_FFA_CONSOLE_LOG_AARCH64,
+};
+
+/**
+  Sets Args to FFA_SUCCESS with all result registers cleared.
+
+  @param  Args  The registers to update.
+
+**/
+STATIC
+VOID
+MockSpmcSuccess (
+  OUT ARM_SVC_ARGS  *Args
+  )
+{
+  ZeroMem (Args, sizeof (*Args));
+  Args->Arg0 = ARM_FID_FFA_SUCCESS_AARCH32;
+}
+
+/**
+  Sets Args to FFA_ERROR with the given status.
+
+  @param  Args    The registers to update.
+  @param  Status  The FF-A status code.
+
+**/
+STATIC
+VOID
+MockSpmcError (
+  OUT ARM_SVC_ARGS  *Args,
+  IN  INT32         Status
+  )
+{
+  ZeroMem (Args, sizeof (*Args));
+  Args->Arg0 = ARM_FID_FFA_ERROR;
+  Args->Arg2 = (UINT32)Status;
+}
+
+/**
+  Looks up a modeled partition.
+
+  @param  PartitionId  The partition ID.
+
+  @retval The partition, or NULL if it is not modeled.
+**/
+STATIC
+MOCK_SPMC_PARTITION *
+MockSpmcFindPartition (
+  IN UINT16  PartitionId
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < mSpmc.PartitionCount; Index++) {
+    if (mSpmc.Partitions[Index].PartitionId == PartitionId) {
+      return &mSpmc.Partitions[Index];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Default direct request handler, echoes the request back as a response.
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+STATIC
+VOID
+EFIAPI
+MockSpmcEchoHandler (
+  IN OUT ARM_SVC_ARGS  *Args
+  )
+{
+  UINT16  Sender;
+  UINT16  Receiver;
+
+  Sender   = (UINT16)(Args->Arg1 >> 16);
+  Receiver = (UINT16)Args->Arg1;
+
+  switch (Args->Arg0) {
+    case ARM_FID_FFA_MSG_SEND_DIRECT_REQ_AARCH32:
+      Args->Arg0 = ARM_FID_FFA_MSG_SEND_DIRECT_RESP_AARCH32;
+      break;
+    case ARM_FID_FFA_MSG_SEND_DIRECT_REQ_AARCH64:
+      Args->Arg0 = ARM_FID_FFA_MSG_SEND_DIRECT_RESP_AARCH64;
+      break;
+    default:
+      Args->Arg0 = ARM_FID_FFA_MSG_SEND_DIRECT_RESP2;
+      break;
+  }
+
+  Args->Arg1 = ((UINT32)Receiver << 16) | Sender;
+}
+
+/**
+  Reports that a partition yielded or was preempted on vCPU 0.
+
+  @param  Partition  The partition.
+  @param  Args       Receives the FFA_YIELD or FFA_INTERRUPT.
+
+**/
+STATIC
+VOID
+MockSpmcPreempt (
+  IN OUT MOCK_SPMC_PARTITION  *Partition,
+  OUT    ARM_SVC_ARGS         *Args
+  )
+{
+  Partition->PreemptCount--;
+  ZeroMem (Args, sizeof (*Args));
+  Args->Arg0 = Partition->PreemptFunctionId;
+  Args->Arg1 = (UINT32)Partition->PartitionId << 16;
+  if (Partition->PreemptFunctionId == ARM_FID_FFA_YIELD) {
+    Args->Arg2 = MOCK_SPMC_YIELD_TIMEOUT;
+  }
+}
+
+/**
+  Answers a direct request from the code under test.
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+STATIC
+VOID
+MockSpmcDirectRequest (
+  IN OUT ARM_SVC_ARGS  *Args
+  )
+{
+  MOCK_SPMC_PARTITION  *Partition;
+
+  if ((UINT16)(Args->Arg1 >> 16) != MOCK_SPMC_CALLER_ID) {
+    MockSpmcError (Args, ARM_FFA_RET_INVALID_PARAMETERS);
+    return;
+  }
+
+  Partition = MockSpmcFindPartition ((UINT16)Args->Arg1);
+  if (Partition == NULL) {
+    MockSpmcError (Args, ARM_FFA_RET_INVALID_PARAMETERS);
+    return;
+  }
+
+  if (Partition->PreemptCount > 0) {
+    Partition->RequestPending = TRUE;
+    CopyMem (&Partition->Request, Args, sizeof (*Args));
+    MockSpmcPreempt (Partition, Args);
+    return;
+  }
+
+  Partition->Handler (Args);
+}
+
+/**
+  Models FFA_RUN: resumes a partition holding back a direct request.
+
+  @param  Args  Call registers on input, result registers on output.
+
+**/
+STATIC
+VOID
+MockSpmcRun (
+  IN OUT ARM_SVC_ARGS  *Args
+  )
+{
+  MOCK_SPMC_PARTITION  *Partition;
+
+  Partition = MockSpmcFindPartition ((UINT16)(Args->Arg1 >> 16));
+  if (Partition == NULL) {
+    MockSpmcError (Args, ARM_FFA_RET_INVALID_PARAMETERS);
+    return;
+  }
+
+  if (!Partition->RequestPending) {
+    MockSpmcError (Args, ARM_FFA_RET_DENIED);
+    return;
+  }
+
+  if (Partition->PreemptCount > 0) {
+    MockSpmcPreempt (Partition, Args);
+    return;
+  }
+
+  Partition->RequestPending = FALSE;
+  CopyMem (Args, &Partition->Request, sizeof (*Args));
+  Partition->Handler (Args);
+}
+
+/**
+  Hands the next queued message to the code under test, or FFA_SUCCESS if
+  none is queued.
+
+  @param  Args  Receives the message.
+
+**/
+STATIC
+VOID
+MockSpmcDeliverMessage (
+  OUT ARM_SVC_ARGS  *Args
+  )
+{
+  if (mSpmc.MessageCount == 0) {
+    MockSpmcSuccess (Args);
+    return;
+  }
+
+  CopyMem (Args, &mSpmc.Messages[mSpmc.MessageHead], sizeof (*Args));
+  mSpmc.MessageHead = (mSpmc.MessageHead + 1) % MOCK_SPMC_MAX_MESSAGES;
+  mSpmc.MessageCount--;
+}
+
+/**
+  Models FFA_MSG_WAIT: the RX buffer is released unless the caller retains
+  it, then the next queued message is delivered.
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+STATIC
+VOID
+MockSpmcMsgWait (
+  IN OUT ARM_SVC_ARGS  *Args
+  )
+{
+  if (((UINT32)Args->Arg2 & MOCK_SPMC_MSG_WAIT_FLAG_RETAIN_RX) == 0) {
+    mSpmc.RxFull = FALSE;
+  }
+
+  MockSpmcDeliverMessage (Args);
+}
+
+/**
+  Returns the pending bitmaps of a receiver.
+
+  @param  ReceiverId  The receiver partition ID.
+  @param  FromSp      Receives the bitmap of notifications set by SPs.
+  @param  FromVm      Receives the bitmap of notifications set by VMs.
+
+  @retval TRUE   The receiver is known to the model.
+  @retval FALSE  The receiver is unknown.
+**/
+STATIC
+BOOLEAN
+MockSpmcPendingBitmaps (
+  IN  UINT16  ReceiverId,
+  OUT UINT64  **FromSp,
+  OUT UINT64  **FromVm
+  )
+{
+  MOCK_SPMC_PARTITION  *Partition;
+
+  if (ReceiverId == MOCK_SPMC_CALLER_ID) {
+    *FromSp = &mSpmc.CallerPendingFromSp;
+    *FromVm = &mSpmc.CallerPendingFromVm;
+    return TRUE;
+  }
+
+  Partition = MockSpmcFindPartition (ReceiverId);
+  if (Partition == NULL) {
+    return FALSE;
+  }
+
+  *FromSp = &Partition->PendingFromSp;
+  *FromVm = &Partition->PendingFromVm;
+  return TRUE;
+}
+
+/**
+  Models FFA_NOTIFICATION_SET.
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+STATIC
+VOID
+MockSpmcNotificationSet (
+  IN OUT ARM_SVC_ARGS  *Args
+  )
+{
+  UINT16               Sender;
+  UINT64               *FromSp;
+  UINT64               *FromVm;
+  UINT64               Bitmap;
+  UINTN                Flags;
+  MOCK_SPMC_PARTITION  *Receiver;
+
+  Sender = (UINT16)(Args->Arg1 >> 16);
+  Flags  = Args->Arg2;
+  Bitmap = ((UINT64)(UINT32)Args->Arg4 << 32) | (UINT32)Args->Arg3;
+
+  if (!MockSpmcPendingBitmaps ((UINT16)Args->Arg1, &FromSp, &FromVm)) {
+    MockSpmcError (Args, ARM_FFA_RET_INVALID_PARAMETERS);
+    return;
+  }
+
+  if (MOCK_SPMC_IS_SP_ID (Sender)) {
+    *FromSp |= Bitmap;
+  } else {
+    *FromVm |= Bitmap;
+  }
+
+  Receiver = MockSpmcFindPartition ((UINT16)Args->Arg1);
+  if (Receiver != NULL) {
+    if ((Flags & MOCK_SPMC_NOTIFICATION_FLAG_PER_VCPU) != 0) {
+      Receiver->InfoVcpus |= 1U << ((Flags >> MOCK_SPMC_NOTIFICATION_VCPU_SHIFT) & 0x1F);
+    } else {
+      Receiver->InfoGlobal = TRUE;
+    }
+  }
+
+  MockSpmcSuccess (Args);
+}
+
+/**
+  Models FFA_NOTIFICATION_GET. Returned notifications are cleared.
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+STATIC
+VOID
+MockSpmcNotificationGet (
+  IN OUT ARM_SVC_ARGS  *Args
+  )
+{
+  UINT64  *FromSp;
+  UINT64  *FromVm;
+  UINT64  SpBitmap;
+  UINT64  VmBitmap;
+  UINTN   Flags;
+
+  Flags = Args->Arg2;
+  if (!MockSpmcPendingBitmaps ((UINT16)Args->Arg1, &FromSp, &FromVm)) {
+    MockSpmcError (Args, ARM_FFA_RET_INVALID_PARAMETERS);
+    return;
+  }
+
+  SpBitmap = 0;
+  VmBitmap = 0;
+  if ((Flags & ARM_FFA_NOTIFICATION_FLAG_BITMAP_SP) != 0) {
+    SpBitmap = *FromSp;
+    *FromSp  = 0;
+  }
+
+  if ((Flags & ARM_FFA_NOTIFICATION_FLAG_BITMAP_VM) != 0) {
+    VmBitmap = *FromVm;
+    *FromVm  = 0;
+  }
+
+  MockSpmcSuccess (Args);
+  Args->Arg2 = (UINT32)SpBitmap;
+  Args->Arg3 = (UINT32)RShiftU64 (SpBitmap, 32);
+  Args->Arg4 = (UINT32)VmBitmap;
+  Args->Arg5 = (UINT32)RShiftU64 (VmBitmap, 32);
+}
+
+/**
+  Appends one 16-bit ID to the FFA_NOTIFICATION_INFO_GET response.
+
+  @param  Args     The response registers.
+  @param  IdCount  Number of IDs already packed, incremented.
+  @param  Id       The ID.
+
+**/
+STATIC
+VOID
+MockSpmcPackInfoId (
+  IN OUT ARM_SVC_ARGS  *Args,
+  IN OUT UINTN         *IdCount,
+  IN     UINT16        Id
+  )
+{
+  UINTN  *Registers;
+
+  Registers                = &Args->Arg3;
+  Registers[*IdCount / 4] |= (UINTN)LShiftU64 (Id, (*IdCount % 4) * 16);
+  (*IdCount)++;
+}
+
+/**
+  Models FFA_NOTIFICATION_INFO_GET. Every pending global notification and
+  every vCPU with pending per-vCPU notifications is reported once.
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+STATIC
+VOID
+MockSpmcNotificationInfoGet (
+  IN OUT ARM_SVC_ARGS  *Args
+  )
+{
+  MOCK_SPMC_PARTITION  *Partition;
+  UINTN                IdCount;
+  UINTN                ListCount;
+  UINTN                ListSize;
+  UINTN                Index;
+  UINT32               Vcpu;
+  BOOLEAN              MorePending;
+
+  MockSpmcSuccess (Args);
+  IdCount     = 0;
+  ListCount   = 0;
+  MorePending = FALSE;
+
+  for (Index = 0; Index < mSpmc.PartitionCount; Index++) {
+    Partition = &mSpmc.Partitions[Index];
+
+    if (Partition->InfoGlobal) {
+      if (IdCount + 1 > MOCK_SPMC_NOTIFICATION_INFO_MAX_IDS) {
+        MorePending = TRUE;
+        break;
+      }
+
+      MockSpmcPackInfoId (Args, &IdCount, Partition->PartitionId);
+      ListCount++;
+      Partition->InfoGlobal = FALSE;
+    }
+
+    //
+    // One list per up to three vCPUs.
+    //
+    while (Partition->InfoVcpus != 0) {
+      if (IdCount + 2 > MOCK_SPMC_NOTIFICATION_INFO_MAX_IDS) {
+        MorePending = TRUE;
+        break;
+      }
+
+      MockSpmcPackInfoId (Args, &IdCount, Partition->PartitionId);
+      ListSize = 0;
+      for (Vcpu = 0; Vcpu < 32; Vcpu++) {
+        if ((ListSize == MOCK_SPMC_NOTIFICATION_INFO_MAX_VCPUS) ||
+            (IdCount == MOCK_SPMC_NOTIFICATION_INFO_MAX_IDS))
+        {
+          break;
+        }
+
+        if ((Partition->InfoVcpus & (1U << Vcpu)) != 0) {
+          MockSpmcPackInfoId (Args, &IdCount, (UINT16)Vcpu);
+          Partition->InfoVcpus &= ~(1U << Vcpu);
+          ListSize++;
+        }
+      }
+
+      Args->Arg2 |= ListSize << (MOCK_SPMC_NOTIFICATION_INFO_LIST_SIZE_SHIFT + 2 * ListCount);
+      ListCount++;
+    }
+
+    if (MorePending) {
+      break;
+    }
+  }
+
+  if (ListCount == 0) {
+    MockSpmcError (Args, ARM_FFA_RET_NODATA);
+    return;
+  }
+
+  Args->Arg2 |= ListCount << MOCK_SPMC_NOTIFICATION_INFO_LIST_COUNT_SHIFT;
+  if (MorePending) {
+    Args->Arg2 |= BIT0;
+  }
+}
+
+/**
+  Models FFA_MSG_SEND2: the message in the TX buffer of the code under test is
+  copied to the RX buffer of the receiver.
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+STATIC
+VOID
+MockSpmcMsgSend2 (
+  IN OUT ARM_SVC_ARGS  *Args
+  )
+{
+  MOCK_SPMC_MSG_HEADER  *Header;
+  MOCK_SPMC_PARTITION   *Receiver;
+
+  Header = (MOCK_SPMC_MSG_HEADER *)mSpmc.TxBuffer;
+  if ((Header->SenderId != MOCK_SPMC_CALLER_ID) ||
+      (Header->PayloadOffset < sizeof (*Header)) ||
+      (Header->PayloadOffset > MOCK_SPMC_RXTX_SIZE) ||
+      (Header->PayloadSize > MOCK_SPMC_RXTX_SIZE - Header->PayloadOffset))
+  {
+    MockSpmcError (Args, ARM_FFA_RET_INVALID_PARAMETERS);
+    return;
+  }
+
+  Receiver = MockSpmcFindPartition (Header->ReceiverId);
+  if (Receiver == NULL) {
+    MockSpmcError (Args, ARM_FFA_RET_INVALID_PARAMETERS);
+    return;
+  }
+
+  if (Receiver->MailboxFull) {
+    MockSpmcError (Args, ARM_FFA_RET_BUSY);
+    return;
+  }
+
+  CopyMem (Receiver->Mailbox, Header, Header->PayloadOffset + Header->PayloadSize);
+  Receiver->MailboxFull = TRUE;
+  MockSpmcSuccess (Args);
+}
+
+/**
+  Models FFA_RX_RELEASE.
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+STATIC
+VOID
+MockSpmcRxRelease (
+  IN OUT ARM_SVC_ARGS  *Args
+  )
+{
+  if (!mSpmc.RxFull) {
+    MockSpmcError (Args, ARM_FFA_RET_DENIED);
+    return;
+  }
+
+  mSpmc.RxFull = FALSE;
+  MockSpmcSuccess (Args);
+}
+
+/**
+  Answers a memory transaction fragment: FFA_MEM_FRAG_RX while more of the
+  descriptor is due, FFA_SUCCESS with the handle once it is complete.
+
+  @param  Region  The transaction the fragment belongs to.
+  @param  Args    Response registers on output.
+
+**/
+STATIC
+VOID
+MockSpmcMemFragmentDone (
+  IN  CONST MOCK_SPMC_MEM_REGION  *Region,
+  OUT ARM_SVC_ARGS                *Args
+  )
+{
+  if (Region->ReceivedLength < Region->TotalLength) {
+    ZeroMem (Args, sizeof (*Args));
+    Args->Arg0 = ARM_FID_FFA_MEM_FRAG_RX;
+    Args->Arg1 = (UINT32)Region->Handle;
+    Args->Arg2 = (UINT32)RShiftU64 (Region->Handle, 32);
+    Args->Arg3 = Region->ReceivedLength;
+    return;
+  }
+
+  MockSpmcSuccess (Args);
+  Args->Arg2 = (UINT32)Region->Handle;
+  Args->Arg3 = (UINT32)RShiftU64 (Region->Handle, 32);
+}
+
+/**
+  Models the memory transaction ABIs that create a handle (donate, lend and
+  share).
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+STATIC
+VOID
+MockSpmcMemTransaction (
+  IN OUT ARM_SVC_ARGS  *Args
+  )
+{
+  UINTN   Index;
+  UINT64  Handle;
+  UINT32  TotalLength;
+  UINT32  FragmentLength;
+
+  for (Index = 0; Index < MOCK_SPMC_MAX_HANDLES; Index++) {
+    if (mSpmc.Regions[Index].Handle == 0) {
+      break;
+    }
+  }
+
+  if (Index == MOCK_SPMC_MAX_HANDLES) {
+    MockSpmcError (Args, ARM_FFA_RET_NO_MEMORY);
+    return;
+  }
+
+  TotalLength    = (UINT32)Args->Arg1;
+  FragmentLength = (UINT32)Args->Arg2;
+  if ((FragmentLength == 0) || (FragmentLength > TotalLength)) {
+    MockSpmcError (Args, ARM_FFA_RET_INVALID_PARAMETERS);
+    return;
+  }
+
+  Handle                              = mSpmc.NextHandle++;
+  mSpmc.Regions[Index].Handle         = Handle;
+  mSpmc.Regions[Index].TotalLength    = TotalLength;
+  mSpmc.Regions[Index].ReceivedLength = TotalLength;
+
+  //
+  // A descriptor passed in a buffer of the caller's own is not modeled, only
+  // one in the TX buffer is reassembled.
+  //
+  if (Args->Arg3 == 0) {
+    if ((TotalLength > MOCK_SPMC_MEM_DESC_SIZE) || (FragmentLength > MOCK_SPMC_RXTX_SIZE)) {
+      ZeroMem (&mSpmc.Regions[Index], sizeof (mSpmc.Regions[Index]));
+      MockSpmcError (Args, ARM_FFA_RET_NO_MEMORY);
+      return;
+    }
+
+    CopyMem (mSpmc.MemDesc, mSpmc.TxBuffer, FragmentLength);
+    mSpmc.MemDescHandle                 = Handle;
+    mSpmc.Regions[Index].ReceivedLength = FragmentLength;
+  }
+
+  MockSpmcMemFragmentDone (&mSpmc.Regions[Index], Args);
+}
+
+/**
+  Models FFA_MEM_FRAG_TX.
+
+  A fragment that does not fit the transaction aborts it, as on a real SPMC.
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+STATIC
+VOID
+MockSpmcMemFragTx (
+  IN OUT ARM_SVC_ARGS  *Args
+  )
+{
+  MOCK_SPMC_MEM_REGION  *Region;
+  UINTN                 Index;
+  UINT64                Handle;
+  UINT32                FragmentLength;
+
+  Handle = ((UINT64)(UINT32)Args->Arg2 << 32) | (UINT32)Args->Arg1;
+  Region = NULL;
+  for (Index = 0; Index < MOCK_SPMC_MAX_HANDLES; Index++) {
+    if ((Handle != 0) && (mSpmc.Regions[Index].Handle == Handle)) {
+      Region = &mSpmc.Regions[Index];
+      break;
+    }
+  }
+
+  if ((Region == NULL) || (Region->ReceivedLength == Region->TotalLength)) {
+    MockSpmcError (Args, ARM_FFA_RET_INVALID_PARAMETERS);
+    return;
+  }
+
+  FragmentLength = (UINT32)Args->Arg3;
+  if ((FragmentLength == 0) || (FragmentLength > MOCK_SPMC_RXTX_SIZE) ||
+      ((FragmentLength % MOCK_SPMC_MEM_CONSTITUENT_SIZE) != 0) ||
+      (FragmentLength > Region->TotalLength - Region->ReceivedLength))
+  {
+    ZeroMem (Region, sizeof (*Region));
+    MockSpmcError (Args, ARM_FFA_RET_INVALID_PARAMETERS);
+    return;
+  }
+
+  CopyMem (mSpmc.MemDesc + Region->ReceivedLength, mSpmc.TxBuffer, FragmentLength);
+  Region->ReceivedLength += FragmentLength;
+
+  MockSpmcMemFragmentDone (Region, Args);
+}
+
+/**
+  Returns the length of the next fragment of a retrieve response: whatever
+  is left of the descriptor, cut to a whole number of constituents if it does
+  not fit the RX buffer.
+
+  @param  TotalLength  The length of the descriptor.
+
+  @retval The fragment length.
+**/
+STATIC
+UINT32
+MockSpmcRetrieveFragmentLength (
+  IN UINT32  TotalLength
+  )
+{
+  UINT32  Length;
+  UINT32  Start;
+
+  Length = TotalLength - mSpmc.RetrieveOffset;
+  if (Length <= MOCK_SPMC_RXTX_SIZE) {
+    return Length;
+  }
+
+  //
+  // Constituents start after the composite descriptor of the first receiver
+  // in the first fragment, at the start of every other fragment.
+  //
+  Start = 0;
+  if (mSpmc.RetrieveOffset == 0) {
+    Start = *(UINT32 *)(mSpmc.MemDesc + MOCK_SPMC_MEM_ACCESS_OFFSET_OFFSET);
+    Start = *(UINT32 *)(mSpmc.MemDesc + Start + MOCK_SPMC_MEM_COMPOSITE_OFFSET_OFFSET) +
+            MOCK_SPMC_MEM_COMPOSITE_SIZE;
+  }
+
+  return Start + (MOCK_SPMC_RXTX_SIZE - Start) / MOCK_SPMC_MEM_CONSTITUENT_SIZE * MOCK_SPMC_MEM_CONSTITUENT_SIZE;
+}
+
+/**
+  Finds the completed memory transaction a handle identifies.
+
+  @param  Handle  The handle.
+
+  @retval The transaction, or NULL if none matches or it still has fragments
+          due.
+**/
+STATIC
+MOCK_SPMC_MEM_REGION *
+MockSpmcFindMemRegion (
+  IN UINT64  Handle
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < MOCK_SPMC_MAX_HANDLES; Index++) {
+    if ((Handle != 0) && (mSpmc.Regions[Index].Handle == Handle) &&
+        (mSpmc.Regions[Index].ReceivedLength == mSpmc.Regions[Index].TotalLength))
+    {
+      return &mSpmc.Regions[Index];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Models FFA_MEM_RETRIEVE_REQ.
+
+  A request for the last transaction passed in the TX buffer is answered with
+  its descriptor in the RX buffer, in as many fragments as needed. Any other
+  request is answered with a response as long as the request, without data.
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+STATIC
+VOID
+MockSpmcMemRetrieveReq (
+  IN OUT ARM_SVC_ARGS  *Args
+  )
+{
+  MOCK_SPMC_MEM_REGION  *Region;
+  UINT64                Handle;
+  UINT32                FragmentLength;
+
+  Handle = 0;
+  if ((Args->Arg3 == 0) && (Args->Arg1 >= MOCK_SPMC_MEM_HANDLE_OFFSET + sizeof (Handle))) {
+    CopyMem (&Handle, (UINT8 *)mSpmc.TxBuffer + MOCK_SPMC_MEM_HANDLE_OFFSET, sizeof (Handle));
+  }
+
+  Region = NULL;
+  if ((Handle != 0) && (Handle == mSpmc.MemDescHandle)) {
+    Region = MockSpmcFindMemRegion (Handle);
+  }
+
+  if (Region == NULL) {
+    Args->Arg0 = ARM_FID_FFA_MEM_RETRIEVE_RESP;
+    Args->Arg3 = 0;
+    Args->Arg4 = 0;
+    return;
+  }
+
+  if (mSpmc.RxFull) {
+    MockSpmcError (Args, ARM_FFA_RET_BUSY);
+    return;
+  }
+
+  mSpmc.RetrieveOffset = 0;
+  FragmentLength       = MockSpmcRetrieveFragmentLength (Region->TotalLength);
+  CopyMem (mSpmc.RxBuffer, mSpmc.MemDesc, FragmentLength);
+  mSpmc.RetrieveOffset = FragmentLength;
+  mSpmc.RxFull         = TRUE;
+
+  ZeroMem (Args, sizeof (*Args));
+  Args->Arg0 = ARM_FID_FFA_MEM_RETRIEVE_RESP;
+  Args->Arg1 = Region->TotalLength;
+  Args->Arg2 = FragmentLength;
+}
+
+/**
+  Models FFA_MEM_FRAG_RX from a borrower: places the next fragment of the
+  retrieve response in the RX buffer.
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+STATIC
+VOID
+MockSpmcMemFragRx (
+  IN OUT ARM_SVC_ARGS  *Args
+  )
+{
+  MOCK_SPMC_MEM_REGION  *Region;
+  UINT64                Handle;
+  UINT32                FragmentLength;
+
+  Handle = ((UINT64)(UINT32)Args->Arg2 << 32) | (UINT32)Args->Arg1;
+  Region = NULL;
+  if (Handle == mSpmc.MemDescHandle) {
+    Region = MockSpmcFindMemRegion (Handle);
+  }
+
+  if ((Region == NULL) || !mSpmc.RxFull || ((UINT32)Args->Arg3 != mSpmc.RetrieveOffset) ||
+      (mSpmc.RetrieveOffset == Region->TotalLength))
+  {
+    MockSpmcError (Args, ARM_FFA_RET_INVALID_PARAMETERS);
+    return;
+  }
+
+  FragmentLength = MockSpmcRetrieveFragmentLength (Region->TotalLength);
+  CopyMem (mSpmc.RxBuffer, mSpmc.MemDesc + mSpmc.RetrieveOffset, FragmentLength);
+  mSpmc.RetrieveOffset += FragmentLength;
+
+  ZeroMem (Args, sizeof (*Args));
+  Args->Arg0 = ARM_FID_FFA_MEM_FRAG_TX;
+  Args->Arg1 = (UINT32)Handle;
+  Args->Arg2 = (UINT32)RShiftU64 (Handle, 32);
+  Args->Arg3 = FragmentLength;
+}
+
+/**
+  Models FFA_MEM_RECLAIM.
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+STATIC
+VOID
+MockSpmcMemReclaim (
+  IN OUT ARM_SVC_ARGS  *Args
+  )
+{
+  UINTN   Index;
+  UINT64  Handle;
+
+  Handle = ((UINT64)(UINT32)Args->Arg2 << 32) | (UINT32)Args->Arg1;
+  for (Index = 0; Index < MOCK_SPMC_MAX_HANDLES; Index++) {
+    if ((Handle != 0) && (mSpmc.Regions[Index].Handle == Handle)) {
+      ZeroMem (&mSpmc.Regions[Index], sizeof (mSpmc.Regions[Index]));
+      MockSpmcSuccess (Args);
+      return;
+    }
+  }
+
+  MockSpmcError (Args, ARM_FFA_RET_INVALID_PARAMETERS);
+}
+
+/**
+  Returns the permissions last set on a page.
+
+  @param  Address     An address in the page.
+  @param  MemoryPerm  Receives the permission attributes.
+
+  @retval TRUE   The permissions were returned.
+  @retval FALSE  No permissions were ever set on the page.
+**/
+STATIC
+BOOLEAN
+MockSpmcFindMemPerm (
+  IN  UINT64  Address,
+  OUT UINT32  *MemoryPerm
+  )
+{
+  MOCK_SPMC_PERM_RANGE  *Range;
+  UINTN                 Index;
+
+  for (Index = mSpmc.PermRangeCount; Index-- > 0;) {
+    Range = &mSpmc.PermRanges[Index];
+    if ((Address >= Range->BaseAddress) &&
+        (Address - Range->BaseAddress < EFI_PAGES_TO_SIZE ((UINTN)Range->PageCount)))
+    {
+      *MemoryPerm = Range->MemoryPerm;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/**
+  Records the permissions of a range of pages.
+
+  @param  BaseAddress  Base of the range.
+  @param  PageCount    Number of 4K pages in the range.
+  @param  MemoryPerm   The permission attributes.
+
+  @retval TRUE   The permissions were recorded.
+  @retval FALSE  Too many ranges were set since the last reset.
+**/
+STATIC
+BOOLEAN
+MockSpmcAddMemPerm (
+  IN UINT64  BaseAddress,
+  IN UINT64  PageCount,
+  IN UINT32  MemoryPerm
+  )
+{
+  MOCK_SPMC_PERM_RANGE  *Range;
+
+  if (mSpmc.PermRangeCount == MOCK_SPMC_MAX_PERM_RANGES) {
+    return FALSE;
+  }
+
+  Range              = &mSpmc.PermRanges[mSpmc.PermRangeCount++];
+  Range->BaseAddress = BaseAddress;
+  Range->PageCount   = PageCount;
+  Range->MemoryPerm  = MemoryPerm;
+  return TRUE;
+}
+
+/**
+  Models FFA_MEM_PERM_GET and FFA_MEM_PERM_SET. The 32-bit variants only see
+  the low 32 bits of the base address, as on real hardware.
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+STATIC
+VOID
+MockSpmcMemPerm (
+  IN OUT ARM_SVC_ARGS  *Args
+  )
+{
+  UINT64  BaseAddress;
+  UINT32  MemoryPerm;
+
+  BaseAddress = Args->Arg1;
+  if (((UINT32)Args->Arg0 == ARM_FID_FFA_MEM_PERM_GET_AARCH32) ||
+      ((UINT32)Args->Arg0 == ARM_FID_FFA_MEM_PERM_SET_AARCH32))
+  {
+    BaseAddress = (UINT32)BaseAddress;
+  }
+
+  if (((UINT32)Args->Arg0 == ARM_FID_FFA_MEM_PERM_GET_AARCH32) ||
+      ((UINT32)Args->Arg0 == ARM_FID_FFA_MEM_PERM_GET_AARCH64))
+  {
+    if (!MockSpmcFindMemPerm (BaseAddress, &MemoryPerm)) {
+      MockSpmcError (Args, ARM_FFA_RET_INVALID_PARAMETERS);
+      return;
+    }
+
+    MockSpmcSuccess (Args);
+    Args->Arg2 = MemoryPerm;
+    return;
+  }
+
+  if (((BaseAddress & EFI_PAGE_MASK) != 0) || ((UINT32)Args->Arg2 == 0) ||
+      ((Args->Arg3 & ARM_FFA_MEM_PERM_RESERVED_MASK) != 0))
+  {
+    MockSpmcError (Args, ARM_FFA_RET_INVALID_PARAMETERS);
+    return;
+  }
+
+  if (!MockSpmcAddMemPerm (BaseAddress, (UINT32)Args->Arg2, (UINT32)Args->Arg3)) {
+    MockSpmcError (Args, ARM_FFA_RET_NO_MEMORY);
+    return;
+  }
+
+  MockSpmcSuccess (Args);
+}
+
+/**
+  Models FFA_CONSOLE_LOG.
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+STATIC
+VOID
+MockSpmcConsoleLog (
+  IN OUT ARM_SVC_ARGS  *Args
+  )
+{
+  UINTN  Length;
+  UINTN  CharSize;
+  UINTN  MaxLength;
+  UINTN  Index;
+  UINTN  *Registers;
+
+  //
+  // The 32-bit ABI packs 4 characters in each of w2-w7, the 64-bit one 8 in
+  // each of x2-x17.
+  //
+  Registers = &Args->Arg2;
+  if (Args->Arg0 == ARM_FID_FFA_CONSOLE_LOG_AARCH32) {
+    CharSize  = sizeof (UINT32);
+    MaxLength = 6 * sizeof (UINT32);
+  } else {
+    CharSize  = sizeof (UINT64);
+    MaxLength = 16 * sizeof (UINT64);
+  }
+
+  Length = Args->Arg1;
+  if ((Length == 0) || (Length > MaxLength)) {
+    MockSpmcError (Args, ARM_FFA_RET_INVALID_PARAMETERS);
+    return;
+  }
+
+  for (Index = 0; Index < Length; Index++) {
+    if (mSpmc.ConsoleLength + 1 >= MOCK_SPMC_CONSOLE_SIZE) {
+      break;
+    }
+
+    mSpmc.Console[mSpmc.ConsoleLength++] =
+      (CHAR8)RShiftU64 (Registers[Index / CharSize], (Index % CharSize) * 8);
+  }
+
+  mSpmc.Console[mSpmc.ConsoleLength] = '\0';
+  MockSpmcSuccess (Args);
+}
+
+/**
+  Models FFA_PARTITION_INFO_GET_REGS.
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+STATIC
+VOID
+MockSpmcPartitionInfoGetRegs (
+  IN OUT ARM_SVC_ARGS  *Args
+  )
+{
+  EFI_GUID                Uuid;
+  EFI_FFA_PART_INFO_DESC  Descs[MOCK_SPMC_PART_INFO_REGS_MAX_DESCS];
+  UINT16                  StartIndex;
+  UINT16                  Tag;
+  UINTN                   Matched;
+  UINTN                   Count;
+  UINTN                   Index;
+
+  CopyMem (&Uuid, &Args->Arg1, sizeof (Uuid));
+  StartIndex = (UINT16)Args->Arg3;
+  Tag        = (UINT16)(Args->Arg3 >> 16);
+
+  //
+  // A walk past the first window must carry the tag it was started with.
+  //
+  if ((StartIndex != 0) && (Tag != mSpmc.PartInfoTag)) {
+    MockSpmcError (Args, ARM_FFA_RET_RETRY);
+    return;
+  }
+
+  ZeroMem (Descs, sizeof (Descs));
+  Matched = 0;
+  Count   = 0;
+  for (Index = 0; Index < mSpmc.PartitionCount; Index++) {
+    if (!IsZeroGuid (&Uuid) && !CompareGuid (&Uuid, &mSpmc.Partitions[Index].Uuid)) {
+      continue;
+    }
+
+    if ((Matched >= StartIndex) && (Count < MOCK_SPMC_PART_INFO_REGS_MAX_DESCS)) {
+      Descs[Count].PartitionId                        = mSpmc.Partitions[Index].PartitionId;
+      Descs[Count].ExecContextCountOrProxyPartitionId = 1;
+      if (IsZeroGuid (&Uuid)) {
+        CopyMem (Descs[Count].PartitionUuid, &mSpmc.Partitions[Index].Uuid, sizeof (EFI_GUID));
+      }
+
+      Count++;
+    }
+
+    Matched++;
+  }
+
+  if ((Matched == 0) || (StartIndex >= Matched)) {
+    MockSpmcError (Args, ARM_FFA_RET_INVALID_PARAMETERS);
+    return;
+  }
+
+  MockSpmcSuccess (Args);
+  Args->Arg2 = (Matched - 1) |
+               ((StartIndex + Count - 1) << 16) |
+               LShiftU64 (mSpmc.PartInfoTag, 32) |
+               LShiftU64 (sizeof (EFI_FFA_PART_INFO_DESC), 48);
+  CopyMem (&Args->Arg3, Descs, Count * sizeof (EFI_FFA_PART_INFO_DESC));
+}
+
+/**
+  Models FFA_FEATURES.
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+STATIC
+VOID
+MockSpmcFeatures (
+  IN OUT ARM_SVC_ARGS  *Args
+  )
+{
+  UINT32  Id;
+  UINTN   Index;
+
+  Id = (UINT32)Args->Arg1;
+  if (Id == ARM_FFA_FEATURE_ID_SCHEDULE_RECEIVER_INTERRUPT) {
+    MockSpmcSuccess (Args);
+    Args->Arg2 = MOCK_SPMC_SRI_INTERRUPT_ID;
+    return;
+  }
+
+  for (Index = 0; Index < ARRAY_SIZE (mSupportedFids); Index++) {
+    if (mSupportedFids[Index] == Id) {
+      MockSpmcSuccess (Args);
+      return;
+    }
+  }
+
+  MockSpmcError (Args, ARM_FFA_RET_NOT_SUPPORTED);
+}
+
+/**
+  Answers one FF-A call, in place.
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+STATIC
+VOID
+MockSpmcCall (
+  IN OUT ARM_SVC_ARGS  *Args
+  )
+{
+  mSpmc.CallCount++;
+
+  if (mSpmc.InjectArmed && (mSpmc.InjectFunctionId == (UINT32)Args->Arg0)) {
+    if (mSpmc.InjectAfterCalls == 0) {
+      mSpmc.InjectArmed = FALSE;
+      MockSpmcError (Args, mSpmc.InjectStatus);
+      return;
+    }
+
+    mSpmc.InjectAfterCalls--;
+  }
+
+  if (mSpmc.InterruptArmed && (mSpmc.InterruptFunctionId == (UINT32)Args->Arg0)) {
+    mSpmc.InterruptArmed         = FALSE;
+    mSpmc.InterruptedCallPending = TRUE;
+    CopyMem (&mSpmc.InterruptedCall, Args, sizeof (*Args));
+    ZeroMem (Args, sizeof (*Args));
+    Args->Arg0 = ARM_FID_FFA_INTERRUPT;
+    Args->Arg2 = mSpmc.InterruptId;
+    return;
+  }
+
+  if (mSpmc.InterruptedCallPending && ((UINT32)Args->Arg0 == ARM_FID_FFA_WAIT)) {
+    if (((UINT32)Args->Arg2 & MOCK_SPMC_MSG_WAIT_FLAG_RETAIN_RX) == 0) {
+      mSpmc.RxFull = FALSE;
+    }
+
+    mSpmc.InterruptedCallPending = FALSE;
+    CopyMem (Args, &mSpmc.InterruptedCall, sizeof (*Args));
+  }
+
+  switch ((UINT32)Args->Arg0) {
+    case ARM_FID_FFA_VERSION:
+      ZeroMem (Args, sizeof (*Args));
+      Args->Arg0 = (MOCK_SPMC_MAJOR_VERSION << 16) | MOCK_SPMC_MINOR_VERSION;
+      break;
+
+    case ARM_FID_FFA_FEATURES:
+      MockSpmcFeatures (Args);
+      break;
+
+    case ARM_FID_FFA_ID_GET:
+      MockSpmcSuccess (Args);
+      Args->Arg2 = MOCK_SPMC_CALLER_ID;
+      break;
+
+    case ARM_FID_FFA_PARTITION_INFO_GET_REGS:
+      MockSpmcPartitionInfoGetRegs (Args);
+      break;
+
+    case ARM_FID_FFA_MSG_SEND_DIRECT_REQ_AARCH32:
+    case ARM_FID_FFA_MSG_SEND_DIRECT_REQ_AARCH64:
+    case ARM_FID_FFA_MSG_SEND_DIRECT_REQ2:
+      MockSpmcDirectRequest (Args);
+      break;
+
+    case ARM_FID_FFA_MSG_SEND2:
+      MockSpmcMsgSend2 (Args);
+      break;
+
+    case ARM_FID_FFA_RUN:
+      MockSpmcRun (Args);
+      break;
+
+    case ARM_FID_FFA_RX_RELEASE:
+      MockSpmcRxRelease (Args);
+      break;
+
+    case ARM_FID_FFA_WAIT:
+      MockSpmcMsgWait (Args);
+      break;
+
+    case ARM_FID_FFA_MSG_SEND_DIRECT_RESP_AARCH32:
+    case ARM_FID_FFA_MSG_SEND_DIRECT_RESP_AARCH64:
+    case ARM_FID_FFA_MSG_SEND_DIRECT_RESP2:
+      MockSpmcDeliverMessage (Args);
+      break;
+
+    case ARM_FID_FFA_NOTIFICATION_BITMAP_CREATE:
+    case ARM_FID_FFA_NOTIFICATION_BITMAP_DESTROY:
+    case ARM_FID_FFA_NOTIFICATION_BIND:
+    case ARM_FID_FFA_NOTIFICATION_UNBIND:
+      MockSpmcSuccess (Args);
+      break;
+
+    case ARM_FID_FFA_NOTIFICATION_SET:
+      MockSpmcNotificationSet (Args);
+      break;
+
+    case ARM_FID_FFA_NOTIFICATION_GET:
+      MockSpmcNotificationGet (Args);
+      break;
+
+    case ARM_FID_FFA_NOTIFICATION_INFO_GET_AARCH64:
+      MockSpmcNotificationInfoGet (Args);
+      break;
+
+    case ARM_FID_FFA_MEM_DONATE_AARCH32:
+    case ARM_FID_FFA_MEM_DONATE_AARCH64:
+    case ARM_FID_FFA_MEM_LEND_AARCH32:
+    case ARM_FID_FFA_MEM_LEND_AARCH64:
+    case ARM_FID_FFA_MEM_SHARE_AARCH32:
+    case ARM_FID_FFA_MEM_SHARE_AARCH64:
+      MockSpmcMemTransaction (Args);
+      break;
+
+    case ARM_FID_FFA_MEM_FRAG_TX:
+      MockSpmcMemFragTx (Args);
+      break;
+
+    case ARM_FID_FFA_MEM_RETRIEVE_REQ_AARCH32:
+    case ARM_FID_FFA_MEM_RETRIEVE_REQ_AARCH64:
+      MockSpmcMemRetrieveReq (Args);
+      break;
+
+    case ARM_FID_FFA_MEM_FRAG_RX:
+      MockSpmcMemFragRx (Args);
+      break;
+
+    case ARM_FID_FFA_MEM_RETRIEVE_RELINQUISH:
+      MockSpmcSuccess (Args);
+      break;
+
+    case ARM_FID_FFA_MEM_RETRIEVE_RECLAIM:
+      MockSpmcMemReclaim (Args);
+      break;
+
+    case ARM_FID_FFA_MEM_PERM_GET_AARCH32:
+    case ARM_FID_FFA_MEM_PERM_GET_AARCH64:
+    case ARM_FID_FFA_MEM_PERM_SET_AARCH32:
+    case ARM_FID_FFA_MEM_PERM_SET_AARCH64:
+      MockSpmcMemPerm (Args);
+      break;
+
+    case ARM_FID_FFA_CONSOLE_LOG_AARCH32:
+    case ARM_FID_FFA_CONSOLE_LOG_AARCH64:
+      MockSpmcConsoleLog (Args);
+      break;
+
+    default:
+      DEBUG ((DEBUG_INFO, "%a: FID 0x%lx is not modeled\n", __func__, Args->Arg0));
+      MockSpmcError (Args, ARM_FFA_RET_NOT_SUPPORTED);
+      break;
+  }
+}
+
+/**
+  Trigger an SVC call, answered by the SPMC model.
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+VOID
+ArmCallSvc (
+  IN OUT ARM_SVC_ARGS  *Args
+  )
+{
+  MockSpmcCall (Args);
+}
+
+/**
+  Trigger an SMC call, answered by the SPMC model.
+
+  @param  Args  Request registers on input, response registers on output.
+
+**/
+VOID
+ArmCallSmc (
+  IN OUT ARM_SMC_ARGS  *Args
+  )
+{
+  MockSpmcCall ((ARM_SVC_ARGS *)Args);
+}
+
+/**
+  Restores the model to its initial state: no partitions, no pending
+  notifications, no shared memory, no queued requests and an empty console.
+
+**/
+VOID
+EFIAPI
+MockSpmcReset (
+  VOID
+  )
+{
+  ZeroMem (&mSpmc, sizeof (mSpmc));
+  mSpmc.NextHandle  = 1;
+  mSpmc.PartInfoTag = 1;
+}
+
+/**
+  Restores the model to its initial state and initializes ArmFfaLibEx
+  against it, the common fixture of the host tests.
+
+  @retval The status of the ArmFfaLibEx constructor.
+**/
+RETURN_STATUS
+EFIAPI
+MockSpmcResetAndInit (
+  VOID
+  )
+{
+  MockSpmcReset ();
+  return ArmFfaLibExConstructor ();
+}
+
+/**
+  Adds a partition that direct requests can be sent to.
+
+  @param  PartitionId  The partition ID.
+  @param  Handler      Handler answering its direct requests. If NULL, the
+                       partition echoes every request back as a response.
+
+  @retval EFI_SUCCESS           The partition was added.
+  @retval EFI_OUT_OF_RESOURCES  The partition table is full.
+**/
+EFI_STATUS
+EFIAPI
+MockSpmcAddPartition (
+  IN UINT16                        PartitionId,
+  IN MOCK_SPMC_DIRECT_REQ_HANDLER  Handler OPTIONAL
+  )
+{
+  MOCK_SPMC_PARTITION  *Partition;
+
+  if (mSpmc.PartitionCount == MOCK_SPMC_MAX_PARTITIONS) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Partition = &mSpmc.Partitions[mSpmc.PartitionCount++];
+  ZeroMem (Partition, sizeof (*Partition));
+  Partition->PartitionId = PartitionId;
+  Partition->Handler     = (Handler != NULL) ? Handler : MockSpmcEchoHandler;
+  mSpmc.PartInfoTag++;
+  return EFI_SUCCESS;
+}
+
+/**
+  Sets the UUID a partition reports through FFA_PARTITION_INFO_GET_REGS.
+
+  @param  PartitionId  The partition ID.
+  @param  Uuid         The UUID, in EFI_GUID byte order.
+
+  @retval EFI_SUCCESS    The UUID was set.
+  @retval EFI_NOT_FOUND  The partition is not modeled.
+**/
+EFI_STATUS
+EFIAPI
+MockSpmcSetPartitionUuid (
+  IN UINT16          PartitionId,
+  IN CONST EFI_GUID  *Uuid
+  )
+{
+  MOCK_SPMC_PARTITION  *Partition;
+
+  Partition = MockSpmcFindPartition (PartitionId);
+  if (Partition == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  CopyGuid (&Partition->Uuid, Uuid);
+  Partition->Uuid.Data1 = SwapBytes32 (Partition->Uuid.Data1);
+  Partition->Uuid.Data2 = SwapBytes16 (Partition->Uuid.Data2);
+  Partition->Uuid.Data3 = SwapBytes16 (Partition->Uuid.Data3);
+  mSpmc.PartInfoTag++;
+  return EFI_SUCCESS;
+}
+
+/**
+  Makes one future call fail with FFA_ERROR.
+
+  @param  FunctionId  The function ID of the call to fail.
+  @param  Status      The FF-A status code to return.
+  @param  AfterCalls  Number of calls with FunctionId to answer normally
+                      before the failing one.
+
+**/
+VOID
+EFIAPI
+MockSpmcInjectError (
+  IN UINT32  FunctionId,
+  IN INT32   Status,
+  IN UINTN   AfterCalls
+  )
+{
+  mSpmc.InjectArmed      = TRUE;
+  mSpmc.InjectFunctionId = FunctionId;
+  mSpmc.InjectStatus     = Status;
+  mSpmc.InjectAfterCalls = AfterCalls;
+}
+
+/**
+  Makes one future call be preempted by an interrupt.
+
+  The call is answered with FFA_INTERRUPT. The FFA_MSG_WAIT that ends the
+  interrupt handling is then answered as the preempted call would have been.
+
+  @param  FunctionId   The function ID of the call to preempt.
+  @param  InterruptId  The interrupt ID to report.
+
+**/
+VOID
+EFIAPI
+MockSpmcRaiseInterrupt (
+  IN UINT32  FunctionId,
+  IN UINT32  InterruptId
+  )
+{
+  mSpmc.InterruptArmed      = TRUE;
+  mSpmc.InterruptFunctionId = FunctionId;
+  mSpmc.InterruptId         = InterruptId;
+}
+
+/**
+  Makes a partition hold back its response to the next direct requests.
+
+  The request is answered with FunctionId, FFA_YIELD or FFA_INTERRUPT, naming
+  the partition. Each FFA_RUN resuming the partition is answered the same way
+  until Count preemptions were reported, then with the response.
+
+  @param  PartitionId  The partition ID.
+  @param  FunctionId   ARM_FID_FFA_YIELD or ARM_FID_FFA_INTERRUPT.
+  @param  Count        Number of preemptions to report.
+
+  @retval EFI_SUCCESS    The preemptions were set up.
+  @retval EFI_NOT_FOUND  The partition is not modeled.
+**/
+EFI_STATUS
+EFIAPI
+MockSpmcPreemptPartition (
+  IN UINT16  PartitionId,
+  IN UINT32  FunctionId,
+  IN UINTN   Count
+  )
+{
+  MOCK_SPMC_PARTITION  *Partition;
+
+  Partition = MockSpmcFindPartition (PartitionId);
+  if (Partition == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  Partition->PreemptFunctionId = FunctionId;
+  Partition->PreemptCount      = Count;
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns the interrupts handed to SecurePartitionInterruptHandler since the
+  last reset.
+
+  @param  InterruptIds  Optional, receives the interrupt IDs in the order they
+                        were handled.
+
+  @retval The number of interrupts handled.
+**/
+UINTN
+EFIAPI
+MockSpmcGetHandledInterrupts (
+  OUT CONST UINT32  **InterruptIds OPTIONAL
+  )
+{
+  if (InterruptIds != NULL) {
+    *InterruptIds = mSpmc.HandledInterrupts;
+  }
+
+  return mSpmc.HandledInterruptCount;
+}
+
+/**
+  Secure Partition interrupt handler, records the interrupt for
+  MockSpmcGetHandledInterrupts.
+
+  @param  InterruptId  The interrupt ID.
+
+**/
+VOID
+EFIAPI
+SecurePartitionInterruptHandler (
+  UINT32  InterruptId
+  )
+{
+  if (mSpmc.HandledInterruptCount < MOCK_SPMC_MAX_INTERRUPTS) {
+    mSpmc.HandledInterrupts[mSpmc.HandledInterruptCount++] = InterruptId;
+  }
+}
+
+/**
+  Queues a message for the code under test. It is returned by the next
+  FFA_MSG_WAIT or direct response the code under test issues.
+
+  @param  Message  The registers to return.
+
+  @retval EFI_SUCCESS           The message was queued.
+  @retval EFI_OUT_OF_RESOURCES  The queue is full.
+**/
+EFI_STATUS
+EFIAPI
+MockSpmcQueueMessage (
+  IN CONST ARM_SVC_ARGS  *Message
+  )
+{
+  UINTN  Tail;
+
+  if (mSpmc.MessageCount == MOCK_SPMC_MAX_MESSAGES) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Tail = (mSpmc.MessageHead + mSpmc.MessageCount) % MOCK_SPMC_MAX_MESSAGES;
+  CopyMem (&mSpmc.Messages[Tail], Message, sizeof (*Message));
+  mSpmc.MessageCount++;
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns the RX/TX buffers the model maps for the code under test.
+
+  @param  TxBuffer  Receives the TX buffer.
+  @param  RxBuffer  Receives the RX buffer.
+  @param  Size      Receives the size of each buffer.
+
+**/
+VOID
+EFIAPI
+MockSpmcGetRxTxBuffers (
+  OUT VOID   **TxBuffer,
+  OUT VOID   **RxBuffer,
+  OUT UINTN  *Size
+  )
+{
+  *TxBuffer = mSpmc.TxBuffer;
+  *RxBuffer = mSpmc.RxBuffer;
+  *Size     = MOCK_SPMC_RXTX_SIZE;
+}
+
+/**
+  Delivers an indirect message to the RX buffer of the code under test, as
+  FFA_MSG_SEND2 from another partition would.
+
+  @param  SenderId     The sender partition ID.
+  @param  ServiceGuid  Optional, the service GUID, in EFI_GUID byte order.
+  @param  Payload      The payload.
+  @param  PayloadSize  The size of the payload.
+
+  @retval EFI_SUCCESS           The message was delivered.
+  @retval EFI_NOT_READY         The RX buffer was not released since the last
+                                delivery.
+  @retval EFI_BAD_BUFFER_SIZE   The payload does not fit.
+**/
+EFI_STATUS
+EFIAPI
+MockSpmcDeliverIndirectMessage (
+  IN UINT16          SenderId,
+  IN CONST EFI_GUID  *ServiceGuid OPTIONAL,
+  IN CONST VOID      *Payload,
+  IN UINTN           PayloadSize
+  )
+{
+  MOCK_SPMC_MSG_HEADER  *Header;
+
+  if (mSpmc.RxFull) {
+    return EFI_NOT_READY;
+  }
+
+  if (PayloadSize > MOCK_SPMC_RXTX_SIZE - sizeof (*Header)) {
+    return EFI_BAD_BUFFER_SIZE;
+  }
+
+  Header = (MOCK_SPMC_MSG_HEADER *)mSpmc.RxBuffer;
+  ZeroMem (Header, sizeof (*Header));
+  Header->PayloadOffset = sizeof (*Header);
+  Header->ReceiverId    = MOCK_SPMC_CALLER_ID;
+  Header->SenderId      = SenderId;
+  Header->PayloadSize   = (UINT32)PayloadSize;
+  if (ServiceGuid != NULL) {
+    CopyGuid (&Header->ServiceGuid, ServiceGuid);
+    Header->ServiceGuid.Data1 = SwapBytes32 (Header->ServiceGuid.Data1);
+    Header->ServiceGuid.Data2 = SwapBytes16 (Header->ServiceGuid.Data2);
+    Header->ServiceGuid.Data3 = SwapBytes16 (Header->ServiceGuid.Data3);
+  }
+
+  CopyMem (Header + 1, Payload, PayloadSize);
+  mSpmc.RxFull = TRUE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Retrieves the indirect message last sent to a partition and empties its RX
+  buffer.
+
+  @param  ReceiverId   The receiver partition ID.
+  @param  SenderId     Optional, receives the sender partition ID.
+  @param  Payload      Receives the payload.
+  @param  PayloadSize  On input the size of Payload, on output the size of the
+                       message payload.
+
+  @retval EFI_SUCCESS           The message was retrieved.
+  @retval EFI_NOT_FOUND         No message is pending for the receiver.
+  @retval EFI_BUFFER_TOO_SMALL  Payload is too small, PayloadSize has the size
+                                needed.
+**/
+EFI_STATUS
+EFIAPI
+MockSpmcGetIndirectMessage (
+  IN     UINT16  ReceiverId,
+  OUT    UINT16  *SenderId OPTIONAL,
+  OUT    VOID    *Payload,
+  IN OUT UINTN   *PayloadSize
+  )
+{
+  MOCK_SPMC_PARTITION   *Receiver;
+  MOCK_SPMC_MSG_HEADER  *Header;
+
+  Receiver = MockSpmcFindPartition (ReceiverId);
+  if ((Receiver == NULL) || !Receiver->MailboxFull) {
+    return EFI_NOT_FOUND;
+  }
+
+  Header = (MOCK_SPMC_MSG_HEADER *)Receiver->Mailbox;
+  if (*PayloadSize < Header->PayloadSize) {
+    *PayloadSize = Header->PayloadSize;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  if (SenderId != NULL) {
+    *SenderId = Header->SenderId;
+  }
+
+  *PayloadSize = Header->PayloadSize;
+  CopyMem (Payload, Receiver->Mailbox + Header->PayloadOffset, Header->PayloadSize);
+  Receiver->MailboxFull = FALSE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Returns the descriptor of a memory transaction passed in the TX buffer, as
+  reassembled from all of its fragments.
+
+  @param  Handle      The handle of the memory region.
+  @param  Descriptor  Receives the memory transaction descriptor.
+  @param  Length      Receives the length of the descriptor.
+
+  @retval EFI_SUCCESS    The descriptor was returned.
+  @retval EFI_NOT_FOUND  Handle is not the last transaction passed in the TX
+                         buffer, or some of its fragments are still due.
+**/
+EFI_STATUS
+EFIAPI
+MockSpmcGetMemTransaction (
+  IN  UINT64      Handle,
+  OUT CONST VOID  **Descriptor,
+  OUT UINT32      *Length
+  )
+{
+  MOCK_SPMC_MEM_REGION  *Region;
+
+  Region = NULL;
+  if (mSpmc.MemDescHandle == Handle) {
+    Region = MockSpmcFindMemRegion (Handle);
+  }
+
+  if (Region == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  *Descriptor = mSpmc.MemDesc;
+  *Length     = Region->TotalLength;
+  return EFI_SUCCESS;
+}
+
+/**
+  Sets the permissions of a range of pages behind the back of the code under
+  test, as the SPMC does when it maps a partition.
+
+  @param  BaseAddress  Base of the range, page aligned.
+  @param  PageCount    Number of 4K pages in the range.
+  @param  MemoryPerm   The permission attributes.
+
+  @retval EFI_SUCCESS           The permissions were set.
+  @retval EFI_OUT_OF_RESOURCES  Too many ranges were set since the last reset.
+**/
+EFI_STATUS
+EFIAPI
+MockSpmcSetMemPerm (
+  IN UINT64  BaseAddress,
+  IN UINT64  PageCount,
+  IN UINT32  MemoryPerm
+  )
+{
+  return MockSpmcAddMemPerm (BaseAddress, PageCount, MemoryPerm) ? EFI_SUCCESS : EFI_OUT_OF_RESOURCES;
+}
+
+/**
+  Returns the permissions last set on a page, without counting as a call.
+
+  @param  Address     An address in the page.
+  @param  MemoryPerm  Receives the permission attributes.
+
+  @retval EFI_SUCCESS    The permissions were returned.
+  @retval EFI_NOT_FOUND  No permissions were ever set on the page.
+**/
+EFI_STATUS
+EFIAPI
+MockSpmcGetMemPerm (
+  IN  UINT64  Address,
+  OUT UINT32  *MemoryPerm
+  )
+{
+  return MockSpmcFindMemPerm (Address, MemoryPerm) ? EFI_SUCCESS : EFI_NOT_FOUND;
+}
+
+/**
+  Returns the notifications pending for a receiver without clearing them.
+
+  @param  ReceiverId  The receiver partition ID.
+  @param  FromSp      TRUE for the notifications set by secure partitions,
+                      FALSE for the ones set by VMs.
+
+  @retval The pending notification bitmap.
+**/
+UINT64
+EFIAPI
+MockSpmcGetPendingNotifications (
+  IN UINT16   ReceiverId,
+  IN BOOLEAN  FromSp
+  )
+{
+  UINT64  *SpBitmap;
+  UINT64  *VmBitmap;
+
+  if (!MockSpmcPendingBitmaps (ReceiverId, &SpBitmap, &VmBitmap)) {
+    return 0;
+  }
+
+  return FromSp ? *SpBitmap : *VmBitmap;
+}
+
+/**
+  Returns the characters logged through FFA_CONSOLE_LOG since the last reset.
+
+  @param  Length  Optional, receives the number of characters logged.
+
+  @retval A NUL-terminated string owned by the model.
+**/
+CONST CHAR8 *
+EFIAPI
+MockSpmcGetConsoleLog (
+  OUT UINTN  *Length OPTIONAL
+  )
+{
+  if (Length != NULL) {
+    *Length = mSpmc.ConsoleLength;
+  }
+
+  return mSpmc.Console;
+}
+
+/**
+  Returns the number of FF-A calls the model has answered since the last
+  reset.
+
+  @retval The number of calls.
+**/
+UINTN
+EFIAPI
+MockSpmcGetCallCount (
+  VOID
+  )
+{
+  return mSpmc.CallCount;
+}